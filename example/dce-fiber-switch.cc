@@ -0,0 +1,75 @@
+// Context switch micro-benchmark: two tasks yield to each other through
+// the TaskManager, once with each FiberManager implementation.
+//
+// ./waf --run "dce-fiber-switch --switches=1000000"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/dce-module.h"
+#include <time.h>
+#include <iostream>
+
+using namespace ns3;
+
+static uint32_t g_switches = 100000;
+
+static void
+YieldLoop (void *context)
+{
+  TaskManager *manager = TaskManager::Current ();
+  for (uint32_t i = 0; i < g_switches; i++)
+    {
+      manager->Yield ();
+    }
+  manager->Exit ();
+}
+
+static void
+StartTasks (Ptr<TaskManager> manager)
+{
+  manager->Start (&YieldLoop, 0);
+  manager->Start (&YieldLoop, 0);
+}
+
+static double
+Measure (std::string fiberManagerType)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::TaskManager");
+  factory.Set ("FiberManagerType", StringValue (fiberManagerType));
+  Ptr<TaskManager> manager = factory.Create<TaskManager> ();
+  factory.SetTypeId ("ns3::RrTaskScheduler");
+  manager->SetScheduler (factory.Create<TaskScheduler> ());
+  factory.SetTypeId ("ns3::RandomProcessDelayModel");
+  manager->SetDelayModel (factory.Create<ProcessDelayModel> ());
+  Ptr<Node> node = CreateObject<Node> ();
+  node->AggregateObject (manager);
+
+  Simulator::ScheduleWithContext (node->GetId (), Seconds (0.0), &StartTasks, manager);
+
+  struct timespec start, end;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  Simulator::Run ();
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  Simulator::Destroy ();
+
+  double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+  // each yield is a switch to the main fiber and a switch back.
+  return ns / (2.0 * 2 * g_switches);
+}
+
+int main (int argc, char *argv[])
+{
+  bool pthread = true;
+  CommandLine cmd;
+  cmd.AddValue ("switches", "Number of yields done by each of the two tasks", g_switches);
+  cmd.AddValue ("pthread", "Also measure the (slow) PthreadFiberManager", pthread);
+  cmd.Parse (argc, argv);
+
+  std::cout << "UcontextFiberManager: " << Measure ("UcontextFiberManager") << " ns/switch" << std::endl;
+  std::cout << "AsmFiberManager: " << Measure ("AsmFiberManager") << " ns/switch" << std::endl;
+  if (pthread)
+    {
+      std::cout << "PthreadFiberManager: " << Measure ("PthreadFiberManager") << " ns/switch" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,69 @@
+// poll micro-benchmark: a DCE process polls 10, 100 and 1000 empty pipes
+// in a loop and the host time spent in the simulation gives the number of
+// poll calls per second.
+//
+// ./waf --run "dce-poll-bench --polls=10000 --timeout=1"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/dce-module.h"
+#include <time.h>
+#include <iostream>
+#include <sstream>
+
+using namespace ns3;
+
+static double
+Measure (uint32_t nfds, uint32_t polls, uint32_t timeout)
+{
+  NodeContainer nodes;
+  nodes.Create (1);
+
+  InternetStackHelper stack;
+  stack.Install (nodes);
+
+  DceManagerHelper dceManager;
+  dceManager.Install (nodes);
+
+  DceApplicationHelper dce;
+  ApplicationContainer apps;
+
+  dce.SetStackSize (1 << 20);
+  dce.SetBinary ("poll-bench");
+  dce.ResetArguments ();
+  std::ostringstream nfdsArg, pollsArg, timeoutArg;
+  nfdsArg << nfds;
+  pollsArg << polls;
+  timeoutArg << timeout;
+  dce.AddArgument (nfdsArg.str ());
+  dce.AddArgument (pollsArg.str ());
+  dce.AddArgument (timeoutArg.str ());
+  apps = dce.Install (nodes.Get (0));
+  apps.Start (Seconds (1.0));
+
+  struct timespec start, end;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  Simulator::Run ();
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  Simulator::Destroy ();
+
+  double s = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  return polls / s;
+}
+
+int main (int argc, char *argv[])
+{
+  uint32_t polls = 10000;
+  uint32_t timeout = 1;
+  CommandLine cmd;
+  cmd.AddValue ("polls", "Number of poll calls done by the process", polls);
+  cmd.AddValue ("timeout", "poll timeout in ms, 0 to only scan the fds", timeout);
+  cmd.Parse (argc, argv);
+
+  uint32_t nfds[] = { 10, 100, 1000 };
+  for (uint32_t i = 0; i < sizeof (nfds) / sizeof (nfds[0]); i++)
+    {
+      std::cout << nfds[i] << " fds: " << Measure (nfds[i], polls, timeout) << " polls/s" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,41 @@
+// DCE application used by dce-poll-bench: polls the read end of n empty
+// pipes again and again.
+//
+// poll-bench <fds> <polls> <timeout ms>
+#include <unistd.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <iostream>
+
+int main (int argc, char *argv[])
+{
+  int nfds = argc > 1 ? atoi (argv[1]) : 10;
+  int polls = argc > 2 ? atoi (argv[2]) : 1000;
+  int timeout = argc > 3 ? atoi (argv[3]) : 1;
+
+  struct pollfd *fds = new struct pollfd [nfds];
+  for (int i = 0; i < nfds; i++)
+    {
+      int p[2];
+      if (pipe (p) != 0)
+        {
+          std::cerr << "pipe failed after " << i << " pipes" << std::endl;
+          return 1;
+        }
+      fds[i].fd = p[0];
+      fds[i].events = POLLIN;
+    }
+
+  // nothing is ever written: each poll registers on every pipe and times
+  // out, or only scans the pipes if timeout is 0.
+  for (int i = 0; i < polls; i++)
+    {
+      if (poll (fds, nfds, timeout) != 0)
+        {
+          std::cerr << "unexpected poll result" << std::endl;
+          return 1;
+        }
+    }
+  delete [] fds;
+  return 0;
+}
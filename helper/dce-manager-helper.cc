@@ -5,6 +5,7 @@
 #include "task-scheduler.h"
 #include "task-manager.h"
 #include "loader-factory.h"
+#include "file-system.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/uinteger.h"
 #include "ns3/string.h"
@@ -19,6 +20,8 @@
 #include <stdio.h>
 #include <limits.h>
 #include <errno.h>
+#include <ctype.h>
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("DceManagerHelper");
 
@@ -53,6 +56,7 @@ DceManagerHelper::DceManagerHelper ()
   m_managerFactory.SetTypeId ("ns3::DceManager");
   m_networkStackFactory.SetTypeId ("ns3::Ns3SocketFdFactory");
   m_delayFactory.SetTypeId ("ns3::RandomProcessDelayModel");
+  m_fileSystemFactory.SetTypeId ("ns3::HostFileSystem");
   m_virtualPath = "";
 }
 void
@@ -91,6 +95,13 @@ DceManagerHelper::SetNetworkStack (std::string type,
   m_networkStackFactory.Set (n0, v0);
 }
 void
+DceManagerHelper::SetFileSystem (std::string type,
+                                 std::string n0, const AttributeValue &v0)
+{
+  m_fileSystemFactory.SetTypeId (type);
+  m_fileSystemFactory.Set (n0, v0);
+}
+void
 DceManagerHelper::SetAttribute (std::string n1, const AttributeValue &v1)
 {
   m_managerFactory.Set (n1, v1);
@@ -124,6 +135,7 @@ DceManagerHelper::Install (Ptr<Node> node)
       node->AggregateObject (manager);
       node->AggregateObject (networkStack);
       node->AggregateObject (CreateObject<LocalSocketFdFactory> ());
+      node->AggregateObject (m_fileSystemFactory.Create<FileSystem> ());
       manager->AggregateObject (CreateObject<DceNodeContext> ());
       manager->SetVirtualPath (GetVirtualPath ());
 }
@@ -252,7 +264,33 @@ DceManagerHelper::GetProcStatus (void)
               crsr = next;
               next = 0;
 
-              ProcStatus st (node, exitcode, pid, nst, ned, rst, red, dur3, durr, crsr + 1);
+              // tid:peak,tid:peak... or - when unknown
+              std::map<int, uint32_t> peaks;
+              while (' ' == *crsr)
+                {
+                  crsr++;
+                }
+              if ('-' == *crsr)
+                {
+                  crsr++;
+                }
+              while (isdigit (*crsr))
+                {
+                  int tid = (int) strtol (crsr, &next, 10);
+                  if (':' != *next)
+                    {
+                      break;
+                    }
+                  crsr = next + 1;
+                  peaks[tid] = (uint32_t) strtoul (crsr, &next, 10);
+                  crsr = next;
+                  if (',' == *crsr)
+                    {
+                      crsr++;
+                    }
+                }
+
+              ProcStatus st (node, exitcode, pid, nst, ned, rst, red, dur3, durr, peaks, crsr + 1);
 
               res.push_back (st);
             }
@@ -278,6 +316,22 @@ ProcStatus::ProcStatus (int n, int e, int p, int64_t ns, int64_t ne, long rs, lo
 {
 }
 
+ProcStatus::ProcStatus (int n, int e, int p, int64_t ns, int64_t ne, long rs, long re, double nd, long rd,
+                        std::map<int, uint32_t> stackPeaks, std::string cmd)
+  : m_node (n),
+    m_exitCode (e),
+    m_pid (p),
+    m_ns3StartTime (ns),
+    m_ns3EndTime (ne),
+    m_realStartTime (rs),
+    m_realEndTime (re),
+    m_ns3Duration (nd),
+    m_realDuration (rd),
+    m_cmdLine (cmd),
+    m_stackPeaks (stackPeaks)
+{
+}
+
 int
 ProcStatus::GetNode (void) const
 {
@@ -338,4 +392,22 @@ ProcStatus::GetCmdLine (void) const
   return m_cmdLine;
 }
 
+std::map<int, uint32_t>
+ProcStatus::GetStackPeaks (void) const
+{
+  return m_stackPeaks;
+}
+
+uint32_t
+ProcStatus::GetStackPeak (void) const
+{
+  uint32_t peak = 0;
+  for (std::map<int, uint32_t>::const_iterator i = m_stackPeaks.begin ();
+       i != m_stackPeaks.end (); ++i)
+    {
+      peak = std::max (peak, i->second);
+    }
+  return peak;
+}
+
 } // namespace ns3
@@ -7,6 +7,7 @@
 #include "ns3/node-container.h"
 #include "ns3/nstime.h"
 #include <string>
+#include <map>
 
 namespace ns3 {
 
@@ -20,6 +21,8 @@ public:
 	ProcStatus() {};
 
   ProcStatus (int n, int e, int p, int64_t ns, int64_t ne, long rs, long re, double nd, long rd, std::string cmd);
+  ProcStatus (int n, int e, int p, int64_t ns, int64_t ne, long rs, long re, double nd, long rd,
+              std::map<int, uint32_t> stackPeaks, std::string cmd);
 
   /**
    * returns node ID information
@@ -61,6 +64,14 @@ public:
    * returns Command Line argv[]
    */
   std::string GetCmdLine (void) const;
+  /**
+   * returns the peak stack usage in bytes of each thread, by thread id
+   */
+  std::map<int, uint32_t> GetStackPeaks (void) const;
+  /**
+   * returns the largest peak stack usage in bytes of the threads
+   */
+  uint32_t GetStackPeak (void) const;
 
 private:
   int m_node;
@@ -73,6 +84,7 @@ private:
   double m_ns3Duration;
   long m_realDuration;
   std::string m_cmdLine;
+  std::map<int, uint32_t> m_stackPeaks;
 };
 
 /**
@@ -105,7 +117,8 @@ public:
 
   /**
    * \param type the name of the ProcessDelayModel to set
-   * (ns3::RandomProcessDelayModel and ns3::TimeOfDayProcessDelayModel are available)
+   * (ns3::RandomProcessDelayModel, ns3::TimeOfDayProcessDelayModel and
+   * ns3::CpuTimeProcessDelayModel are available)
    * \param n0 the name of the attribute to set to the ProcessDelayModel
    * \param v0 the value of the attribute to set to the ProcessDelayModel
    * \param n1 the name of the attribute to set to the ProcessDelayModel
@@ -143,6 +156,17 @@ public:
   void SetNetworkStack (std::string type,
                         std::string n0 = "", const AttributeValue &v0 = EmptyAttributeValue ());
 
+  /**
+   * \param type the name of the ns3::FileSystem to set
+   * (ns3::HostFileSystem, the default, and ns3::MemoryFileSystem are available)
+   * \param n0 the name of the attribute to set to the ns3::FileSystem
+   * \param v0 the value of the attribute to set to the ns3::FileSystem
+   *
+   * Set these attributes on each ns3::FileSystem
+   */
+  void SetFileSystem (std::string type,
+                      std::string n0 = "", const AttributeValue &v0 = EmptyAttributeValue ());
+
   /**
    * \param n1 the name of the attribute to set to the ns3::DceManager
    * \param v1 the value of the attribute to set to the ns3::DceManager
@@ -188,6 +212,7 @@ private:
   ObjectFactory m_managerFactory;
   ObjectFactory m_networkStackFactory;
   ObjectFactory m_delayFactory;
+  ObjectFactory m_fileSystemFactory;
   std::string m_virtualPath;
   static unsigned long nanoCpt;
 };
@@ -24,6 +24,7 @@
 #include "dce-application-helper.h"
 #include "ns3/node.h"
 #include "ns3/node-container.h"
+#include "ns3/net-device.h"
 #include "ns3/names.h"
 #include "ns3/ipv4-list-routing-helper.h"
 #include "ns3/ipv4-static-routing-helper.h"
@@ -173,6 +174,25 @@ LinuxStackHelper::SysctlGet (Ptr<Node> node, Time at, std::string path,
 #endif
 }
 void
+LinuxStackHelper::GetDeviceStats (Ptr<NetDevice> device, uint64_t *txBytesCopied,
+                                  uint64_t *rxBytesCopied)
+{
+  *txBytesCopied = 0;
+  *rxBytesCopied = 0;
+#ifdef KERNEL_STACK
+  Ptr<LinuxSocketFdFactory> sock = device->GetNode ()->GetObject<LinuxSocketFdFactory> ();
+  if (!sock)
+    {
+      NS_ASSERT_MSG (0, "No LinuxSocketFdFactory is installed. "
+                     "You may need to do it via DceManagerHelper::Install ()");
+      return;
+    }
+  struct KernelSocketFdFactory::DeviceStats stats = sock->GetDeviceStats (device);
+  *txBytesCopied = stats.txBytesCopied;
+  *rxBytesCopied = stats.rxBytesCopied;
+#endif
+}
+void
 LinuxStackHelper::SysctlSet (NodeContainer c, std::string path, std::string value)
 {
 #ifdef KERNEL_STACK
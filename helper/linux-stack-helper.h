@@ -25,6 +25,7 @@
 namespace ns3 {
 
 class Node;
+class NetDevice;
 class NodeContainer;
 class Time;
 class Ipv4RoutingHelper;
@@ -131,6 +132,17 @@ public:
    */
   static void RunIp (Ptr<Node> node, Time at, std::string str);
 
+  /**
+   * Obtain the bytes of the frames copied by DCE between the Linux kernel
+   * and a device of its node so far.
+   *
+   * \param device the device, on a node with a Linux kernel stack.
+   * \param txBytesCopied set to the bytes copied from the kernel to the device.
+   * \param rxBytesCopied set to the bytes copied from the device to the kernel.
+   */
+  static void GetDeviceStats (Ptr<NetDevice> device, uint64_t *txBytesCopied,
+                              uint64_t *rxBytesCopied);
+
 private:
   void Initialize ();
   const Ipv4RoutingHelper *m_routing;
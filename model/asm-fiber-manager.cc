@@ -0,0 +1,464 @@
+#define _GNU_SOURCE 1
+#include "asm-fiber-manager.h"
+#include "ns3/fatal-error.h"
+#include "ns3/assert.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <algorithm>
+
+#ifdef HAVE_VALGRIND_H
+# include "valgrind/valgrind.h"
+#else
+# define VALGRIND_STACK_REGISTER(start,end) (0)
+# define VALGRIND_STACK_DEREGISTER(id)
+#endif
+
+/**
+ * void *dce_fiber_switch (void **fromSp, void *toSp, void *arg);
+ *   Push the callee-saved registers and the floating point control words
+ *   on the current stack, store the stack pointer in *fromSp, load toSp
+ *   and pop the same frame from there. arg is returned to the fiber
+ *   which is resumed.
+ *
+ * void *dce_fiber_fork (void **sp, void (*save)(void *ctx, void *sp), void *ctx);
+ *   Push the same frame as dce_fiber_switch, store the stack pointer in *sp,
+ *   call save (ctx, sp) below this frame and return 0. Switching later to *sp
+ *   returns a second time from dce_fiber_fork, with the arg of the switch.
+ *
+ * dce_fiber_entry
+ *   Where the first switch to a new fiber returns: calls the function found
+ *   in the frame with the fiber found in the frame.
+ */
+#if defined (__x86_64__)
+
+// Frame, from the saved stack pointer: mxcsr, x87 control word, r15, r14,
+// r13, r12, rbx, rbp, return address.
+#define FIBER_FRAME_SIZE 64
+__asm__ (
+  ".pushsection .text\n"
+  ".globl dce_fiber_switch\n"
+  ".hidden dce_fiber_switch\n"
+  ".type dce_fiber_switch,@function\n"
+  ".p2align 4\n"
+  "dce_fiber_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  movq %rdx, %rax\n"
+  "  ret\n"
+  ".size dce_fiber_switch,.-dce_fiber_switch\n"
+
+  ".globl dce_fiber_fork\n"
+  ".hidden dce_fiber_fork\n"
+  ".type dce_fiber_fork,@function\n"
+  ".p2align 4\n"
+  "dce_fiber_fork:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rax\n"
+  "  movq %rdx, %rdi\n"
+  "  movq %rsp, %rsi\n"
+  "  callq *%rax\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  xorl %eax, %eax\n"
+  "  ret\n"
+  ".size dce_fiber_fork,.-dce_fiber_fork\n"
+
+  ".globl dce_fiber_entry\n"
+  ".hidden dce_fiber_entry\n"
+  ".type dce_fiber_entry,@function\n"
+  ".p2align 4\n"
+  "dce_fiber_entry:\n"
+  "  movq %r12, %rdi\n"
+  "  callq *%rbx\n"
+  "  ud2\n"
+  ".size dce_fiber_entry,.-dce_fiber_entry\n"
+  ".popsection\n"
+  );
+
+#elif defined (__aarch64__)
+
+// Frame, from the saved stack pointer: x19-x28, x29 (fp), x30 (lr),
+// d8-d15, fpcr, padding.
+#define FIBER_FRAME_SIZE 176
+#define FIBER_FRAME_PUSH \
+  "  sub sp, sp, #176\n" \
+  "  stp x19, x20, [sp, #0]\n" \
+  "  stp x21, x22, [sp, #16]\n" \
+  "  stp x23, x24, [sp, #32]\n" \
+  "  stp x25, x26, [sp, #48]\n" \
+  "  stp x27, x28, [sp, #64]\n" \
+  "  stp x29, x30, [sp, #80]\n" \
+  "  stp d8, d9, [sp, #96]\n" \
+  "  stp d10, d11, [sp, #112]\n" \
+  "  stp d12, d13, [sp, #128]\n" \
+  "  stp d14, d15, [sp, #144]\n" \
+  "  mrs x9, fpcr\n" \
+  "  str x9, [sp, #160]\n"
+#define FIBER_FRAME_POP \
+  "  ldr x9, [sp, #160]\n" \
+  "  msr fpcr, x9\n" \
+  "  ldp x19, x20, [sp, #0]\n" \
+  "  ldp x21, x22, [sp, #16]\n" \
+  "  ldp x23, x24, [sp, #32]\n" \
+  "  ldp x25, x26, [sp, #48]\n" \
+  "  ldp x27, x28, [sp, #64]\n" \
+  "  ldp x29, x30, [sp, #80]\n" \
+  "  ldp d8, d9, [sp, #96]\n" \
+  "  ldp d10, d11, [sp, #112]\n" \
+  "  ldp d12, d13, [sp, #128]\n" \
+  "  ldp d14, d15, [sp, #144]\n" \
+  "  add sp, sp, #176\n"
+__asm__ (
+  ".pushsection .text\n"
+  ".globl dce_fiber_switch\n"
+  ".hidden dce_fiber_switch\n"
+  ".type dce_fiber_switch,%function\n"
+  ".p2align 4\n"
+  "dce_fiber_switch:\n"
+  FIBER_FRAME_PUSH
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  mov sp, x1\n"
+  FIBER_FRAME_POP
+  "  mov x0, x2\n"
+  "  ret\n"
+  ".size dce_fiber_switch,.-dce_fiber_switch\n"
+
+  ".globl dce_fiber_fork\n"
+  ".hidden dce_fiber_fork\n"
+  ".type dce_fiber_fork,%function\n"
+  ".p2align 4\n"
+  "dce_fiber_fork:\n"
+  FIBER_FRAME_PUSH
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  mov x9, x1\n"
+  "  mov x0, x2\n"
+  "  mov x1, sp\n"
+  "  blr x9\n"
+  FIBER_FRAME_POP
+  "  mov x0, #0\n"
+  "  ret\n"
+  ".size dce_fiber_fork,.-dce_fiber_fork\n"
+
+  ".globl dce_fiber_entry\n"
+  ".hidden dce_fiber_entry\n"
+  ".type dce_fiber_entry,%function\n"
+  ".p2align 4\n"
+  "dce_fiber_entry:\n"
+  "  mov x0, x19\n"
+  "  blr x20\n"
+  "  brk #0\n"
+  ".size dce_fiber_entry,.-dce_fiber_entry\n"
+  ".popsection\n"
+  );
+
+#endif
+
+#ifdef FIBER_FRAME_SIZE
+extern "C" {
+void * dce_fiber_switch (void **fromSp, void *toSp, void *arg);
+void * dce_fiber_fork (void **sp, void (*save)(void *, void *), void *ctx) __attribute__ ((returns_twice));
+void dce_fiber_entry (void);
+}
+#endif
+
+namespace ns3 {
+
+// Shared by a fiber and all its clones: they run at the same addresses.
+struct AsmFiberStack
+{
+  uint8_t *buffer;
+  uint32_t size;
+  uint32_t refcount;
+  struct AsmFiber *owner; // fiber whose content is in buffer, zero if deleted.
+  bool sentinel;
+  unsigned int vgId;
+};
+
+struct AsmFiber : public Fiber
+{
+  void *sp;
+  struct AsmFiberStack *stack; // zero for the fiber created from caller.
+  uint8_t *copy; // our content of stack->buffer while another clone owns it.
+  uint32_t stackUsage; // deepest point seen at a switch.
+  void (*callback)(void *);
+  void *context;
+  sigset_t sigmask;
+};
+
+AsmFiberManager::AsmFiberManager (bool saveSignalMask)
+  : m_notifySwitch (0),
+    m_saveSignalMask (saveSignalMask)
+{
+  if (!IsSupported ())
+    {
+      NS_FATAL_ERROR ("AsmFiberManager is not available on this architecture");
+    }
+}
+AsmFiberManager::~AsmFiberManager ()
+{
+}
+
+bool
+AsmFiberManager::IsSupported (void)
+{
+#ifdef FIBER_FRAME_SIZE
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+AsmFiberManager::Start (void *fib)
+{
+  struct AsmFiber *fiber = (struct AsmFiber *)fib;
+  fiber->callback (fiber->context);
+  NS_FATAL_ERROR ("The fiber function must not return.");
+}
+
+struct Fiber *
+AsmFiberManager::Create (void (*callback)(void *),
+                         void *context,
+                         uint32_t stackSize)
+{
+  struct AsmFiber *fiber = new struct AsmFiber ();
+  struct AsmFiberStack *stack = new struct AsmFiberStack ();
+  stack->buffer = AllocateStack (stackSize);
+  stack->size = stackSize;
+  stack->refcount = 1;
+  stack->owner = fiber;
+  stack->sentinel = FillStack (stack->buffer, stackSize);
+  stack->vgId = VALGRIND_STACK_REGISTER (stack->buffer, stack->buffer + stackSize);
+  fiber->stack = stack;
+  fiber->copy = 0;
+  fiber->stackUsage = 0;
+  fiber->callback = callback;
+  fiber->context = context;
+  sigprocmask (SIG_SETMASK, 0, &fiber->sigmask);
+
+#ifdef FIBER_FRAME_SIZE
+  uintptr_t top = ((uintptr_t)(stack->buffer + stackSize)) & ~((uintptr_t)15);
+  uint64_t *frame = (uint64_t *)(top - FIBER_FRAME_SIZE);
+  memset (frame, 0, FIBER_FRAME_SIZE);
+  void (*start)(void *) = &AsmFiberManager::Start;
+# if defined (__x86_64__)
+  uint32_t mxcsr;
+  uint16_t fpucw;
+  __asm__ __volatile__ ("stmxcsr %0" : "=m" (mxcsr));
+  __asm__ __volatile__ ("fnstcw %0" : "=m" (fpucw));
+  frame[0] = mxcsr | ((uint64_t)fpucw << 32);
+  frame[4] = (uint64_t)fiber; // r12
+  frame[5] = (uint64_t)start; // rbx
+  frame[7] = (uint64_t)&dce_fiber_entry;
+# elif defined (__aarch64__)
+  uint64_t fpcr;
+  __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (fpcr));
+  frame[0] = (uint64_t)fiber; // x19
+  frame[1] = (uint64_t)start; // x20
+  frame[11] = (uint64_t)&dce_fiber_entry; // x30
+  frame[20] = fpcr;
+# endif
+  fiber->sp = frame;
+#endif
+
+  return fiber;
+}
+
+struct Fiber *
+AsmFiberManager::CreateFromCaller (void)
+{
+  struct AsmFiber *fiber = new struct AsmFiber ();
+  fiber->sp = 0;
+  fiber->stack = 0;
+  fiber->copy = 0;
+  fiber->stackUsage = 0;
+  fiber->callback = 0;
+  fiber->context = 0;
+  sigprocmask (SIG_SETMASK, 0, &fiber->sigmask);
+  return fiber;
+}
+
+void
+AsmFiberManager::SaveCloneStack (void *ctx, void *sp)
+{
+  struct AsmFiber *clone = (struct AsmFiber *)ctx;
+  clone->sp = sp;
+  SaveStack (clone);
+}
+
+void
+AsmFiberManager::SaveStack (struct AsmFiber *fiber)
+{
+  struct AsmFiberStack *stack = fiber->stack;
+  uint8_t *sp = (uint8_t *)fiber->sp;
+  uint32_t offset = sp - stack->buffer;
+  NS_ASSERT (sp >= stack->buffer && offset < stack->size);
+  if (fiber->copy == 0)
+    {
+      fiber->copy = (uint8_t *)malloc (stack->size);
+    }
+  // only the used part of the stack, from the saved frame to the top.
+  memcpy (fiber->copy + offset, sp, stack->size - offset);
+}
+
+void
+AsmFiberManager::RestoreStack (struct AsmFiber *fiber)
+{
+  struct AsmFiberStack *stack = fiber->stack;
+  uint8_t *sp = (uint8_t *)fiber->sp;
+  uint32_t offset = sp - stack->buffer;
+  memcpy (sp, fiber->copy + offset, stack->size - offset);
+  stack->owner = fiber;
+}
+
+struct Fiber *
+AsmFiberManager::Clone (struct Fiber *fib)
+{
+  struct AsmFiber *fiber = (struct AsmFiber *)fib;
+  NS_ASSERT (fiber->stack != 0 && fiber->stack->owner == fiber);
+  struct AsmFiber *clone = new struct AsmFiber ();
+  clone->stack = fiber->stack;
+  clone->stack->refcount++;
+  clone->copy = 0;
+  clone->stackUsage = fiber->stackUsage;
+  clone->callback = fiber->callback;
+  clone->context = fiber->context;
+  clone->sigmask = fiber->sigmask;
+#ifdef FIBER_FRAME_SIZE
+  if (dce_fiber_fork (&clone->sp, &AsmFiberManager::SaveCloneStack, clone) == 0)
+    {
+      // parent.
+      return clone;
+    }
+#endif
+  // child, resumed by a SwitchTo.
+  return 0;
+}
+
+void
+AsmFiberManager::Delete (struct Fiber *fib)
+{
+  struct AsmFiber *fiber = (struct AsmFiber *)fib;
+  struct AsmFiberStack *stack = fiber->stack;
+  if (stack != 0)
+    {
+      if (stack->owner == fiber)
+        {
+          stack->owner = 0;
+        }
+      stack->refcount--;
+      if (stack->refcount == 0)
+        {
+          VALGRIND_STACK_DEREGISTER (stack->vgId);
+          DeallocateStack (stack->buffer, stack->size);
+          delete stack;
+        }
+    }
+  free (fiber->copy);
+  fiber->stack = 0;
+  fiber->copy = 0;
+  delete fiber;
+}
+
+void
+AsmFiberManager::SwitchTo (struct Fiber *fromFiber,
+                           const struct Fiber *toFiber)
+{
+  struct AsmFiber *from = (struct AsmFiber *)fromFiber;
+  struct AsmFiber *to = (struct AsmFiber *)toFiber;
+  if (from->stack != 0)
+    {
+      uint8_t *sp = (uint8_t *)__builtin_frame_address (0);
+      from->stackUsage = std::max (from->stackUsage,
+                                   (uint32_t)(from->stack->buffer + from->stack->size - sp));
+    }
+  if (to->stack != 0 && to->stack->owner != to)
+    {
+      // We cannot overwrite the stack we are running on: clones are
+      // always switched to from another stack, usually the main one.
+      NS_ASSERT (from->stack != to->stack);
+      if (to->stack->owner != 0)
+        {
+          SaveStack (to->stack->owner);
+        }
+      RestoreStack (to);
+    }
+  if (m_saveSignalMask)
+    {
+      sigprocmask (SIG_SETMASK, &to->sigmask, &from->sigmask);
+    }
+#ifdef FIBER_FRAME_SIZE
+  dce_fiber_switch (&from->sp, to->sp, to);
+#endif
+  if (m_notifySwitch != 0)
+    {
+      m_notifySwitch ();
+    }
+}
+
+uint32_t
+AsmFiberManager::GetStackSize (struct Fiber *fib) const
+{
+  struct AsmFiber *fiber = (struct AsmFiber *)fib;
+  if (fiber->stack == 0)
+    {
+      return 0;
+    }
+  return fiber->stack->size;
+}
+
+uint32_t
+AsmFiberManager::GetStackUsage (struct Fiber *fib) const
+{
+  struct AsmFiber *fiber = (struct AsmFiber *)fib;
+  if (fiber->stack != 0 && fiber->stack->sentinel)
+    {
+      // shared with the clones, if any.
+      return std::max (fiber->stackUsage, ScanStack (fiber->stack->buffer, fiber->stack->size));
+    }
+  return fiber->stackUsage;
+}
+
+void
+AsmFiberManager::SetSwitchNotification (void (*fn)(void))
+{
+  m_notifySwitch = fn;
+}
+
+} // namespace ns3
@@ -0,0 +1,55 @@
+#ifndef ASM_FIBER_MANAGER_H
+#define ASM_FIBER_MANAGER_H
+
+#include "ucontext-fiber-manager.h"
+
+namespace ns3 {
+
+struct AsmFiber;
+struct AsmFiberStack;
+
+/**
+ * Same stacks (guard pages, pool) as the UcontextFiberManager but the
+ * context switch is a few lines of assembly which save and restore only
+ * the callee-saved registers: contrary to swapcontext, it does not issue
+ * a rt_sigprocmask system call at each switch unless asked to.
+ *
+ * Only available on x86-64 and aarch64.
+ */
+class AsmFiberManager : public UcontextFiberManager
+{
+public:
+  /**
+   * \param saveSignalMask if true, each fiber keeps its own host signal
+   *        mask which is saved and restored at each switch, like swapcontext
+   *        does.
+   */
+  AsmFiberManager (bool saveSignalMask);
+  virtual ~AsmFiberManager ();
+
+  virtual struct Fiber * Clone (struct Fiber *fiber);
+  virtual struct Fiber *Create (void (*callback)(void *),
+                                void *context,
+                                uint32_t stackSize);
+  virtual struct Fiber * CreateFromCaller (void);
+  virtual void Delete (struct Fiber *fiber);
+  virtual void SwitchTo (struct Fiber *from,
+                         const struct Fiber *to);
+  virtual uint32_t GetStackSize (struct Fiber *fiber) const;
+  virtual uint32_t GetStackUsage (struct Fiber *fiber) const;
+  virtual void SetSwitchNotification (void (*fn)(void));
+
+  static bool IsSupported (void);
+private:
+  static void Start (void *fiber);
+  static void SaveCloneStack (void *clone, void *sp);
+  static void SaveStack (struct AsmFiber *fiber);
+  static void RestoreStack (struct AsmFiber *fiber);
+
+  void (*m_notifySwitch)(void);
+  bool m_saveSignalMask;
+};
+
+} // namespace ns3
+
+#endif /* ASM_FIBER_MANAGER_H */
@@ -0,0 +1,408 @@
+#include "buffered-log-writer.h"
+#include "fault-handlers.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+NS_LOG_COMPONENT_DEFINE ("BufferedLogWriter");
+
+// a stream holding this much wakes up the writer thread.
+#define BATCH_SIZE (1 << 16)
+// period of the writer thread, in milliseconds.
+#define FLUSH_PERIOD 100
+
+namespace ns3 {
+
+GlobalValue g_outputBufferBudget = GlobalValue ("OutputBufferBudget",
+                                                "The maximum number of bytes of process output "
+                                                "kept in memory when MinimizeOpenFiles is set",
+                                                UintegerValue (64 << 20),
+                                                MakeUintegerChecker<uint64_t> ());
+
+struct BufferedLogWriter::Stream
+{
+  std::string path;
+  // plain copies of the path and data, readable from the crash handler.
+  char *hostPath;
+  char *buffer;
+  size_t size;
+  size_t capacity;
+  uint32_t refs;
+  struct Stream *next;
+};
+
+static BufferedLogWriter *g_writer = 0;
+
+BufferedLogWriter *
+BufferedLogWriter::Get (void)
+{
+  if (g_writer == 0)
+    {
+      g_writer = new BufferedLogWriter ();
+      atexit (&BufferedLogWriter::AtExit);
+      // a child forked while the writer thread holds a lock would never get it.
+      pthread_atfork (&BufferedLogWriter::LockAll, &BufferedLogWriter::UnlockAll,
+                      &BufferedLogWriter::UnlockAll);
+    }
+  return g_writer;
+}
+
+BufferedLogWriter::BufferedLogWriter ()
+  : m_pid (getpid ()),
+    m_stop (false),
+    m_pending (0),
+    m_list (0)
+{
+  NS_LOG_FUNCTION (this);
+  UintegerValue budget;
+  GlobalValue::GetValueByName ("OutputBufferBudget", budget);
+  m_budget = budget.Get ();
+  pthread_mutex_init (&m_mutex, 0);
+  pthread_mutex_init (&m_ioMutex, 0);
+  pthread_cond_init (&m_wakeup, 0);
+  // the signals are for the simulation threads.
+  sigset_t all, previous;
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &previous);
+  int status = pthread_create (&m_thread, 0, &BufferedLogWriter::Run, this);
+  pthread_sigmask (SIG_SETMASK, &previous, 0);
+  NS_ASSERT_MSG (status == 0, "Unable to start the output writer thread");
+  FaultHandlers::AddCrashHandler (&BufferedLogWriter::CrashHandler);
+}
+
+void
+BufferedLogWriter::LockAll (void)
+{
+  pthread_mutex_lock (&g_writer->m_ioMutex);
+  pthread_mutex_lock (&g_writer->m_mutex);
+}
+
+void
+BufferedLogWriter::UnlockAll (void)
+{
+  pthread_mutex_unlock (&g_writer->m_mutex);
+  pthread_mutex_unlock (&g_writer->m_ioMutex);
+}
+
+struct BufferedLogWriter::Stream *
+BufferedLogWriter::Open (std::string path)
+{
+  NS_LOG_FUNCTION (this << path);
+  pthread_mutex_lock (&m_mutex);
+  struct Stream *stream;
+  std::map<std::string, struct Stream *>::iterator i = m_streams.find (path);
+  if (i != m_streams.end ())
+    {
+      stream = i->second;
+    }
+  else
+    {
+      stream = new Stream ();
+      stream->path = path;
+      stream->hostPath = strdup (path.c_str ());
+      stream->buffer = 0;
+      stream->size = 0;
+      stream->capacity = 0;
+      stream->refs = 0;
+      stream->next = m_list;
+      m_list = stream;
+      m_streams[path] = stream;
+    }
+  stream->refs++;
+  pthread_mutex_unlock (&m_mutex);
+  return stream;
+}
+
+void
+BufferedLogWriter::Write (struct Stream *stream, const void *buf, size_t count)
+{
+  pthread_mutex_lock (&m_mutex);
+  if (stream->size + count > stream->capacity)
+    {
+      size_t capacity = std::max (stream->capacity * 2, stream->size + count);
+      char *buffer = (char *)realloc (stream->buffer, capacity);
+      if (buffer == 0)
+        {
+          NS_FATAL_ERROR ("Unable to buffer " << count << " bytes for " << stream->path);
+        }
+      stream->buffer = buffer;
+      stream->capacity = capacity;
+    }
+  memcpy (stream->buffer + stream->size, buf, count);
+  stream->size += count;
+  m_pending += count;
+  bool overBudget = m_pending > m_budget;
+  if (!overBudget && stream->size >= BATCH_SIZE)
+    {
+      pthread_cond_signal (&m_wakeup);
+    }
+  pthread_mutex_unlock (&m_mutex);
+  if (overBudget)
+    {
+      NS_LOG_DEBUG ("over budget, flushing " << m_pending << " bytes");
+      Flush ();
+    }
+}
+
+void
+BufferedLogWriter::Close (struct Stream *stream)
+{
+  NS_LOG_FUNCTION (this << stream->path);
+  pthread_mutex_lock (&m_mutex);
+  NS_ASSERT (stream->refs > 0);
+  stream->refs--;
+  if (stream->refs == 0)
+    {
+      // last user gone, typically the process exited: do not wait.
+      pthread_cond_signal (&m_wakeup);
+    }
+  pthread_mutex_unlock (&m_mutex);
+}
+
+void
+BufferedLogWriter::WriteStream (struct Stream *stream)
+{
+  // m_ioMutex held.
+  pthread_mutex_lock (&m_mutex);
+  char *data = stream->buffer;
+  size_t size = stream->size;
+  stream->buffer = 0;
+  stream->size = 0;
+  stream->capacity = 0;
+  m_pending -= size;
+  pthread_mutex_unlock (&m_mutex);
+  if (size == 0)
+    {
+      free (data);
+      return;
+    }
+  int fd = ::open (stream->path.c_str (), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd == -1)
+    {
+      NS_LOG_WARN ("Unable to open " << stream->path << ": " << strerror (errno));
+      free (data);
+      return;
+    }
+  const char *p = data;
+  size_t left = size;
+  while (left > 0)
+    {
+      ssize_t ret = ::write (fd, p, left);
+      if (ret == -1 && errno == EINTR)
+        {
+          continue;
+        }
+      if (ret <= 0)
+        {
+          NS_LOG_WARN ("Unable to write " << stream->path << ": " << strerror (errno));
+          break;
+        }
+      p += ret;
+      left -= ret;
+    }
+  ::close (fd);
+  free (data);
+}
+
+void
+BufferedLogWriter::Collect (void)
+{
+  // m_ioMutex held: nobody else is writing a stream.
+  pthread_mutex_lock (&m_mutex);
+  struct Stream **prev = &m_list;
+  while (*prev != 0)
+    {
+      struct Stream *stream = *prev;
+      if (stream->refs == 0 && stream->size == 0)
+        {
+          *prev = stream->next;
+          m_streams.erase (stream->path);
+          free (stream->hostPath);
+          free (stream->buffer);
+          delete stream;
+        }
+      else
+        {
+          prev = &stream->next;
+        }
+    }
+  pthread_mutex_unlock (&m_mutex);
+}
+
+void
+BufferedLogWriter::Flush (void)
+{
+  pthread_mutex_lock (&m_ioMutex);
+  std::vector<struct Stream *> streams;
+  pthread_mutex_lock (&m_mutex);
+  streams.reserve (m_streams.size ());
+  for (struct Stream *stream = m_list; stream != 0; stream = stream->next)
+    {
+      streams.push_back (stream);
+    }
+  pthread_mutex_unlock (&m_mutex);
+  for (std::vector<struct Stream *>::iterator i = streams.begin (); i != streams.end (); ++i)
+    {
+      WriteStream (*i);
+    }
+  Collect ();
+  pthread_mutex_unlock (&m_ioMutex);
+}
+
+void
+BufferedLogWriter::Sync (std::string path)
+{
+  BufferedLogWriter *self = g_writer;
+  if (self == 0)
+    {
+      return;
+    }
+  pthread_mutex_lock (&self->m_ioMutex);
+  pthread_mutex_lock (&self->m_mutex);
+  std::map<std::string, struct Stream *>::iterator i = self->m_streams.find (path);
+  struct Stream *stream = (i != self->m_streams.end ()) ? i->second : 0;
+  pthread_mutex_unlock (&self->m_mutex);
+  if (stream != 0)
+    {
+      self->WriteStream (stream);
+    }
+  pthread_mutex_unlock (&self->m_ioMutex);
+}
+
+void
+BufferedLogWriter::FlushAll (void)
+{
+  if (g_writer != 0)
+    {
+      g_writer->Flush ();
+    }
+}
+
+void *
+BufferedLogWriter::Run (void *context)
+{
+  BufferedLogWriter *self = (BufferedLogWriter *)context;
+  pthread_mutex_lock (&self->m_mutex);
+  while (!self->m_stop)
+    {
+      struct timespec deadline;
+      clock_gettime (CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += FLUSH_PERIOD * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L)
+        {
+          deadline.tv_sec++;
+          deadline.tv_nsec -= 1000000000L;
+        }
+      pthread_cond_timedwait (&self->m_wakeup, &self->m_mutex, &deadline);
+      if (self->m_pending == 0 && self->m_list == 0)
+        {
+          continue;
+        }
+      pthread_mutex_unlock (&self->m_mutex);
+      self->Flush ();
+      pthread_mutex_lock (&self->m_mutex);
+    }
+  pthread_mutex_unlock (&self->m_mutex);
+  return 0;
+}
+
+void
+BufferedLogWriter::Stop (void)
+{
+  if (getpid () != m_pid)
+    {
+      // a forked child: the thread is not there, the data is the parent's.
+      return;
+    }
+  pthread_mutex_lock (&m_mutex);
+  if (m_stop)
+    {
+      pthread_mutex_unlock (&m_mutex);
+      return;
+    }
+  m_stop = true;
+  pthread_cond_signal (&m_wakeup);
+  pthread_mutex_unlock (&m_mutex);
+  pthread_join (m_thread, 0);
+  Flush ();
+}
+
+void
+BufferedLogWriter::AtExit (void)
+{
+  if (g_writer != 0)
+    {
+      g_writer->Stop ();
+    }
+}
+
+void
+BufferedLogWriter::CrashFlush (void)
+{
+  // best effort: only system calls and plain memory, and no waiting on
+  // a lock the crashed thread might hold.
+  if (pthread_mutex_trylock (&m_ioMutex) != 0)
+    {
+      return;
+    }
+  if (pthread_mutex_trylock (&m_mutex) != 0)
+    {
+      pthread_mutex_unlock (&m_ioMutex);
+      return;
+    }
+  for (struct Stream *stream = m_list; stream != 0; stream = stream->next)
+    {
+      if (stream->size == 0)
+        {
+          continue;
+        }
+      int fd = ::open (stream->hostPath, O_WRONLY | O_APPEND | O_CREAT, 0644);
+      if (fd == -1)
+        {
+          continue;
+        }
+      const char *p = stream->buffer;
+      size_t left = stream->size;
+      while (left > 0)
+        {
+          ssize_t ret = ::write (fd, p, left);
+          if (ret == -1 && errno == EINTR)
+            {
+              continue;
+            }
+          if (ret <= 0)
+            {
+              break;
+            }
+          p += ret;
+          left -= ret;
+        }
+      ::close (fd);
+      // written: not again if the process survives the signal.
+      m_pending -= stream->size;
+      stream->size = 0;
+    }
+  pthread_mutex_unlock (&m_mutex);
+  pthread_mutex_unlock (&m_ioMutex);
+}
+
+void
+BufferedLogWriter::CrashHandler (int sig)
+{
+  if (g_writer != 0 && getpid () == g_writer->m_pid)
+    {
+      g_writer->CrashFlush ();
+    }
+}
+
+} // namespace ns3
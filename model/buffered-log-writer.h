@@ -0,0 +1,91 @@
+#ifndef BUFFERED_LOG_WRITER_H
+#define BUFFERED_LOG_WRITER_H
+
+#include <string>
+#include <map>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <signal.h>
+
+namespace ns3 {
+
+/**
+ * \brief Append-only host files written in the background
+ *
+ * Used for the stdout, stderr and syslog files of the processes when
+ * MinimizeOpenFiles is set: the data written to a Stream is kept in memory
+ * and a host thread appends it to the file in large batches, opening the
+ * file only for the time of the batch. So a process does not keep any
+ * host fd open for its output and a chatty process does not cost an
+ * open/write/close per write.
+ *
+ * The data buffered by all the streams is bounded by the global value
+ * OutputBufferBudget: above it, Write flushes everything synchronously.
+ * Everything is flushed when the streams are closed, when the DceManager
+ * is disposed, at exit and, as much as possible, when the simulation
+ * crashes, that is on a signal which no handler of the FaultHandlers
+ * claims.
+ *
+ * A host child forked by the simulation has a copy of the buffers of its
+ * parent but no writer thread: it writes nothing at exit.
+ */
+class BufferedLogWriter
+{
+public:
+  struct Stream;
+
+  static BufferedLogWriter * Get (void);
+
+  /**
+   * \param path absolute host path of a file, which should already exist.
+   * \returns the stream of this path, shared by all its users.
+   */
+  struct Stream * Open (std::string path);
+  void Write (struct Stream *stream, const void *buf, size_t count);
+  // the data still buffered is written later.
+  void Close (struct Stream *stream);
+
+  /**
+   * Write now the data buffered for path, if any, typically before
+   * reading the file. Does nothing if the writer was never used.
+   */
+  static void Sync (std::string path);
+  // Write now all the data buffered.
+  void Flush (void);
+  /**
+   * Write now all the data buffered, typically when the simulation is
+   * destroyed. Does nothing if the writer was never used.
+   */
+  static void FlushAll (void);
+
+private:
+  BufferedLogWriter ();
+  static void * Run (void *context);
+  static void AtExit (void);
+  static void LockAll (void);
+  static void UnlockAll (void);
+  static void CrashHandler (int sig);
+  void Stop (void);
+  void WriteStream (struct Stream *stream);
+  void Collect (void);
+  void CrashFlush (void);
+
+  // protects the streams and their buffers.
+  pthread_mutex_t m_mutex;
+  // held while writing to the host files, to keep the order of the writes.
+  pthread_mutex_t m_ioMutex;
+  pthread_cond_t m_wakeup;
+  pthread_t m_thread;
+  pid_t m_pid; // of the host process which runs m_thread.
+  bool m_stop;
+  uint64_t m_pending; // bytes buffered by all the streams.
+  uint64_t m_budget;
+  std::map<std::string, struct Stream *> m_streams;
+  // the same streams, walked by the crash handler which cannot use m_streams.
+  struct Stream *m_list;
+};
+
+} // namespace ns3
+
+#endif /* BUFFERED_LOG_WRITER_H */
@@ -2,7 +2,9 @@
 #include "cooja-loader-factory.h"
 #include "elf-cache.h"
 #include "elf-dependencies.h"
+#include "fault-handlers.h"
 #include "ns3/log.h"
+#include "ns3/boolean.h"
 #ifdef DCE_MPI
 #include "ns3/mpi-interface.h"
 #endif
@@ -16,7 +18,10 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <list>
+#include <vector>
+#include <algorithm>
 #include <errno.h>
+#include <signal.h>
 
 namespace {
 struct SharedModule
@@ -29,6 +34,16 @@ struct SharedModule
   uint32_t id;
   uint32_t refcount;
   std::list<struct SharedModule *> deps;
+  // When tracking, the whole pages of data_buffer are write protected:
+  // only the pages dirtied since the last switch are saved and only the
+  // pages whose content differs are restored.
+  bool tracking;
+  uint8_t *tracked_start;
+  uint32_t tracked_pages;
+  std::vector<bool> dirty;
+  // Each saved version of a page gets a new number, 0 is the template.
+  std::vector<uint32_t> live_versions;
+  std::vector<uint32_t> *current_versions;
 };
 }
 
@@ -37,6 +52,33 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("CoojaLoaderFactory");
 NS_OBJECT_ENSURE_REGISTERED (CoojaLoaderFactory);
 
+static struct CoojaLoaderFactory::SwapStats g_swapStats;
+// of the loader which started executing last, it pays for its switch.
+static struct CoojaLoaderFactory::SwapStats *g_currentStats = 0;
+#define SWAP_STATS_ADD(field, n)                \
+  do                                            \
+    {                                           \
+      g_swapStats.field += (n);                 \
+      if (g_currentStats != 0)                  \
+        {                                       \
+          g_currentStats->field += (n);         \
+        }                                       \
+    }                                           \
+  while (0)
+#define ROUND_DOWN(addr, align) \
+  (((unsigned long)addr) - (((unsigned long)(addr)) % (align)))
+
+// version of a data page whose content is not known anymore.
+static const uint32_t INVALID_VERSION = 0xffffffff;
+static uint32_t g_nextVersion = 1;
+
+static uint32_t
+PageSize (void)
+{
+  static uint32_t pageSize = sysconf (_SC_PAGESIZE);
+  return pageSize;
+}
+
 struct SharedModules
 {
   SharedModules ();
@@ -48,7 +90,8 @@ struct SharedModules
 class CoojaLoader : public Loader
 {
 public:
-  CoojaLoader ();
+  CoojaLoader (bool trackDirtyPages);
+  struct CoojaLoaderFactory::SwapStats GetStats (void) const;
 private:
   struct Module
   {
@@ -56,11 +99,13 @@ private:
     std::list<struct Module *> deps;
     uint32_t refcount;
     void *buffer;
+    std::vector<uint32_t> versions; // version of each tracked page of buffer.
   };
 
   virtual ~CoojaLoader ();
   virtual void NotifyStartExecute (void);
   virtual void NotifyEndExecute (void);
+  virtual void Prefault (void *buffer, size_t size);
   virtual Loader * Clone (void);
   virtual void UnloadAll (void);
   virtual void * Load (std::string filename, int flag, bool failsafe = false);
@@ -74,7 +119,15 @@ private:
                                            bool failsafe = false);
   void UnrefSharedModule (SharedModule *search);
 
+  static void SwitchData (struct Module *module);
+  static void TrackStart (struct SharedModule *shared);
+  static void SaveCurrent (struct SharedModule *shared);
+  static void ReleaseCurrent (struct SharedModule *shared);
+  static bool SegvHandler (int sig, siginfo_t *si, void *context);
+
   std::list<struct Module *> m_modules;
+  bool m_trackDirtyPages;
+  struct CoojaLoaderFactory::SwapStats m_stats;
 };
 
 SharedModules::SharedModules ()
@@ -110,26 +163,222 @@ CoojaLoader::Peek (void)
 void
 CoojaLoader::NotifyStartExecute (void)
 {
+  g_currentStats = &m_stats;
   for (std::list<struct Module *>::const_iterator i = m_modules.begin (); i != m_modules.end (); ++i)
     {
-      const struct Module *module = *i;
+      struct Module *module = *i;
       if (module->buffer == module->module->current_buffer)
         {
           continue;
         }
-      if (module->module->current_buffer != 0)
+      SwitchData (module);
+    }
+}
+void
+CoojaLoader::SwitchData (struct Module *module)
+{
+  struct SharedModule *shared = module->module;
+  SWAP_STATS_ADD (switches, 1);
+  if (!shared->tracking)
+    {
+      if (shared->current_buffer != 0)
         {
           // save the previous one
-          memcpy (module->module->current_buffer,
-                  module->module->data_buffer,
-                  module->module->buffer_size);
+          memcpy (shared->current_buffer,
+                  shared->data_buffer,
+                  shared->buffer_size);
+          SWAP_STATS_ADD (savedBytes, shared->buffer_size);
         }
       // restore our own
-      memcpy (module->module->data_buffer,
+      memcpy (shared->data_buffer,
               module->buffer,
-              module->module->buffer_size);
+              shared->buffer_size);
+      SWAP_STATS_ADD (restoredBytes, shared->buffer_size);
       // remember what we did
-      module->module->current_buffer = module->buffer;
+      shared->current_buffer = module->buffer;
+      return;
+    }
+
+  SaveCurrent (shared);
+
+  // restore the partial pages around the tracked ones.
+  uint8_t *data = (uint8_t *)shared->data_buffer;
+  uint8_t *mine = (uint8_t *)module->buffer;
+  uint32_t headSize = shared->tracked_start - data;
+  uint32_t tailOffset = headSize + shared->tracked_pages * PageSize ();
+  memcpy (data, mine, headSize);
+  memcpy (data + tailOffset, mine + tailOffset, shared->buffer_size - tailOffset);
+  SWAP_STATS_ADD (restoredBytes, headSize + shared->buffer_size - tailOffset);
+
+  // and only the pages which do not already hold our content.
+  bool writable = false;
+  for (uint32_t p = 0; p < shared->tracked_pages; p++)
+    {
+      if (module->versions[p] == shared->live_versions[p])
+        {
+          SWAP_STATS_ADD (skippedBytes, PageSize ());
+          continue;
+        }
+      if (!writable)
+        {
+          mprotect (shared->tracked_start, shared->tracked_pages * PageSize (),
+                    PROT_READ | PROT_WRITE);
+          writable = true;
+        }
+      uint32_t offset = headSize + p * PageSize ();
+      memcpy (data + offset, mine + offset, PageSize ());
+      shared->live_versions[p] = module->versions[p];
+      SWAP_STATS_ADD (restoredBytes, PageSize ());
+    }
+  if (writable)
+    {
+      mprotect (shared->tracked_start, shared->tracked_pages * PageSize (), PROT_READ);
+    }
+  shared->current_buffer = module->buffer;
+  shared->current_versions = &module->versions;
+}
+void
+CoojaLoader::SaveCurrent (struct SharedModule *shared)
+{
+  if (shared->current_buffer == 0)
+    {
+      return;
+    }
+  uint8_t *data = (uint8_t *)shared->data_buffer;
+  uint8_t *current = (uint8_t *)shared->current_buffer;
+  uint32_t headSize = shared->tracked_start - data;
+  uint32_t tailOffset = headSize + shared->tracked_pages * PageSize ();
+  memcpy (current, data, headSize);
+  memcpy (current + tailOffset, data + tailOffset, shared->buffer_size - tailOffset);
+  SWAP_STATS_ADD (savedBytes, headSize + shared->buffer_size - tailOffset);
+
+  bool dirty = false;
+  for (uint32_t p = 0; p < shared->tracked_pages; p++)
+    {
+      if (!shared->dirty[p])
+        {
+          // still the same content than the one saved in current.
+          continue;
+        }
+      uint32_t offset = headSize + p * PageSize ();
+      memcpy (current + offset, data + offset, PageSize ());
+      uint32_t version = g_nextVersion++;
+      shared->live_versions[p] = version;
+      (*shared->current_versions)[p] = version;
+      shared->dirty[p] = false;
+      dirty = true;
+      SWAP_STATS_ADD (savedBytes, PageSize ());
+    }
+  if (dirty)
+    {
+      // track the writes of the next owner.
+      mprotect (shared->tracked_start, shared->tracked_pages * PageSize (), PROT_READ);
+    }
+}
+void
+CoojaLoader::ReleaseCurrent (struct SharedModule *shared)
+{
+  shared->current_buffer = 0;
+  if (!shared->tracking)
+    {
+      return;
+    }
+  // nobody saved the pages dirtied by the last owner.
+  bool dirty = false;
+  for (uint32_t p = 0; p < shared->tracked_pages; p++)
+    {
+      if (shared->dirty[p])
+        {
+          shared->live_versions[p] = INVALID_VERSION;
+          shared->dirty[p] = false;
+          dirty = true;
+        }
+    }
+  if (dirty)
+    {
+      mprotect (shared->tracked_start, shared->tracked_pages * PageSize (), PROT_READ);
+    }
+}
+void
+CoojaLoader::TrackStart (struct SharedModule *shared)
+{
+  FaultHandlers::AddHandler (SIGSEGV, &CoojaLoader::SegvHandler);
+  uint8_t *data = (uint8_t *)shared->data_buffer;
+  uint8_t *start = (uint8_t *)ROUND_DOWN (data + PageSize () - 1, PageSize ());
+  uint8_t *end = (uint8_t *)ROUND_DOWN (data + shared->buffer_size, PageSize ());
+  if (end <= start)
+    {
+      // too small: always copied as a whole.
+      start = data + shared->buffer_size;
+      end = start;
+    }
+  shared->tracking = true;
+  shared->tracked_start = start;
+  shared->tracked_pages = (end - start) / PageSize ();
+  shared->dirty.assign (shared->tracked_pages, false);
+  shared->live_versions.assign (shared->tracked_pages, 0);
+  shared->current_versions = 0;
+  if (shared->tracked_pages > 0)
+    {
+      int status = mprotect (start, end - start, PROT_READ);
+      NS_ASSERT_MSG (status == 0, "Unable to protect data section, errno=" << strerror (errno));
+    }
+}
+bool
+CoojaLoader::SegvHandler (int sig, siginfo_t *si, void *context)
+{
+  uint8_t *address = (uint8_t *)si->si_addr;
+  struct SharedModules *modules = Peek ();
+  for (std::list<struct SharedModule *>::iterator i = modules->modules.begin ();
+       i != modules->modules.end (); ++i)
+    {
+      struct SharedModule *shared = *i;
+      if (!shared->tracking || address < shared->tracked_start
+          || address >= shared->tracked_start + shared->tracked_pages * PageSize ())
+        {
+          continue;
+        }
+      uint32_t p = (address - shared->tracked_start) / PageSize ();
+      if (shared->dirty[p])
+        {
+          // already writable: not a fault for us.
+          break;
+        }
+      shared->dirty[p] = true;
+      mprotect (shared->tracked_start + p * PageSize (), PageSize (), PROT_READ | PROT_WRITE);
+      SWAP_STATS_ADD (faults, 1);
+      return true;
+    }
+  // Not a write in a tracked data section.
+  return false;
+}
+void
+CoojaLoader::Prefault (void *buffer, size_t size)
+{
+  uint8_t *begin = (uint8_t *)buffer;
+  uint8_t *end = begin + size;
+  for (std::list<struct Module *>::const_iterator i = m_modules.begin (); i != m_modules.end (); ++i)
+    {
+      struct SharedModule *shared = (*i)->module;
+      if (!shared->tracking || shared->current_buffer != (*i)->buffer)
+        {
+          continue;
+        }
+      uint8_t *trackedEnd = shared->tracked_start + shared->tracked_pages * PageSize ();
+      if (end <= shared->tracked_start || begin >= trackedEnd)
+        {
+          continue;
+        }
+      uint32_t first = (std::max (begin, shared->tracked_start) - shared->tracked_start) / PageSize ();
+      uint32_t last = (std::min (end, trackedEnd) - 1 - shared->tracked_start) / PageSize ();
+      for (uint32_t p = first; p <= last; p++)
+        {
+          if (!shared->dirty[p])
+            {
+              shared->dirty[p] = true;
+              mprotect (shared->tracked_start + p * PageSize (), PageSize (), PROT_READ | PROT_WRITE);
+            }
+        }
     }
 }
 void
@@ -140,7 +389,7 @@ CoojaLoader::NotifyEndExecute (void)
 Loader *
 CoojaLoader::Clone (void)
 {
-  CoojaLoader *clone = new CoojaLoader ();
+  CoojaLoader *clone = new CoojaLoader (m_trackDirtyPages);
   for (std::list<struct Module *>::const_iterator i = m_modules.begin (); i != m_modules.end (); ++i)
     {
       struct Module *module = *i;
@@ -149,9 +398,24 @@ CoojaLoader::Clone (void)
       clonedModule->module->refcount++;
       clonedModule->refcount = module->refcount;
       clonedModule->buffer = malloc (module->module->buffer_size);
-      memcpy (clonedModule->buffer,
-              module->module->data_buffer,
-              clonedModule->module->buffer_size);
+      if (module->module->tracking)
+        {
+          // bring our copy up to date and share its page versions.
+          if (module->module->current_buffer == module->buffer)
+            {
+              SaveCurrent (module->module);
+            }
+          memcpy (clonedModule->buffer,
+                  module->buffer,
+                  clonedModule->module->buffer_size);
+          clonedModule->versions = module->versions;
+        }
+      else
+        {
+          memcpy (clonedModule->buffer,
+                  module->module->data_buffer,
+                  clonedModule->module->buffer_size);
+        }
       // setup deps.
       for (std::list<struct Module *>::iterator j = module->deps.begin ();
            j != module->deps.end (); ++j)
@@ -211,9 +475,6 @@ CoojaLoader::SearchSharedModule (uint32_t id)
   return 0;
 }
 
-#define ROUND_DOWN(addr, align) \
-  (((unsigned long)addr) - (((unsigned long)(addr)) % (align)))
-
 struct CoojaLoader::Module *
 CoojaLoader::LoadModule (std::string filename, int flag, bool failsafe)
 {
@@ -251,6 +512,7 @@ CoojaLoader::LoadModule (std::string filename, int flag, bool failsafe)
                   sharedModule->data_buffer,
                   sharedModule->buffer_size);
           sharedModule->current_buffer = 0;
+          sharedModule->tracking = false;
           for (std::vector<uint32_t>::const_iterator j = cached.deps.begin ();
                j != cached.deps.end (); ++j)
             {
@@ -259,6 +521,10 @@ CoojaLoader::LoadModule (std::string filename, int flag, bool failsafe)
               sharedModule->deps.push_back (dep);
             }
           modules->modules.push_back (sharedModule);
+          if (m_trackDirtyPages)
+            {
+              TrackStart (sharedModule);
+            }
         }
       module = SearchModule (sharedModule->id);
       if (module == 0)
@@ -270,19 +536,31 @@ CoojaLoader::LoadModule (std::string filename, int flag, bool failsafe)
           sharedModule->refcount++;
           module->refcount = 0;
           module->buffer = malloc (sharedModule->buffer_size);
-          if (sharedModule->current_buffer != 0)
+          if (sharedModule->tracking)
             {
-              // save the previous one
-              memcpy (module->module->current_buffer,
-                      module->module->data_buffer,
-                      module->module->buffer_size);
+              // our copy starts as the template, i.e., version 0 of each page.
+              memcpy (module->buffer,
+                      sharedModule->template_buffer,
+                      sharedModule->buffer_size);
+              module->versions.assign (sharedModule->tracked_pages, 0);
+              SwitchData (module);
+            }
+          else
+            {
+              if (sharedModule->current_buffer != 0)
+                {
+                  // save the previous one
+                  memcpy (module->module->current_buffer,
+                          module->module->data_buffer,
+                          module->module->buffer_size);
+                }
+              // make sure we re-initialize the data section with the template
+              memcpy (sharedModule->data_buffer,
+                      sharedModule->template_buffer,
+                      sharedModule->buffer_size);
+              // record current buffer to ensure that it is saved later
+              sharedModule->current_buffer = module->buffer;
             }
-          // make sure we re-initialize the data section with the template
-          memcpy (sharedModule->data_buffer,
-                  sharedModule->template_buffer,
-                  sharedModule->buffer_size);
-          // record current buffer to ensure that it is saved later
-          sharedModule->current_buffer = module->buffer;
           // setup deps.
           for (std::vector<uint32_t>::const_iterator j = cached.deps.begin ();
                j != cached.deps.end (); ++j)
@@ -337,7 +615,7 @@ CoojaLoader::UnloadAll (void)
       NS_LOG_DEBUG ("Delete module " << module);
       if (module->module->current_buffer == module->buffer)
         {
-          module->module->current_buffer = 0;
+          ReleaseCurrent (module->module);
         }
       UnrefSharedModule (module->module);
       free (module->buffer);
@@ -368,7 +646,7 @@ CoojaLoader::Unload (void *handle)
               NS_LOG_DEBUG ("Delete module for " << module->module->handle);
               if (module->module->current_buffer == module->buffer)
                 {
-                  module->module->current_buffer = 0;
+                  ReleaseCurrent (module->module);
                 }
               UnrefSharedModule (module->module);
               free (module->buffer);
@@ -390,15 +668,27 @@ CoojaLoader::Lookup (void *module, std::string symbol)
   return p;
 }
 
-CoojaLoader::CoojaLoader ()
+CoojaLoader::CoojaLoader (bool trackDirtyPages)
+  : m_trackDirtyPages (trackDirtyPages)
 {
   NS_LOG_FUNCTION (this);
+  memset (&m_stats, 0, sizeof (m_stats));
 }
 
 CoojaLoader::~CoojaLoader ()
 {
   NS_LOG_FUNCTION (this);
   UnloadAll ();
+  if (g_currentStats == &m_stats)
+    {
+      g_currentStats = 0;
+    }
+}
+
+struct CoojaLoaderFactory::SwapStats
+CoojaLoader::GetStats (void) const
+{
+  return m_stats;
 }
 
 
@@ -408,10 +698,16 @@ CoojaLoaderFactory::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::CoojaLoaderFactory")
     .SetParent<LoaderFactory> ()
     .AddConstructor<CoojaLoaderFactory> ()
+    .AddAttribute ("TrackDirtyPages", "Write protect the data sections of the loaded modules in order to save"
+                   " only the pages dirtied since the last switch and restore only the pages which changed.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&CoojaLoaderFactory::m_trackDirtyPages),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 CoojaLoaderFactory::CoojaLoaderFactory ()
+  : m_trackDirtyPages (false)
 {
 }
 CoojaLoaderFactory::~CoojaLoaderFactory ()
@@ -420,8 +716,24 @@ CoojaLoaderFactory::~CoojaLoaderFactory ()
 Loader *
 CoojaLoaderFactory::Create (int argc, char **argv, char **envp)
 {
-  CoojaLoader *loader = new CoojaLoader ();
+  CoojaLoader *loader = new CoojaLoader (m_trackDirtyPages);
   return loader;
 }
+struct CoojaLoaderFactory::SwapStats
+CoojaLoaderFactory::GetSwapStats (void)
+{
+  return g_swapStats;
+}
+struct CoojaLoaderFactory::SwapStats
+CoojaLoaderFactory::GetSwapStats (Loader *loader)
+{
+  CoojaLoader *cooja = dynamic_cast<CoojaLoader *> (loader);
+  if (cooja == 0)
+    {
+      struct SwapStats stats = { 0, 0, 0, 0, 0 };
+      return stats;
+    }
+  return cooja->GetStats ();
+}
 
 } // namespace ns3
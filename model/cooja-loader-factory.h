@@ -8,10 +8,26 @@ namespace ns3 {
 class CoojaLoaderFactory : public LoaderFactory
 {
 public:
+  struct SwapStats
+  {
+    uint64_t switches; // number of data segment switches.
+    uint64_t savedBytes; // bytes saved from the data segment to a private copy.
+    uint64_t restoredBytes; // bytes restored from a private copy to the data segment.
+    uint64_t skippedBytes; // bytes not restored because they were unchanged.
+    uint64_t faults; // pages dirtied since the last switch (TrackDirtyPages only).
+  };
+
   static TypeId GetTypeId (void);
   CoojaLoaderFactory ();
   virtual ~CoojaLoaderFactory ();
   virtual Loader * Create (int argc, char **argv, char **envp);
+  // Statistics of all the cooja loaders of this simulation.
+  static struct SwapStats GetSwapStats (void);
+  // Statistics of the switches to this loader, zero if it is not a cooja loader.
+  static struct SwapStats GetSwapStats (Loader *loader);
+
+private:
+  bool m_trackDirtyPages;
 };
 
 } // namespace ns3
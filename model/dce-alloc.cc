@@ -20,10 +20,7 @@ void * dce_calloc (size_t nmemb, size_t size)
 void * dce_malloc (size_t size)
 {
   GET_CURRENT (size);
-  size += sizeof (size_t);
   uint8_t *buffer = current->process->alloc->Malloc (size);
-  memcpy (buffer, &size, sizeof (size_t));
-  buffer += sizeof (size_t);
   NS_LOG_DEBUG ("alloc=" << (void*)buffer);
   return buffer;
 }
@@ -34,11 +31,7 @@ void dce_free (void *ptr)
     {
       return;
     }
-  uint8_t *buffer = (uint8_t*)ptr;
-  size_t size;
-  buffer -= sizeof (size_t);
-  memcpy (&size, buffer, sizeof (size_t));
-  current->process->alloc->Free (buffer, size);
+  current->process->alloc->Free ((uint8_t*)ptr);
 }
 void * dce_realloc (void *ptr, size_t size)
 {
@@ -51,19 +44,7 @@ void * dce_realloc (void *ptr, size_t size)
     {
       return dce_malloc (size);
     }
-  size_t oldSize;
-  uint8_t *buffer = (uint8_t*)ptr;
-  buffer -= sizeof (size_t);
-  size += sizeof (size_t);
-  memcpy (&oldSize, buffer, sizeof (size_t));
-  if (size <= oldSize)
-    {
-      return ptr;
-    }
-  buffer = current->process->alloc->Realloc (buffer, oldSize, size);
-  memcpy (buffer, &size, sizeof (size_t));
-  buffer += sizeof (size_t);
-  return buffer;
+  return current->process->alloc->Realloc ((uint8_t*)ptr, size);
 }
 void * dce_sbrk (intptr_t increment)
 {
@@ -22,6 +22,9 @@
 #include "sys/dce-stat.h"
 #include "process.h"
 #include "utils.h"
+#include "file-system.h"
+#include "file-usage.h"
+#include "memory-file-fd.h"
 #include "ns3/log.h"
 #include "errno.h"
 #include <string.h>
@@ -32,12 +35,45 @@ NS_LOG_COMPONENT_DEFINE ("DceAt");
 
 using namespace ns3;
 
+// The path of the node named by pathname relative to the directory fd.
+static int
+AtPath (Thread *current, int fd, const char *pathname, std::string *path)
+{
+  if (fd == AT_FDCWD || pathname[0] == '/')
+    {
+      *path = UtilsGetVirtualFilePath (pathname);
+      return 0;
+    }
+  FileUsage *fu = current->process->openFiles.Get (fd);
+  if (fu == 0)
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  MemoryFileFd *memoryFd = dynamic_cast<MemoryFileFd *> (fu->GetFile ());
+  if (memoryFd != 0)
+    {
+      *path = memoryFd->GetPath () + "/" + pathname;
+      return 0;
+    }
+  int realFd = fu->GetFile ()->GetRealFd ();
+  std::string directory = (realFd < 0) ? "" : PathOfFd (realFd);
+  std::string base = UtilsGetCurrentDirName () + "/" + UtilsGetRealFilePath ("/");
+  if (directory.compare (0, base.length () - 1, base, 0, base.length () - 1) != 0)
+    {
+      // not a directory of the node.
+      current->err = ENOTDIR;
+      return -1;
+    }
+  *path = std::string (directory, base.length () - 1) + "/" + pathname;
+  return 0;
+}
+
 int dce___fxstatat (int ver, int fd, const char *pathname, struct stat *buf, int flag)
 {
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId () << pathname << buf);
   NS_ASSERT (current != 0);
-  int retval = -1;
 
   if ((0 == pathname) || (0 == buf))
     {
@@ -49,37 +85,27 @@ int dce___fxstatat (int ver, int fd, const char *pathname, struct stat *buf, int
       current->err = ENOENT;
       return -1;
     }
-  if (fd != AT_FDCWD && pathname[0] != '/')
+  UtilsPrefault (current, buf, sizeof (*buf), true);
+  std::string path;
+  if (AtPath (current, fd, pathname, &path) == -1)
     {
-      int realFd = getRealFd (fd, current);
-
-      if (realFd < 0)
-        {
-          current->err = EBADF;
-          return -1;
-        }
-      retval = ::__fxstatat (ver, realFd, pathname, buf, flag);
-    }
-  else
-    {
-      std::string path = UtilsGetCurrentDirName () + "/" +  UtilsGetRealFilePath (pathname);
-      retval = ::__fxstatat (ver, fd, path.c_str (), buf, flag);
+      return -1;
     }
-  if (retval == -1)
+  struct ::stat64 st;
+  if (UtilsGetFileSystem ()->Stat (path, &st, !(flag & AT_SYMLINK_NOFOLLOW)) == -1)
     {
       current->err = errno;
       return -1;
     }
-  return retval;
+  UtilsStat64ToStat (&st, buf);
+  return 0;
 }
-void unlink_notify (std::string fullpath);
+void unlink_notify (std::string path);
 int dce_unlinkat (int fd, const char *pathname, int flags)
 {
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId () << pathname);
   NS_ASSERT (current != 0);
-  int retval = -1;
-  std::string realpath = "";
 
   if (0 == pathname)
     {
@@ -91,36 +117,24 @@ int dce_unlinkat (int fd, const char *pathname, int flags)
       current->err = ENOENT;
       return -1;
     }
-  if (fd != AT_FDCWD && pathname[0] != '/')
+  if (flags & ~AT_REMOVEDIR)
     {
-      int realFd = getRealFd (fd, current);
-
-      if (realFd < 0)
-        {
-          current->err = EBADF;
-          return -1;
-        }
-      retval = ::unlinkat (realFd, pathname, flags);
-      if (retval == 0)
-        {
-          realpath = PathOfFd (realFd);
-        }
+      current->err = EINVAL;
+      return -1;
     }
-  else
+  std::string path;
+  if (AtPath (current, fd, pathname, &path) == -1)
     {
-      realpath = UtilsGetCurrentDirName () + "/" + UtilsGetRealFilePath (pathname);
-      retval = ::unlinkat (fd, realpath.c_str (), flags);
+      return -1;
     }
+  Ptr<FileSystem> fs = UtilsGetFileSystem ();
+  int retval = (flags & AT_REMOVEDIR) ? fs->Rmdir (path) : fs->Unlink (path);
   if (retval == -1)
     {
       current->err = errno;
       return -1;
     }
-
-  if (retval == 0)
-    {
-      unlink_notify (realpath);
-    }
+  unlink_notify (path);
 
   return retval;
 }
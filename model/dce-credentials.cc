@@ -2,6 +2,7 @@
 
 #include "utils.h"
 #include "process.h"
+#include "file-system.h"
 #include "ns3/log.h"
 #include "ns3/assert.h"
 #include <errno.h>
@@ -42,15 +43,21 @@ pid_t dce_getpgrp (void)
 int dce_euidaccess (const char *pathname, int mode)
 {
   NS_LOG_FUNCTION (pathname << mode);
-  std::string rPath = UtilsGetRealFilePath (pathname);
-  int ret = euidaccess (rPath.c_str (), mode);
+  int ret = UtilsGetFileSystem ()->Access (UtilsGetVirtualFilePath (pathname), mode);
+  if (ret == -1)
+    {
+      Current ()->err = errno;
+    }
   return ret;
 }
 int dce_eaccess (const char *pathname, int mode)
 {
   NS_LOG_FUNCTION (pathname << mode);
-  std::string rPath = UtilsGetRealFilePath (pathname);
-  int ret = eaccess (rPath.c_str (), mode);
+  int ret = UtilsGetFileSystem ()->Access (UtilsGetVirtualFilePath (pathname), mode);
+  if (ret == -1)
+    {
+      Current ()->err = errno;
+    }
   return ret;
 }
 int dce_chown(const char *path, uid_t owner, gid_t group)
@@ -30,7 +30,11 @@
 #include "ns3/log.h"
 #include "errno.h"
 #include "dce-stdlib.h"
+#include "host-file-system.h"
+#include "memory-file-fd.h"
 #include <string.h>
+#include <stdlib.h>
+#include <vector>
 
 NS_LOG_COMPONENT_DEFINE ("DceDirent");
 
@@ -40,6 +44,14 @@ struct my__dirstream
 };
 
 namespace ns3 {
+// The directories of a MemoryFileSystem are listed by their fd, not by the host.
+static MemoryFileFd *
+GetMemoryFd (int fd, Thread *current)
+{
+  FileUsage *fu = current->process->openFiles.Get (fd);
+  return fu ? dynamic_cast<MemoryFileFd *> (fu->GetFile ()) : 0;
+}
+
 void
 remove_dir (DIR *d, Thread *current)
 {
@@ -74,6 +86,15 @@ int dce_internalClosedir (DIR *dirp, struct Thread *cur)
           cur->err = EBADF;
           return -1;
         }
+      if (GetMemoryFd (-saveFd, cur) != 0)
+        {
+          // no host fd to close.
+          ds->fd = -1;
+          closedir (dirp);
+          dce_close (-saveFd);
+          remove_dir (dirp, cur);
+          return 0;
+        }
       int realFd = getRealFd (-saveFd, cur);
       if (realFd < 0)
         {
@@ -158,6 +179,11 @@ struct dirent * dce_readdir (DIR *dirp)
       current->err = EBADF;
       return 0;
     }
+  MemoryFileFd *memoryFd = GetMemoryFd (-saveFd, current);
+  if (memoryFd != 0)
+    {
+      return memoryFd->Readdir ();
+    }
   int realFd = getRealFd (-saveFd, current);
   if (realFd < 0)
     {
@@ -184,6 +210,11 @@ struct dirent64 * dce_readdir64 (DIR *dirp)
       current->err = EBADF;
       return 0;
     }
+  MemoryFileFd *memoryFd = GetMemoryFd (-saveFd, current);
+  if (memoryFd != 0)
+    {
+      return memoryFd->Readdir64 ();
+    }
   int realFd = getRealFd (-saveFd, current);
   if (realFd < 0)
     {
@@ -211,6 +242,17 @@ int dce_readdir_r (DIR *dirp, struct dirent *entry, struct dirent **result)
       current->err = EBADF;
       return -1;
     }
+  MemoryFileFd *memoryFd = GetMemoryFd (-saveFd, current);
+  if (memoryFd != 0)
+    {
+      struct dirent *next = memoryFd->Readdir ();
+      if (next != 0)
+        {
+          memcpy (entry, next, sizeof (*entry));
+        }
+      *result = next ? entry : 0;
+      return 0;
+    }
   int realFd = getRealFd (-saveFd, current);
   if (realFd < 0)
     {
@@ -238,6 +280,17 @@ int dce_readdir64_r (DIR *dirp, struct dirent64 *entry, struct dirent64 **result
       current->err = EBADF;
       return -1;
     }
+  MemoryFileFd *memoryFd = GetMemoryFd (-saveFd, current);
+  if (memoryFd != 0)
+    {
+      struct dirent64 *next = memoryFd->Readdir64 ();
+      if (next != 0)
+        {
+          memcpy (entry, next, sizeof (*entry));
+        }
+      *result = next ? entry : 0;
+      return 0;
+    }
   int realFd = getRealFd (-saveFd, current);
   if (realFd < 0)
     {
@@ -278,6 +331,12 @@ void dce_rewinddir (DIR *dirp)
     {
       return;
     }
+  MemoryFileFd *memoryFd = GetMemoryFd (-saveFd, current);
+  if (memoryFd != 0)
+    {
+      memoryFd->Rewinddir ();
+      return;
+    }
   int realFd = getRealFd (-saveFd, current);
   if (realFd < 0)
     {
@@ -288,6 +347,56 @@ void dce_rewinddir (DIR *dirp)
   rewinddir (dirp);
   ds->fd = saveFd;
 }
+// scandir on top of dce_opendir and dce_readdir, for the file systems
+// which are not host directories.
+static int
+ScandirFileSystem (const char *dirp, struct dirent ***namelist,
+                   int (*filter)(const struct dirent *),
+                   int (*compar)(const struct dirent **, const struct dirent **))
+{
+  DIR *dir = dce_opendir (dirp);
+  if (dir == 0)
+    {
+      return -1;
+    }
+  std::vector<struct dirent *> entries;
+  struct dirent *entry;
+  while ((entry = dce_readdir (dir)) != 0)
+    {
+      if (filter != 0 && filter (entry) == 0)
+        {
+          continue;
+        }
+      struct dirent *copy = (struct dirent *) dce_malloc (sizeof (*copy));
+      memcpy (copy, entry, sizeof (*copy));
+      entries.push_back (copy);
+    }
+  dce_closedir (dir);
+  if (compar != 0 && !entries.empty ())
+    {
+      qsort (&entries[0], entries.size (), sizeof (struct dirent *),
+             (int (*)(const void *, const void *)) compar);
+    }
+  int ret = entries.size ();
+  if (namelist)
+    {
+      struct dirent **res = (struct dirent **) dce_malloc (sizeof (struct dirent *) * ret);
+      for (int i = 0; i < ret; i++)
+        {
+          res[i] = entries[i];
+        }
+      *namelist = res;
+    }
+  else
+    {
+      for (int i = 0; i < ret; i++)
+        {
+          dce_free (entries[i]);
+        }
+    }
+  return ret;
+}
+
 int dce_scandir (const char *dirp, struct dirent ***namelist,
                  int (*filter)(const struct dirent *),
                  int (*compar)(const struct dirent **, const struct dirent **))
@@ -295,6 +404,10 @@ int dce_scandir (const char *dirp, struct dirent ***namelist,
   NS_LOG_FUNCTION (Current () << UtilsGetNodeId ());
   NS_ASSERT (Current () != 0);
 
+  if (DynamicCast<HostFileSystem> (UtilsGetFileSystem ()) == 0)
+    {
+      return ScandirFileSystem (dirp, namelist, filter, compar);
+    }
   std::string vPath = UtilsGetRealFilePath (std::string (dirp));
 
   struct dirent **nl = 0;
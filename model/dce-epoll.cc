@@ -21,7 +21,6 @@
 #include "utils.h"
 #include "process.h"
 #include "linux-epoll-fd.h"
-#include "dce-poll.h"
 #include "ns3/log.h"
 #include <errno.h>
 #include "file-usage.h"
@@ -44,7 +43,7 @@ int dce_epoll_create (int size)
 
   UnixFd *unixFd = new LinuxEpollFd (size);
   unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
   return fd;
 }
 
@@ -55,106 +54,37 @@ dce_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
   NS_ASSERT (Current () != 0);
   Thread *current = Current ();
 
-  UnixFd *unixFd = current->process->openFiles[epfd]->GetFileInc ();
-  LinuxEpollFd *epollFd = (LinuxEpollFd *)unixFd;
-  struct epoll_event *ev;
-
-  switch (op)
+  if (!CheckFdExists (current->process, epfd, true))
     {
-    case EPOLL_CTL_ADD:
-      ev = (struct epoll_event *)malloc (sizeof (struct epoll_event));
-      memcpy (ev, event, sizeof (struct epoll_event));
-      epollFd->evs[fd] = ev;
-      break;
-    case EPOLL_CTL_MOD:
-      ev = epollFd->evs[fd];
-      memcpy (ev, event, sizeof (struct epoll_event));
-      break;
-    case EPOLL_CTL_DEL:
-      ev = epollFd->evs[fd];
-      epollFd->evs.erase (fd);
-      free (ev);
-      break;
-    default:
-      break;
+      current->err = EBADF;
+      return -1;
     }
+  UnixFd *unixFd = current->process->openFiles.Get (epfd)->GetFileInc ();
+  LinuxEpollFd *epollFd = (LinuxEpollFd *)unixFd;
+  int retval = epollFd->Ctl (op, fd, event);
 
   FdDecUsage (epfd);
-  return 0;
+  return retval;
 }
 
 int
 dce_epoll_wait(int epfd, struct epoll_event *events,
                int maxevents, int timeout)
 {
-  NS_LOG_FUNCTION (Current () << UtilsGetNodeId () <<  epfd << events 
+  NS_LOG_FUNCTION (Current () << UtilsGetNodeId () <<  epfd << events
                    << maxevents << timeout);
   NS_ASSERT (Current () != 0);
   Thread *current = Current ();
 
-  UnixFd *unixFd = current->process->openFiles[epfd]->GetFileInc ();
-  LinuxEpollFd *epollFd = (LinuxEpollFd *)unixFd;
-
-  struct pollfd pollFd[maxevents];
-  int j = 0;
-
-  for (std::map<int, struct epoll_event *>::iterator i = epollFd->evs.begin (); 
-       i != epollFd->evs.end (); ++i)
+  if (!CheckFdExists (current->process, epfd, true))
     {
-      struct epoll_event *ev = (*i).second;
-      int pevent = 0;
-      if (ev->events & EPOLLIN)
-        {
-          pevent |= POLLIN;
-        }
-      if (ev->events & EPOLLOUT)
-        {
-          pevent |= POLLOUT;
-        }
-
-      NS_LOG_INFO ("set poll " << (*i).first << " event " <<pevent);
-      pollFd[j].events = pevent;
-      pollFd[j].fd = (*i).first;
-      pollFd[j++].revents = 0;
-    }
-
-  int pollRet = dce_poll (pollFd, j, timeout);
-  if (pollRet > 0)
-    {
-      pollRet = 0;
-      for (uint32_t i = 0; i < maxevents; i++)
-        {
-          int fd = pollFd[i].fd;
-
-          if ((POLLIN & pollFd[i].revents) || (POLLHUP & pollFd[i].revents)
-              || (POLLERR & pollFd[i].revents))
-            {
-              memcpy (events, epollFd->evs[fd], sizeof (struct epoll_event));
-              NS_LOG_INFO ("epoll woke up for read with " << fd);
-              pollRet++;
-              events++;
-            }
-          if (POLLOUT & pollFd[i].revents)
-            {
-              memcpy (events, epollFd->evs[fd], sizeof (struct epoll_event));
-              // *events = *epollFd->evs[fd];
-              // events->data.fd = fd;
-              NS_LOG_INFO ("epoll woke up for write with " << fd);
-              pollRet++;
-              events++;
-            }
-          if (POLLPRI & pollFd[i].revents)
-            {
-              memcpy (events, epollFd->evs[fd], sizeof (struct epoll_event));
-              NS_LOG_INFO ("epoll woke up for other with " << fd);
-              // *events = *epollFd->evs[fd];
-              // events->data.fd = fd;
-              pollRet++;
-              events++;
-            }
-        }
+      current->err = EBADF;
+      return -1;
     }
+  UnixFd *unixFd = current->process->openFiles.Get (epfd)->GetFileInc ();
+  LinuxEpollFd *epollFd = (LinuxEpollFd *)unixFd;
+  int retval = epollFd->Wait (events, maxevents, timeout);
 
-  return pollRet;
+  FdDecUsage (epfd);
+  return retval;
 }
-       
@@ -13,6 +13,11 @@ int dce_open64 (const char *path, int flags, ...);
 int dce_creat (const char *path, mode_t mode);
 int dce_fcntl (int fd, int cmd, ...);
 int dce_unlinkat (int dirfd, const char *pathname, int flags);
+ssize_t dce_splice (int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+                    size_t len, unsigned int flags);
+ssize_t dce_tee (int fd_in, int fd_out, size_t len, unsigned int flags);
+ssize_t dce_vmsplice (int fd, const struct iovec *iov, unsigned long nr_segs,
+                      unsigned int flags);
 
 #ifdef __cplusplus
 }
@@ -25,12 +25,16 @@
 #include <linux/rtnetlink.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <limits.h>
+#include <sstream>
 #include "ns3/node.h"
 #include "local-socket-fd-factory.h"
 #include "ns3-socket-fd-factory.h"
 #include "file-usage.h"
 #include "dce-stdlib.h"
 #include "pipe-fd.h"
+#include "host-file-system.h"
+#include "mmap-cache.h"
 
 NS_LOG_COMPONENT_DEFINE ("SimuFd");
 
@@ -52,8 +56,8 @@ NS_LOG_COMPONENT_DEFINE ("SimuFd");
         current->err = ENOENT;                                          \
         return -1;                                                      \
       }                                                                 \
-    std::string fullpath = UtilsGetRealFilePath (pathname);     \
-    int status = ::name (fullpath.c_str (), ## __VA_ARGS__);             \
+    std::string path = UtilsGetVirtualFilePath (pathname);      \
+    int status = UtilsGetFileSystem ()->name (path, ## __VA_ARGS__);     \
     if (status == -1)                                                   \
       {                                                                 \
         current->err = errno;                                           \
@@ -64,6 +68,21 @@ NS_LOG_COMPONENT_DEFINE ("SimuFd");
 
 
 using namespace ns3;
+
+// stdout, stderr and syslog of the process, see DceManager::CreatePidFile
+// and dce_openlog.
+static bool
+IsOutputFile (int fd, std::string vpath)
+{
+  if ((1 == fd) || (2 == fd))
+    {
+      return true;
+    }
+  std::ostringstream oss;
+  oss << "/var/log/" << Current ()->process->pid << "/syslog";
+  return vpath == oss.str ();
+}
+
 int dce_open64 (const char *path, int flags, ...)
 {
   va_list vl;
@@ -111,35 +130,23 @@ int dce_open (const char *path, int flags, ...)
     }
   else
     {
-	  std::string fullpath;
-//	  if (strncmp (path, "/proc/", 6) == 0)
-//	  {
-//		  fullpath = std::string(path);
-//	  }
-//	  else
-	  {
-	      fullpath = UtilsGetRealFilePath (path);
-	  }
-
-      int realFd = ::open (fullpath.c_str (), flags, mode);
-      if (realFd == -1)
+      Ptr<FileSystem> fs = UtilsGetFileSystem ();
+      std::string vpath = UtilsGetVirtualFilePath (path);
+      unixFd = fs->Open (vpath, flags, mode);
+      if (unixFd == 0)
         {
           current->err = errno;
           return -1;
         }
-
-      if (((2 == fd) || (1 == fd)) && (Current ()->process->minimizeFiles))
+      Ptr<HostFileSystem> host = DynamicCast<HostFileSystem> (fs);
+      if ((Current ()->process->minimizeFiles) && host != 0 && IsOutputFile (fd, vpath))
         {
-          unixFd = new UnixFileFdLight (fullpath);
-          close (realFd);
-        }
-      else
-        {
-          unixFd = new UnixFileFd (realFd);
+          unixFd->Unref ();
+          unixFd = new UnixFileFdLight (host->GetRealPath (vpath));
         }
     }
   unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
   return fd;
 }
 
@@ -150,11 +157,14 @@ int dce_creat (const char *path, mode_t mode)
 
 int dce_unlink_real (const char *pathname)
 {
-  DEFINE_FORWARDER_PATH (unlink, pathname);
+  DEFINE_FORWARDER_PATH (Unlink, pathname);
 }
 
-void unlink_notify (std::string fullpath)
+// path is a path of the node: the local sockets are bound to the host
+// path of the same name.
+void unlink_notify (std::string path)
 {
+  std::string fullpath = UtilsGetRealFilePath (path);
   NS_LOG_FUNCTION ("UNLINK FULL PATH " << fullpath);
 
   Ptr<SocketFdFactory> factory = Current ()->process->manager->GetObject<LocalSocketFdFactory> ();
@@ -177,9 +187,7 @@ int dce_unlink (const char *pathname)
 
   if (0 == ret)
     {
-      std::string fullpath = UtilsGetRealFilePath (pathname);
-
-      unlink_notify (fullpath);
+      unlink_notify (UtilsGetVirtualFilePath (pathname));
     }
 
   return ret;
@@ -187,15 +195,15 @@ int dce_unlink (const char *pathname)
 int dce_mkdir (const char *pathname, mode_t mode)
 {
   mode_t m =  (mode & ~(Current ()->process->uMask));
-  DEFINE_FORWARDER_PATH (mkdir, pathname, m);
+  DEFINE_FORWARDER_PATH (Mkdir, pathname, m);
 }
 int dce_rmdir (const char *pathname)
 {
-  DEFINE_FORWARDER_PATH (rmdir, pathname);
+  DEFINE_FORWARDER_PATH (Rmdir, pathname);
 }
 int dce_access (const char *pathname, int mode)
 {
-  DEFINE_FORWARDER_PATH (access, pathname, mode);
+  DEFINE_FORWARDER_PATH (Access, pathname, mode);
 }
 int dce_close (int fd)
 {
@@ -203,32 +211,28 @@ int dce_close (int fd)
   NS_LOG_FUNCTION (Current () << UtilsGetNodeId () << fd);
   NS_ASSERT (Current () != 0);
   Thread *current = Current ();
-  std::map<int,FileUsage *>::iterator it =  current->process->openFiles.find (fd);
+  FileUsage *fu = current->process->openFiles.Get (fd);
 
-  if (it == current->process->openFiles.end ())
+  if (fu == 0)
     {
       current->err = EBADF;
       return -1;
     }
 
-  FileUsage *fu = current->process->openFiles[fd];
-
   if (fu->GetFile () && (1 == fu->GetFile ()->GetFdCount ()))
     {
       // If only one process point to file we can really close it
       // else we be closed while the last process close it
+      fu->GetFile ()->ReleaseEpollItems ();
       retval = fu->GetFile ()->Close ();
     }
   if (fu->CanForget ())
     {
       // If no thread of this process is using it we can free the corresponding fd entry
       // else we be freed by last thread renoncing of using it
-      if (current->process->openFiles[fd] != NULL)
-        {
-          delete fu;
-          current->process->openFiles.erase (fd);
-          fu = 0;
-        }
+      delete fu;
+      current->process->openFiles.Erase (fd);
+      fu = 0;
     }
 
   return retval;
@@ -282,6 +286,16 @@ ssize_t dce_sendmsg (int fd, const struct msghdr *msg, int flags)
 
   OPENED_FD_METHOD (ssize_t, Sendmsg (msg, flags))
 }
+int dce_sendmmsg (int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd << msgvec << vlen << flags);
+  NS_ASSERT (current != 0);
+  // same limit as linux.
+  vlen = std::min (vlen, (unsigned int)UIO_MAXIOV);
+
+  OPENED_FD_METHOD (int, Sendmmsg (msgvec, vlen, flags))
+}
 
 int dce_ioctl (int fd, long unsigned int request, ...)
 {
@@ -317,33 +331,19 @@ ssize_t dce_writev (int fd, const struct iovec *iov, int iovcnt)
       current->err = EBADF;
       return -1;
     }
-
-  size_t count = 0;
-  for (int i = 0; i < iovcnt; ++i)
-    {
-      count += iov[i].iov_len;
-    }
-
-  if (count == 0)
+  if ((0 == iov && iovcnt > 0) || (iovcnt < 0) || (iovcnt > IOV_MAX))
     {
       current->err = EINVAL;
       return -1;
     }
-
-  void *buf = malloc (count);
-  void *bufp = buf;
-  for (int i = 0; i < iovcnt; ++i)
+  if (iovcnt == 0)
     {
-      memcpy (bufp, iov[i].iov_base, iov[i].iov_len);
-      bufp = (char *)bufp + iov[i].iov_len;
+      // nothing to write.
+      return 0;
     }
 
-  UnixFd *unixFd = current->process->openFiles[fd]->GetFileInc ();
-  int retval = unixFd->Write (buf, count);
-  FdDecUsage (fd);
-  free (buf);
-
-  return retval;
+  // the buffers go down to the file, no copy here.
+  OPENED_FD_METHOD (ssize_t, Writev (iov, iovcnt))
 }
 
 ssize_t dce_read (int fd, void *buf, size_t count)
@@ -396,44 +396,22 @@ int dce_socket (int domain, int type, int protocol)
       return -1;
     }
   socket->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, socket);
+  current->process->openFiles.Set (fd, new FileUsage (fd, socket));
 
   return fd;
 }
 ssize_t dce_readv (int fd, const struct iovec *iov, int iovcnt)
 {
   Thread *current = Current ();
-  ssize_t ret = 0;
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd << iov << iovcnt);
+  NS_ASSERT (current != 0);
 
-  if ((0 == iov)||(iovcnt < 0))
+  if ((0 == iov) || (iovcnt < 0) || (iovcnt > IOV_MAX))
     {
       current->err = EINVAL;
       return -1;
     }
-  for (int b = 0; b < iovcnt; b++)
-    {
-      ssize_t r = dce_read (fd, iov[b].iov_base, iov[b].iov_len);
-      if (r >= 0)
-        {
-          ret += r;
-          if (!r || (r < (ssize_t)iov[b].iov_len))
-            {
-              return ret;
-            }
-        }
-      else
-        {
-          if (b == 0)
-            {
-              return -1;
-            }
-          else
-            {
-              return ret;
-            }
-        }
-    }
-  return ret;
+  OPENED_FD_METHOD (ssize_t, Readv (iov, iovcnt))
 }
 int dce_socketpair (int domain, int type, int protocol, int sv[2])
 {
@@ -537,6 +515,22 @@ ssize_t dce_recvmsg (int fd, struct msghdr *msg, int flags)
 
   OPENED_FD_METHOD (ssize_t, Recvmsg (msg, flags))
 }
+int dce_recvmmsg (int fd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                  struct timespec *timeout)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd << msgvec << vlen << flags << timeout);
+  NS_ASSERT (current != 0);
+  if (timeout != 0
+      && (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000L))
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  vlen = std::min (vlen, (unsigned int)UIO_MAXIOV);
+
+  OPENED_FD_METHOD (int, Recvmmsg (msgvec, vlen, flags, timeout))
+}
 int dce_setsockopt (int fd, int level, int optname,
                     const void *optval, socklen_t optlen)
 {
@@ -589,10 +583,10 @@ int dce_dup (int oldfd)
       return -1;
     }
 
-  UnixFd *unixFd = current->process->openFiles[oldfd]->GetFile ();
+  UnixFd *unixFd = current->process->openFiles.Get (oldfd)->GetFile ();
   unixFd->IncFdCount ();
   unixFd->Ref ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
 
   return fd;
 }
@@ -601,7 +595,7 @@ int dce_dup2 (int oldfd, int newfd)
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId () << oldfd << newfd);
   NS_ASSERT (current != 0);
-  if (!CheckFdExists (current->process, oldfd, true) || (newfd > MAX_FDS))
+  if (!CheckFdExists (current->process, oldfd, true) || (newfd < 0) || (newfd >= MAX_FDS))
     {
       current->err = EBADF;
       return -1;
@@ -625,17 +619,17 @@ int dce_dup2 (int oldfd, int newfd)
       return -1;
     }
 
-  UnixFd *unixFd = current->process->openFiles[oldfd]->GetFile ();
+  UnixFd *unixFd = current->process->openFiles.Get (oldfd)->GetFile ();
   unixFd->IncFdCount ();
   unixFd->Ref ();
-  current->process->openFiles[newfd] = new FileUsage (newfd, unixFd);
+  current->process->openFiles.Set (newfd, new FileUsage (newfd, unixFd));
 
   return newfd;
 }
 void * dce_mmap (void *addr, size_t length, int prot, int flags,
                  int fd, off_t offset)
 {
-	if (addr != NULL)
+	if (addr != NULL || fd != -1)
 	{
 		return dce_mmap64 (addr, length, prot, flags, fd, offset);
 	}
@@ -655,7 +649,7 @@ void * dce_mmap64 (void *start, size_t length, int prot, int flags,
   NS_ASSERT (current != 0);
 
   Process *proc = current->process;
-  int openFileCount = proc->openFiles.size();
+  int openFileCount = proc->openFiles.GetCount ();
 
   if (fd == -1)
   {
@@ -683,6 +677,7 @@ int dce_munmap (void *start, size_t length)
       current->err = errno;
       return -1;
     }
+  MmapCache::Get ()->Unmap (start, length);
   return 0;
 }
 off_t dce_lseek (int fildes, off_t offset, int whence)
@@ -751,7 +746,7 @@ int dce_ftruncate (int fd, off_t length)
       current->err = EBADF;
       return -1;
     }
-  UnixFd *unixFd = current->process->openFiles[index].second;
+  UnixFd *unixFd = current->process->openFiles.Get (index).second;
   int retval = unixFd->Ftruncate (length);
   return retval;
   */
@@ -789,13 +784,13 @@ int dce_pipe (int pipefd[2])
       current->err = EMFILE;
       return -1;
     }
-  current->process->openFiles[fdRead] = new FileUsage (fdRead, reader);
+  current->process->openFiles.Set (fdRead, new FileUsage (fdRead, reader));
 
   int fdWrite =  UtilsAllocateFd ();
   if (fdWrite == -1)
     {
-      delete current->process->openFiles[fdRead];
-      current->process->openFiles.erase (fdRead);
+      delete current->process->openFiles.Get (fdRead);
+      current->process->openFiles.Erase (fdRead);
       delete reader;
       current->err = EMFILE;
       return -1;
@@ -805,13 +800,13 @@ int dce_pipe (int pipefd[2])
 
   if (!writer)
     {
-      delete current->process->openFiles[fdRead];
-      current->process->openFiles.erase (fdRead);
+      delete current->process->openFiles.Get (fdRead);
+      current->process->openFiles.Erase (fdRead);
       delete reader;
       current->err = EMFILE;
       return -1;
     }
-  current->process->openFiles[fdWrite] = new FileUsage (fdWrite, writer);
+  current->process->openFiles.Set (fdWrite, new FileUsage (fdWrite, writer));
 
 //  writer->m_peer = reader;
   reader->IncFdCount ();
@@ -890,25 +885,426 @@ int dce_fsync (int fd)
   OPENED_FD_METHOD (int, Fsync ())
 }
 
-ssize_t dce_sendfile(int out_fd, int in_fd, off_t * offset, size_t count)
+// sendfile, splice and tee never move more than this at once through
+// an intermediate buffer or a mapping of the source file.
+#define SENDFILE_CHUNK (1 << 16)
+
+ssize_t dce_sendfile (int out_fd, int in_fd, off_t *offset, size_t count)
 {
-  void *read_buf = NULL;
-  read_buf = malloc (count);
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << out_fd << in_fd << offset << count);
+  NS_ASSERT (current != 0);
 
-  ssize_t res;
-  if (offset)
+  if (!CheckFdExists (current->process, out_fd, true)
+      || !CheckFdExists (current->process, in_fd, true))
     {
-      res = dce_pread (in_fd, read_buf, count, *offset);
+      current->err = EBADF;
+      return -1;
+    }
+  UnixFd *in = current->process->openFiles.Get (in_fd)->GetFileInc ();
+  UnixFd *out = current->process->openFiles.Get (out_fd)->GetFileInc ();
+
+  // like linux, the source must be a seekable file.
+  off64_t start = in->Lseek (0, SEEK_CUR);
+  off64_t position = start;
+  ssize_t total = -1;
+  if (position == -1)
+    {
+      current->err = EINVAL;
     }
   else
     {
-      res = dce_read (in_fd, read_buf, count);
+      if (offset)
+        {
+          position = *offset;
+        }
+      total = 0;
+    }
+
+  // A host file is either sent to another host file by the host
+  // sendfile or mapped and written from the mapping: no copy in between.
+  int realIn = in->GetRealFd ();
+  struct stat st;
+  bool mapped = (total == 0) && (realIn >= 0)
+    && (::fstat (realIn, &st) == 0) && S_ISREG (st.st_mode);
+  bool hostToHost = mapped && (out->GetRealFd () >= 0);
+  uint8_t *buffer = 0;
+  // the whole range is mapped once and written by chunks.
+  void *map = MAP_FAILED;
+  size_t mapLength = 0;
+  uint8_t *data = 0;
+  if (mapped && !hostToHost && position < st.st_size)
+    {
+      long pageSize = sysconf (_SC_PAGESIZE);
+      off_t base = position & ~(pageSize - 1);
+      mapLength = std::min (count, (size_t)(st.st_size - position)) + (position - base);
+      map = ::mmap (0, mapLength, PROT_READ, MAP_SHARED, realIn, base);
+      if (map == MAP_FAILED)
+        {
+          mapped = false;
+        }
+      else
+        {
+          data = (uint8_t *)map + (position - base);
+        }
     }
 
-  if (res == -1) return res;
+  while ((total >= 0) && ((size_t)total < count))
+    {
+      size_t chunk = std::min (count - total, (size_t)SENDFILE_CHUNK);
+      ssize_t written;
+      if (hostToHost)
+        {
+          off_t hostOffset = position;
+          written = ::sendfile (out->GetRealFd (), realIn, &hostOffset, chunk);
+          if (written == -1)
+            {
+              current->err = errno;
+            }
+          else if (written == 0)
+            {
+              break;
+            }
+        }
+      else if (mapped)
+        {
+          if (position >= st.st_size)
+            {
+              break;
+            }
+          chunk = std::min (chunk, (size_t)(st.st_size - position));
+          written = out->Write (data + total, chunk);
+        }
+      else
+        {
+          if (buffer == 0)
+            {
+              buffer = (uint8_t *)malloc (SENDFILE_CHUNK);
+            }
+          ssize_t got = -1;
+          if (in->Lseek (position, SEEK_SET) == position)
+            {
+              got = in->Read (buffer, chunk);
+            }
+          if (got <= 0)
+            {
+              total = (got < 0 && total == 0) ? -1 : total;
+              break;
+            }
+          chunk = got;
+          written = out->Write (buffer, chunk);
+        }
+      if (written < 0)
+        {
+          // keep the error only if nothing was sent.
+          total = (total == 0) ? -1 : total;
+          break;
+        }
+      total += written;
+      position += written;
+      if ((size_t)written < chunk)
+        {
+          // short write, typically a non blocking socket which is full.
+          break;
+        }
+    }
+  free (buffer);
+  if (map != MAP_FAILED)
+    {
+      ::munmap (map, mapLength);
+    }
 
-  ssize_t ret = dce_write (out_fd, read_buf, count);
+  if (total >= 0)
+    {
+      if (offset)
+        {
+          // the file offset does not move when an offset is given.
+          *offset = position;
+          in->Lseek (start, SEEK_SET);
+        }
+      else
+        {
+          in->Lseek (position, SEEK_SET);
+        }
+    }
+  FdDecUsage (in_fd);
+  FdDecUsage (out_fd);
+  return total;
+}
 
-  free (read_buf);
+// Copy at most len bytes from the ring of the pipe in to the pipe out,
+// without blocking, and without an intermediate buffer.
+static size_t
+PipeToPipe (PipeFd *in, PipeFd *out, size_t len)
+{
+  size_t done = 0;
+  while (done < len)
+    {
+      size_t segment;
+      const uint8_t *data = in->PeekSegment (done, &segment);
+      segment = std::min (segment, len - done);
+      size_t pushed = out->Push (data, segment);
+      done += pushed;
+      if (pushed < segment)
+        {
+          break;
+        }
+    }
+  return done;
+}
+
+ssize_t dce_splice (int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+                    size_t len, unsigned int flags)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd_in << off_in << fd_out << off_out << len << flags);
+  NS_ASSERT (current != 0);
+
+  if (!CheckFdExists (current->process, fd_in, true)
+      || !CheckFdExists (current->process, fd_out, true))
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  UnixFd *in = current->process->openFiles.Get (fd_in)->GetFile ();
+  UnixFd *out = current->process->openFiles.Get (fd_out)->GetFile ();
+  PipeFd *pipeIn = dynamic_cast<PipeFd *> (in);
+  PipeFd *pipeOut = dynamic_cast<PipeFd *> (out);
+  if ((pipeIn != 0 && !pipeIn->IsReadSide ())
+      || (pipeOut != 0 && pipeOut->IsReadSide ()))
+    {
+      // wrong end of the pipe: not open for reading or writing.
+      current->err = EBADF;
+      return -1;
+    }
+  if ((pipeIn == 0 && pipeOut == 0)
+      || (pipeIn != 0 && pipeIn->IsPeer (pipeOut)))
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  if ((pipeIn != 0 && off_in != 0) || (pipeOut != 0 && off_out != 0))
+    {
+      current->err = ESPIPE;
+      return -1;
+    }
+  if (len == 0)
+    {
+      return 0;
+    }
+  bool nonBlocking = (flags & SPLICE_F_NONBLOCK) != 0;
+  current->process->openFiles.Get (fd_in)->IncUsage ();
+  current->process->openFiles.Get (fd_out)->IncUsage ();
+
+  ssize_t ret = -1;
+  ssize_t available = pipeIn ? pipeIn->WaitReadable (nonBlocking) : pipeOut->WaitWritable (nonBlocking);
+  if (available <= 0)
+    {
+      ret = available;
+    }
+  else if (pipeIn != 0 && pipeOut != 0)
+    {
+      ssize_t room = pipeOut->WaitWritable (nonBlocking);
+      if (room > 0)
+        {
+          size_t n = std::min (len, (size_t)std::min (available, room));
+          ret = PipeToPipe (pipeIn, pipeOut, n);
+          pipeIn->Consume (ret);
+        }
+      else
+        {
+          ret = room;
+        }
+    }
+  else
+    {
+      size_t n = std::min (std::min (len, (size_t)SENDFILE_CHUNK), (size_t)available);
+      loff_t *off = pipeIn ? off_out : off_in;
+      UnixFd *file = pipeIn ? out : in;
+      off64_t saved = -1;
+      if (off != 0)
+        {
+          saved = file->Lseek (0, SEEK_CUR);
+          if (saved == -1 || file->Lseek (*off, SEEK_SET) != *off)
+            {
+              current->err = EINVAL;
+              n = 0;
+            }
+        }
+      if (n > 0 && pipeIn != 0)
+        {
+          // written straight from the ring: the data leaves the pipe
+          // only once written.
+          ret = 0;
+          while ((size_t)ret < n)
+            {
+              size_t segment;
+              const uint8_t *data = pipeIn->PeekSegment (ret, &segment);
+              segment = std::min (segment, n - ret);
+              ssize_t written = out->Write (data, segment);
+              if (written <= 0)
+                {
+                  ret = (ret == 0) ? written : ret;
+                  break;
+                }
+              ret += written;
+              if ((size_t)written < segment)
+                {
+                  break;
+                }
+            }
+          if (ret > 0)
+            {
+              pipeIn->Consume (ret);
+            }
+        }
+      else if (n > 0)
+        {
+          uint8_t *buffer = (uint8_t *)malloc (n);
+          ret = in->Read (buffer, n);
+          if (ret > 0)
+            {
+              // at most the room seen above unless another writer
+              // filled the pipe meanwhile: then this blocks.
+              ssize_t pushed = pipeOut->Write (buffer, ret);
+              ret = (pushed < 0) ? pushed : ret;
+            }
+          free (buffer);
+        }
+      if (ret > 0 && off != 0)
+        {
+          *off += ret;
+        }
+      if (saved != -1)
+        {
+          file->Lseek (saved, SEEK_SET);
+        }
+    }
+  FdDecUsage (fd_in);
+  FdDecUsage (fd_out);
+  return ret;
+}
+
+ssize_t dce_tee (int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd_in << fd_out << len << flags);
+  NS_ASSERT (current != 0);
+
+  if (!CheckFdExists (current->process, fd_in, true)
+      || !CheckFdExists (current->process, fd_out, true))
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  PipeFd *pipeIn = dynamic_cast<PipeFd *> (current->process->openFiles.Get (fd_in)->GetFile ());
+  PipeFd *pipeOut = dynamic_cast<PipeFd *> (current->process->openFiles.Get (fd_out)->GetFile ());
+  if ((pipeIn != 0 && !pipeIn->IsReadSide ())
+      || (pipeOut != 0 && pipeOut->IsReadSide ()))
+    {
+      // wrong end of the pipe: not open for reading or writing.
+      current->err = EBADF;
+      return -1;
+    }
+  if (pipeIn == 0 || pipeOut == 0 || pipeIn->IsPeer (pipeOut))
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  if (len == 0)
+    {
+      return 0;
+    }
+  bool nonBlocking = (flags & SPLICE_F_NONBLOCK) != 0;
+  current->process->openFiles.Get (fd_in)->IncUsage ();
+  current->process->openFiles.Get (fd_out)->IncUsage ();
+
+  ssize_t ret = pipeIn->WaitReadable (nonBlocking);
+  if (ret > 0)
+    {
+      ssize_t room = pipeOut->WaitWritable (nonBlocking);
+      if (room > 0)
+        {
+          // the data stays in the source pipe.
+          ret = PipeToPipe (pipeIn, pipeOut, std::min (len, (size_t)std::min (ret, room)));
+        }
+      else
+        {
+          ret = room;
+        }
+    }
+  FdDecUsage (fd_in);
+  FdDecUsage (fd_out);
   return ret;
 }
+
+// The page passing of Linux is not provided: SPLICE_F_GIFT is accepted but
+// the pages are always copied into the pipe. The forked processes of a node
+// run at the same addresses and their heap and stack are swapped at each
+// task switch, so a page referenced by the pipe after the call could hold
+// the memory of an other process by the time the reader gets it.
+ssize_t dce_vmsplice (int fd, const struct iovec *iov, unsigned long nr_segs,
+                      unsigned int flags)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << fd << iov << nr_segs << flags);
+  NS_ASSERT (current != 0);
+
+  if (!CheckFdExists (current->process, fd, true))
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  PipeFd *pipe = dynamic_cast<PipeFd *> (current->process->openFiles.Get (fd)->GetFile ());
+  if (pipe == 0 || nr_segs > IOV_MAX || (iov == 0 && nr_segs > 0))
+    {
+      current->err = (pipe == 0) ? EBADF : EINVAL;
+      return -1;
+    }
+  bool nonBlocking = (flags & SPLICE_F_NONBLOCK) != 0;
+  current->process->openFiles.Get (fd)->IncUsage ();
+
+  ssize_t total = 0;
+  if (pipe->IsReadSide ())
+    {
+      // like readv: wait for some data, then take what is there.
+      ssize_t available = pipe->WaitReadable (nonBlocking);
+      if (available <= 0)
+        {
+          total = available;
+        }
+      for (unsigned long i = 0; i < nr_segs && available > 0; i++)
+        {
+          size_t n = pipe->Peek ((uint8_t *)iov[i].iov_base,
+                                 std::min (iov[i].iov_len, (size_t)available));
+          pipe->Consume (n);
+          total += n;
+          available -= n;
+        }
+    }
+  else
+    {
+      // like a pipe write: block until all the segments are in the pipe.
+      for (unsigned long i = 0; i < nr_segs; i++)
+        {
+          const uint8_t *data = (const uint8_t *)iov[i].iov_base;
+          size_t left = iov[i].iov_len;
+          while (left > 0)
+            {
+              ssize_t room = pipe->WaitWritable (nonBlocking);
+              if (room <= 0)
+                {
+                  total = (total == 0) ? room : total;
+                  goto out;
+                }
+              size_t pushed = pipe->Push (data, left);
+              data += pushed;
+              left -= pushed;
+              total += pushed;
+            }
+        }
+    }
+out:
+  FdDecUsage (fd);
+  return total;
+}
@@ -31,6 +31,7 @@
 #include "dce-fcntl.h"
 #include "sys/dce-stat.h"
 #include "loader-factory.h"
+#include "cooja-loader-factory.h"
 #include "ns3/node.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
@@ -47,6 +48,11 @@
 #include "waiter.h"
 #include "dce-dirent.h"
 #include "exec-utils.h"
+#include "host-file-system.h"
+#include "host-io-ring.h"
+#include "mmap-cache.h"
+#include "buffered-log-writer.h"
+#include "ns3/node-list.h"
 
 #include <errno.h>
 #include <dlfcn.h>
@@ -58,6 +64,7 @@
 #include <signal.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("DceManager");
 
@@ -80,11 +87,31 @@ DceManager::GetTypeId (void)
                    MakeUintegerAccessor (&DceManager::m_nextPid),
                    MakeUintegerChecker<uint16_t> ())
     .AddAttribute ("MinimizeOpenFiles", "For each DCE virtual process running it exists 3 files opened (stdin,stdout and stderr),"
-                   " if you enable this flag, the 2 files stderr and stdout will be closed between each write in order to "
+                   " if you enable this flag, the stderr, stdout and syslog files are not kept open: their data is buffered in memory"
+                   " and appended by a background thread in large batches (see the OutputBufferBudget global value), in order to"
                    " minimize the number of opened files and then maximize the number of DCE virtual process running at the same time.",
                    BooleanValue (false),
                    MakeBooleanAccessor (&DceManager::m_minimizeFiles),
                    MakeBooleanChecker ())
+    .AddAttribute ("HeapCopyOnWrite", "If true, the heap of a forked process is shared page by page with its parent"
+                   " and only the pages written by one of them are copied, instead of copying the whole heap"
+                   " at fork time and at each context switch.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DceManager::m_heapCopyOnWrite),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HostIoRing", "If true, the reads, writes and fsyncs of host files issued by the processes"
+                   " during a simulation timestep are submitted together to the host kernel with io_uring at the"
+                   " end of the timestep, instead of one blocking system call each. Ignored if io_uring is not"
+                   " available on the host.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DceManager::m_hostIoRing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ShareFileMappings", "If true, the MAP_PRIVATE mappings of identical files made by the"
+                   " processes of all the nodes share the same host pages, taken from a snapshot of the content"
+                   " of the files. The snapshots of the recently unmapped contents are kept open.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&DceManager::m_shareFileMappings),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -113,6 +140,8 @@ DceManager::DoDispose (void)
       DeleteProcess (tmp, PEC_NS3_END);
     }
   mapCopy.clear ();
+  // the output of the processes is complete when the simulation is destroyed.
+  BufferedLogWriter::FlushAll ();
   Object::DoDispose ();
 }
 
@@ -178,14 +207,13 @@ int (*DceManager::PrepareDoStartProcess (Thread * current)) (int, char **, char
 
   if (current->process->stdinFilename.length () > 0)
     {
-      std::string fullpath = UtilsGetRealFilePath (current->process->stdinFilename);
-      int realFd = ::open (fullpath.c_str (), O_RDONLY, 0);
+      std::string path = UtilsGetVirtualFilePath (current->process->stdinFilename);
+      unixFd = UtilsGetFileSystem ()->Open (path, O_RDONLY, 0);
 
-      if (-1 == realFd)
+      if (0 == unixFd)
         {
           NS_FATAL_ERROR ("Unable to open stdin file : " << current->process->stdinFilename);
         }
-      unixFd = new UnixFileFd (realFd);
     }
   else
     {
@@ -193,7 +221,7 @@ int (*DceManager::PrepareDoStartProcess (Thread * current)) (int, char **, char
     }
   // create fd 0
   unixFd->IncFdCount ();
-  current->process->openFiles[0] = new FileUsage (0, unixFd);
+  current->process->openFiles.Set (0, new FileUsage (0, unixFd));
 
   // create fd 1
   int fd = CreatePidFile (current, "stdout");
@@ -302,6 +330,7 @@ DceManager::CreateProcess (std::string name, std::string stdinfilename, std::vec
   process->rgid = 0;
   process->sgid = 0;
   process->alloc = new KingsleyAlloc ();
+  process->alloc->SetCopyOnWrite (m_heapCopyOnWrite);
   process->originalArgv = 0;
   process->originalArgc = 0;
   process->originalEnvp = 0;
@@ -357,6 +386,8 @@ DceManager::CreateProcess (std::string name, std::string stdinfilename, std::vec
   process->nodeId = UtilsGetNodeId ();
 
   process->minimizeFiles = (m_minimizeFiles ? 1 : 0);
+  process->hostIoRing = (m_hostIoRing ? 1 : 0);
+  process->shareFileMappings = (m_shareFileMappings ? 1 : 0);
 
   if (!pid)
     {
@@ -534,6 +565,7 @@ DceManager::CreateThread (struct Process *process)
   thread->lastTime = Time (0);
   thread->childWaiter = 0;
   thread->pollTable = 0;
+  thread->pollContext = 0;
   thread->ioWait = std::make_pair ((UnixFd*)0,(WaitQueueEntry*)0);
   sigemptyset (&thread->signalMask);
   if (!process->threads.empty ())
@@ -611,22 +643,23 @@ DceManager::Clone (Thread *thread)
   clone->pid = AllocatePid ();
   thread->process->children.insert (clone->pid);
   // dup each file descriptor.
-  for (std::map <int, FileUsage*>::iterator i = thread->process->openFiles.begin ();
-       i != thread->process->openFiles.end (); ++i)
+  for (int fd = thread->process->openFiles.GetNext (0); fd != -1;
+       fd = thread->process->openFiles.GetNext (fd + 1))
     {
-      int fd = i->first;
-      FileUsage* fu = i->second;
+      FileUsage* fu = thread->process->openFiles.Get (fd);
 
-      if (fu && fu->GetFile ())
+      if (fu->GetFile ())
         {
           fu->GetFile ()->IncFdCount ();
           fu->GetFile ()->Ref ();
-          clone->openFiles[fd] = new FileUsage (fd, fu->GetFile ());
+          clone->openFiles.Set (fd, new FileUsage (fd, fu->GetFile ()));
         }
     }
   // don't copy threads, semaphores, mutexes, condition vars
   // XXX: what about file streams ?
   clone->manager = this;
+  clone->hostIoRing = thread->process->hostIoRing;
+  clone->shareFileMappings = thread->process->shareFileMappings;
   sigemptyset (&clone->pendingSignals);
 
   SetDefaultSigHandler (clone->signalHandlers);
@@ -737,20 +770,34 @@ DceManager::CleanupThread (struct Thread *thread)
     }
   if (thread->pollTable != 0)
     {
+      // the table belongs to the poll context of the thread.
       PollTable *lb = thread->pollTable;
       thread->pollTable = 0;
       lb->FreeWait ();
-      delete lb;
-      lb = 0;
     }
 }
 
+void
+DceManager::RecordStackUsage (struct Thread *thread)
+{
+  if (thread->task == 0)
+    {
+      return;
+    }
+  Ptr<TaskManager> manager = GetObject<TaskManager> ();
+  struct ThreadStackUsage &usage = thread->process->stackUsage[thread->tid];
+  usage.size = manager->GetStackSize (thread->task);
+  usage.peak = std::max (usage.peak, manager->GetStackUsage (thread->task));
+}
+
 void
 DceManager::DeleteThread (struct Thread *thread)
 {
   NS_LOG_FUNCTION (this << thread);
   if (thread->task != 0)
     {
+      RecordStackUsage (thread);
+      HostIoRing::Forget (thread->task);
       // the task could be 0 if it was Exited by
       // pthread_exit and it was not pthread_detached.
       GetObject<TaskManager> ()->Stop (thread->task);
@@ -771,6 +818,11 @@ DceManager::DeleteThread (struct Thread *thread)
       thread->childWaiter = 0;
       delete lb;
     }
+  if (0 != thread->pollContext)
+    {
+      delete thread->pollContext;
+      thread->pollContext = 0;
+    }
   delete thread;
 }
 
@@ -795,23 +847,18 @@ DceManager::DeleteProcess (struct Process *process, ProcessEndCause type)
   if (type == PEC_EXIT)
     {
       // We have a Current so we can call dce_close !
-      std::map<int,FileUsage *> openFiles = process->openFiles;
+      FdTable openFiles = process->openFiles;
 
-      for (std::map <int, FileUsage*>::iterator i = openFiles.begin ();
-           i != openFiles.end (); ++i)
+      for (int fd = openFiles.GetNext (0); fd != -1; fd = openFiles.GetNext (fd + 1))
         {
-          int fd = i->first;
-          FileUsage* fu = i->second;
+          FileUsage* fu = openFiles.Get (fd);
 
-          if (fu)
-            {
-              // Nullify count of thread using this file.
-              fu->NullifyUsage ();
-              // Close my files and eventually wake up others processes.
-              dce_close (fd);
-            }
+          // Nullify count of thread using this file.
+          fu->NullifyUsage ();
+          // Close my files and eventually wake up others processes.
+          dce_close (fd);
         }
-      openFiles.clear ();
+      openFiles.Clear ();
     }
 
   // Close all streams opened
@@ -841,19 +888,13 @@ DceManager::DeleteProcess (struct Process *process, ProcessEndCause type)
   // stop itimer timers if there are any.
   process->itimer.Cancel ();
   // Delete File References Memory
-  std::map<int,FileUsage *> openFiles = process->openFiles;
-  process->openFiles.clear ();
-  for (std::map <int, FileUsage*>::iterator i = openFiles.begin ();
-       i != openFiles.end (); ++i)
+  FdTable openFiles = process->openFiles;
+  process->openFiles.Clear ();
+  for (int fd = openFiles.GetNext (0); fd != -1; fd = openFiles.GetNext (fd + 1))
     {
-      FileUsage* fu = i->second;
-
-      if (fu)
-        {
-          delete fu;
-        }
+      delete openFiles.Get (fd);
     }
-  openFiles.clear ();
+  openFiles.Clear ();
 
   // finally, delete remaining threads
   while (!process->threads.empty ())
@@ -912,8 +953,47 @@ DceManager::DeleteProcess (struct Process *process, ProcessEndCause type)
         }
       m_processExit (process->pid, process->timing.exitValue);
     }
+  struct CoojaLoaderFactory::SwapStats swapStats = CoojaLoaderFactory::GetSwapStats (process->loader);
+  if (swapStats.switches > 0)
+    {
+      std::ostringstream oss;
+      oss << "Swap: " << swapStats.switches << " data switches, " << swapStats.savedBytes
+          << " bytes saved, " << swapStats.restoredBytes << " bytes restored, "
+          << swapStats.skippedBytes << " bytes skipped, " << swapStats.faults << " dirty page faults.";
+      std::string line = oss.str ();
+      AppendStatusFile (process->pid, process->nodeId, line);
+    }
   delete process->loader;
   process->loader = 0;
+  struct KingsleyAlloc::Stats heapStats = process->alloc->GetStats ();
+  if (heapStats.switches > 0)
+    {
+      std::ostringstream oss;
+      oss << "Heap: " << heapStats.switches << " switches, " << heapStats.copiedBytes
+          << " bytes copied, " << heapStats.faults << " page faults.";
+      std::string line = oss.str ();
+      AppendStatusFile (process->pid, process->nodeId, line);
+    }
+  struct MmapCache::Stats mmapStats = MmapCache::Get ()->Release (process);
+  if (mmapStats.peak > 0)
+    {
+      std::ostringstream oss;
+      struct MmapCache::Stats nodeStats = MmapCache::Get ()->GetNodeStats (process->nodeId);
+      oss << "Mmap: " << mmapStats.peak << " bytes of files mapped at most, "
+          << mmapStats.shared << " bytes shared with other nodes at exit; node "
+          << nodeStats.mapped << " bytes mapped, " << nodeStats.shared << " shared.";
+      std::string line = oss.str ();
+      AppendStatusFile (process->pid, process->nodeId, line);
+    }
+  for (std::map<uint16_t, struct ThreadStackUsage>::const_iterator i = process->stackUsage.begin ();
+       i != process->stackUsage.end (); ++i)
+    {
+      std::ostringstream oss;
+      oss << "Stack: thread " << i->first << " used " << i->second.peak
+          << " of " << i->second.size << " bytes.";
+      std::string line = oss.str ();
+      AppendStatusFile (process->pid, process->nodeId, line);
+    }
   if (type == PEC_EXIT)
     {
       // Only dispose from good context
@@ -1034,22 +1114,21 @@ void
 DceManager::AppendStatusFile (uint16_t pid, uint32_t nodeId,  std::string &line)
 {
   std::ostringstream oss;
-  oss << "files-" << nodeId << "/var/log/" << pid << "/status";
-  std::string s = oss.str ();
-
-  int fd = ::open (s.c_str (), O_WRONLY | O_APPEND, 0);
+  oss << "/var/log/" << pid << "/status";
+  std::string path = oss.str ();
+  oss.str ("");
+  oss.clear ();
+  oss << "      Time: " << GetTimeStamp () << " --> " << line << std::endl;
+  std::string wholeLine = oss.str ();
 
-  if (fd >= 0) // XXX: When fork is used the pid directory is not created, I plan to fix it when I will work on fork/exec/wait...
+  Ptr<Node> node = NodeList::GetNode (nodeId);
+  Ptr<FileSystem> fs = node->GetObject<FileSystem> ();
+  if (fs == 0)
     {
-      oss.str ("");
-      oss.clear ();
-      oss << "      Time: " << GetTimeStamp () << " --> " << line << std::endl;
-      std::string wholeLine = oss.str ();
-      int l =  wholeLine.length ();
-      const char *str = wholeLine.c_str ();
-      ::write (fd, str, l);
-      ::close (fd);
+      fs = CreateObject<HostFileSystem> ();
+      node->AggregateObject (fs);
     }
+  fs->Append (path, wholeLine.c_str (), wholeLine.length ());
 }
 void
 DceManager::AppendProcFile (Process *p)
@@ -1066,7 +1145,7 @@ DceManager::AppendProcFile (Process *p)
       struct stat st;
       if ((!fstat (fd, &st)) && (0 == st.st_size))
         {
-          const char *header =  "NODE EXIT-CODE PID NS3-START-TIME NS3-END-TIME REAL-START-TIME REAL-END-TIME NS3-DURATION REAL-DURATION CMDLINE\n";
+          const char *header =  "NODE EXIT-CODE PID NS3-START-TIME NS3-END-TIME REAL-START-TIME REAL-END-TIME NS3-DURATION REAL-DURATION STACK-PEAKS CMDLINE\n";
 
           ::write (fd, header, strlen (header));
         }
@@ -1080,7 +1159,17 @@ DceManager::AppendProcFile (Process *p)
           << ' ' <<  p->timing.realEnd
           << ' ' <<  ((p->timing.ns3End - p->timing.ns3Start) / (double) 1000000000)
           << ' ' <<  (p->timing.realEnd - p->timing.realStart)
-          << ' ' <<  p->timing.cmdLine  << std::endl;
+          << ' ';
+      if (p->stackUsage.empty ())
+        {
+          oss << '-';
+        }
+      for (std::map<uint16_t, struct ThreadStackUsage>::const_iterator i = p->stackUsage.begin ();
+           i != p->stackUsage.end (); ++i)
+        {
+          oss << (i == p->stackUsage.begin () ? "" : ",") << i->first << ':' << i->second.peak;
+        }
+      oss << ' ' <<  p->timing.cmdLine  << std::endl;
       std::string wholeLine = oss.str ();
       int l =  wholeLine.length ();
       const char *str = wholeLine.c_str ();
@@ -1511,6 +1600,7 @@ DceManager::Execve (const char *path, const char *argv0, char *const argv[], cha
   process->alloc->Dispose ();
   delete process->alloc;
   process->alloc = new KingsleyAlloc ();
+  process->alloc->SetCopyOnWrite (m_heapCopyOnWrite);
 
   while (!process->mutexes.empty ())
     {
@@ -101,6 +101,8 @@ public:
   struct Thread * CreateThread (struct Process *process);
   void DeleteProcess (struct Process *process, ProcessEndCause type);
   void DeleteThread (struct Thread *thread);
+  // Keep the stack usage of this thread in its process before its task goes away.
+  void RecordStackUsage (struct Thread *thread);
 
   Thread * SearchThread (uint16_t pid, uint16_t tid);
   Process * SearchProcess (uint16_t pid);
@@ -160,6 +162,12 @@ private:
   TracedCallback<uint16_t, int> m_processExit;
   // If true close stderr and stdout between writes .
   bool m_minimizeFiles;
+  // If true forked heaps are copied page by page on write.
+  bool m_heapCopyOnWrite;
+  // If true the host file I/O of the processes goes through io_uring.
+  bool m_hostIoRing;
+  // If true identical files mapped by the processes share their pages.
+  bool m_shareFileMappings;
   std::string m_virtualPath;
 };
 
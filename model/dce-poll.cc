@@ -8,7 +8,7 @@
 #include "dce-manager.h"
 #include "process.h"
 #include "errno.h"
-#include <map>
+#include <vector>
 
 
 NS_LOG_COMPONENT_DEFINE ("PollSelect");
@@ -20,15 +20,28 @@ int dce_poll (struct pollfd *fds, nfds_t nfds, int timeout)
   int count = -1;
   int timed_out = 0;
   Time endtime;
-  // key fd
-  std::map <int, FileUsage*> toUnRef;
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId () << fds << nfds << timeout);
-  PollTable *table = new PollTable ();
-  PollTable *currentTable = table;
-
   NS_ASSERT (current != 0);
 
+  // The poll table, its entries and the usage array are reused from one
+  // call to the next one. A poll nested in another one (from a signal
+  // handler) gets its own context.
+  if (current->pollContext == 0)
+    {
+      current->pollContext = new PollContext ();
+    }
+  PollContext *context = current->pollContext;
+  PollContext *nested = 0;
+  if (context->busy)
+    {
+      nested = new PollContext ();
+      context = nested;
+    }
+  context->busy = true;
+  PollTable *table = &context->table;
+  PollTable *currentTable = table;
+
   if (0 == timeout)
     {
       currentTable = 0;
@@ -54,12 +67,12 @@ int dce_poll (struct pollfd *fds, nfds_t nfds, int timeout)
             {
               validFd++;
               UnixFd *unixFd = 0;
-              FileUsage *fu = current->process->openFiles[fds[i].fd];
+              FileUsage *fu = current->process->openFiles.Get (fds[i].fd);
 
               if (currentTable)
                 {
                   unixFd = fu->GetFileInc ();
-                  toUnRef[fds[i].fd] = fu;
+                  context->usages.push_back (fu);
                   currentTable->SetEventMask (fds[i].events | POLLERR | POLLHUP);
                 }
               else
@@ -111,13 +124,15 @@ int dce_poll (struct pollfd *fds, nfds_t nfds, int timeout)
     }
 
   table->FreeWait ();
-  delete (table);
 
-  for (std::map <int, FileUsage*>::iterator i = toUnRef.begin ();
-       i != toUnRef.end (); ++i)
+  for (std::vector<FileUsage *>::iterator i = context->usages.begin ();
+       i != context->usages.end (); ++i)
     {
-      i->second->DecUsage ();
+      (*i)->DecUsage ();
     }
+  context->usages.clear ();
+  context->busy = false;
+  delete nested;
 
   // Try to break infinite loop in poll with a 0 timeout !
   if ((0 == count) && (0 == timeout))
@@ -134,7 +149,6 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId () << nfds << timeout);
   NS_ASSERT (current != 0);
-  std::map <int, int> eventByFd;
 
   if (nfds == -1)
     {
@@ -154,6 +168,15 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
           return -1;
         }
     }
+  if (current->pollContext == 0)
+    {
+      current->pollContext = new PollContext ();
+    }
+  // A select done by a signal handler which interrupted a poll must not
+  // touch the array of the interrupted select.
+  std::vector<struct pollfd> nestedArray;
+  std::vector<struct pollfd> &fdArray = current->pollContext->busy ? nestedArray : current->pollContext->fds;
+  fdArray.clear ();
   for (int fd = 0; fd < nfds; fd++)
     {
       int event = 0;
@@ -178,10 +201,14 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
               current->err = EBADF;
               return -1;
             }
-          eventByFd[fd] = event;
+          struct pollfd pollFd;
+          pollFd.fd = fd;
+          pollFd.events = event;
+          pollFd.revents = 0;
+          fdArray.push_back (pollFd);
         }
     }
-  nfds = eventByFd.size ();
+  nfds = fdArray.size ();
 
   // select(2):
   // Some  code  calls  select() with all three sets empty, nfds zero, and a
@@ -189,16 +216,6 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
   // precision.
   // 130825: this condition will be passed by dce_poll ()
 
-  struct pollfd pollFd[nfds];
-  int j = 0;
-
-  for (std::map<int, int>::iterator i = eventByFd.begin (); i != eventByFd.end (); ++i)
-    {
-      pollFd[j].events = (*i).second;
-      pollFd[j].fd = (*i).first;
-      pollFd[j++].revents = 0;
-    }
-
   int pollTo = -1;
 
   if (timeout)
@@ -206,6 +223,7 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
       pollTo = timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
     }
 
+  struct pollfd *pollFd = nfds ? &fdArray[0] : 0;
   int pollRet = dce_poll (pollFd, nfds, pollTo);
 
   if (readfds)
@@ -224,7 +242,7 @@ int dce_select (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
   if (pollRet > 0)
     {
       pollRet = 0;
-      for (j = 0; j < nfds; j++)
+      for (int j = 0; j < nfds; j++)
         {
           if (readfds && ((POLLIN & pollFd[j].revents) || (POLLHUP & pollFd[j].revents)
                           || (POLLERR & pollFd[j].revents)))
@@ -90,6 +90,11 @@ void dce_exit (int status)
   oss << "Exit (" << status << ")";
   line = oss.str ();
   DceManager::AppendStatusFile (current->process->pid, current->process->nodeId, line);
+  for (std::vector<Thread *>::const_iterator i = current->process->threads.begin ();
+       i != current->process->threads.end (); ++i)
+    {
+      current->process->manager->RecordStackUsage (*i);
+    }
   DceManager::AppendProcFile (current->process);
 
   current->process->manager->DeleteProcess (current->process, DceManager::PEC_EXIT);
@@ -172,6 +177,7 @@ void dce_pthread_exit (void *arg)
       // but we clear this up to make sure that DeleteThread
       // does not try to 'Stop' the task because the call to
       // Exit below will effectively delete the task.
+      current->process->manager->RecordStackUsage (current);
       current->task = 0;
     }
   else
@@ -7,6 +7,7 @@
 #include "ns3/assert.h"
 #include <errno.h>
 #include "file-usage.h"
+#include "file-system.h"
 
 using namespace ns3;
 
@@ -22,12 +23,14 @@ int dce___xstat (int ver, const char *path, struct stat *buf)
       current->err = ENOENT;
       return -1;
     }
-  int retval = ::__xstat (ver, UtilsGetRealFilePath (path).c_str (), buf);
+  struct ::stat64 st;
+  int retval = UtilsGetFileSystem ()->Stat (UtilsGetVirtualFilePath (path), &st, true);
   if (retval == -1)
     {
       current->err = errno;
       return -1;
     }
+  UtilsStat64ToStat (&st, buf);
   return retval;
 }
 int dce___xstat64 (int ver, const char *path, struct stat64 *buf)
@@ -40,7 +43,7 @@ int dce___xstat64 (int ver, const char *path, struct stat64 *buf)
       current->err = ENOENT;
       return -1;
     }
-  int retval = ::__xstat64 (ver, UtilsGetRealFilePath (path).c_str (), buf);
+  int retval = UtilsGetFileSystem ()->Stat (UtilsGetVirtualFilePath (path), buf, true);
   if (retval == -1)
     {
       current->err = errno;
@@ -74,12 +77,14 @@ int dce___lxstat (int ver, const char *pathname, struct stat *buf)
       current->err = ENOENT;
       return -1;
     }
-  int retval = ::__lxstat (ver, UtilsGetRealFilePath (pathname).c_str (), buf);
+  struct ::stat64 st;
+  int retval = UtilsGetFileSystem ()->Stat (UtilsGetVirtualFilePath (pathname), &st, false);
   if (retval == -1)
     {
       current->err = errno;
       return -1;
     }
+  UtilsStat64ToStat (&st, buf);
   return retval;
 }
 int dce___lxstat64 (int ver, const char *pathname, struct stat64 *buf)
@@ -92,7 +97,7 @@ int dce___lxstat64 (int ver, const char *pathname, struct stat64 *buf)
       current->err = ENOENT;
       return -1;
     }
-  int retval = ::__lxstat64 (ver, UtilsGetRealFilePath (pathname).c_str (), buf);
+  int retval = UtilsGetFileSystem ()->Stat (UtilsGetVirtualFilePath (pathname), buf, false);
   if (retval == -1)
     {
       current->err = errno;
@@ -7,6 +7,7 @@
 #include "process.h"
 #include "utils.h"
 #include "unix-fd.h"
+#include "file-system.h"
 #include "ns3/log.h"
 #include <errno.h>
 #include <fcntl.h>
@@ -696,8 +697,14 @@ int dce_remove (const char *pathname)
       current->err = ENOENT;
       return -1;
     }
-  std::string fullpath = UtilsGetRealFilePath (pathname);
-  int status = ::remove (fullpath.c_str ());
+  Ptr<FileSystem> fs = UtilsGetFileSystem ();
+  std::string path = UtilsGetVirtualFilePath (pathname);
+  struct ::stat64 st;
+  int status = fs->Stat (path, &st, false);
+  if (status == 0)
+    {
+      status = S_ISDIR (st.st_mode) ? fs->Rmdir (path) : fs->Unlink (path);
+    }
   if (status == -1)
     {
       current->err = errno;
@@ -5,9 +5,14 @@
 #include "unix-fd.h"
 #include "unix-file-fd.h"
 #include "file-usage.h"
+#include "file-system.h"
+#include "dce-fcntl.h"
+#include "dce-unistd.h"
 #include "ns3/log.h"
 #include <errno.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <string.h>
 
 
 NS_LOG_COMPONENT_DEFINE ("SimuStdlib");
@@ -95,31 +100,43 @@ int dce_mkstemp (char *temp)
   NS_LOG_FUNCTION (current << UtilsGetNodeId ());
   NS_ASSERT (current != 0);
 
-  std::string fullpath = UtilsGetRealFilePath (temp);
-  NS_LOG_FUNCTION (fullpath);
-  int realFd = mkstemp ((char *)fullpath.c_str ());
-  if (realFd == -1)
+  size_t len = strlen (temp);
+  if (len < 6 || strcmp (temp + len - 6, "XXXXXX") != 0)
     {
-      current->err = errno;
+      current->err = EINVAL;
       return -1;
     }
-
-  int fd = UtilsAllocateFd ();
-  if (fd == -1)
+  static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  // the same names on every run, as everything else in the simulation.
+  static uint32_t seed = 0;
+  for (int attempt = 0; attempt < 1000; attempt++)
     {
-      current->err = EMFILE;
-      return -1;
+      uint32_t value = seed++ * 2654435761U;
+      for (int i = 0; i < 6; i++)
+        {
+          temp[len - 6 + i] = letters[value % (sizeof (letters) - 1)];
+          value /= sizeof (letters) - 1;
+        }
+      int fd = dce_open (temp, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+      if (fd != -1 || current->err != EEXIST)
+        {
+          return fd;
+        }
     }
-  UnixFd *unixFd = 0;
-  unixFd = new UnixFileFd (realFd);
-  unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
-  return fd;
+  current->err = EEXIST;
+  return -1;
 }
 
 FILE * dce_tmpfile (void)
 {
-  int fd = dce_mkstemp ((char *)"temp");
+  char name[] = "tmpfileXXXXXX";
+  int fd = dce_mkstemp (name);
+  if (fd == -1)
+    {
+      return 0;
+    }
+  // no name, like the host tmpfile.
+  dce_unlink (name);
   return dce_fdopen (fd, "w+");
 //  return dce_fopen("temp.dat", "w+");
 }
@@ -130,10 +147,8 @@ int dce_rename (const char *oldpath, const char *newpath)
   NS_LOG_FUNCTION (current << UtilsGetNodeId ());
   NS_ASSERT (current != 0);
 
-  std::string oldFullpath = UtilsGetRealFilePath (oldpath);
-  std::string newFullpath = UtilsGetRealFilePath (newpath);
-
-  int ret = rename (oldFullpath.c_str (), newFullpath.c_str ());
+  int ret = UtilsGetFileSystem ()->Rename (UtilsGetVirtualFilePath (oldpath),
+                                           UtilsGetVirtualFilePath (newpath));
   if (ret == -1)
     {
       current->err = errno;
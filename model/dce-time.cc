@@ -9,6 +9,7 @@
 #include "sys/dce-timerfd.h"
 #include "unix-timer-fd.h"
 #include "file-usage.h"
+#include "file-system.h"
 #include <iostream>
 
 NS_LOG_COMPONENT_DEFINE ("DceTime");
@@ -108,12 +109,21 @@ int dce_clock_getres (clockid_t c, struct timespec *r)
 
 int dce_utime (const char *filename, const struct utimbuf *times)
 {
-  NS_LOG_FUNCTION (Current () << UtilsGetNodeId ());
-  NS_ASSERT (Current () != 0);
-
-  std::string fullpath = UtilsGetRealFilePath (filename);
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << filename);
+  NS_ASSERT (current != 0);
 
-  return utime (fullpath.c_str (), times);
+  if (std::string (filename) == "")
+    {
+      current->err = ENOENT;
+      return -1;
+    }
+  if (UtilsGetFileSystem ()->Utime (UtilsGetVirtualFilePath (filename), times) == -1)
+    {
+      current->err = errno;
+      return -1;
+    }
+  return 0;
 }
 
 
@@ -135,7 +145,7 @@ int dce_timer_create(clockid_t clockid, struct sigevent *sevp, timer_t *timerid)
 
   UnixTimerFd *unixFd = new UnixTimerFd (clockid, flags);
   unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
   return 0;
 }
 
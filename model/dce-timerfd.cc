@@ -24,7 +24,7 @@ int dce_timerfd_create (int clockid, int flags)
 
   UnixFd *unixFd = new UnixTimerFd (clockid, flags);
   unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
   return fd;
 }
 
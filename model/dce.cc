@@ -32,6 +32,8 @@
 #include "ns3/names.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "socket-fd-factory.h"
+#include "memory-file-fd.h"
+#include "file-usage.h"
 
 NS_LOG_COMPONENT_DEFINE ("Dce");
 
@@ -628,17 +630,20 @@ int dce_chdir (const char *path)
   NS_LOG_FUNCTION (current << UtilsGetNodeId ());
   NS_ASSERT (current != 0);
 
-  int retval;
-  std::string newCwd = UtilsGetRealFilePath (path);
+  std::string newCwd = UtilsGetVirtualFilePath (path);
   // test to see if the target directory exists
-  retval = ::open (newCwd.c_str (), O_DIRECTORY | O_RDONLY);
-  if (retval == -1)
+  struct ::stat64 st;
+  if (UtilsGetFileSystem ()->Stat (newCwd, &st, true) == -1)
     {
       current->err = errno;
       return -1;
     }
-  ::close (retval);
-  current->process->cwd = UtilsGetVirtualFilePath (path);
+  if (!S_ISDIR (st.st_mode))
+    {
+      current->err = ENOTDIR;
+      return -1;
+    }
+  current->process->cwd = newCwd;
   return 0;
 }
 int dce_fchdir (int fd)
@@ -646,6 +651,12 @@ int dce_fchdir (int fd)
   Thread *current = Current ();
   NS_LOG_FUNCTION (current << UtilsGetNodeId ());
   NS_ASSERT (current != 0);
+  FileUsage *fu = current->process->openFiles.Get (fd);
+  MemoryFileFd *memoryFd = fu ? dynamic_cast<MemoryFileFd *> (fu->GetFile ()) : 0;
+  if (memoryFd != 0)
+    {
+      return dce_chdir (memoryFd->GetPath ().c_str ());
+    }
   int realFd = getRealFd (fd, current);
 
   if (realFd < 0)
@@ -970,25 +981,21 @@ unsigned int dce_alarm (unsigned int s)
 ssize_t dce_readlink (const char *path, char *buf, size_t bufsize)
 {
   Thread *current = Current ();
-  NS_LOG_FUNCTION (current << UtilsGetNodeId ());
+  NS_LOG_FUNCTION (current << UtilsGetNodeId () << path);
   NS_ASSERT (current != 0);
 
-  std::string fullpath = UtilsGetRealFilePath (path);
-
-  ssize_t ret = readlink (fullpath.c_str (), buf, bufsize);
-
-  if (ret)
+  if (std::string (path) == "")
+    {
+      current->err = ENOENT;
+      return -1;
+    }
+  ssize_t ret = UtilsGetFileSystem ()->Readlink (UtilsGetVirtualFilePath (path), buf, bufsize);
+  if (ret == -1)
     {
       current->err = errno;
-      return ret;
+      return -1;
     }
-
-  int l = UtilsGetRealFilePath ("/").length ();
-
-  memcpy (buf, buf + l, l);
-  buf [l] = 0;
-
-  return 0;
+  return ret;
 }
 #ifdef HAVE_GETCPUFEATURES
 extern "C"
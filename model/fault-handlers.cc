@@ -0,0 +1,114 @@
+#include "fault-handlers.h"
+#include "ns3/assert.h"
+#include <string.h>
+
+// fixed arrays: the signal handler must not see them move.
+#define MAX_HANDLERS 8
+
+namespace ns3 {
+
+static const int g_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+#define N_SIGNALS (sizeof (g_signals) / sizeof (g_signals[0]))
+static struct sigaction g_previousActions[N_SIGNALS];
+static FaultHandlers::Handler g_handlers[N_SIGNALS][MAX_HANDLERS];
+static FaultHandlers::CrashHandler g_crashHandlers[MAX_HANDLERS];
+static bool g_installed = false;
+
+static uint32_t
+GetIndex (int sig)
+{
+  uint32_t index = 0;
+  while (index < N_SIGNALS && g_signals[index] != sig)
+    {
+      index++;
+    }
+  return index;
+}
+
+void
+FaultHandlers::Install (void)
+{
+  if (g_installed)
+    {
+      return;
+    }
+  g_installed = true;
+  memset (g_handlers, 0, sizeof (g_handlers));
+  memset (g_crashHandlers, 0, sizeof (g_crashHandlers));
+  struct sigaction sa;
+  sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  sigemptyset (&sa.sa_mask);
+  sa.sa_sigaction = &FaultHandlers::Dispatch;
+  for (uint32_t i = 0; i < N_SIGNALS; i++)
+    {
+      int status = sigaction (g_signals[i], &sa, &g_previousActions[i]);
+      NS_ASSERT_MSG (status == 0, "Unable to setup the fault handler");
+    }
+}
+
+void
+FaultHandlers::AddHandler (int sig, Handler handler)
+{
+  Install ();
+  uint32_t index = GetIndex (sig);
+  NS_ASSERT_MSG (index < N_SIGNALS, "Not a crash signal: " << sig);
+  for (uint32_t i = 0; i < MAX_HANDLERS; i++)
+    {
+      if (g_handlers[index][i] == handler)
+        {
+          return;
+        }
+      if (g_handlers[index][i] == 0)
+        {
+          g_handlers[index][i] = handler;
+          return;
+        }
+    }
+  NS_ASSERT_MSG (false, "Too many fault handlers");
+}
+
+void
+FaultHandlers::AddCrashHandler (CrashHandler handler)
+{
+  Install ();
+  for (uint32_t i = 0; i < MAX_HANDLERS; i++)
+    {
+      if (g_crashHandlers[i] == handler)
+        {
+          return;
+        }
+      if (g_crashHandlers[i] == 0)
+        {
+          g_crashHandlers[i] = handler;
+          return;
+        }
+    }
+  NS_ASSERT_MSG (false, "Too many crash handlers");
+}
+
+void
+FaultHandlers::Dispatch (int sig, siginfo_t *si, void *context)
+{
+  uint32_t index = GetIndex (sig);
+  for (uint32_t i = 0; i < MAX_HANDLERS && g_handlers[index][i] != 0; i++)
+    {
+      if (g_handlers[index][i](sig, si, context))
+        {
+          // the faulting instruction is restarted.
+          return;
+        }
+    }
+  for (uint32_t i = 0; i < MAX_HANDLERS && g_crashHandlers[i] != 0; i++)
+    {
+      g_crashHandlers[i](sig);
+    }
+  sigaction (sig, &g_previousActions[index], 0);
+  if (si->si_code <= 0)
+    {
+      // sent by kill, raise or abort: it will not come back by itself.
+      raise (sig);
+    }
+  // otherwise the fault happens again on return, for the previous action.
+}
+
+} // namespace ns3
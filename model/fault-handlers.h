@@ -0,0 +1,41 @@
+#ifndef FAULT_HANDLERS_H
+#define FAULT_HANDLERS_H
+
+#include <signal.h>
+
+namespace ns3 {
+
+/**
+ * \brief The single host handler of the crash signals
+ *
+ * SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT are caught once for the
+ * whole host process, with the alternate signal stack. On a signal, the
+ * handlers added for it are asked in turn, such as the copy-on-write
+ * heaps and the dirty page tracking of the loaders: the first one which
+ * claims it ends the signal, and the faulting instruction is restarted.
+ *
+ * A signal nobody claims is a crash: the crash handlers run, for example
+ * to write the buffered output, then the action the host process had
+ * before is restored and gets the signal.
+ *
+ * The handlers are never removed, and are added before the simulation
+ * runs its tasks.
+ */
+class FaultHandlers
+{
+public:
+  // returns true if the signal was dealt with.
+  typedef bool (*Handler)(int sig, siginfo_t *si, void *context);
+  typedef void (*CrashHandler)(int sig);
+
+  static void AddHandler (int sig, Handler handler);
+  static void AddCrashHandler (CrashHandler handler);
+
+private:
+  static void Install (void);
+  static void Dispatch (int sig, siginfo_t *si, void *context);
+};
+
+} // namespace ns3
+
+#endif /* FAULT_HANDLERS_H */
@@ -0,0 +1,116 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#include "fd-table.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+FdTable::FdTable ()
+  : m_firstFreeWord (0),
+    m_count (0)
+{
+}
+
+FileUsage *
+FdTable::Get (int fd) const
+{
+  if (fd < 0 || (uint32_t)fd >= m_files.size ())
+    {
+      return 0;
+    }
+  return m_files[fd];
+}
+
+void
+FdTable::Set (int fd, FileUsage *fu)
+{
+  NS_ASSERT (fd >= 0 && fu != 0);
+  if ((uint32_t)fd >= m_files.size ())
+    {
+      // grow by whole bitmap words.
+      uint32_t words = fd / 64 + 1;
+      m_files.resize (words * 64, 0);
+      m_used.resize (words, 0);
+    }
+  if (m_files[fd] == 0)
+    {
+      m_used[fd / 64] |= ((uint64_t)1) << (fd % 64);
+      m_count++;
+    }
+  m_files[fd] = fu;
+}
+
+void
+FdTable::Erase (int fd)
+{
+  if (Get (fd) == 0)
+    {
+      return;
+    }
+  m_files[fd] = 0;
+  m_used[fd / 64] &= ~(((uint64_t)1) << (fd % 64));
+  m_count--;
+  if ((uint32_t)fd / 64 < m_firstFreeWord)
+    {
+      m_firstFreeWord = fd / 64;
+    }
+}
+
+void
+FdTable::Clear (void)
+{
+  m_files.clear ();
+  m_used.clear ();
+  m_firstFreeWord = 0;
+  m_count = 0;
+}
+
+int
+FdTable::GetLowestFree (int limit) const
+{
+  uint32_t word = m_firstFreeWord;
+  while (word < m_used.size () && m_used[word] == ~((uint64_t)0))
+    {
+      word++;
+    }
+  m_firstFreeWord = word;
+  int fd = word * 64;
+  if (word < m_used.size ())
+    {
+      fd += __builtin_ctzll (~m_used[word]);
+    }
+  return (fd < limit) ? fd : -1;
+}
+
+int
+FdTable::GetNext (int fd) const
+{
+  if (fd < 0)
+    {
+      fd = 0;
+    }
+  uint32_t word = fd / 64;
+  if (word >= m_used.size ())
+    {
+      return -1;
+    }
+  // ignore the fds below fd in the first word.
+  uint64_t bits = m_used[word] & (~((uint64_t)0) << (fd % 64));
+  while (bits == 0)
+    {
+      word++;
+      if (word >= m_used.size ())
+        {
+          return -1;
+        }
+      bits = m_used[word];
+    }
+  return word * 64 + __builtin_ctzll (bits);
+}
+
+uint32_t
+FdTable::GetCount (void) const
+{
+  return m_count;
+}
+
+} // namespace ns3
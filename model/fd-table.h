@@ -0,0 +1,46 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef FD_TABLE_H
+#define FD_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+class FileUsage;
+
+/**
+ * \brief The file descriptors of a process.
+ *
+ * Indexed by fd. A bitmap of the fds in use gives the lowest free fd
+ * and the iteration in fd order without looking at every slot.
+ */
+class FdTable
+{
+public:
+  FdTable ();
+
+  // Return 0 if fd is not in the table.
+  FileUsage * Get (int fd) const;
+  // Replace the entry of fd if any, fu must not be zero.
+  void Set (int fd, FileUsage *fu);
+  // Does nothing if fd is not in the table.
+  void Erase (int fd);
+  void Clear (void);
+
+  // Return the lowest fd not in the table, -1 if all the fds below limit are used.
+  int GetLowestFree (int limit) const;
+  // Return the lowest fd in the table greater or equal to fd, -1 if none.
+  int GetNext (int fd) const;
+  uint32_t GetCount (void) const;
+
+private:
+  std::vector<FileUsage *> m_files;
+  std::vector<uint64_t> m_used; // one bit per fd.
+  mutable uint32_t m_firstFreeWord; // all the words before are full.
+  uint32_t m_count;
+};
+
+} // namespace ns3
+
+#endif /* FD_TABLE_H */
@@ -68,6 +68,15 @@ public:
    */
   virtual uint32_t GetStackSize (struct Fiber *fiber) const = 0;
 
+  /**
+   * \return the largest number of bytes of its stack this fiber was
+   * seen using so far, zero if unknown.
+   */
+  virtual uint32_t GetStackUsage (struct Fiber *fiber) const
+  {
+    return 0;
+  }
+
   /**
    * \param fn a function which will be invoked whenever SwitchTo
    * is invoked, just before it returns to the destination fiber.
@@ -25,15 +25,11 @@
 
 NS_LOG_COMPONENT_DEFINE ("FifoBuffer");
 
-#define MIN_ALLOC 1024
-
 namespace ns3 {
-FifoBuffer::FifoBuffer (size_t mxSz) : m_maxSize (mxSz),
+FifoBuffer::FifoBuffer (size_t mxSz) : m_capacity (RoundUp (mxSz)),
                                        m_buffer (0),
-                                       m_read (0)
-                                       ,
-                                       m_fill (0),
-                                       m_size (0)
+                                       m_read (0),
+                                       m_write (0)
 {
 }
 FifoBuffer::~FifoBuffer (void)
@@ -44,91 +40,124 @@ FifoBuffer::~FifoBuffer (void)
       m_buffer = 0;
     }
 }
-ssize_t
-FifoBuffer::Write (uint8_t *buf, size_t len)
+size_t
+FifoBuffer::RoundUp (size_t size)
 {
-  NS_LOG_FUNCTION ("r:" << m_read << " f:" << m_fill << " s:" <<  m_size);
-  size_t capa = m_size - m_fill;
-
-  if (len <= capa)
+  size_t capacity = 1;
+  while (capacity < size)
     {
-      memcpy (m_buffer + m_fill, buf, len);
-      m_fill += len;
-      return len;
+      capacity <<= 1;
     }
-  if ((m_read > 0) && (m_size <= m_maxSize))
+  return size ? capacity : 0;
+}
+ssize_t
+FifoBuffer::Write (const uint8_t *buf, size_t len)
+{
+  NS_LOG_FUNCTION ("r:" << m_read << " w:" << m_write << " c:" <<  m_capacity);
+  size_t l = std::min (len, m_capacity - (m_write - m_read));
+  if (l == 0)
     {
-      if (m_fill > m_read)
-        {
-          memmove (m_buffer, m_buffer + m_read, m_fill - m_read);
-        }
-      m_fill -= m_read;
-      m_read = 0;
-      return Write (buf, len);
+      return 0;
     }
-  if (m_size == m_maxSize)
+  if (m_buffer == 0)
     {
-      if (capa > 0)
+      m_buffer = (uint8_t*) malloc (m_capacity);
+      if (!m_buffer)
         {
-          memcpy (m_buffer + m_fill, buf, capa);
-          m_fill += capa;
-          return capa;
+          return -1;
         }
     }
-  else
+  size_t start = m_write & (m_capacity - 1);
+  size_t first = std::min (l, m_capacity - start);
+  memcpy (m_buffer + start, buf, first);
+  memcpy (m_buffer, buf + first, l - first);
+  m_write += l;
+  return l;
+}
+void
+FifoBuffer::Copy (uint8_t *to, size_t offset, size_t len) const
+{
+  if (len == 0)
     {
-      size_t newSize = len + m_fill;
-
-      if (newSize - m_size < MIN_ALLOC)
-        {
-          newSize = m_size + MIN_ALLOC;
-        }
-      if (newSize > m_maxSize)
-        {
-          newSize = m_maxSize;
-        }
-
-      uint8_t *newBuf = (uint8_t*) malloc (newSize);
-      if (!newBuf)
-        {
-          return -1;
-        }
-      memcpy (newBuf, m_buffer + m_read, m_fill - m_read);
-      free (m_buffer);
-      m_buffer = newBuf;
-      m_fill -= m_read;
-      m_read = 0;
-      m_size = newSize;
-
-      return Write (buf, len);
+      return;
     }
-  return 0;
+  size_t start = (m_read + offset) & (m_capacity - 1);
+  size_t first = std::min (len, m_capacity - start);
+  memcpy (to, m_buffer + start, first);
+  memcpy (to + first, m_buffer, len - first);
 }
 ssize_t
 FifoBuffer::Read (uint8_t *buf, size_t len)
 {
-  NS_LOG_FUNCTION ("r:" << m_read << " f:" << m_fill << " s:" <<  m_size);
-  size_t capa = m_fill - m_read;
-
-  if (capa > 0)
-    {
-      size_t l = std::min (len, capa);
-
-      memcpy (buf, m_buffer + m_read, l);
-      m_read += l;
-
-      return l;
-    }
-  return 0;
+  NS_LOG_FUNCTION ("r:" << m_read << " w:" << m_write << " c:" <<  m_capacity);
+  size_t l = std::min (len, m_write - m_read);
+  Copy (buf, 0, l);
+  m_read += l;
+  return l;
+}
+ssize_t
+FifoBuffer::Peek (uint8_t *buf, size_t len)
+{
+  size_t l = std::min (len, m_write - m_read);
+  Copy (buf, 0, l);
+  return l;
+}
+void
+FifoBuffer::Discard (size_t len)
+{
+  m_read += std::min (len, m_write - m_read);
+}
+const uint8_t *
+FifoBuffer::PeekSegment (size_t offset, size_t *len) const
+{
+  NS_ASSERT (offset < m_write - m_read);
+  size_t start = (m_read + offset) & (m_capacity - 1);
+  *len = std::min (m_write - m_read - offset, m_capacity - start);
+  return m_buffer + start;
 }
 ssize_t
 FifoBuffer::GetSize ()
 {
-  return m_fill - m_read;
+  return m_write - m_read;
 }
 ssize_t
 FifoBuffer::GetSpace ()
 {
-  return m_maxSize - GetSize ();
+  return m_capacity - GetSize ();
+}
+size_t
+FifoBuffer::GetCapacity (void) const
+{
+  return m_capacity;
+}
+bool
+FifoBuffer::SetCapacity (size_t capacity)
+{
+  capacity = RoundUp (capacity);
+  size_t size = m_write - m_read;
+  if (capacity < size)
+    {
+      return false;
+    }
+  if (capacity == m_capacity)
+    {
+      return true;
+    }
+  uint8_t *buffer = 0;
+  if (size > 0)
+    {
+      buffer = (uint8_t*) malloc (capacity);
+      if (!buffer)
+        {
+          return false;
+        }
+      Copy (buffer, 0, size);
+    }
+  free (m_buffer);
+  m_buffer = buffer;
+  m_read = 0;
+  m_write = size;
+  m_capacity = capacity;
+  return true;
 }
 } // namespace ns3
@@ -25,23 +25,50 @@
 #include <unistd.h>
 
 namespace ns3 {
+/**
+ * Byte FIFO with a fixed capacity, a power of two, kept in a ring: the
+ * storage is allocated once, by the first Write, and the data never
+ * moves until it is read. The offsets run freely and are masked on
+ * access.
+ */
 class FifoBuffer
 {
 public:
+  // the capacity is rounded up to a power of two.
   FifoBuffer (size_t mxSz);
   ~FifoBuffer (void);
 
-  ssize_t Write (uint8_t *buf, size_t len);
+  // returns the number of bytes copied, 0 if the buffer is full.
+  ssize_t Write (const uint8_t *buf, size_t len);
   ssize_t Read (uint8_t *buf, size_t len);
+  // Same as Read but the data stays in the buffer.
+  ssize_t Peek (uint8_t *buf, size_t len);
+  // Drop len bytes, at most GetSize, from the head of the buffer.
+  void Discard (size_t len);
+  /**
+   * \param offset from the head of the buffer, less than GetSize.
+   * \param len set to the number of contiguous bytes at this offset.
+   * \returns the address of the data, it stays valid until it is read or
+   *          discarded.
+   */
+  const uint8_t * PeekSegment (size_t offset, size_t *len) const;
   ssize_t GetSize ();
   ssize_t GetSpace ();
+  size_t GetCapacity (void) const;
+  /**
+   * Change the capacity, rounded up to a power of two.
+   * \returns false if the data in the buffer does not fit.
+   */
+  bool SetCapacity (size_t capacity);
 
 private:
-  const size_t m_maxSize;
+  static size_t RoundUp (size_t size);
+  void Copy (uint8_t *to, size_t offset, size_t len) const;
+
+  size_t m_capacity;
   uint8_t *m_buffer;
-  size_t m_read;
-  size_t m_fill;
-  size_t m_size;
+  size_t m_read; // offset of the head.
+  size_t m_write; // offset of the tail.
 };
 }
 
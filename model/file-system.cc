@@ -0,0 +1,20 @@
+#include "file-system.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (FileSystem);
+
+TypeId
+FileSystem::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::FileSystem")
+    .SetParent<Object> ()
+  ;
+  return tid;
+}
+
+FileSystem::~FileSystem ()
+{
+}
+
+} // namespace ns3
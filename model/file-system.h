@@ -0,0 +1,54 @@
+#ifndef FILE_SYSTEM_H
+#define FILE_SYSTEM_H
+
+#include "ns3/ptr.h"
+#include "ns3/object.h"
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+namespace ns3 {
+
+class UnixFd;
+
+/**
+ * \brief Storage of the files of a node.
+ *
+ * Aggregated to the node, see DceManagerHelper::SetFileSystem. The paths
+ * are absolute paths as seen by the processes of the node. Like the
+ * system calls they implement, the methods return -1 (or 0 for Open) and
+ * set errno on failure.
+ *
+ * Two kinds of files stay in the host files-N directory of the node
+ * whatever its FileSystem: the AF_UNIX socket paths, bound as host
+ * sockets so that LocalSocketFdFactory can find them, and the
+ * /var/log/messages log of the kernel stacks, opened before any process
+ * runs.
+ */
+class FileSystem : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual ~FileSystem ();
+
+  virtual UnixFd * Open (std::string path, int flags, mode_t mode) = 0;
+  virtual int Stat (std::string path, struct ::stat64 *buf, bool followLink) = 0;
+  virtual int Access (std::string path, int mode) = 0;
+  virtual int Mkdir (std::string path, mode_t mode) = 0;
+  virtual int Rmdir (std::string path) = 0;
+  virtual int Unlink (std::string path) = 0;
+  virtual int Rename (std::string oldPath, std::string newPath) = 0;
+  // The target is returned as seen by the processes of the node.
+  virtual ssize_t Readlink (std::string path, char *buf, size_t bufsize) = 0;
+  virtual int Utime (std::string path, const struct utimbuf *times) = 0;
+  /**
+   * Append data to an existing file on behalf of the simulator itself,
+   * e.g. the status files: can be called outside of any process.
+   */
+  virtual int Append (std::string path, const void *buf, size_t count) = 0;
+};
+
+} // namespace ns3
+
+#endif /* FILE_SYSTEM_H */
@@ -36,6 +36,11 @@ FileUsage::FileUsage (int fd, UnixFd *file)
 FileUsage::~FileUsage ()
 {
   m_file->DecFdCount ();
+  if (m_file->GetFdCount () == 0)
+    {
+      // the file may be released without dce_close on exit.
+      m_file->ReleaseEpollItems ();
+    }
   m_file->Unref ();
 }
 
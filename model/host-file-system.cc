@@ -0,0 +1,149 @@
+#include "host-file-system.h"
+#include "unix-file-fd.h"
+#include "buffered-log-writer.h"
+#include "utils.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("HostFileSystem");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (HostFileSystem);
+
+TypeId
+HostFileSystem::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::HostFileSystem")
+    .SetParent<FileSystem> ()
+    .AddConstructor<HostFileSystem> ()
+  ;
+  return tid;
+}
+
+HostFileSystem::HostFileSystem ()
+{
+}
+
+HostFileSystem::~HostFileSystem ()
+{
+}
+
+std::string
+HostFileSystem::GetRealPath (std::string path)
+{
+  Ptr<Node> node = GetObject<Node> ();
+  return UtilsGetAbsRealFilePath (node ? node->GetId () : UtilsGetNodeId (), path);
+}
+
+UnixFd *
+HostFileSystem::Open (std::string path, int flags, mode_t mode)
+{
+  NS_LOG_FUNCTION (this << path << flags << mode);
+  std::string realPath = GetRealPath (path);
+  // the output of the processes may still be in memory.
+  BufferedLogWriter::Sync (realPath);
+  int realFd = ::open (realPath.c_str (), flags, mode);
+  if (realFd == -1)
+    {
+      return 0;
+    }
+  return new UnixFileFd (realFd);
+}
+
+int
+HostFileSystem::Stat (std::string path, struct ::stat64 *buf, bool followLink)
+{
+  std::string realPath = GetRealPath (path);
+  BufferedLogWriter::Sync (realPath);
+  Thread *current = Current ();
+  if (current != 0)
+    {
+      // buf is often in the memory of the process.
+      UtilsPrefault (current, buf, sizeof (*buf), true);
+    }
+  if (followLink)
+    {
+      return ::stat64 (realPath.c_str (), buf);
+    }
+  return ::lstat64 (realPath.c_str (), buf);
+}
+
+int
+HostFileSystem::Access (std::string path, int mode)
+{
+  return ::access (GetRealPath (path).c_str (), mode);
+}
+
+int
+HostFileSystem::Mkdir (std::string path, mode_t mode)
+{
+  return ::mkdir (GetRealPath (path).c_str (), mode);
+}
+
+int
+HostFileSystem::Rmdir (std::string path)
+{
+  return ::rmdir (GetRealPath (path).c_str ());
+}
+
+int
+HostFileSystem::Unlink (std::string path)
+{
+  return ::unlink (GetRealPath (path).c_str ());
+}
+
+int
+HostFileSystem::Rename (std::string oldPath, std::string newPath)
+{
+  return ::rename (GetRealPath (oldPath).c_str (), GetRealPath (newPath).c_str ());
+}
+
+ssize_t
+HostFileSystem::Readlink (std::string path, char *buf, size_t bufsize)
+{
+  char target[PATH_MAX];
+  ssize_t ret = ::readlink (GetRealPath (path).c_str (), target, sizeof (target));
+  if (ret == -1)
+    {
+      return -1;
+    }
+  std::string link (target, ret);
+  // an absolute target in the files of the node.
+  std::string root = UtilsGetCurrentDirName () + "/" + GetRealPath ("/");
+  if (link.compare (0, root.size (), root) == 0)
+    {
+      link = "/" + link.substr (root.size ());
+    }
+  ret = std::min (link.size (), bufsize);
+  memcpy (buf, link.c_str (), ret);
+  return ret;
+}
+
+int
+HostFileSystem::Utime (std::string path, const struct utimbuf *times)
+{
+  return ::utime (GetRealPath (path).c_str (), times);
+}
+
+int
+HostFileSystem::Append (std::string path, const void *buf, size_t count)
+{
+  int fd = ::open (GetRealPath (path).c_str (), O_WRONLY | O_APPEND, 0);
+  if (fd == -1)
+    {
+      return -1;
+    }
+  ssize_t ret = ::write (fd, buf, count);
+  ::close (fd);
+  return (ret == -1) ? -1 : 0;
+}
+
+} // namespace ns3
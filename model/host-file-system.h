@@ -0,0 +1,37 @@
+#ifndef HOST_FILE_SYSTEM_H
+#define HOST_FILE_SYSTEM_H
+
+#include "file-system.h"
+
+namespace ns3 {
+
+/**
+ * \brief The files of the node are host files under files-<nodeId>/
+ *
+ * The default: the files can be read from the host after the simulation.
+ */
+class HostFileSystem : public FileSystem
+{
+public:
+  static TypeId GetTypeId (void);
+  HostFileSystem ();
+  virtual ~HostFileSystem ();
+
+  virtual UnixFd * Open (std::string path, int flags, mode_t mode);
+  virtual int Stat (std::string path, struct ::stat64 *buf, bool followLink);
+  virtual int Access (std::string path, int mode);
+  virtual int Mkdir (std::string path, mode_t mode);
+  virtual int Rmdir (std::string path);
+  virtual int Unlink (std::string path);
+  virtual int Rename (std::string oldPath, std::string newPath);
+  virtual ssize_t Readlink (std::string path, char *buf, size_t bufsize);
+  virtual int Utime (std::string path, const struct utimbuf *times);
+  virtual int Append (std::string path, const void *buf, size_t count);
+
+  // the host path of a path of the node.
+  std::string GetRealPath (std::string path);
+};
+
+} // namespace ns3
+
+#endif /* HOST_FILE_SYSTEM_H */
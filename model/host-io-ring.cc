@@ -0,0 +1,437 @@
+#include "host-io-ring.h"
+#include "task-manager.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_IO_URING_H
+#include <linux/io_uring.h>
+#else
+// never submitted: Setup always fails.
+#define IORING_OP_FSYNC 3
+#define IORING_OP_READ 22
+#define IORING_OP_WRITE 23
+#endif
+
+NS_LOG_COMPONENT_DEFINE ("HostIoRing");
+
+// operations which can be queued at the same time.
+#define RING_ENTRIES 256
+// same limit as the kernel for a single read or write.
+#define MAX_RW_COUNT 0x7ffff000
+
+namespace ns3 {
+
+struct HostIoRing::Request
+{
+  uint8_t opcode;
+  int fd;
+  uint32_t len;
+  bool chained; // after an other operation of its chain.
+  bool cancelled; // by the failure of an earlier one of its chain.
+  TaskManager *manager;
+  Task *task; // 0 if the task was deleted while waiting.
+  void *buffer; // freed here if the task was deleted.
+  ssize_t result;
+  bool done;
+};
+
+static HostIoRing *g_ring = 0;
+static bool g_ringUnavailable = false;
+
+HostIoRing *
+HostIoRing::Get (void)
+{
+  if (g_ring == 0 && !g_ringUnavailable)
+    {
+      HostIoRing *ring = new HostIoRing ();
+      if (ring->Setup ())
+        {
+          g_ring = ring;
+        }
+      else
+        {
+          NS_LOG_WARN ("io_uring not available, host file I/O stays synchronous");
+          delete ring;
+          g_ringUnavailable = true;
+        }
+    }
+  return g_ring;
+}
+
+HostIoRing::HostIoRing ()
+  : m_ringFd (-1),
+    m_entries (0),
+    m_inflight (0),
+    m_destroyScheduled (false)
+{
+}
+
+void
+HostIoRing::Forget (Task *task)
+{
+  if (g_ring == 0)
+    {
+      return;
+    }
+  for (std::vector<struct Request *>::iterator i = g_ring->m_requests.begin ();
+       i != g_ring->m_requests.end (); ++i)
+    {
+      if ((*i)->task == task)
+        {
+          (*i)->task = 0;
+        }
+    }
+}
+
+ssize_t
+HostIoRing::Read (int fd, void *buf, size_t count)
+{
+  count = std::min (count, (size_t)MAX_RW_COUNT);
+  uint8_t *buffer = (uint8_t *)malloc (count);
+  ssize_t result = Submit (IORING_OP_READ, fd, buffer, count);
+  if (result > 0)
+    {
+      memcpy (buf, buffer, result);
+    }
+  free (buffer);
+  return result;
+}
+
+ssize_t
+HostIoRing::Write (int fd, const void *buf, size_t count)
+{
+  count = std::min (count, (size_t)MAX_RW_COUNT);
+  uint8_t *buffer = (uint8_t *)malloc (count);
+  memcpy (buffer, buf, count);
+  ssize_t result = Submit (IORING_OP_WRITE, fd, buffer, count);
+  free (buffer);
+  return result;
+}
+
+ssize_t
+HostIoRing::Readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    {
+      return -EINVAL;
+    }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      count += iov[i].iov_len;
+    }
+  count = std::min (count, (size_t)MAX_RW_COUNT);
+  uint8_t *buffer = (uint8_t *)malloc (count);
+  ssize_t result = Submit (IORING_OP_READ, fd, buffer, count);
+  size_t offset = 0;
+  for (int i = 0; i < iovcnt && result > 0 && offset < (size_t)result; i++)
+    {
+      size_t len = std::min (iov[i].iov_len, result - offset);
+      memcpy (iov[i].iov_base, buffer + offset, len);
+      offset += len;
+    }
+  free (buffer);
+  return result;
+}
+
+ssize_t
+HostIoRing::Writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    {
+      return -EINVAL;
+    }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      count += iov[i].iov_len;
+    }
+  count = std::min (count, (size_t)MAX_RW_COUNT);
+  uint8_t *buffer = (uint8_t *)malloc (count);
+  size_t offset = 0;
+  for (int i = 0; i < iovcnt && offset < count; i++)
+    {
+      size_t len = std::min (iov[i].iov_len, count - offset);
+      memcpy (buffer + offset, iov[i].iov_base, len);
+      offset += len;
+    }
+  ssize_t result = Submit (IORING_OP_WRITE, fd, buffer, count);
+  free (buffer);
+  return result;
+}
+
+int
+HostIoRing::Fsync (int fd)
+{
+  return Submit (IORING_OP_FSYNC, fd, 0, 0);
+}
+
+void
+HostIoRing::Sync (int fd)
+{
+  for (std::vector<struct Request *>::iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+    {
+      if ((*i)->fd == fd)
+        {
+          Drain ();
+          return;
+        }
+    }
+}
+
+void
+HostIoRing::DoDestroy (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the tasks are never going to run again: complete their operations
+  // without them, and do not keep an event of the destroyed simulation.
+  for (std::vector<struct Request *>::iterator i = m_requests.begin ();
+       i != m_requests.end (); ++i)
+    {
+      (*i)->task = 0;
+    }
+  Drain ();
+  m_drain.Cancel ();
+  m_drain = EventId ();
+  m_destroyScheduled = false;
+}
+
+#ifdef HAVE_IO_URING_H
+
+bool
+HostIoRing::Setup (void)
+{
+  struct io_uring_params params;
+  memset (&params, 0, sizeof (params));
+  m_ringFd = syscall (__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (m_ringFd == -1)
+    {
+      return false;
+    }
+  // read and write at the current file position need linux 5.6.
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)
+      || !(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+      close (m_ringFd);
+      return false;
+    }
+  m_entries = params.sq_entries;
+  size_t size = std::max (params.sq_off.array + params.sq_entries * sizeof (uint32_t),
+                          params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe));
+  uint8_t *rings = (uint8_t *)mmap (0, size, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+  if (rings == MAP_FAILED)
+    {
+      close (m_ringFd);
+      return false;
+    }
+  void *sqes = mmap (0, params.sq_entries * sizeof (struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+    {
+      munmap (rings, size);
+      close (m_ringFd);
+      return false;
+    }
+  m_sqHead = (uint32_t *)(rings + params.sq_off.head);
+  m_sqTail = (uint32_t *)(rings + params.sq_off.tail);
+  m_sqMask = *(uint32_t *)(rings + params.sq_off.ring_mask);
+  m_sqArray = (uint32_t *)(rings + params.sq_off.array);
+  m_sqes = (struct io_uring_sqe *)sqes;
+  m_cqHead = (uint32_t *)(rings + params.cq_off.head);
+  m_cqTail = (uint32_t *)(rings + params.cq_off.tail);
+  m_cqMask = *(uint32_t *)(rings + params.cq_off.ring_mask);
+  m_cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+  return true;
+}
+
+ssize_t
+HostIoRing::Submit (uint8_t opcode, int fd, void *buf, uint32_t len)
+{
+  if (m_queue.size () == m_entries)
+    {
+      // no room left: do not wait for the end of the timestep.
+      Drain ();
+    }
+  struct Request *request = new Request ();
+  request->opcode = opcode;
+  request->fd = fd;
+  request->len = len;
+  request->chained = false;
+  request->cancelled = false;
+  request->manager = TaskManager::Current ();
+  request->task = request->manager->CurrentTask ();
+  request->buffer = buf;
+  request->result = 0;
+  request->done = false;
+  m_requests.push_back (request);
+  m_queue.push_back (request);
+
+  if (!m_destroyScheduled)
+    {
+      Simulator::ScheduleDestroy (&HostIoRing::DoDestroy, this);
+      m_destroyScheduled = true;
+    }
+  if (!m_drain.IsRunning ())
+    {
+      m_drain = Simulator::ScheduleNow (&HostIoRing::Drain, this);
+    }
+  while (!request->done)
+    {
+      request->manager->Sleep ();
+    }
+  ssize_t result = request->result;
+  delete request;
+  return result;
+}
+
+uint32_t
+HostIoRing::Enqueue (void)
+{
+  // the operations on the same fd are consecutive entries linked in a
+  // chain: each one starts when the previous one is complete.
+  std::vector<bool> taken (m_queue.size (), false);
+  uint32_t tail = *m_sqTail;
+  for (uint32_t i = 0; i < m_queue.size (); i++)
+    {
+      if (taken[i])
+        {
+          continue;
+        }
+      for (uint32_t j = i; j < m_queue.size (); j++)
+        {
+          if (m_queue[j]->fd != m_queue[i]->fd)
+            {
+              continue;
+            }
+          taken[j] = true;
+          struct Request *request = m_queue[j];
+          request->chained = j != i;
+          request->cancelled = false;
+          uint32_t next = j + 1;
+          while (next < m_queue.size () && m_queue[next]->fd != request->fd)
+            {
+              next++;
+            }
+          uint32_t index = tail & m_sqMask;
+          struct io_uring_sqe *sqe = &m_sqes[index];
+          memset (sqe, 0, sizeof (*sqe));
+          sqe->opcode = request->opcode;
+          sqe->fd = request->fd;
+          sqe->addr = (uintptr_t)request->buffer;
+          sqe->len = request->len;
+          // at the current file position, and move it.
+          sqe->off = (request->opcode == IORING_OP_FSYNC) ? 0 : (uint64_t)-1;
+          sqe->user_data = (uintptr_t)request;
+          if (next < m_queue.size ())
+            {
+              sqe->flags |= IOSQE_IO_LINK;
+            }
+          m_sqArray[index] = index;
+          tail++;
+        }
+    }
+  __atomic_store_n (m_sqTail, tail, __ATOMIC_RELEASE);
+  uint32_t submit = m_queue.size ();
+  m_inflight += submit;
+  return submit;
+}
+
+void
+HostIoRing::Drain (void)
+{
+  NS_LOG_FUNCTION (this << m_queue.size () << m_inflight);
+  while (!m_queue.empty ())
+    {
+      std::vector<struct Request *> queue;
+      std::vector<struct Request *> orphans;
+      uint32_t submit = Enqueue ();
+      queue.swap (m_queue);
+      while (m_inflight > 0)
+        {
+          int status = syscall (__NR_io_uring_enter, m_ringFd, submit, m_inflight,
+                                IORING_ENTER_GETEVENTS, 0, 0);
+          if (status == -1)
+            {
+              if (errno == EINTR)
+                {
+                  continue;
+                }
+              NS_FATAL_ERROR ("io_uring_enter failed: " << strerror (errno));
+            }
+          submit -= std::min ((uint32_t)status, submit);
+          uint32_t head = *m_cqHead;
+          while (head != __atomic_load_n (m_cqTail, __ATOMIC_ACQUIRE))
+            {
+              struct io_uring_cqe *cqe = &m_cqes[head & m_cqMask];
+              struct Request *request = (struct Request *)(uintptr_t)cqe->user_data;
+              head++;
+              m_inflight--;
+              if (cqe->res == -ECANCELED && request->chained)
+                {
+                  // an earlier operation of the chain failed or was
+                  // short: this one was not done yet.
+                  request->cancelled = true;
+                  continue;
+                }
+              m_requests.erase (std::find (m_requests.begin (), m_requests.end (), request));
+              request->result = cqe->res;
+              request->done = true;
+              if (request->task == 0)
+                {
+                  orphans.push_back (request);
+                  continue;
+                }
+              request->manager->Wakeup (request->task);
+            }
+          __atomic_store_n (m_cqHead, head, __ATOMIC_RELEASE);
+        }
+      // again after the end of their chain, in the order of the calls.
+      for (std::vector<struct Request *>::iterator i = queue.begin (); i != queue.end (); ++i)
+        {
+          if (!(*i)->done)
+            {
+              NS_ASSERT ((*i)->cancelled);
+              m_queue.push_back (*i);
+            }
+        }
+      for (std::vector<struct Request *>::iterator i = orphans.begin (); i != orphans.end (); ++i)
+        {
+          free ((*i)->buffer);
+          delete *i;
+        }
+    }
+}
+
+#else /* HAVE_IO_URING_H */
+
+bool
+HostIoRing::Setup (void)
+{
+  return false;
+}
+
+ssize_t
+HostIoRing::Submit (uint8_t opcode, int fd, void *buf, uint32_t len)
+{
+  NS_ASSERT (false);
+  return -ENOSYS;
+}
+
+void
+HostIoRing::Drain (void)
+{
+}
+
+#endif /* HAVE_IO_URING_H */
+
+} // namespace ns3
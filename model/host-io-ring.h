@@ -0,0 +1,94 @@
+#ifndef HOST_IO_RING_H
+#define HOST_IO_RING_H
+
+#include "ns3/event-id.h"
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ns3 {
+
+class Task;
+
+/**
+ * \brief Batch the host file I/O of the tasks with io_uring
+ *
+ * A task calling Read, Write or Fsync queues the operation and sleeps.
+ * At the end of the current simulation timestep, all the operations
+ * queued by the tasks are submitted to the host kernel with a single
+ * system call which returns once they are all complete, then the tasks
+ * resume: the latency of the host disk is paid once per batch instead
+ * of once per operation.
+ *
+ * The data goes through host buffers of the ring so the kernel never
+ * writes into the memory of a task while an other process might be
+ * swapped in at the same addresses.
+ *
+ * Operations on the same fd keep their order, linked in a chain, and use
+ * the file position, so they are only meant for regular files: a pipe or
+ * a terminal would block the whole batch. The chains of different fds run
+ * concurrently. A caller which moves the file position itself,
+ * like lseek, first calls Sync to complete the operations queued on the
+ * fd.
+ *
+ * Get returns 0 when io_uring is not available on this host, the callers
+ * then do their system calls themselves.
+ */
+class HostIoRing
+{
+public:
+  static HostIoRing * Get (void);
+
+  // Same as the system calls but return -errno on error.
+  ssize_t Read (int fd, void *buf, size_t count);
+  ssize_t Write (int fd, const void *buf, size_t count);
+  ssize_t Readv (int fd, const struct iovec *iov, int iovcnt);
+  ssize_t Writev (int fd, const struct iovec *iov, int iovcnt);
+  int Fsync (int fd);
+  // Complete now the operations queued on fd, if any.
+  void Sync (int fd);
+
+  // The task is being deleted: its operations complete without it.
+  static void Forget (Task *task);
+
+private:
+  struct Request;
+
+  HostIoRing ();
+  bool Setup (void);
+  ssize_t Submit (uint8_t opcode, int fd, void *buf, uint32_t len);
+  void Drain (void);
+  // give the queued operations to the kernel, returns their number.
+  uint32_t Enqueue (void);
+  void DoDestroy (void);
+
+  int m_ringFd;
+  uint32_t m_entries;
+  // submission queue.
+  uint32_t *m_sqHead;
+  uint32_t *m_sqTail;
+  uint32_t m_sqMask;
+  uint32_t *m_sqArray;
+  struct io_uring_sqe *m_sqes;
+  // completion queue.
+  uint32_t *m_cqHead;
+  uint32_t *m_cqTail;
+  uint32_t m_cqMask;
+  struct io_uring_cqe *m_cqes;
+
+  // not yet given to the kernel, in the order of the calls.
+  std::vector<struct Request *> m_queue;
+  uint32_t m_inflight; // given to the kernel, not yet complete.
+  std::vector<struct Request *> m_requests; // queued or in flight.
+  EventId m_drain;
+  // a DoDestroy is scheduled at the end of the current simulation.
+  bool m_destroyScheduled;
+};
+
+} // namespace ns3
+
+#endif /* HOST_IO_RING_H */
@@ -0,0 +1,373 @@
+#include "kernel-offload.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <string.h>
+#include <netinet/in.h>
+
+NS_LOG_COMPONENT_DEFINE ("KernelOffload");
+
+#define TCP_FIN 0x01
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+#define TCP_CWR 0x80
+// the IPv6 headers which must stay before a fragment header.
+#define IPV6_HOPOPTS 0
+#define IPV6_ROUTING 43
+#define IPV6_FRAGMENT 44
+#define IPV6_DSTOPTS 60
+
+namespace ns3 {
+
+static uint16_t
+Read16 (const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+static uint32_t
+Read32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+static void
+Write16 (uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+}
+static void
+Write32 (uint8_t *p, uint32_t v)
+{
+  Write16 (p, v >> 16);
+  Write16 (p + 2, v & 0xffff);
+}
+static uint64_t
+Sum (const uint8_t *p, uint32_t len, uint64_t sum)
+{
+  for (; len > 1; len -= 2, p += 2)
+    {
+      sum += Read16 (p);
+    }
+  if (len > 0)
+    {
+      sum += p[0] << 8;
+    }
+  return sum;
+}
+static uint16_t
+Fold (uint64_t sum)
+{
+  while (sum >> 16)
+    {
+      sum = (sum & 0xffff) + (sum >> 16);
+    }
+  return ~sum & 0xffff;
+}
+
+Ptr<Packet>
+KernelOffload::MakePacket (std::vector<uint8_t> &buffer, uint32_t len)
+{
+  // the 14 bytes before the packet are left as room for the header of
+  // the device, as in DevXmit.
+  Ptr<Packet> p = Create<Packet> (&buffer[0], 14 + len);
+  p->RemoveAtStart (14);
+  return p;
+}
+
+void
+KernelOffload::SetIpLength (uint8_t *ip, uint32_t len)
+{
+  if ((ip[0] >> 4) == 4)
+    {
+      uint32_t ipHeaderSize = (ip[0] & 0x0f) * 4;
+      Write16 (ip + 2, len);
+      Write16 (ip + 10, 0);
+      Write16 (ip + 10, Fold (Sum (ip, ipHeaderSize, 0)));
+    }
+  else
+    {
+      Write16 (ip + 4, len - 40);
+    }
+}
+
+void
+KernelOffload::SetChecksum (uint8_t *ip, uint32_t len, uint32_t ipHeaderSize, uint8_t protocol)
+{
+  uint8_t *l4 = ip + ipHeaderSize;
+  uint32_t l4Len = len - ipHeaderSize;
+  uint8_t *checksum = l4 + (protocol == IPPROTO_TCP ? 16 : 6);
+  uint64_t sum = protocol + l4Len;
+  if ((ip[0] >> 4) == 4)
+    {
+      sum = Sum (ip + 12, 8, sum);
+    }
+  else
+    {
+      sum = Sum (ip + 8, 32, sum);
+    }
+  Write16 (checksum, 0);
+  uint16_t value = Fold (Sum (l4, l4Len, sum));
+  // 0 is no checksum for UDP.
+  Write16 (checksum, (value == 0 && protocol == IPPROTO_UDP) ? 0xffff : value);
+}
+
+void
+KernelOffload::SetChecksums (uint8_t *ip, uint32_t len, uint16_t protocol)
+{
+  uint32_t ipHeaderSize;
+  uint8_t l4;
+  if (protocol == 0x0800 && len >= 20 && (ip[0] >> 4) == 4)
+    {
+      ipHeaderSize = (ip[0] & 0x0f) * 4;
+      l4 = ip[9];
+      if ((Read16 (ip + 6) & 0x3fff) != 0)
+        {
+          // the kernel computes the checksums of the fragments itself.
+          return;
+        }
+    }
+  else if (protocol == 0x86dd && len >= 40 && (ip[0] >> 4) == 6)
+    {
+      ipHeaderSize = 40;
+      l4 = ip[6];
+    }
+  else
+    {
+      return;
+    }
+  if ((l4 == IPPROTO_TCP && len >= ipHeaderSize + 20)
+      || (l4 == IPPROTO_UDP && len >= ipHeaderSize + 8))
+    {
+      SetChecksum (ip, len, ipHeaderSize, l4);
+    }
+}
+
+bool
+KernelOffload::SplitTcp (const uint8_t *data, uint32_t len, uint32_t ipHeaderSize, uint32_t mtu,
+                         std::vector<Ptr<Packet> > *packets)
+{
+  if (len < ipHeaderSize + 20)
+    {
+      return false;
+    }
+  uint32_t tcpHeaderSize = (data[ipHeaderSize + 12] >> 4) * 4;
+  uint32_t headerSize = ipHeaderSize + tcpHeaderSize;
+  if (tcpHeaderSize < 20 || len < headerSize || headerSize >= mtu)
+    {
+      return false;
+    }
+  uint32_t mss = mtu - headerSize;
+  uint32_t seq = Read32 (data + ipHeaderSize + 4);
+  uint8_t flags = data[ipHeaderSize + 13];
+  uint16_t id = Read16 (data + 4);
+  bool ipv4 = (data[0] >> 4) == 4;
+  std::vector<uint8_t> buffer (14 + headerSize + mss);
+  uint8_t *ip = &buffer[14];
+  uint8_t *tcp = ip + ipHeaderSize;
+  uint32_t i = 0;
+  for (uint32_t offset = headerSize; offset < len; offset += mss, i++)
+    {
+      uint32_t size = std::min (mss, len - offset);
+      bool last = offset + size == len;
+      memcpy (ip, data, headerSize);
+      memcpy (ip + headerSize, data + offset, size);
+      Write32 (tcp + 4, seq + offset - headerSize);
+      // as TSO: FIN and PSH on the last segment only, CWR on the first.
+      tcp[13] = flags & ~((last ? 0 : TCP_FIN | TCP_PSH) | (i == 0 ? 0 : TCP_CWR));
+      if (ipv4)
+        {
+          Write16 (ip + 4, id + i);
+        }
+      SetIpLength (ip, headerSize + size);
+      SetChecksum (ip, headerSize + size, ipHeaderSize, IPPROTO_TCP);
+      packets->push_back (MakePacket (buffer, headerSize + size));
+    }
+  return true;
+}
+
+void
+KernelOffload::FragmentIpv4 (const uint8_t *data, uint32_t len, uint32_t mtu,
+                             std::vector<Ptr<Packet> > *packets)
+{
+  uint32_t ipHeaderSize = (data[0] & 0x0f) * 4;
+  uint16_t fragment = Read16 (data + 6);
+  uint32_t base = (fragment & 0x1fff) * 8;
+  bool more = (fragment & 0x2000) != 0;
+  uint32_t chunk = (mtu - ipHeaderSize) & ~7U;
+  std::vector<uint8_t> buffer (14 + ipHeaderSize + chunk);
+  uint8_t *ip = &buffer[14];
+  for (uint32_t offset = ipHeaderSize; offset < len; offset += chunk)
+    {
+      uint32_t size = std::min (chunk, len - offset);
+      bool last = offset + size == len;
+      memcpy (ip, data, ipHeaderSize);
+      memcpy (ip + ipHeaderSize, data + offset, size);
+      // the kernel would have fragmented it with the real mtu: DF goes.
+      Write16 (ip + 6, ((base + offset - ipHeaderSize) / 8) | ((last && !more) ? 0 : 0x2000));
+      SetIpLength (ip, ipHeaderSize + size);
+      packets->push_back (MakePacket (buffer, ipHeaderSize + size));
+    }
+}
+
+void
+KernelOffload::FragmentIpv6 (const uint8_t *data, uint32_t len, uint32_t mtu, uint32_t id,
+                             std::vector<Ptr<Packet> > *packets)
+{
+  uint32_t chunk = (mtu - 48) & ~7U;
+  std::vector<uint8_t> buffer (14 + 48 + chunk);
+  uint8_t *ip = &buffer[14];
+  uint8_t *fragment = ip + 40;
+  for (uint32_t offset = 40; offset < len; offset += chunk)
+    {
+      uint32_t size = std::min (chunk, len - offset);
+      bool last = offset + size == len;
+      memcpy (ip, data, 40);
+      ip[6] = IPV6_FRAGMENT;
+      fragment[0] = data[6];
+      fragment[1] = 0;
+      Write16 (fragment + 2, (offset - 40) | (last ? 0 : 1));
+      Write32 (fragment + 4, id);
+      memcpy (ip + 48, data + offset, size);
+      SetIpLength (ip, 48 + size);
+      packets->push_back (MakePacket (buffer, 48 + size));
+    }
+}
+
+void
+KernelOffload::Split (const uint8_t *data, uint32_t len, uint16_t protocol, uint32_t mtu,
+                      uint32_t *fragmentId, std::vector<Ptr<Packet> > *packets)
+{
+  NS_LOG_FUNCTION (len << protocol << mtu);
+  if (protocol == 0x0800 && len >= 20 && (data[0] >> 4) == 4)
+    {
+      uint32_t ipHeaderSize = (data[0] & 0x0f) * 4;
+      bool fragment = (Read16 (data + 6) & 0x3fff) != 0;
+      if (data[9] == IPPROTO_TCP && !fragment
+          && SplitTcp (data, len, ipHeaderSize, mtu, packets))
+        {
+          return;
+        }
+      if (ipHeaderSize + 8 <= mtu)
+        {
+          FragmentIpv4 (data, len, mtu, packets);
+          return;
+        }
+    }
+  else if (protocol == 0x86dd && len >= 40 && (data[0] >> 4) == 6)
+    {
+      if (data[6] == IPPROTO_TCP && SplitTcp (data, len, 40, mtu, packets))
+        {
+          return;
+        }
+      if (data[6] != IPV6_HOPOPTS && data[6] != IPV6_ROUTING && data[6] != IPV6_FRAGMENT
+          && data[6] != IPV6_DSTOPTS && 48 + 8 <= mtu)
+        {
+          FragmentIpv6 (data, len, mtu, (*fragmentId)++, packets);
+          return;
+        }
+    }
+  NS_LOG_WARN ("frame of " << len << " bytes over the device mtu " << mtu << " sent as is");
+  packets->push_back (Create<Packet> (data, len));
+}
+
+bool
+KernelOffload::Parse (Ptr<const Packet> p, uint16_t protocol, struct Segment *segment)
+{
+  uint32_t size = p->GetSize ();
+  uint8_t *h = segment->header;
+  uint32_t copied = p->CopyData (h, std::min (size, (uint32_t)MAX_HEADER_SIZE));
+  uint32_t ipLen;
+  if (protocol == 0x0800)
+    {
+      // no IP options and no fragments, as linux.
+      if (copied < 20 || h[0] != 0x45 || h[9] != IPPROTO_TCP
+          || (Read16 (h + 6) & 0x3fff) != 0)
+        {
+          return false;
+        }
+      segment->ipHeaderSize = 20;
+      ipLen = Read16 (h + 2);
+    }
+  else if (protocol == 0x86dd)
+    {
+      if (copied < 40 || (h[0] >> 4) != 6 || h[6] != IPPROTO_TCP)
+        {
+          return false;
+        }
+      segment->ipHeaderSize = 40;
+      ipLen = 40 + Read16 (h + 4);
+    }
+  else
+    {
+      return false;
+    }
+  if (copied < segment->ipHeaderSize + 20)
+    {
+      return false;
+    }
+  uint32_t tcpHeaderSize = (h[segment->ipHeaderSize + 12] >> 4) * 4;
+  segment->headerSize = segment->ipHeaderSize + tcpHeaderSize;
+  if (tcpHeaderSize < 20 || segment->headerSize > copied
+      || ipLen > size || ipLen <= segment->headerSize)
+    {
+      return false;
+    }
+  segment->payloadSize = ipLen - segment->headerSize;
+  segment->seq = Read32 (h + segment->ipHeaderSize + 4);
+  return true;
+}
+
+bool
+KernelOffload::CanMerge (const struct Segment &first, const struct Segment &last,
+                         uint32_t payloadSize, const struct Segment &next)
+{
+  const uint8_t *a = first.header;
+  const uint8_t *b = next.header;
+  uint32_t ipHeaderSize = first.ipHeaderSize;
+  if (next.headerSize != first.headerSize || next.ipHeaderSize != ipHeaderSize)
+    {
+      return false;
+    }
+  // only the last segment may be smaller than the first one.
+  if (last.payloadSize != first.payloadSize || next.payloadSize > first.payloadSize
+      || next.seq != last.seq + last.payloadSize
+      || first.headerSize + payloadSize + next.payloadSize > 0xffff)
+    {
+      return false;
+    }
+  if (ipHeaderSize == 20)
+    {
+      // tos, DF, ttl and addresses.
+      if (a[1] != b[1] || a[6] != b[6] || a[8] != b[8] || memcmp (a + 12, b + 12, 8) != 0)
+        {
+          return false;
+        }
+    }
+  else if (memcmp (a, b, 4) != 0 || a[7] != b[7] || memcmp (a + 8, b + 8, 32) != 0)
+    {
+      // traffic class, flow label, hop limit or addresses.
+      return false;
+    }
+  const uint8_t *ta = a + ipHeaderSize;
+  const uint8_t *tb = b + ipHeaderSize;
+  // same ports, acknowledgment and options, nothing but ACK and a final
+  // PSH.
+  return memcmp (ta, tb, 4) == 0
+         && memcmp (ta + 8, tb + 8, 4) == 0
+         && last.header[ipHeaderSize + 13] == TCP_ACK
+         && (tb[13] & ~TCP_PSH) == TCP_ACK
+         && memcmp (ta + 20, tb + 20, first.headerSize - ipHeaderSize - 20) == 0;
+}
+
+void
+KernelOffload::Finish (uint8_t *ip, uint32_t len, const struct Segment &last)
+{
+  uint32_t ipHeaderSize = last.ipHeaderSize;
+  uint8_t *tcp = ip + ipHeaderSize;
+  // flags and window of the last segment.
+  tcp[13] = last.header[ipHeaderSize + 13];
+  memcpy (tcp + 14, last.header + ipHeaderSize + 14, 2);
+  SetIpLength (ip, len);
+  SetChecksum (ip, len, ipHeaderSize, IPPROTO_TCP);
+}
+
+} // namespace ns3
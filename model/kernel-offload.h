@@ -0,0 +1,83 @@
+#ifndef KERNEL_OFFLOAD_H
+#define KERNEL_OFFLOAD_H
+
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \brief Segmentation and receive merging of the frames of the kernel
+ * devices, as the offloads of a real network card
+ *
+ * When the kernel is given an mtu larger than the one of its ns-3 device,
+ * its TCP stack sends super-packets of up to 64KB. Segment cuts them at
+ * the device boundary: TCP into segments of the device mtu, as TSO does,
+ * and everything else into IP fragments. The fragments are made as by the
+ * source of the packet, DF or not, even for a forwarded packet, for which
+ * a real router would send back an ICMP error instead.
+ *
+ * On receive, the consecutive segments of the same TCP flow are merged
+ * back into a single packet before they enter the kernel, as GRO does:
+ * Parse reads the headers of a frame, CanMerge tells whether it follows
+ * the frames already merged and Finish fixes the headers of the merged
+ * packet.
+ */
+class KernelOffload
+{
+public:
+  // the largest IP headers kept by Parse: 60 bytes of IPv4 or 40 of
+  // IPv6, and 60 of TCP.
+  enum
+  {
+    MAX_HEADER_SIZE = 120
+  };
+  struct Segment
+  {
+    uint8_t header[MAX_HEADER_SIZE];
+    uint32_t ipHeaderSize;
+    uint32_t headerSize; // IP and TCP.
+    uint32_t payloadSize;
+    uint32_t seq;
+  };
+
+  /**
+   * Cut the IP packet data of len bytes into packets of at most mtu
+   * bytes. fragmentId gives the identifiers of the IPv6 fragments.
+   */
+  static void Split (const uint8_t *data, uint32_t len, uint16_t protocol, uint32_t mtu,
+                     uint32_t *fragmentId, std::vector<Ptr<Packet> > *packets);
+
+  // false if p is not a TCP segment which can be merged.
+  static bool Parse (Ptr<const Packet> p, uint16_t protocol, struct Segment *segment);
+  /**
+   * True if next can be added after last to the merged packet which
+   * starts with first and holds payloadSize bytes of payload.
+   */
+  static bool CanMerge (const struct Segment &first, const struct Segment &last,
+                        uint32_t payloadSize, const struct Segment &next);
+  /**
+   * Fix the IP lengths and checksums of the merged packet at ip, of
+   * len bytes, whose last segment was last.
+   */
+  static void Finish (uint8_t *ip, uint32_t len, const struct Segment &last);
+  // Fill the TCP or UDP checksum of the IP packet at ip, of len bytes.
+  static void SetChecksums (uint8_t *ip, uint32_t len, uint16_t protocol);
+
+private:
+  static bool SplitTcp (const uint8_t *data, uint32_t len, uint32_t ipHeaderSize, uint32_t mtu,
+                        std::vector<Ptr<Packet> > *packets);
+  static void FragmentIpv4 (const uint8_t *data, uint32_t len, uint32_t mtu,
+                            std::vector<Ptr<Packet> > *packets);
+  static void FragmentIpv6 (const uint8_t *data, uint32_t len, uint32_t mtu, uint32_t id,
+                            std::vector<Ptr<Packet> > *packets);
+  static void SetIpLength (uint8_t *ip, uint32_t len);
+  static void SetChecksum (uint8_t *ip, uint32_t len, uint32_t ipHeaderSize, uint8_t protocol);
+  static Ptr<Packet> MakePacket (std::vector<uint8_t> &buffer, uint32_t len);
+};
+
+} // namespace ns3
+
+#endif /* KERNEL_OFFLOAD_H */
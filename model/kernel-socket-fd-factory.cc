@@ -1,5 +1,6 @@
 #include "kernel-socket-fd-factory.h"
 #include "kernel-socket-fd.h"
+#include "kernel-offload.h"
 #include "loader-factory.h"
 #include "dce-manager.h"
 #include "process.h"
@@ -17,9 +18,12 @@
 #include "ns3/log.h"
 #include "ns3/string.h"
 #include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "ns3/pointer.h"
 #include "ns3/node.h"
 #include "ns3/net-device.h"
+#include "ns3/channel.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/event-id.h"
 #include "ns3/simulator.h"
@@ -36,6 +40,11 @@
 
 NS_LOG_COMPONENT_DEFINE ("KernelSocketFdFactory");
 
+// flag of dev_create: the device computes the TCP and UDP checksums. It
+// is kept clear of the SIM_DEV_ flags of sim-init.h, and only given to
+// the stack libraries which list it in their sim_dev_features symbol.
+#define DCE_DEV_CHECKSUM_OFFLOAD (1 << 16)
+
 namespace ns3 {
 
 // Sadly NetDevice Callback add by method AddLinkChangeCallback take no parameters ..
@@ -82,6 +91,29 @@ KernelSocketFdFactory::GetTypeId (void)
                    StringValue ("ns3::UniformRandomVariable[Min=0.0|Max=1.0]"),
                    MakePointerAccessor (&KernelSocketFdFactory::m_ranvar),
                    MakePointerChecker<RandomVariableStream> ())
+    .AddAttribute ("RxBudget",
+                   "The maximum number of received frames given to the kernel at once, "
+                   "per device, as the NAPI weight. 0 gives each frame as soon as it arrives.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&KernelSocketFdFactory::m_rxBudget),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("OffloadMtu",
+                   "The mtu given to the kernel for the devices with a smaller one, as "
+                   "TSO: its super-packets are cut at the mtu of the device, and the "
+                   "received TCP segments are merged back, as GRO. 0 disables the offload.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&KernelSocketFdFactory::m_offloadMtu),
+                   MakeUintegerChecker<uint32_t> (0, 65535))
+    .AddAttribute ("ChecksumOffload",
+                   "Create the devices as computing the TCP and UDP checksums, which the "
+                   "simulated links do not need. They are filled on transmit when a pcap "
+                   "trace or a receiver needs them, and not checked on receive unless the "
+                   "device has an error model. The stack library must support it: none of "
+                   "the libraries shipped with DCE does yet, so it is turned off with a "
+                   "warning for them.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&KernelSocketFdFactory::m_checksumOffload),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -89,10 +121,18 @@ KernelSocketFdFactory::KernelSocketFdFactory ()
   : m_loader (0),
     m_exported (0),
     m_alloc (new KingsleyAlloc ()),
-    m_logFile (0)
+    m_logFile (0),
+    m_rxBudget (0),
+    m_offloadMtu (0),
+    m_fragmentId (0),
+    m_checksumOffload (false),
+    m_timersEventTick (0),
+    m_timersTick (0),
+    m_timersPending (false)
 {
   TypeId::LookupByNameFailSafe ("ns3::LteUeNetDevice", &m_lteUeTid);
   m_variable = CreateObject<UniformRandomVariable> ();
+  m_pollFreeWait = MakeCallback (&KernelSocketFdFactory::PollFreeWait, this);
 }
 
 KernelSocketFdFactory::~KernelSocketFdFactory ()
@@ -126,6 +166,12 @@ KernelSocketFdFactory::DoDispose (void)
   m_kernelTasks.clear ();
   m_manager = 0;
   m_listeners.clear ();
+  for (std::map<struct SimDevice *, struct RxQueue>::iterator i = m_rxQueues.begin (); i != m_rxQueues.end (); ++i)
+    {
+      i->second.poll.Cancel ();
+    }
+  m_rxQueues.clear ();
+  m_timersEvent.Cancel ();
 }
 
 int
@@ -146,21 +192,13 @@ KernelSocketFdFactory::Malloc (struct SimKernel *kernel, unsigned long size)
       return NULL;
     }
 
-  size += sizeof (size_t);
-  uint8_t *buffer = self->m_alloc->Malloc (size);
-  memcpy (buffer, &size, sizeof (size_t));
-  buffer += sizeof (size_t);
-  return buffer;
+  return self->m_alloc->Malloc (size);
 }
 void
 KernelSocketFdFactory::Free (struct SimKernel *kernel, void *ptr)
 {
   KernelSocketFdFactory *self = (KernelSocketFdFactory *)kernel;
-  uint8_t *buffer = (uint8_t*)ptr;
-  size_t size;
-  buffer -= sizeof (size_t);
-  memcpy (&size, buffer, sizeof (size_t));
-  self->m_alloc->Free (buffer, size);
+  self->m_alloc->Free ((uint8_t*)ptr);
 }
 void *
 KernelSocketFdFactory::Memcpy (struct SimKernel *kernel, void *dst, const void *src, unsigned long size)
@@ -262,34 +300,145 @@ KernelSocketFdFactory::Random (struct SimKernel *kernel)
     }
   return u.v;
 }
+struct KernelSocketFdFactory::KernelTimer *
+KernelSocketFdFactory::AllocateTimer (void (*fn)(void *context), void *context,
+                                     void (*pre_fn)(void))
+{
+  struct KernelTimer *timer;
+  if (m_freeTimers.empty ())
+    {
+      // a deque never moves its elements.
+      m_timerPool.push_back (KernelTimer ());
+      timer = &m_timerPool.back ();
+    }
+  else
+    {
+      timer = m_freeTimers.back ();
+      m_freeTimers.pop_back ();
+    }
+  TimerWheel::InitEntry (&timer->entry, timer);
+  timer->event = EventId ();
+  timer->fn = fn;
+  timer->context = context;
+  timer->pre_fn = pre_fn;
+  timer->expired = false;
+  timer->cancelled = false;
+  return timer;
+}
 void
-KernelSocketFdFactory::EventTrampoline (void (*fn)(void *context),
-                                       void *context, void (*pre_fn)(void),
-                                       Ptr<EventIdHolder> event)
+KernelSocketFdFactory::ReleaseTimer (struct KernelTimer *timer)
+{
+  m_freeTimers.push_back (timer);
+}
+void
+KernelSocketFdFactory::FireTimer (struct KernelTimer *timer)
 {
   m_loader->NotifyStartExecute ();
-  pre_fn ();
-  fn (context);
+  timer->pre_fn ();
+  timer->fn (timer->context);
   m_loader->NotifyEndExecute ();
+  // the kernel forgets the timer before it runs.
+  ReleaseTimer (timer);
+}
+void
+KernelSocketFdFactory::ScheduleTimers (void)
+{
+  m_timersPending = false;
+  uint64_t now = Simulator::Now ().GetNanoSeconds ();
+  uint64_t next;
+  if (!m_timers.GetNext (now, &next))
+    {
+      return;
+    }
+  if (m_timersEvent.IsRunning () && m_timersEventTick <= next)
+    {
+      return;
+    }
+  m_timersEvent.Cancel ();
+  m_timersEventTick = next;
+  m_timersEvent = Simulator::Schedule (NanoSeconds (next - now),
+                                       &KernelSocketFdFactory::ExpireTimers, this);
+}
+void
+KernelSocketFdFactory::ExpireTimers (void)
+{
+  uint64_t now = Simulator::Now ().GetNanoSeconds ();
+  m_timersTick = now;
+  // the timers armed by the callbacks are scheduled once, at the end.
+  m_timersPending = true;
+  TimerWheel::Entry *entry = m_timers.Expire (now);
+  if (entry != 0)
+    {
+      // a timer may cancel an other one of the same batch.
+      for (TimerWheel::Entry *i = entry; i != 0; i = i->next)
+        {
+          ((struct KernelTimer *)i->context)->expired = true;
+        }
+      m_loader->NotifyStartExecute ();
+      while (entry != 0)
+        {
+          TimerWheel::Entry *next = entry->next;
+          struct KernelTimer *timer = (struct KernelTimer *)entry->context;
+          entry->next = 0;
+          if (!timer->cancelled)
+            {
+              timer->pre_fn ();
+              timer->fn (timer->context);
+            }
+          ReleaseTimer (timer);
+          entry = next;
+        }
+      m_loader->NotifyEndExecute ();
+    }
+  ScheduleTimers ();
 }
 void *
 KernelSocketFdFactory::EventScheduleNs (struct SimKernel *kernel, __u64 ns, void (*fn)(void *context), void *context,
                                        void (*pre_fn)(void))
 {
   KernelSocketFdFactory *self = (KernelSocketFdFactory *)kernel;
-  Ptr<EventIdHolder> ev = Create<EventIdHolder> ();
+  struct KernelTimer *timer = self->AllocateTimer (fn, context, pre_fn);
   TaskManager *manager = TaskManager::Current ();
+  uint64_t expire = Simulator::Now ().GetNanoSeconds () + ns;
 
-  ev->id = manager->ScheduleMain (NanoSeconds (ns),
-                                  MakeEvent (&KernelSocketFdFactory::EventTrampoline, self, fn, context, pre_fn, ev));
-
-  return &ev->id;
+  if (expire <= self->m_timersTick)
+    {
+      // the wheel is already past this nanosecond.
+      timer->event = manager->ScheduleMain (NanoSeconds (ns),
+                                            MakeEvent (&KernelSocketFdFactory::FireTimer, self, timer));
+      return timer;
+    }
+  self->m_timers.Insert (&timer->entry, expire);
+  if (!self->m_timersPending
+      && (!self->m_timersEvent.IsRunning () || expire < self->m_timersEventTick))
+    {
+      // the tasks cannot schedule events themselves.
+      self->m_timersPending = true;
+      manager->ExecOnMain (MakeEvent (&KernelSocketFdFactory::ScheduleTimers, self));
+    }
+  return timer;
 }
 void
 KernelSocketFdFactory::EventCancel (struct SimKernel *kernel, void *ev)
 {
-  EventId *event = (EventId *)ev;
-  Simulator::Remove (*event);
+  KernelSocketFdFactory *self = (KernelSocketFdFactory *)kernel;
+  struct KernelTimer *timer = (struct KernelTimer *)ev;
+  if (timer->expired)
+    {
+      // released by ExpireTimers.
+      timer->cancelled = true;
+      return;
+    }
+  if (TimerWheel::IsArmed (&timer->entry))
+    {
+      // the event of the wheel is left alone: it finds nothing to expire.
+      self->m_timers.Remove (&timer->entry);
+    }
+  else
+    {
+      Simulator::Remove (timer->event);
+    }
+  self->ReleaseTimer (timer);
 }
 static __u64 CurrentNs (struct SimKernel *kernel)
 {
@@ -316,7 +465,9 @@ struct SimTask *
 KernelSocketFdFactory::TaskStart (struct SimKernel *kernel, void (*callback)(void *), void *context)
 {
   KernelSocketFdFactory *self = (KernelSocketFdFactory *)kernel;
-  Task *task = self->m_manager->Start (callback, context, 1 << 17);
+  // softirqs and kernel threads run ahead of the applications, from
+  // their first run.
+  Task *task = self->m_manager->Start (callback, context, 1 << 17, Task::HIGH_PRIORITY);
   struct SimTask *simTask = self->m_exported->task_create (task, 0);
   task->SetExtraContext (simTask);
   task->SetSwitchNotifier (&KernelSocketFdFactory::TaskSwitch, self->m_loader);
@@ -378,6 +529,14 @@ KernelSocketFdFactory::SendMain (bool *r, NetDevice *dev, Ptr<Packet> p, const A
   *r = dev->Send (p, d, pro);
 }
 void
+KernelSocketFdFactory::SendMainPackets (NetDevice *dev, std::vector<Ptr<Packet> > packets, const Address& d, uint16_t pro)
+{
+  for (std::vector<Ptr<Packet> >::const_iterator i = packets.begin (); i != packets.end (); ++i)
+    {
+      dev->Send (*i, d, pro);
+    }
+}
+void
 KernelSocketFdFactory::DevXmit (struct SimKernel *kernel, struct SimDevice *dev, unsigned char *data, int len)
 {
   NS_LOG_FUNCTION (dev);
@@ -391,13 +550,42 @@ KernelSocketFdFactory::DevXmit (struct SimKernel *kernel, struct SimDevice *dev,
     unsigned char   h_source[6];
     uint16_t        h_proto;
   } *hdr = (struct ethhdr *)data;
-  data += 14;
-  len -= 14;
-  Ptr<Packet> p = Create<Packet> (data, len);
   uint16_t protocol = ntohs (hdr->h_proto);
   Mac48Address dest;
   dest.CopyFrom (hdr->h_dest);
+  struct DeviceStats *stats = &self->m_deviceStats[dev];
   TaskManager *manager = TaskManager::Current ();
+  std::vector<uint8_t> frame;
+  if (self->m_checksumOffload && self->NeedsChecksums (dev, nsDev))
+    {
+      // the kernel may have left the TCP and UDP checksums to the device.
+      frame.assign (data, data + len);
+      stats->txBytesCopied += len;
+      KernelOffload::SetChecksums (&frame[14], len - 14, protocol);
+      data = &frame[0];
+    }
+  if (self->m_offloadMtu != 0 && (uint32_t)len - 14 > nsDev->GetMtu ())
+    {
+      // a super-packet: cut at the mtu of the device.
+      std::vector<Ptr<Packet> > packets;
+      KernelOffload::Split (data + 14, len - 14, protocol, nsDev->GetMtu (),
+                            &self->m_fragmentId, &packets);
+      for (std::vector<Ptr<Packet> >::const_iterator i = packets.begin (); i != packets.end (); ++i)
+        {
+          stats->txBytesCopied += (*i)->GetSize ();
+        }
+      manager->ExecOnMain (MakeEvent (&KernelSocketFdFactory::SendMainPackets, nsDev, packets, dest, protocol));
+      return;
+    }
+  // the skb is freed when we return so its data must be copied: the
+  // packet is made with the ethernet header which is removed afterwards,
+  // the device then adds its own header in the room left. There is no
+  // room at the end: a device adding a trailer, like the FCS of
+  // CsmaNetDevice, makes ns-3 copy the frame once more, which is not
+  // counted in the stats.
+  Ptr<Packet> p = Create<Packet> (data, len);
+  p->RemoveAtStart (14);
+  stats->txBytesCopied += len;
   bool r = false;
 
   manager->ExecOnMain (MakeEvent (&KernelSocketFdFactory::SendMain, &r, nsDev, p, dest, protocol));
@@ -423,6 +611,55 @@ KernelSocketFdFactory::DevToDev (Ptr<NetDevice> device)
   return 0;
 }
 
+static bool
+HasErrorModel (Ptr<NetDevice> device)
+{
+  PointerValue model;
+  return device->GetAttributeFailSafe ("ReceiveErrorModel", model) && model.GetObject () != 0;
+}
+
+bool
+KernelSocketFdFactory::NeedsChecksums (struct SimDevice *dev, Ptr<NetDevice> device)
+{
+  // looked up again in each timestep, which sees the error models and
+  // the devices added during the simulation.
+  struct ChecksumsState *state = &m_needsChecksums[dev];
+  Time now = Simulator::Now ();
+  if (state->checked && state->time == now)
+    {
+      return state->needs;
+    }
+  // the checksums are only left out when each device of the channel is
+  // known to skip them: a kernel with the offload and without error model.
+  // The pcap traces read them once ns-3 is told to compute them.
+  bool needs = Node::ChecksumEnabled ();
+  Ptr<Channel> channel = device->GetChannel ();
+  for (uint32_t j = 0; !needs && channel != 0 && j < channel->GetNDevices (); j++)
+    {
+      Ptr<NetDevice> peer = channel->GetDevice (j);
+      Ptr<KernelSocketFdFactory> kernel = peer->GetNode ()->GetObject<KernelSocketFdFactory> ();
+      // an ns-3 stack, or anything else, checks them.
+      needs = HasErrorModel (peer) || kernel == 0 || !kernel->m_checksumOffload;
+    }
+  state->checked = true;
+  state->time = now;
+  state->needs = needs;
+  return needs;
+}
+
+struct KernelSocketFdFactory::DeviceStats
+KernelSocketFdFactory::GetDeviceStats (Ptr<NetDevice> device)
+{
+  struct SimDevice *dev = DevToDev (device);
+  std::map<struct SimDevice *, struct DeviceStats>::const_iterator i = m_deviceStats.find (dev);
+  if (dev == 0 || i == m_deviceStats.end ())
+    {
+      struct DeviceStats stats = { 0, 0, 0, 0 };
+      return stats;
+    }
+  return i->second;
+}
+
 void
 KernelSocketFdFactory::RxFromDevice (Ptr<NetDevice> device, Ptr<const Packet> p,
                                     uint16_t protocol, const Address & from,
@@ -434,15 +671,136 @@ NS_LOG_FUNCTION (device << p << protocol << from << to << type);
     {
       return;
     }
-  m_loader->NotifyStartExecute (); // Restore the memory of the kernel before access it !
+  m_deviceStats[dev].rxFrames++;
+  if (m_rxBudget == 0 && m_offloadMtu == 0)
+    {
+      m_deviceStats[dev].rxEntries++;
+      m_loader->NotifyStartExecute (); // Restore the memory of the kernel before access it !
+      DevRx (dev, device, p, protocol, from, to);
+      m_loader->NotifyEndExecute ();
+      return;
+    }
+  // as NAPI: the frames of a burst wait in the queue of the device and
+  // are given to the kernel together, after the other events of this
+  // timestep.
+  struct RxQueue &queue = m_rxQueues[dev];
+  struct RxFrame frame;
+  frame.packet = p;
+  frame.protocol = protocol;
+  frame.from = from;
+  frame.to = to;
+  queue.frames.push_back (frame);
+  queue.device = device;
+  if (!queue.poll.IsRunning ())
+    {
+      queue.poll = Simulator::ScheduleNow (&KernelSocketFdFactory::RxPoll, this, dev);
+    }
+}
+
+void
+KernelSocketFdFactory::RxPoll (struct SimDevice *dev)
+{
+  struct RxQueue &queue = m_rxQueues[dev];
+  NS_LOG_FUNCTION (this << dev << queue.frames.size ());
+  // without a budget the queue is only there for the merges.
+  uint32_t budget = m_rxBudget != 0 ? m_rxBudget : 64;
+  m_deviceStats[dev].rxEntries++;
+  m_loader->NotifyStartExecute ();
+  uint32_t n = 0;
+  while (n < budget && !queue.frames.empty ())
+    {
+      std::vector<struct RxFrame> frames (1, queue.frames.front ());
+      queue.frames.pop_front ();
+      n++;
+      std::vector<KernelOffload::Segment> segments (1);
+      uint32_t payloadSize = 0;
+      if (m_offloadMtu != 0 && KernelOffload::Parse (frames[0].packet, frames[0].protocol, &segments[0]))
+        {
+          // as GRO: the following segments of the same flow are merged.
+          payloadSize = segments[0].payloadSize;
+          KernelOffload::Segment next;
+          while (n < budget && !queue.frames.empty ())
+            {
+              struct RxFrame &frame = queue.frames.front ();
+              if (frame.protocol != frames[0].protocol || frame.from != frames[0].from
+                  || frame.to != frames[0].to
+                  || !KernelOffload::Parse (frame.packet, frame.protocol, &next)
+                  || !KernelOffload::CanMerge (segments[0], segments.back (), payloadSize, next))
+                {
+                  break;
+                }
+              frames.push_back (frame);
+              segments.push_back (next);
+              payloadSize += next.payloadSize;
+              queue.frames.pop_front ();
+              n++;
+            }
+        }
+      if (frames.size () == 1)
+        {
+          struct RxFrame &frame = frames[0];
+          DevRx (dev, queue.device, frame.packet, frame.protocol, frame.from, frame.to);
+        }
+      else
+        {
+          DevRxMerged (dev, queue.device, frames, segments, payloadSize);
+        }
+    }
+  m_loader->NotifyEndExecute ();
+  if (!queue.frames.empty ())
+    {
+      // budget exhausted: let the other devices and the tasks run first.
+      queue.poll = Simulator::ScheduleNow (&KernelSocketFdFactory::RxPoll, this, dev);
+    }
+}
+
+void
+KernelSocketFdFactory::DevRx (struct SimDevice *dev, Ptr<NetDevice> device, Ptr<const Packet> p,
+                              uint16_t protocol, const Address &from, const Address &to)
+{
+  // the kernel owns the buffers of its packets: a single copy, straight
+  // from the ns-3 buffer to the skb.
   struct SimDevicePacket packet = m_exported->dev_create_packet (dev, p->GetSize () + 14);
   p->CopyData (((unsigned char *)packet.buffer) + 14, p->GetSize ());
+  m_deviceStats[dev].rxBytesCopied += p->GetSize () + 14;
+  SetEthernetHeader ((uint8_t *)packet.buffer, device, protocol, from, to);
+  m_exported->dev_rx (dev, packet);
+}
+
+void
+KernelSocketFdFactory::DevRxMerged (struct SimDevice *dev, Ptr<NetDevice> device,
+                                    const std::vector<struct RxFrame> &frames,
+                                    const std::vector<KernelOffload::Segment> &segments,
+                                    uint32_t payloadSize)
+{
+  const KernelOffload::Segment &first = segments.front ();
+  uint32_t size = first.headerSize + payloadSize;
+  struct SimDevicePacket packet = m_exported->dev_create_packet (dev, size + 14);
+  uint8_t *ip = ((uint8_t *)packet.buffer) + 14;
+  memcpy (ip, first.header, first.headerSize);
+  uint8_t *payload = ip + first.headerSize;
+  for (uint32_t i = 0; i < frames.size (); i++)
+    {
+      uint32_t n = segments[i].payloadSize;
+      frames[i].packet->CreateFragment (first.headerSize, n)->CopyData (payload, n);
+      payload += n;
+    }
+  KernelOffload::Finish (ip, size, segments.back ());
+  m_deviceStats[dev].rxBytesCopied += size + 14;
+  SetEthernetHeader ((uint8_t *)packet.buffer, device, frames[0].protocol, frames[0].from, frames[0].to);
+  m_exported->dev_rx (dev, packet);
+}
+
+void
+KernelSocketFdFactory::SetEthernetHeader (uint8_t *buffer, Ptr<NetDevice> device, uint16_t protocol,
+                                          const Address &from, const Address &to)
+{
   struct ethhdr
   {
     unsigned char   h_dest[6];
     unsigned char   h_source[6];
     uint16_t        h_proto;
-  } *hdr = (struct ethhdr *)packet.buffer;
+  } *hdr = (struct ethhdr *)buffer;
   if (device->GetInstanceTypeId () != m_lteUeTid)
     {
       Mac48Address realFrom = Mac48Address::ConvertFrom (from);
@@ -451,8 +809,6 @@ NS_LOG_FUNCTION (device << p << protocol << from << to << type);
   Mac48Address realTo = Mac48Address::ConvertFrom (to);
   realTo.CopyTo (hdr->h_dest);
   hdr->h_proto = ntohs (protocol);
-  m_exported->dev_rx (dev, packet);
-  m_loader->NotifyEndExecute ();
 }
 
 void
@@ -475,7 +831,13 @@ KernelSocketFdFactory::NotifyDeviceStateChangeTask (Ptr<NetDevice> device)
   ad.CopyTo (buffer);
   m_loader->NotifyStartExecute (); // Restore the memory of the kernel before access it !
   m_exported->dev_set_address (dev, buffer);
-  m_exported->dev_set_mtu (dev, device->GetMtu ());
+  uint32_t mtu = device->GetMtu ();
+  if (m_offloadMtu > mtu)
+    {
+      // the kernel sends super-packets, DevXmit cuts them.
+      mtu = m_offloadMtu;
+    }
+  m_exported->dev_set_mtu (dev, mtu);
   m_loader->NotifyEndExecute ();
 }
 
@@ -528,6 +890,11 @@ KernelSocketFdFactory::NotifyAddDeviceTask (Ptr<NetDevice> device)
     {
       flags |= SIM_DEV_NOARP;
     }
+  NS_ASSERT ((flags & DCE_DEV_CHECKSUM_OFFLOAD) == 0);
+  if (m_checksumOffload && !HasErrorModel (device))
+    {
+      flags |= DCE_DEV_CHECKSUM_OFFLOAD;
+    }
   m_loader->NotifyStartExecute (); // Restore the memory of the kernel before access it !
 #if ((LIBOS_API_VERSION == 2))
   struct SimDevice *dev = m_exported->dev_create ("sim%d", PeekPointer (device), (enum SimDevFlags)flags);
@@ -613,6 +980,14 @@ KernelSocketFdFactory::InitializeStack (void)
 
   init (m_exported, &imported, (struct SimKernel *)this);
 
+  // the flags of dev_create known to the library, if it says.
+  const int *features = (const int *)m_loader->Lookup (handle, "sim_dev_features");
+  if (m_checksumOffload && (features == 0 || (*features & DCE_DEV_CHECKSUM_OFFLOAD) == 0))
+    {
+      NS_LOG_WARN (m_library << " does not support ChecksumOffload: disabled");
+      m_checksumOffload = false;
+    }
+
   // update the kernel device list with simulation device list
   Ptr<Node> node = GetObject<Node> ();
   node->RegisterDeviceAdditionListener (MakeCallback (&KernelSocketFdFactory::NotifyAddDevice,
@@ -679,6 +1054,57 @@ KernelSocketFdFactory::Sendmsg (struct SimSocket *socket, const struct msghdr *m
   return retval;
 }
 int
+KernelSocketFdFactory::Sendmmsg (struct SimSocket *socket, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  GET_CURRENT (socket << msgvec << vlen << flags);
+  ssize_t retval = 0;
+  unsigned int i;
+  m_loader->NotifyStartExecute ();
+  for (i = 0; i < vlen; i++)
+    {
+      retval = m_exported->sock_sendmsg (socket, &msgvec[i].msg_hdr, flags);
+      if (retval < 0)
+        {
+          break;
+        }
+      msgvec[i].msg_len = retval;
+    }
+  m_loader->NotifyEndExecute ();
+  if (i == 0 && retval < 0)
+    {
+      current->err = -retval;
+      return -1;
+    }
+  // as linux: an error after the first message is not reported.
+  return i;
+}
+int
+KernelSocketFdFactory::Recvmmsg (struct SimSocket *socket, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                                 struct timespec *timeout)
+{
+  GET_CURRENT (socket << msgvec << vlen << flags << timeout);
+  struct RecvmsgContext context;
+  context.self = this;
+  context.socket = socket;
+  ssize_t retval;
+  m_loader->NotifyStartExecute ();
+  int received = UtilsRecvmmsg (msgvec, vlen, flags, timeout,
+                                &KernelSocketFdFactory::RecvmsgTrampoline, &context, &retval);
+  m_loader->NotifyEndExecute ();
+  if (received == 0 && retval < 0)
+    {
+      current->err = -retval;
+      return -1;
+    }
+  return received;
+}
+ssize_t
+KernelSocketFdFactory::RecvmsgTrampoline (void *context, struct msghdr *msg, int flags)
+{
+  struct RecvmsgContext *ctx = (struct RecvmsgContext *)context;
+  return ctx->self->m_exported->sock_recvmsg (ctx->socket, msg, flags);
+}
+int
 KernelSocketFdFactory::Getsockname (struct SimSocket *socket, struct sockaddr *name, socklen_t *namelen)
 {
   GET_CURRENT (socket << name << namelen);
@@ -801,7 +1227,7 @@ KernelSocketFdFactory::Accept (struct SimSocket *socket, struct sockaddr *my_add
 
   UnixFd *unixFd = new KernelSocketFd (this, newSocket);
   unixFd->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, unixFd);
+  current->process->openFiles.Set (fd, new FileUsage (fd, unixFd));
 
   return fd;
 }
@@ -897,7 +1323,7 @@ KernelSocketFdFactory::Poll (struct SimSocket *socket, PollTable* ptable)
 
   if (ptable)
     {
-      ptable->PollWait (kernelInOut.opaque, MakeCallback (&KernelSocketFdFactory::PollFreeWait, this));
+      ptable->PollWait (kernelInOut.opaque, m_pollFreeWait);
     }
 
   return kernelInOut.ret;
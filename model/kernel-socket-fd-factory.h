@@ -3,10 +3,15 @@
 
 #include "socket-fd-factory.h"
 #include "task-manager.h"
+#include "kernel-offload.h"
+#include "timer-wheel.h"
 #include "ns3/net-device.h"
+#include "ns3/nstime.h"
 #include "ns3/random-variable-stream.h"
 #include <sys/socket.h>
 #include <vector>
+#include <map>
+#include <deque>
 #include <string>
 #include <utility>
 #include <stdarg.h>
@@ -46,6 +51,20 @@ public:
   void ScheduleTask (EventImpl *event);
   std::string m_library;
 
+  struct DeviceStats
+  {
+    uint64_t txBytesCopied; // from the kernel to ns-3, headers included.
+    uint64_t rxBytesCopied; // from ns-3 to the kernel.
+    uint64_t rxFrames; // received from the device, before any merge.
+    uint64_t rxEntries; // entries into the kernel to give it these frames.
+  };
+  // Bytes of the frames copied by DCE between the kernel and the device
+  // so far: the copies made by the ns-3 buffers themselves are not seen.
+  // With an RxBudget, rxEntries is the number of RxPoll: less than
+  // rxFrames when the frames of a burst are given together.
+  // See also LinuxStackHelper::GetDeviceStats.
+  struct DeviceStats GetDeviceStats (Ptr<NetDevice> device);
+
 protected:
   void InitializeStack (void);
   struct SimExported *m_exported;
@@ -56,15 +75,55 @@ protected:
 private:
   friend class KernelSocketFd;
   friend class KernelDeviceStateListener;
-  struct EventIdHolder : public SimpleRefCount<EventIdHolder>
+  friend class KernelTimersTestCase;
+  // a timer of the kernel, kept in m_timers or, when it is due in the
+  // nanosecond already expired, in its own event.
+  struct KernelTimer
   {
-    EventId id;
+    TimerWheel::Entry entry;
+    EventId event;
+    void (*fn)(void *context);
+    void *context;
+    void (*pre_fn)(void);
+    bool expired; // taken out of m_timers by ExpireTimers, not run yet.
+    bool cancelled;
+  };
+  struct RxFrame
+  {
+    Ptr<const Packet> packet;
+    uint16_t protocol;
+    Address from;
+    Address to;
+  };
+  // received frames waiting for the next RxPoll of their device.
+  struct RxQueue
+  {
+    Ptr<NetDevice> device;
+    std::deque<struct RxFrame> frames;
+    EventId poll;
+  };
+  // the last answer of NeedsChecksums for a device.
+  struct ChecksumsState
+  {
+    bool checked;
+    Time time;
+    bool needs;
   };
 
   // called from KernelSocketFd
   int Close (struct SimSocket *socket);
   ssize_t Recvmsg (struct SimSocket *socket, struct msghdr *msg, int flags);
   ssize_t Sendmsg (struct SimSocket *socket, const struct msghdr *msg, int flags);
+  // the whole batch in a single entry in the kernel.
+  int Sendmmsg (struct SimSocket *socket, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+  int Recvmmsg (struct SimSocket *socket, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                struct timespec *timeout);
+  struct RecvmsgContext
+  {
+    KernelSocketFdFactory *self;
+    struct SimSocket *socket;
+  };
+  static ssize_t RecvmsgTrampoline (void *context, struct msghdr *msg, int flags);
   int Getsockname (struct SimSocket *socket, struct sockaddr *name, socklen_t *namelen);
   int Getpeername (struct SimSocket *socket, struct sockaddr *name, socklen_t *namelen);
   int Bind (struct SimSocket *socket, const struct sockaddr *my_addr, socklen_t addrlen);
@@ -127,7 +186,17 @@ private:
   void RxFromDevice (Ptr<NetDevice> device, Ptr<const Packet> p,
                      uint16_t protocol, const Address & from,
                      const Address &to, NetDevice::PacketType type);
+  void RxPoll (struct SimDevice *dev);
+  void DevRx (struct SimDevice *dev, Ptr<NetDevice> device, Ptr<const Packet> p,
+              uint16_t protocol, const Address &from, const Address &to);
+  void DevRxMerged (struct SimDevice *dev, Ptr<NetDevice> device,
+                    const std::vector<struct RxFrame> &frames,
+                    const std::vector<KernelOffload::Segment> &segments,
+                    uint32_t payloadSize);
+  void SetEthernetHeader (uint8_t *buffer, Ptr<NetDevice> device, uint16_t protocol,
+                          const Address &from, const Address &to);
   struct SimDevice * DevToDev (Ptr<NetDevice> dev);
+  bool NeedsChecksums (struct SimDevice *dev, Ptr<NetDevice> device);
   void NotifyDeviceStateChange (Ptr<NetDevice> device);
   void NotifyDeviceStateChangeTask (Ptr<NetDevice> device);
   void NotifyAddDeviceTask (Ptr<NetDevice> device);
@@ -135,15 +204,40 @@ private:
   void DoSet (std::string path, std::string value);
   static void TaskSwitch (enum Task::SwitchType type, void *context);
   static void ScheduleTaskTrampoline (void *context);
-  void EventTrampoline (void (*fn)(void *context),
-                        void *context, void (*pre_fn)(void),
-                        Ptr<EventIdHolder> event);
+  struct KernelTimer * AllocateTimer (void (*fn)(void *context), void *context,
+                                      void (*pre_fn)(void));
+  void ReleaseTimer (struct KernelTimer *timer);
+  void FireTimer (struct KernelTimer *timer);
+  void ScheduleTimers (void);
+  void ExpireTimers (void);
   static void SendMain (bool *r, NetDevice *d, Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber);
+  static void SendMainPackets (NetDevice *d, std::vector<Ptr<Packet> > packets, const Address& dest, uint16_t protocolNumber);
 
   std::vector<std::pair<Ptr<NetDevice>,struct SimDevice *> > m_devices;
+  std::map<struct SimDevice *, struct DeviceStats> m_deviceStats;
+  std::map<struct SimDevice *, struct RxQueue> m_rxQueues;
+  uint32_t m_rxBudget;
+  uint32_t m_offloadMtu;
+  // identification of the next IPv6 fragments made by DevXmit.
+  uint32_t m_fragmentId;
+  bool m_checksumOffload;
+  std::map<struct SimDevice *, struct ChecksumsState> m_needsChecksums;
   std::list<Task *> m_kernelTasks;
+  // the timers of the kernel, in nanoseconds, with a single event for
+  // the next expiry.
+  TimerWheel m_timers;
+  std::deque<struct KernelTimer> m_timerPool;
+  std::vector<struct KernelTimer *> m_freeTimers;
+  EventId m_timersEvent;
+  uint64_t m_timersEventTick;
+  uint64_t m_timersTick; // of the last ExpireTimers.
+  // a ScheduleTimers is on its way: the timers armed until then need no
+  // other one.
+  bool m_timersPending;
   Ptr<UniformRandomVariable> m_variable;
   KingsleyAlloc *m_alloc;
+  // given to every poll table entry, built once.
+  Callback<void, void*> m_pollFreeWait;
   std::vector<Ptr<KernelDeviceStateListener> > m_listeners;
   double m_rate;
   Ptr<RandomVariableStream> m_ranvar;
@@ -63,6 +63,35 @@ KernelSocketFd::Read (void *buf, size_t count)
   return retval;
 }
 ssize_t
+KernelSocketFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  // a single sendmsg: no copy and the datagram boundaries are right.
+  struct msghdr msg;
+  msg.msg_control = 0;
+  msg.msg_controllen = 0;
+  msg.msg_iovlen = iovcnt;
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_name = 0;
+  msg.msg_namelen = 0;
+  msg.msg_flags = 0;
+  return Sendmsg (&msg, 0);
+}
+ssize_t
+KernelSocketFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  struct msghdr msg;
+  msg.msg_control = 0;
+  msg.msg_controllen = 0;
+  msg.msg_iovlen = iovcnt;
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_name = 0;
+  msg.msg_namelen = 0;
+  msg.msg_flags = 0;
+  return Recvmsg (&msg, 0);
+}
+ssize_t
 KernelSocketFd::Recvmsg (struct msghdr *msg, int flags)
 {
   bool nonBlocking = (m_statusFlags & O_NONBLOCK) == O_NONBLOCK;
@@ -76,6 +105,21 @@ KernelSocketFd::Sendmsg (const struct msghdr *msg, int flags)
   flags |= nonBlocking ? MSG_DONTWAIT : 0;
   return m_factory->Sendmsg (m_socket, msg, flags);
 }
+int
+KernelSocketFd::Sendmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  bool nonBlocking = (m_statusFlags & O_NONBLOCK) == O_NONBLOCK;
+  flags |= nonBlocking ? MSG_DONTWAIT : 0;
+  return m_factory->Sendmmsg (m_socket, msgvec, vlen, flags);
+}
+int
+KernelSocketFd::Recvmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                          struct timespec *timeout)
+{
+  bool nonBlocking = (m_statusFlags & O_NONBLOCK) == O_NONBLOCK;
+  flags |= nonBlocking ? MSG_DONTWAIT : 0;
+  return m_factory->Recvmmsg (m_socket, msgvec, vlen, flags, timeout);
+}
 bool
 KernelSocketFd::Isatty (void) const
 {
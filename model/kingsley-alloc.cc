@@ -1,7 +1,11 @@
 #include "kingsley-alloc.h"
+#include "fault-handlers.h"
 #include <string.h>
 #include <sys/mman.h>
 #include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
 #include "ns3/assert.h"
 #include "ns3/log.h"
 
@@ -26,11 +30,32 @@ NS_LOG_COMPONENT_DEFINE ("Alloc");
 #endif
 
 
+std::map<uint8_t *, struct KingsleyAlloc::Mmap *> KingsleyAlloc::m_cowMmaps;
+
+static uint32_t
+PageSize (void)
+{
+  static uint32_t pageSize = sysconf (_SC_PAGESIZE);
+  return pageSize;
+}
+
+static bool
+CowSegvHandler (int sig, siginfo_t *si, void *context)
+{
+  // on success, the faulting instruction is restarted on a now accessible page.
+  return KingsleyAlloc::HandleFault (si->si_addr);
+}
+
 KingsleyAlloc::KingsleyAlloc ()
-  : m_defaultMmapSize (1 << 15)
+  : m_arena (0),
+    m_cow (false)
 {
   NS_LOG_FUNCTION (this);
-  memset (m_buckets, 0, sizeof(m_buckets));
+  memset (m_free, 0, sizeof(m_free));
+  memset (m_bump, 0, sizeof(m_bump));
+  memset (m_bumpEnd, 0, sizeof(m_bumpEnd));
+  memset (m_runs, 0, sizeof(m_runs));
+  memset (&m_stats, 0, sizeof(m_stats));
 }
 KingsleyAlloc::~KingsleyAlloc ()
 {
@@ -39,31 +64,42 @@ KingsleyAlloc::~KingsleyAlloc ()
   for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
        i != m_chunks.end (); ++i)
     {
-      if (i->copy)
-        {
-          // ok, this means that _our_ buffer is not the
-          // original mmap buffer which means that we were
-          // cloned once so, we need to free our local
-          // buffer.
-          free (i->copy);
+      Release (&*i);
+    }
+  m_chunks.clear ();
+  m_index.clear ();
+}
+void
+KingsleyAlloc::Release (struct MmapChunk *chunk)
+{
+  if (chunk->mmap->cow)
+    {
+      CowRelease (chunk);
+      return;
+    }
+  if (chunk->copy)
+    {
+      // ok, this means that _our_ buffer is not the
+      // original mmap buffer which means that we were
+      // cloned once so, we need to free our local
+      // buffer.
+      free (chunk->copy);
 
-          if (i->copy == i->mmap->current)
-            {
-              // Current must be nullify because we the next switch of context do not need to save our heap.
-              i->mmap->current = 0;
-            }
-          i->copy = 0;
-        }
-      i->mmap->refcount--;
-      if (i->mmap->refcount == 0)
+      if (chunk->copy == chunk->mmap->current)
         {
-          // we are the last to release this chunk.
-          // so, release the mmaped data.
-          MmapFree (i->mmap->buffer, i->mmap->size);
-          delete i->mmap;
+          // Current must be nullify because we the next switch of context do not need to save our heap.
+          chunk->mmap->current = 0;
         }
+      chunk->copy = 0;
+    }
+  chunk->mmap->refcount--;
+  if (chunk->mmap->refcount == 0)
+    {
+      // we are the last to release this chunk.
+      // so, release the mmaped data.
+      MmapFree (chunk->mmap->buffer, chunk->mmap->size);
+      delete chunk->mmap;
     }
-  m_chunks.clear ();
 }
 // Call me only from my context
 void
@@ -73,7 +109,7 @@ KingsleyAlloc::Dispose ()
   for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
        i != m_chunks.end (); ++i)
     {
-      if (i->copy == i->mmap->current)
+      if (!i->mmap->cow && i->copy == i->mmap->current)
         {
           // Current must be nullify because we the next switch of context do not need to save our heap.
           i->mmap->current = 0;
@@ -85,10 +121,50 @@ KingsleyAlloc::Clone (void)
 {
   NS_LOG_FUNCTION (this << "begin");
   KingsleyAlloc *clone = new KingsleyAlloc ();
-  *clone->m_buckets = *m_buckets;
+  // the free lists are in the heap content, which the clone shares.
+  memcpy (clone->m_free, m_free, sizeof(m_free));
+  memcpy (clone->m_bump, m_bump, sizeof(m_bump));
+  memcpy (clone->m_bumpEnd, m_bumpEnd, sizeof(m_bumpEnd));
+  memcpy (clone->m_runs, m_runs, sizeof(m_runs));
+  clone->m_cow = m_cow;
   for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
        i != m_chunks.end (); ++i)
     {
+      if (m_cow)
+        {
+          if (!i->mmap->cow)
+            {
+              CowStart (&*i);
+            }
+          struct Mmap *mmap = i->mmap;
+          mmap->refcount++;
+          // the clone starts with the same content than us: share the pages
+          // we hold in buffer, copy only the ones which are saved in our copy.
+          struct KingsleyAlloc::MmapChunk chunkClone = *i;
+          chunkClone.alloc = clone;
+          chunkClone.copy = CowAllocCopy (mmap->size);
+          uint32_t pages = PageCount (mmap->size);
+          for (uint32_t p = 0; p < pages; p++)
+            {
+              if (i->inBuffer[p])
+                {
+                  mmap->holders[p]++;
+                }
+              else
+                {
+                  uint32_t offset = p * PageSize ();
+                  uint32_t len = std::min (PageSize (), mmap->size - offset);
+                  memcpy (chunkClone.copy + offset, i->copy + offset, len);
+                  m_stats.copiedBytes += len;
+                }
+            }
+          clone->m_chunks.push_back (chunkClone);
+          clone->AddClonedChunk (--clone->m_chunks.end (), &*i == m_arena);
+          mmap->sharers.push_back (&clone->m_chunks.back ());
+          // the pages now shared become read-only.
+          CowProtect (mmap);
+          continue;
+        }
       struct KingsleyAlloc::MmapChunk chunk = *i;
       chunk.mmap->refcount++;
       if ((chunk.mmap->refcount == 2)&&(0 == chunk.copy))
@@ -102,34 +178,309 @@ KingsleyAlloc::Clone (void)
       chunkClone.copy = (uint8_t *)malloc (chunkClone.mmap->size);
       // Save the heap in the clone copy memory
       memcpy (chunkClone.copy, chunk.mmap->buffer, chunk.mmap->size);
+      m_stats.copiedBytes += chunk.mmap->size;
       clone->m_chunks.push_back (chunkClone);
+      clone->AddClonedChunk (--clone->m_chunks.end (), &*i == m_arena);
     }
   NS_LOG_FUNCTION (this << "end");
   return clone;
 }
 
+void
+KingsleyAlloc::AddClonedChunk (std::list<struct MmapChunk>::iterator chunk, bool arena)
+{
+  m_index[chunk->mmap->buffer] = chunk;
+  if (arena)
+    {
+      m_arena = &*chunk;
+    }
+}
+
 void
 KingsleyAlloc::SwitchTo (void)
 {
   NS_LOG_FUNCTION (this);
-  for (std::list<struct KingsleyAlloc::MmapChunk>::const_iterator i = m_chunks.begin ();
+  bool swapped = false;
+  for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
        i != m_chunks.end (); ++i)
     {
-      struct KingsleyAlloc::MmapChunk chunk = *i;
+      struct KingsleyAlloc::MmapChunk *chunk = &*i;
+
+      if (chunk->mmap->cow)
+        {
+          // nothing to copy now, just make the pages which do not
+          // hold our content fault on access.
+          if (chunk->mmap->owner != chunk)
+            {
+              chunk->mmap->owner = chunk;
+              CowProtect (chunk->mmap);
+              swapped = true;
+            }
+          continue;
+        }
+      if (chunk->mmap->current == chunk->copy)
+        {
+          // we already own the heap.
+          continue;
+        }
 
       // save the previous user's heap if necessary
-      if (chunk.mmap->current && (chunk.mmap->current != chunk.mmap->buffer))
+      if (chunk->mmap->current && (chunk->mmap->current != chunk->mmap->buffer))
         {
-          memcpy (chunk.mmap->current, chunk.mmap->buffer, chunk.mmap->size);
+          memcpy (chunk->mmap->current, chunk->mmap->buffer, chunk->mmap->size);
+          m_stats.copiedBytes += chunk->mmap->size;
+          swapped = true;
         }
 
       // swap in our own copy of the heap if necessary
-      if (chunk.copy && (chunk.mmap->buffer != chunk.copy))
+      if (chunk->copy && (chunk->mmap->buffer != chunk->copy))
         {
-          memcpy (chunk.mmap->buffer, chunk.copy, chunk.mmap->size);
+          memcpy (chunk->mmap->buffer, chunk->copy, chunk->mmap->size);
+          m_stats.copiedBytes += chunk->mmap->size;
+          swapped = true;
         }
       // and, now, remember that _we_ own the heap
-      chunk.mmap->current = chunk.copy;
+      chunk->mmap->current = chunk->copy;
+    }
+  if (swapped)
+    {
+      m_stats.switches++;
+    }
+}
+
+void
+KingsleyAlloc::SetCopyOnWrite (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_cow = enable;
+}
+
+struct KingsleyAlloc::Stats
+KingsleyAlloc::GetStats (void) const
+{
+  return m_stats;
+}
+
+uint32_t
+KingsleyAlloc::PageCount (uint32_t size)
+{
+  return (size + PageSize () - 1) / PageSize ();
+}
+
+uint8_t *
+KingsleyAlloc::CowAllocCopy (uint32_t size)
+{
+  // pages of the copy are only committed by the host once we save into them.
+  uint8_t *copy = (uint8_t*)::mmap (0, size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  NS_ASSERT_MSG (copy != MAP_FAILED, "Unable to mmap heap copy");
+  return copy;
+}
+
+void
+KingsleyAlloc::InstallFaultHandler (void)
+{
+  ns3::FaultHandlers::AddHandler (SIGSEGV, &CowSegvHandler);
+}
+
+struct KingsleyAlloc::Mmap *
+KingsleyAlloc::LookupCow (const uint8_t *address)
+{
+  std::map<uint8_t *, struct Mmap *>::iterator i = m_cowMmaps.lower_bound ((uint8_t *)address);
+  if (i == m_cowMmaps.end () || i->second->buffer > address)
+    {
+      return 0;
+    }
+  return i->second;
+}
+
+void
+KingsleyAlloc::CowStart (struct MmapChunk *chunk)
+{
+  NS_LOG_FUNCTION (this << chunk);
+  NS_ASSERT_MSG (chunk->copy == 0, "Copy-on-write must be enabled before the first clone");
+  struct Mmap *mmap = chunk->mmap;
+  uint32_t pages = PageCount (mmap->size);
+
+  InstallFaultHandler ();
+  mmap->cow = true;
+  mmap->owner = chunk;
+  mmap->holders.assign (pages, 1);
+  mmap->sharers.push_back (chunk);
+  chunk->alloc = this;
+  chunk->copy = CowAllocCopy (mmap->size);
+  chunk->inBuffer.assign (pages, true);
+  m_cowMmaps[mmap->buffer + mmap->size - 1] = mmap;
+}
+
+void
+KingsleyAlloc::CowRelease (struct MmapChunk *chunk)
+{
+  NS_LOG_FUNCTION (this << chunk);
+  struct Mmap *mmap = chunk->mmap;
+  uint32_t pages = PageCount (mmap->size);
+  for (uint32_t p = 0; p < pages; p++)
+    {
+      if (chunk->inBuffer[p])
+        {
+          mmap->holders[p]--;
+        }
+    }
+  mmap->sharers.erase (std::find (mmap->sharers.begin (), mmap->sharers.end (), chunk));
+  if (mmap->owner == chunk)
+    {
+      mmap->owner = 0;
+    }
+  ::munmap (chunk->copy, mmap->size);
+  chunk->copy = 0;
+  chunk->inBuffer.clear ();
+  mmap->refcount--;
+  NS_ASSERT (mmap->refcount >= 1);
+  if (mmap->refcount == 1)
+    {
+      CowCollapse (mmap);
+    }
+}
+
+void
+KingsleyAlloc::CowCollapse (struct Mmap *mmap)
+{
+  NS_ASSERT (mmap->sharers.size () == 1);
+  struct MmapChunk *last = mmap->sharers.front ();
+  NS_LOG_FUNCTION (last->alloc << mmap);
+
+  // The last clone takes back the buffer for itself.
+  ::mprotect (mmap->buffer, mmap->size, PROT_READ | PROT_WRITE);
+  uint32_t pages = PageCount (mmap->size);
+  for (uint32_t p = 0; p < pages; p++)
+    {
+      if (!last->inBuffer[p])
+        {
+          uint32_t offset = p * PageSize ();
+          uint32_t len = std::min (PageSize (), mmap->size - offset);
+          memcpy (mmap->buffer + offset, last->copy + offset, len);
+          last->alloc->m_stats.copiedBytes += len;
+        }
+    }
+  ::munmap (last->copy, mmap->size);
+  last->copy = 0;
+  last->inBuffer.clear ();
+  m_cowMmaps.erase (mmap->buffer + mmap->size - 1);
+  mmap->cow = false;
+  mmap->owner = 0;
+  mmap->sharers.clear ();
+  mmap->holders.clear ();
+  mmap->current = mmap->buffer;
+}
+
+int
+KingsleyAlloc::CowPageProtection (struct Mmap *mmap, uint32_t page)
+{
+  // Pages which do not hold the content of the owner are not accessible,
+  // pages shared with other clones are read-only.
+  if (mmap->owner == 0 || !mmap->owner->inBuffer[page])
+    {
+      return PROT_NONE;
+    }
+  if (mmap->holders[page] > 1)
+    {
+      return PROT_READ;
+    }
+  return PROT_READ | PROT_WRITE;
+}
+
+void
+KingsleyAlloc::CowProtect (struct Mmap *mmap)
+{
+  // one mprotect per run of pages with the same protection.
+  uint32_t pages = PageCount (mmap->size);
+  uint32_t start = 0;
+  int startProt = CowPageProtection (mmap, 0);
+  for (uint32_t p = 1; p <= pages; p++)
+    {
+      int prot = (p < pages) ? CowPageProtection (mmap, p) : -1;
+      if (prot != startProt)
+        {
+          int status = ::mprotect (mmap->buffer + start * PageSize (),
+                                   (p - start) * PageSize (), startProt);
+          NS_ASSERT_MSG (status == 0, "Unable to protect heap pages");
+          start = p;
+          startProt = prot;
+        }
+    }
+}
+
+void
+KingsleyAlloc::CowAcquirePage (struct Mmap *mmap, uint32_t page)
+{
+  struct MmapChunk *owner = mmap->owner;
+  uint32_t offset = page * PageSize ();
+  uint32_t len = std::min (PageSize (), mmap->size - offset);
+  uint8_t *buffer = mmap->buffer + offset;
+
+  ::mprotect (buffer, PageSize (), PROT_READ | PROT_WRITE);
+  // save the content of the other clones still living in this page.
+  for (std::vector<struct MmapChunk *>::iterator i = mmap->sharers.begin ();
+       i != mmap->sharers.end (); ++i)
+    {
+      if (*i != owner && (*i)->inBuffer[page])
+        {
+          memcpy ((*i)->copy + offset, buffer, len);
+          (*i)->inBuffer[page] = false;
+          owner->alloc->m_stats.copiedBytes += len;
+        }
+    }
+  // and restore ours if needed.
+  if (!owner->inBuffer[page])
+    {
+      memcpy (buffer, owner->copy + offset, len);
+      owner->inBuffer[page] = true;
+      owner->alloc->m_stats.copiedBytes += len;
+    }
+  mmap->holders[page] = 1;
+}
+
+bool
+KingsleyAlloc::HandleFault (void *address)
+{
+  struct Mmap *mmap = LookupCow ((uint8_t *)address);
+  if (mmap == 0 || mmap->owner == 0)
+    {
+      return false;
+    }
+  uint32_t page = ((uint8_t *)address - mmap->buffer) / PageSize ();
+  if (mmap->owner->inBuffer[page] && mmap->holders[page] == 1)
+    {
+      // the page is already ours and writable: this fault is not for us.
+      return false;
+    }
+  CowAcquirePage (mmap, page);
+  mmap->owner->alloc->m_stats.faults++;
+  return true;
+}
+
+void
+KingsleyAlloc::Prefault (const void *buffer, size_t size, bool write)
+{
+  if (m_cowMmaps.empty () || size == 0)
+    {
+      return;
+    }
+  const uint8_t *start = (const uint8_t *)buffer;
+  const uint8_t *end = start + size;
+  const uint8_t *cur = start - ((uintptr_t)start % PageSize ());
+  for (; cur < end; cur += PageSize ())
+    {
+      struct Mmap *mmap = LookupCow (std::max (cur, start));
+      if (mmap == 0 || mmap->owner == 0)
+        {
+          continue;
+        }
+      uint32_t page = (std::max (cur, start) - mmap->buffer) / PageSize ();
+      if (!mmap->owner->inBuffer[page] || (write && mmap->holders[page] > 1))
+        {
+          CowAcquirePage (mmap, page);
+        }
     }
 }
 
@@ -141,7 +492,7 @@ KingsleyAlloc::MmapFree (uint8_t *buffer, uint32_t size)
   status = ::munmap (buffer, size);
   NS_ASSERT_MSG (status == 0, "Unable to release mmaped buffer");
 }
-void
+struct KingsleyAlloc::MmapChunk *
 KingsleyAlloc::MmapAlloc (uint32_t size)
 {
   NS_LOG_FUNCTION (this << size);
@@ -152,131 +503,298 @@ KingsleyAlloc::MmapAlloc (uint32_t size)
                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
   NS_ASSERT_MSG (mmap_struct->buffer != MAP_FAILED, "Unable to mmap memory buffer");
   mmap_struct->current = mmap_struct->buffer;
+  mmap_struct->cow = false;
+  mmap_struct->owner = 0;
   struct MmapChunk chunk;
   chunk.mmap = mmap_struct;
   chunk.brk = 0;
   chunk.copy = 0; // no clone yet, no copy yet.
+  chunk.alloc = this;
 
   m_chunks.push_front (chunk);
+  m_index[mmap_struct->buffer] = m_chunks.begin ();
   NS_LOG_DEBUG ("mmap alloced=" << size << " at=" << (void*)mmap_struct->buffer);
   MARK_UNDEFINED (mmap_struct->buffer, size);
+  return &m_chunks.front ();
+}
+
+struct KingsleyAlloc::MmapChunk *
+KingsleyAlloc::Lookup (const uint8_t *buffer) const
+{
+  std::map<uint8_t *, std::list<struct MmapChunk>::iterator>::const_iterator i =
+    m_index.upper_bound ((uint8_t *)buffer);
+  NS_ASSERT_MSG (i != m_index.begin (), "Not a heap buffer: " << (void*)buffer);
+  --i;
+  NS_ASSERT_MSG (buffer < i->first + i->second->mmap->size, "Not a heap buffer: " << (void*)buffer);
+  return &*i->second;
+}
+
+void
+KingsleyAlloc::LinkRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs)
+{
+  struct Run *run = (struct Run *)(chunk->mmap->buffer + slab * SLAB_SIZE);
+  // tagged at both ends, for the runs freed next to it.
+  chunk->slabs[slab] = RUN | FREE | slabs;
+  chunk->slabs[slab + slabs - 1] = RUN | FREE | slabs;
+  MARK_DEFINED (run, sizeof(*run));
+  run->prev = 0;
+  run->next = m_runs[slabs];
+  if (run->next != 0)
+    {
+      MARK_DEFINED (run->next, sizeof(*run));
+      run->next->prev = run;
+      MARK_UNDEFINED (run->next, sizeof(*run));
+    }
+  MARK_UNDEFINED (run, sizeof(*run));
+  m_runs[slabs] = run;
+}
+
+void
+KingsleyAlloc::UnlinkRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs)
+{
+  struct Run *run = (struct Run *)(chunk->mmap->buffer + slab * SLAB_SIZE);
+  MARK_DEFINED (run, sizeof(*run));
+  if (run->prev != 0)
+    {
+      MARK_DEFINED (run->prev, sizeof(*run));
+      run->prev->next = run->next;
+      MARK_UNDEFINED (run->prev, sizeof(*run));
+    }
+  else
+    {
+      m_runs[slabs] = run->next;
+    }
+  if (run->next != 0)
+    {
+      MARK_DEFINED (run->next, sizeof(*run));
+      run->next->prev = run->prev;
+      MARK_UNDEFINED (run->next, sizeof(*run));
+    }
+  MARK_UNDEFINED (run, sizeof(*run));
+  chunk->slabs[slab] = 0;
+  chunk->slabs[slab + slabs - 1] = 0;
+}
+
+void
+KingsleyAlloc::PushRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs)
+{
+  // merge with the free runs on each side, within the same mmap.
+  if (slab + slabs < chunk->slabs.size ())
+    {
+      uint16_t next = chunk->slabs[slab + slabs];
+      if ((next & (RUN | FREE)) == (RUN | FREE))
+        {
+          UnlinkRun (chunk, slab + slabs, next & SLAB_MASK);
+          slabs += next & SLAB_MASK;
+        }
+    }
+  if (slab > 0)
+    {
+      uint16_t previous = chunk->slabs[slab - 1];
+      if ((previous & (RUN | FREE)) == (RUN | FREE))
+        {
+          uint32_t previousSlabs = previous & SLAB_MASK;
+          UnlinkRun (chunk, slab - previousSlabs, previousSlabs);
+          slab -= previousSlabs;
+          slabs += previousSlabs;
+        }
+    }
+  LinkRun (chunk, slab, slabs);
 }
 
 uint8_t *
-KingsleyAlloc::Brk (uint32_t needed)
+KingsleyAlloc::Brk (uint32_t slabs, uint16_t descriptor)
 {
-  NS_LOG_FUNCTION (this << needed);
-  for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
-       i != m_chunks.end (); ++i)
+  NS_LOG_FUNCTION (this << slabs << descriptor);
+  uint32_t needed = slabs * SLAB_SIZE;
+  if (m_arena == 0 || m_arena->mmap->size - m_arena->brk < needed)
     {
-      NS_ASSERT (i->mmap->size >= i->brk);
-      if (i->mmap->size - i->brk >= needed)
+      if (m_arena != 0)
         {
-          uint8_t *buffer = i->mmap->buffer + i->brk;
-          i->brk += needed;
-          NS_LOG_DEBUG ("brk: needed=" << needed << ", left=" << i->mmap->size - i->brk);
-          return buffer;
+          // do not lose the end of the previous arena.
+          uint32_t left = (m_arena->mmap->size - m_arena->brk) / SLAB_SIZE;
+          if (left > 0)
+            {
+              PushRun (m_arena, m_arena->brk / SLAB_SIZE, left);
+              m_arena->brk += left * SLAB_SIZE;
+            }
         }
+      m_arena = MmapAlloc (ARENA_SLABS * SLAB_SIZE);
+      m_arena->slabs.resize (ARENA_SLABS, 0);
     }
-  NS_ASSERT_MSG (needed <= m_defaultMmapSize, needed << " " << m_defaultMmapSize);
-  MmapAlloc (m_defaultMmapSize);
-  return Brk (needed);
+  uint8_t *buffer = m_arena->mmap->buffer + m_arena->brk;
+  m_arena->slabs[m_arena->brk / SLAB_SIZE] = descriptor;
+  m_arena->brk += needed;
+  NS_LOG_DEBUG ("brk: needed=" << needed << ", left=" << m_arena->mmap->size - m_arena->brk);
+  return buffer;
 }
-uint8_t
-KingsleyAlloc::SizeToBucket (uint32_t sz)
+
+uint8_t *
+KingsleyAlloc::AllocSlabs (uint32_t slabs, uint16_t descriptor)
 {
-  NS_LOG_FUNCTION (this << sz);
-  uint8_t bucket = 0;
-  uint32_t size = sz;
-  size--;
-  while (size > 7)
+  // the smallest free run which is large enough, split.
+  for (uint32_t n = slabs; n <= ARENA_SLABS; n++)
     {
-      size >>= 1;
-      bucket++;
+      if (m_runs[n] == 0)
+        {
+          continue;
+        }
+      uint8_t *buffer = (uint8_t *)m_runs[n];
+      struct MmapChunk *chunk = Lookup (buffer);
+      uint32_t slab = (buffer - chunk->mmap->buffer) / SLAB_SIZE;
+      UnlinkRun (chunk, slab, n);
+      if (n > slabs)
+        {
+          // its neighbours are not free, no merge needed.
+          LinkRun (chunk, slab + slabs, n - slabs);
+        }
+      chunk->slabs[slab] = descriptor;
+      return buffer;
     }
-  NS_ASSERT (bucket < 32);
-  NS_LOG_DEBUG ("size=" << sz << ", bucket=" << (uint32_t)bucket << ", size=" <<
-                BucketToSize (bucket));
-  return bucket;
+  return Brk (slabs, descriptor);
 }
-uint32_t
-KingsleyAlloc::BucketToSize (uint8_t bucket)
+
+// all multiples of 16, for the alignment of malloc.
+static const uint16_t g_classSize[] = {
+  16, 32, 48, 64, 80, 96, 112, 128,
+  160, 192, 224, 256, 320, 384, 448, 512,
+  640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+uint8_t
+KingsleyAlloc::SizeToClass (uint32_t size)
 {
-  uint32_t size = (1 << (bucket + 3));
-  return size;
+  // one entry per 16 bytes.
+  static uint8_t table[MAX_CLASS_SIZE / 16 + 1];
+  static bool initialized = false;
+  if (!initialized)
+    {
+      uint8_t c = 0;
+      for (uint32_t i = 0; i <= MAX_CLASS_SIZE / 16; i++)
+        {
+          while (g_classSize[c] < i * 16)
+            {
+              c++;
+            }
+          table[i] = c;
+        }
+      initialized = true;
+    }
+  return table[(size + 15) / 16];
 }
 
 uint8_t *
 KingsleyAlloc::Malloc (uint32_t size)
 {
   NS_LOG_FUNCTION (this << size);
-  if (size < m_defaultMmapSize)
+  uint8_t *buffer;
+  if (size <= MAX_CLASS_SIZE)
     {
-      uint8_t bucket = SizeToBucket (size);
-      if (m_buckets[bucket] == 0)
+      uint8_t c = SizeToClass (size);
+      if (m_free[c] != 0)
         {
-          struct Available *avail = (struct Available *)Brk (BucketToSize (bucket));
+          // fast path.
+          struct Available *avail = m_free[c];
           MARK_DEFINED (avail, sizeof(void*));
-          avail->next = 0;
+          m_free[c] = avail->next;
           MARK_UNDEFINED (avail, sizeof(void*));
-          m_buckets[bucket] = avail;
+          buffer = (uint8_t *)avail;
+        }
+      else
+        {
+          if (m_bumpEnd[c] - m_bump[c] < g_classSize[c])
+            {
+              m_bump[c] = AllocSlabs (1, c);
+              m_bumpEnd[c] = m_bump[c] + SLAB_SIZE;
+            }
+          buffer = m_bump[c];
+          m_bump[c] += g_classSize[c];
         }
-      // fast path.
-      struct Available *avail = m_buckets[bucket];
-      MARK_DEFINED (avail, sizeof(void*));
-      m_buckets[bucket] = avail->next;
-      MARK_UNDEFINED (avail, sizeof(void*));
-      REPORT_MALLOC (avail, size);
-      return (uint8_t*)avail;
+    }
+  else if (size <= MAX_RUN_SLABS * SLAB_SIZE)
+    {
+      uint32_t slabs = (size + SLAB_SIZE - 1) / SLAB_SIZE;
+      buffer = AllocSlabs (slabs, RUN | slabs);
     }
   else
     {
-      MmapAlloc (size);
-      uint8_t *buffer = Brk (size);
-      REPORT_MALLOC (buffer, size);
-      return buffer;
+      struct MmapChunk *chunk = MmapAlloc (size);
+      chunk->brk = size;
+      buffer = chunk->mmap->buffer;
     }
+  REPORT_MALLOC (buffer, size);
+  return buffer;
 }
-void
-KingsleyAlloc::Free (uint8_t *buffer, uint32_t size)
+
+uint32_t
+KingsleyAlloc::GetSize (uint8_t *buffer) const
 {
-  NS_LOG_FUNCTION (this << (void*)buffer << size);
-  if (size < m_defaultMmapSize)
+  struct MmapChunk *chunk = Lookup (buffer);
+  if (chunk->slabs.empty ())
     {
-      // return to bucket list.
-      uint8_t bucket = SizeToBucket (size);
-      struct Available *avail = (struct Available *)buffer;
-      avail->next = m_buckets[bucket];
-      m_buckets[bucket] = avail;
-      REPORT_FREE (buffer);
+      return chunk->mmap->size;
     }
-  else
+  uint16_t descriptor = chunk->slabs[(buffer - chunk->mmap->buffer) / SLAB_SIZE];
+  if (descriptor & RUN)
+    {
+      return (descriptor & SLAB_MASK) * SLAB_SIZE;
+    }
+  return g_classSize[descriptor];
+}
+
+void
+KingsleyAlloc::Free (uint8_t *buffer)
+{
+  NS_LOG_FUNCTION (this << (void*)buffer);
+  struct MmapChunk *chunk = Lookup (buffer);
+  if (!chunk->slabs.empty ())
     {
-      for (std::list<struct KingsleyAlloc::MmapChunk>::iterator i = m_chunks.begin ();
-           i != m_chunks.end (); ++i)
+      uint32_t slab = (buffer - chunk->mmap->buffer) / SLAB_SIZE;
+      uint16_t descriptor = chunk->slabs[slab];
+      REPORT_FREE (buffer);
+      if (descriptor & RUN)
         {
-          if (i->mmap->buffer == buffer && i->mmap->size == size)
-            {
-              REPORT_FREE (buffer);
-              MmapFree (buffer, size);
-              m_chunks.erase (i);
-              return;
-            }
+          PushRun (chunk, slab, descriptor & SLAB_MASK);
+          return;
         }
-      // this should never happen but it happens in case of a double-free
-      REPORT_FREE (buffer);
+      // return to the free list of the class.
+      struct Available *avail = (struct Available *)buffer;
+      avail->next = m_free[descriptor];
+      m_free[descriptor] = avail;
+      return;
     }
+  NS_ASSERT_MSG (buffer == chunk->mmap->buffer, "Not a heap buffer: " << (void*)buffer);
+  REPORT_FREE (buffer);
+  std::map<uint8_t *, std::list<struct MmapChunk>::iterator>::iterator i =
+    m_index.find (chunk->mmap->buffer);
+  // the mmap stays if our clones still use it.
+  Release (chunk);
+  m_chunks.erase (i->second);
+  m_index.erase (i);
 }
+
 uint8_t *
-KingsleyAlloc::Realloc (uint8_t *oldBuffer, uint32_t oldSize, uint32_t newSize)
+KingsleyAlloc::Realloc (uint8_t *oldBuffer, uint32_t newSize)
 {
-  NS_LOG_FUNCTION (this << (void*)oldBuffer << oldSize << newSize);
-  if (newSize < oldSize)
+  NS_LOG_FUNCTION (this << (void*)oldBuffer << newSize);
+  uint32_t oldSize = GetSize (oldBuffer);
+  if (newSize <= oldSize)
+    {
+      return oldBuffer;
+    }
+  struct MmapChunk *chunk = Lookup (oldBuffer);
+  uint32_t slabs = (newSize + SLAB_SIZE - 1) / SLAB_SIZE;
+  if (chunk == m_arena && oldSize > MAX_CLASS_SIZE && slabs <= MAX_RUN_SLABS
+      && oldBuffer + oldSize == chunk->mmap->buffer + chunk->brk
+      && chunk->brk + slabs * SLAB_SIZE - oldSize <= chunk->mmap->size)
     {
+      // the last run of the arena can grow in place.
+      chunk->brk += slabs * SLAB_SIZE - oldSize;
+      chunk->slabs[(oldBuffer - chunk->mmap->buffer) / SLAB_SIZE] = RUN | slabs;
       return oldBuffer;
     }
   uint8_t *newBuffer = Malloc (newSize);
   memcpy (newBuffer, oldBuffer, oldSize);
-  Free (oldBuffer, oldSize);
+  Free (oldBuffer);
   return newBuffer;
 }
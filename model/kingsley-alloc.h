@@ -2,32 +2,87 @@
 #define KINGSLEY_ALLOC_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <list>
+#include <map>
+#include <vector>
 
+/**
+ * The heap of a process.
+ *
+ * Small buffers are served from fine-grained size classes, each 4KiB slab
+ * of the heap holding buffers of a single class. Medium buffers are runs
+ * of a few slabs and large ones get their own mmap. The size of a buffer
+ * is found from the descriptor of its slab so there is no per-buffer
+ * header. The descriptors and the free list heads belong to each clone
+ * while the free lists are linked inside the heap content which is
+ * swapped by SwitchTo. All the buffers are 16-byte aligned.
+ *
+ * A freed run is merged with the free runs next to it in the same arena
+ * and a larger free run is split to serve a smaller request. A slab
+ * given to a size class stays in this class: the memory held by the
+ * small buffers is bounded by the peak usage of each class.
+ */
 class KingsleyAlloc
 {
 public:
+  struct Stats
+  {
+    uint64_t switches; // number of times another clone's heap had to be swapped in.
+    uint64_t copiedBytes; // bytes copied to clone, save or restore heap content.
+    uint64_t faults; // page faults resolved (copy-on-write mode only).
+  };
+
   KingsleyAlloc (void);
   ~KingsleyAlloc ();
 
   KingsleyAlloc * Clone (void);
   void SwitchTo (void);
   uint8_t * Malloc (uint32_t size);
-  void Free (uint8_t *buffer, uint32_t size);
-  uint8_t * Realloc (uint8_t *oldBuffer, uint32_t oldSize, uint32_t newSize);
+  // buffer must have been returned by Malloc or Realloc.
+  void Free (uint8_t *buffer);
+  // Grows in place when there is room, oldBuffer must not be zero.
+  uint8_t * Realloc (uint8_t *oldBuffer, uint32_t newSize);
+  // The number of bytes usable in buffer, at least the size requested.
+  uint32_t GetSize (uint8_t *buffer) const;
   // Call me only from my context
   void Dispose ();
 
+  /**
+   * When enabled, the heap chunks shared with the clones created by Clone
+   * are not copied as a whole on each SwitchTo: the shared buffer is write
+   * protected and only the pages really touched by a clone are saved and
+   * restored, page by page, from a SIGSEGV handler.
+   * The clones inherit this setting. It must be set before the first Clone.
+   */
+  void SetCopyOnWrite (bool enable);
+  struct Stats GetStats (void) const;
+  /**
+   * Resolve ahead of time the copy-on-write faults that an access to
+   * [buffer, buffer+size) would trigger. Must be called before handing a
+   * heap buffer to a host system call which would fail with EFAULT instead
+   * of raising a SIGSEGV on a protected page.
+   */
+  static void Prefault (const void *buffer, size_t size, bool write);
+  // Called by the SIGSEGV handler, return false if address is not ours.
+  static bool HandleFault (void *address);
+
 private:
+  struct MmapChunk;
   // The following structure is unique for all clone of this.
   struct Mmap
   {
-    uint32_t refcount; // TODO think about what is happen when refcount come back to one ?
-                       // Perhaps free copy ?
+    uint32_t refcount; // In copy-on-write mode, when refcount come back to one the
+                       // last clone takes back the buffer and the copies are freed.
     uint32_t size;
     uint8_t *buffer;
     uint8_t *current; // Where to save current context , is used when another context is coming up
                       // Zero if there is no clone yet(refcount == 1)
+    // Copy-on-write mode only.
+    bool cow;
+    struct MmapChunk *owner; // clone whose view of the heap is active.
+    std::vector<struct MmapChunk *> sharers; // all the clones of this mmap.
+    std::vector<uint16_t> holders; // per page, number of clones whose content is in buffer.
   };
 
   // But this one is differente between the clones.
@@ -36,20 +91,70 @@ private:
     struct Mmap *mmap;
     uint8_t *copy; // My own copy of mmap->buffer used when there is at less one clone else ZERO.
     uint32_t brk; // Amount of memory used.
+    // per slab: size class, or RUN | number of slabs of the run starting
+    // there. Empty if the mmap holds a single large buffer.
+    std::vector<uint16_t> slabs;
+    // Copy-on-write mode only.
+    KingsleyAlloc *alloc;
+    std::vector<bool> inBuffer; // per page, true if mmap->buffer holds our content.
   };
   struct Available
   {
     struct Available *next;
   };
-  void MmapAlloc (uint32_t size);
+  // at the start of a free run.
+  struct Run
+  {
+    struct Run *prev;
+    struct Run *next;
+  };
+  enum
+  {
+    SLAB_SIZE = 4096,
+    CLASS_COUNT = 24,
+    MAX_CLASS_SIZE = 2048,
+    MAX_RUN_SLABS = 7, // larger buffers get their own mmap.
+    ARENA_SLABS = 8,
+    RUN = 0x8000,
+    FREE = 0x4000, // with RUN, on the first and last slabs of a free run.
+    SLAB_MASK = 0x3fff
+  };
+  struct MmapChunk * MmapAlloc (uint32_t size);
   void MmapFree (uint8_t *buffer, uint32_t size);
-  uint8_t * Brk (uint32_t needed);
-  uint8_t SizeToBucket (uint32_t size);
-  uint32_t BucketToSize (uint8_t bucket);
+  uint8_t * Brk (uint32_t slabs, uint16_t descriptor);
+  uint8_t * AllocSlabs (uint32_t slabs, uint16_t descriptor);
+  void PushRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs);
+  void LinkRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs);
+  void UnlinkRun (struct MmapChunk *chunk, uint32_t slab, uint32_t slabs);
+  struct MmapChunk * Lookup (const uint8_t *buffer) const;
+  void AddClonedChunk (std::list<struct MmapChunk>::iterator chunk, bool arena);
+  void Release (struct MmapChunk *chunk);
+  static uint8_t SizeToClass (uint32_t size);
+
+  static uint32_t PageCount (uint32_t size);
+  static uint8_t * CowAllocCopy (uint32_t size);
+  static void InstallFaultHandler (void);
+  static struct Mmap * LookupCow (const uint8_t *address);
+  void CowStart (struct MmapChunk *chunk);
+  void CowRelease (struct MmapChunk *chunk);
+  static void CowCollapse (struct Mmap *mmap);
+  static int CowPageProtection (struct Mmap *mmap, uint32_t page);
+  static void CowProtect (struct Mmap *mmap);
+  static void CowAcquirePage (struct Mmap *mmap, uint32_t page);
 
   std::list<struct KingsleyAlloc::MmapChunk> m_chunks;
-  struct Available *m_buckets[32];
-  uint32_t m_defaultMmapSize;
+  // Key is the buffer of each mmap of m_chunks.
+  std::map<uint8_t *, std::list<struct MmapChunk>::iterator> m_index;
+  struct MmapChunk *m_arena; // the slabs are taken from its brk.
+  struct Available *m_free[CLASS_COUNT];
+  // The part of the last slab of each class never used yet.
+  uint8_t *m_bump[CLASS_COUNT];
+  uint8_t *m_bumpEnd[CLASS_COUNT];
+  struct Run *m_runs[ARENA_SLABS + 1]; // free runs by length.
+  bool m_cow;
+  struct Stats m_stats;
+  // Key is the last byte of the buffer of each mmap in copy-on-write mode.
+  static std::map<uint8_t *, struct Mmap *> m_cowMmaps;
 };
 
 
@@ -198,9 +198,11 @@ DCE (shutdown)
 DCE (send)
 DCE (sendto)
 DCE (sendmsg)
+DCE (sendmmsg)
 DCE (recv)
 DCE (recvfrom)
 DCE (recvmsg)
+DCE (recvmmsg)
 DCE (getnameinfo)
 
 // SYS/SYSCALL.h
@@ -356,6 +358,9 @@ DCE (fcntl)
 DCE_WITH_ALIAS2 (open, __open_2)
 DCE (open64)
 DCE (unlinkat)
+DCE (splice)
+DCE (tee)
+DCE (vmsplice)
 
 // TIME.H
 DCE (nanosleep)
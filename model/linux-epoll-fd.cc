@@ -25,6 +25,7 @@
 #include "ns3/log.h"
 #include "ns3/simulator.h"
 #include "task-manager.h"
+#include "file-usage.h"
 #include <errno.h>
 #include <sys/mman.h>
 #include <poll.h>
@@ -33,15 +34,62 @@ NS_LOG_COMPONENT_DEFINE ("LinuxEpollFd");
 
 namespace ns3 {
 
+EpollItem::EpollItem (LinuxEpollFd *epoll, int fd, UnixFd *file, const struct epoll_event *event)
+  : m_epoll (epoll),
+    m_fd (fd),
+    m_file (file),
+    m_event (*event),
+    m_ready (false),
+    m_readyPrev (0),
+    m_readyNext (0)
+{
+}
+
+void
+EpollItem::WakeUpCallback ()
+{
+  m_epoll->NotifyReady (this);
+}
+
+/**
+ * Wakes up the threads blocked in epoll_wait when an item becomes ready.
+ */
+class EpollWaiter : public WaitQueueEntry,
+                    public WaitPoint
+{
+public:
+  virtual void WakeUp (void *key)
+  {
+    WakeUpCallback ();
+  }
+};
+
 LinuxEpollFd::LinuxEpollFd (int size)
-  : m_waiter (0)
+  : m_readyHead (0),
+    m_readyTail (0),
+    m_waiter (0)
+{
+}
+
+LinuxEpollFd::~LinuxEpollFd ()
 {
-  //  std::map <int, struct epoll_event *> epollEvs;
+  // released without a close, by the exit of its process.
+  ForgetAll ();
+}
+
+void
+LinuxEpollFd::ForgetAll (void)
+{
+  while (!m_items.empty ())
+    {
+      Forget (m_items.begin ()->second);
+    }
 }
 
 int
 LinuxEpollFd::Close (void)
 {
+  ForgetAll ();
   if (m_waiter != 0)
     {
       m_waiter->process->manager->Wakeup (m_waiter);
@@ -49,6 +97,268 @@ LinuxEpollFd::Close (void)
   return 0;
 }
 
+void
+LinuxEpollFd::Register (EpollItem *item)
+{
+  // the registration in the wait queue of the file stays until Unregister.
+  item->SetEventMask ((item->m_event.events & 0xffff) | POLLERR | POLLHUP);
+  int mask = item->m_file->Poll (item);
+  item->m_file->m_epollItems.push_back (item);
+  if (mask & (item->m_event.events | POLLERR | POLLHUP))
+    {
+      NotifyReady (item);
+    }
+}
+
+void
+LinuxEpollFd::Unregister (EpollItem *item)
+{
+  RemoveReady (item);
+  item->FreeWait ();
+  item->m_file->m_epollItems.remove (item);
+}
+
+void
+LinuxEpollFd::PushReady (EpollItem *item)
+{
+  item->m_ready = true;
+  item->m_readyNext = 0;
+  item->m_readyPrev = m_readyTail;
+  if (m_readyTail != 0)
+    {
+      m_readyTail->m_readyNext = item;
+    }
+  else
+    {
+      m_readyHead = item;
+    }
+  m_readyTail = item;
+}
+
+void
+LinuxEpollFd::RemoveReady (EpollItem *item)
+{
+  if (!item->m_ready)
+    {
+      return;
+    }
+  if (item->m_readyPrev != 0)
+    {
+      item->m_readyPrev->m_readyNext = item->m_readyNext;
+    }
+  else
+    {
+      m_readyHead = item->m_readyNext;
+    }
+  if (item->m_readyNext != 0)
+    {
+      item->m_readyNext->m_readyPrev = item->m_readyPrev;
+    }
+  else
+    {
+      m_readyTail = item->m_readyPrev;
+    }
+  item->m_ready = false;
+  item->m_readyPrev = 0;
+  item->m_readyNext = 0;
+}
+
+void
+LinuxEpollFd::NotifyReady (EpollItem *item)
+{
+  NS_LOG_FUNCTION (this << item->m_fd);
+  if (item->m_ready)
+    {
+      return;
+    }
+  PushReady (item);
+  short pi = POLLIN;
+  WakeWaiters (&pi);
+}
+
+void
+LinuxEpollFd::Forget (EpollItem *item)
+{
+  NS_LOG_FUNCTION (this << item->m_fd);
+  m_items.erase (item->m_fd);
+  Unregister (item);
+  delete item;
+}
+
+int
+LinuxEpollFd::Ctl (int op, int fd, const struct epoll_event *event)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << op << fd);
+  if (!CheckFdExists (current->process, fd, true))
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  UnixFd *file = current->process->openFiles.Get (fd)->GetFile ();
+  if (file == this)
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  if (op != EPOLL_CTL_DEL && event == 0)
+    {
+      current->err = EFAULT;
+      return -1;
+    }
+  std::map<int, EpollItem *>::iterator i = m_items.find (fd);
+  switch (op)
+    {
+    case EPOLL_CTL_ADD:
+      {
+        if (i != m_items.end ())
+          {
+            current->err = EEXIST;
+            return -1;
+          }
+        EpollItem *item = new EpollItem (this, fd, file, event);
+        m_items[fd] = item;
+        Register (item);
+      } break;
+    case EPOLL_CTL_MOD:
+      if (i == m_items.end ())
+        {
+          current->err = ENOENT;
+          return -1;
+        }
+      // register again to use the new event mask and report the current state.
+      Unregister (i->second);
+      i->second->m_event = *event;
+      Register (i->second);
+      break;
+    case EPOLL_CTL_DEL:
+      if (i == m_items.end ())
+        {
+          current->err = ENOENT;
+          return -1;
+        }
+      Forget (i->second);
+      break;
+    default:
+      current->err = EINVAL;
+      return -1;
+    }
+  return 0;
+}
+
+int
+LinuxEpollFd::Harvest (struct epoll_event *events, int maxevents)
+{
+  int count = 0;
+  // the level-triggered items still ready are queued again behind the others.
+  EpollItem *again = 0;
+  EpollItem *againTail = 0;
+  while (m_readyHead != 0 && count < maxevents)
+    {
+      EpollItem *item = m_readyHead;
+      RemoveReady (item);
+      if ((item->m_event.events & ~(EPOLLET | EPOLLONESHOT)) == 0)
+        {
+          // disabled by EPOLLONESHOT until the next EPOLL_CTL_MOD.
+          continue;
+        }
+      int mask = item->m_file->Poll (0) & (item->m_event.events | POLLERR | POLLHUP);
+      if (mask == 0)
+        {
+          // spurious wakeup or already consumed.
+          continue;
+        }
+      events[count].events = mask;
+      events[count].data = item->m_event.data;
+      count++;
+      NS_LOG_INFO ("epoll woke up with " << item->m_fd << " events " << mask);
+      if (item->m_event.events & EPOLLONESHOT)
+        {
+          item->m_event.events &= EPOLLET | EPOLLONESHOT;
+        }
+      else if (!(item->m_event.events & EPOLLET))
+        {
+          item->m_ready = true;
+          item->m_readyPrev = againTail;
+          item->m_readyNext = 0;
+          if (againTail != 0)
+            {
+              againTail->m_readyNext = item;
+            }
+          else
+            {
+              again = item;
+            }
+          againTail = item;
+        }
+    }
+  if (again != 0)
+    {
+      again->m_readyPrev = m_readyTail;
+      if (m_readyTail != 0)
+        {
+          m_readyTail->m_readyNext = again;
+        }
+      else
+        {
+          m_readyHead = again;
+        }
+      m_readyTail = againTail;
+    }
+  return count;
+}
+
+int
+LinuxEpollFd::Wait (struct epoll_event *events, int maxevents, int timeout)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << maxevents << timeout);
+  if (maxevents <= 0)
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  Time end = Simulator::Now () + MilliSeconds (timeout);
+  while (true)
+    {
+      int count = Harvest (events, maxevents);
+      if (count > 0 || timeout == 0)
+        {
+          if (count == 0)
+            {
+              // Try to break infinite loop in epoll_wait with a 0 timeout !
+              UtilsAdvanceTime (current);
+            }
+          return count;
+        }
+      Time left = Seconds (0);
+      if (timeout > 0)
+        {
+          left = end - Simulator::Now ();
+          if (!left.IsStrictlyPositive ())
+            {
+              return 0;
+            }
+        }
+      EpollWaiter *waiter = new EpollWaiter ();
+      AddWaitQueue (waiter, true);
+      WaitPoint::Result res = waiter->Wait (left);
+      RemoveWaitQueue (waiter, true);
+      delete waiter;
+      switch (res)
+        {
+        case WaitPoint::INTERRUPTED:
+          UtilsDoSignal ();
+          current->err = EINTR;
+          return -1;
+        case WaitPoint::TIMEOUT:
+          return Harvest (events, maxevents);
+        default:
+          break;
+        }
+    }
+}
+
 ssize_t
 LinuxEpollFd::Write (const void *buf, size_t count)
 {
@@ -236,8 +546,8 @@ LinuxEpollFd::Gettime (struct itimerspec *cur_value) const
 bool
 LinuxEpollFd::CanRecv (void) const
 {
-  // XXX ?
-  return false;
+  // may be a false positive, as with linux.
+  return m_readyHead != 0;
 }
 bool
 LinuxEpollFd::CanSend (void) const
@@ -23,15 +23,51 @@
 
 #include "unix-fd.h"
 #include "process.h"
+#include "wait-queue.h"
 #include "ns3/nstime.h"
 #include "ns3/event-id.h"
+#include <sys/epoll.h>
 
 namespace ns3 {
 
+class LinuxEpollFd;
+
+/**
+ * A file watched by a LinuxEpollFd. It stays in the wait queue of the
+ * file from EPOLL_CTL_ADD to EPOLL_CTL_DEL and puts itself in the ready
+ * list of the epoll instance each time the file wakes it up.
+ */
+class EpollItem : public PollTable
+{
+public:
+  EpollItem (LinuxEpollFd *epoll, int fd, UnixFd *file, const struct epoll_event *event);
+  virtual void WakeUpCallback ();
+
+  LinuxEpollFd * const m_epoll;
+  int const m_fd;
+  UnixFd * const m_file;
+  struct epoll_event m_event;
+  bool m_ready;
+  EpollItem *m_readyPrev;
+  EpollItem *m_readyNext;
+};
+
+/**
+ * The interest list is keyed by fd. The items which may be ready are
+ * linked in a ready list, so epoll_wait only looks at them.
+ */
 class LinuxEpollFd : public UnixFd
 {
 public:
   LinuxEpollFd (int size);
+  virtual ~LinuxEpollFd ();
+
+  // Same as epoll_ctl and epoll_wait, set Current ()->err on error.
+  int Ctl (int op, int fd, const struct epoll_event *event);
+  int Wait (struct epoll_event *events, int maxevents, int timeout);
+  void NotifyReady (EpollItem *item);
+  // The file of the item is being closed.
+  void Forget (EpollItem *item);
 
   virtual int Close (void);
   virtual ssize_t Write (const void *buf, size_t count);
@@ -68,8 +104,17 @@ public:
   virtual int Poll (PollTable* ptable);
   virtual int Fsync (void);
 
-  std::map <int, struct epoll_event *> evs;
 private:
+  void ForgetAll (void);
+  void Register (EpollItem *item);
+  void Unregister (EpollItem *item);
+  void PushReady (EpollItem *item);
+  void RemoveReady (EpollItem *item);
+  int Harvest (struct epoll_event *events, int maxevents);
+
+  std::map <int, EpollItem *> m_items;
+  EpollItem *m_readyHead;
+  EpollItem *m_readyTail;
   Thread * m_waiter;
 };
 
@@ -47,6 +47,7 @@ LinuxSocketFdFactory::NotifyNewAggregate (void)
     {
       m_manager = taskManager;
       m_loader = loaderFactory->Create (0, 0, 0);
+      // on the host whatever the FileSystem of the node, see FileSystem.
       UtilsEnsureDirectoryExists (UtilsGetAbsRealFilePath (node->GetId (), "/var"));
       UtilsEnsureDirectoryExists (UtilsGetAbsRealFilePath (node->GetId (), "/var/log"));
       std::string path = UtilsGetAbsRealFilePath (node->GetId (), "/var/log/messages");
@@ -587,7 +587,7 @@ LinuxSocketImpl::Poll ()
                   NS_LOG_INFO ("accept error");
                 }
               KernelSocketFd *kern_sock;
-              FileUsage *fu = Current ()->process->openFiles[sock];
+              FileUsage *fu = Current ()->process->openFiles.Get (sock);
               kern_sock = (KernelSocketFd *)fu->GetFileInc ();
               kern_sock->IncFdCount ();
               kern_sock->Fcntl (F_SETFL, O_NONBLOCK);
@@ -12,6 +12,9 @@ void Loader::NotifyStartExecute (void)
 void Loader::NotifyEndExecute (void)
 {
 }
+void Loader::Prefault (void *buffer, size_t size)
+{
+}
 
 TypeId
 LoaderFactory::GetTypeId (void)
@@ -12,6 +12,9 @@ public:
   virtual ~Loader () = 0;
   virtual void NotifyStartExecute (void);
   virtual void NotifyEndExecute (void);
+  // Called before the host writes into [buffer,buffer+size) on behalf of
+  // the current process.
+  virtual void Prefault (void *buffer, size_t size);
   virtual Loader * Clone (void) = 0;
   virtual void UnloadAll (void) = 0;
   virtual void * Load (std::string filename, int flag, bool failsafe = false) = 0;
@@ -446,6 +446,7 @@ LocalDatagramSocketFd::Bind (const struct sockaddr *my_addr, socklen_t addrlen)
       return -1;
     }
 
+  // a host socket whatever the FileSystem of the node, see FileSystem.
   std::string realPath = UtilsGetRealFilePath (std::string (((struct sockaddr_un*) my_addr)->sun_path));
   struct sockaddr_un realAddr;
 
@@ -841,6 +842,18 @@ LocalDatagramSocketFd::UnBind (void)
     }
 }
 
+ssize_t
+LocalDatagramSocketFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  return WritevDatagram (iov, iovcnt);
+}
+ssize_t
+LocalDatagramSocketFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  return ReadvDatagram (iov, iovcnt);
+}
 ssize_t
 LocalDatagramSocketFd::Read (void *buf, size_t count)
 {
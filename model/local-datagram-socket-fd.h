@@ -59,6 +59,8 @@ public:
   virtual ssize_t Read (void *buf, size_t count);
   virtual ssize_t Recvmsg (struct msghdr *msg, int flags);
   virtual ssize_t Sendmsg (const struct msghdr *msg, int flags);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
 
   virtual int Setsockopt (int level, int optname,
                           const void *optval, socklen_t optlen);
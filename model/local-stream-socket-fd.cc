@@ -747,6 +747,7 @@ LocalStreamSocketFd::Bind (const struct sockaddr *my_addr, socklen_t addrlen)
       return -1;
     }
 
+  // a host socket whatever the FileSystem of the node, see FileSystem.
   std::string realPath = UtilsGetRealFilePath (std::string (((struct sockaddr_un*) my_addr)->sun_path));
 
   struct sockaddr_un realAddr;
@@ -962,7 +963,7 @@ LocalStreamSocketFd::Accept (struct sockaddr *my_addr, socklen_t *addrlen)
         {
           LocalStreamSocketFd *socket = new LocalStreamSocketFd (first, m_bindPath);
           socket->IncFdCount ();
-          current->process->openFiles[fd] = new FileUsage (fd, socket);
+          current->process->openFiles.Set (fd, new FileUsage (fd, socket));
 
           first->SetPeer (socket);
 
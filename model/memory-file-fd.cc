@@ -0,0 +1,318 @@
+#include "memory-file-fd.h"
+#include "utils.h"
+#include "process.h"
+#include "ns3/log.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+NS_LOG_COMPONENT_DEFINE ("MemoryFileFd");
+
+namespace ns3 {
+
+MemoryFileFd::MemoryFileFd (Ptr<MemoryFileSystem> fs, MemoryInode *inode,
+                            std::string path, int flags)
+  : UnixFileFdBase (-1),
+    m_fs (fs),
+    m_inode (inode),
+    m_path (path),
+    m_flags (flags & ~(O_CREAT | O_EXCL | O_TRUNC | O_NOCTTY | O_CLOEXEC)),
+    m_offset (0),
+    m_nextEntry (0),
+    m_listed (false)
+{
+  m_fs->Hold (inode);
+  if (flags & O_CLOEXEC)
+    {
+      m_fdFlags = FD_CLOEXEC;
+    }
+}
+
+MemoryFileFd::~MemoryFileFd ()
+{
+  m_fs->Release (m_inode);
+}
+
+int
+MemoryFileFd::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  // the file is released with this instance.
+  return 0;
+}
+
+bool
+MemoryFileFd::IsDirectory (void) const
+{
+  return S_ISDIR (m_fs->GetStat (m_inode)->st_mode);
+}
+
+ssize_t
+MemoryFileFd::Write (const void *buf, size_t count)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << buf << count);
+  NS_ASSERT (current != 0);
+  if ((m_flags & O_ACCMODE) == O_RDONLY)
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  if (m_flags & O_APPEND)
+    {
+      m_offset = m_fs->GetStat (m_inode)->st_size;
+    }
+  ssize_t ret = m_fs->Write (m_inode, m_offset, buf, count);
+  if (ret == -1)
+    {
+      current->err = errno;
+      return -1;
+    }
+  m_offset += ret;
+  return ret;
+}
+
+ssize_t
+MemoryFileFd::Read (void *buf, size_t count)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << buf << count);
+  NS_ASSERT (current != 0);
+  if ((m_flags & O_ACCMODE) == O_WRONLY)
+    {
+      current->err = EBADF;
+      return -1;
+    }
+  if (IsDirectory ())
+    {
+      current->err = EISDIR;
+      return -1;
+    }
+  ssize_t ret = m_fs->Read (m_inode, m_offset, buf, count);
+  m_offset += ret;
+  return ret;
+}
+
+ssize_t
+MemoryFileFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  return UnixFd::Writev (iov, iovcnt);
+}
+
+ssize_t
+MemoryFileFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  return UnixFd::Readv (iov, iovcnt);
+}
+
+void *
+MemoryFileFd::Mmap (void *start, size_t length, int prot, int flags, off64_t offset)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << start << length << prot << flags << offset);
+  NS_ASSERT (current != 0);
+  if ((flags & MAP_SHARED) && (prot & PROT_WRITE))
+    {
+      // the changes could not be seen by read.
+      current->err = ENODEV;
+      return MAP_FAILED;
+    }
+  void *map = ::mmap (start, length, PROT_READ | PROT_WRITE,
+                      (flags & MAP_FIXED) | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    {
+      current->err = errno;
+      return MAP_FAILED;
+    }
+  m_fs->Read (m_inode, offset, map, length);
+  if (prot != (PROT_READ | PROT_WRITE))
+    {
+      ::mprotect (map, length, prot);
+    }
+  return map;
+}
+
+off64_t
+MemoryFileFd::Lseek (off64_t offset, int whence)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << offset << whence);
+  NS_ASSERT (current != 0);
+  off64_t position;
+  switch (whence)
+    {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = m_offset + offset;
+      break;
+    case SEEK_END:
+      position = m_fs->GetStat (m_inode)->st_size + offset;
+      break;
+    default:
+      current->err = EINVAL;
+      return -1;
+    }
+  if (position < 0)
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  if (IsDirectory () && position == 0)
+    {
+      Rewinddir ();
+    }
+  m_offset = position;
+  return position;
+}
+
+int
+MemoryFileFd::Fxstat (int ver, struct ::stat *buf)
+{
+  NS_LOG_FUNCTION (this << buf);
+  UtilsStat64ToStat (m_fs->GetStat (m_inode), buf);
+  return 0;
+}
+
+int
+MemoryFileFd::Fxstat64 (int ver, struct ::stat64 *buf)
+{
+  NS_LOG_FUNCTION (this << buf);
+  *buf = *m_fs->GetStat (m_inode);
+  return 0;
+}
+
+int
+MemoryFileFd::Fcntl (int cmd, unsigned long arg)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << cmd << arg);
+  NS_ASSERT (current != 0);
+  switch (cmd)
+    {
+    case F_GETFL:
+      return m_flags;
+    case F_SETFL:
+      m_flags = (m_flags & ~(O_APPEND | O_NONBLOCK)) | (arg & (O_APPEND | O_NONBLOCK));
+      return 0;
+    case F_GETFD:
+      return m_fdFlags;
+    case F_SETFD:
+      m_fdFlags = arg & FD_CLOEXEC;
+      return 0;
+    case F_GETLK:
+      // no other host process can see these files.
+      ((struct flock *)arg)->l_type = F_UNLCK;
+      return 0;
+    case F_SETLK:
+    case F_SETLKW:
+      return 0;
+    default:
+      current->err = EINVAL;
+      return -1;
+    }
+}
+
+int
+MemoryFileFd::Ftruncate (off_t length)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << length);
+  NS_ASSERT (current != 0);
+  if (IsDirectory () || (m_flags & O_ACCMODE) == O_RDONLY || length < 0)
+    {
+      current->err = EINVAL;
+      return -1;
+    }
+  m_fs->Truncate (m_inode, length);
+  return 0;
+}
+
+bool
+MemoryFileFd::CanRecv (void) const
+{
+  return true;
+}
+
+bool
+MemoryFileFd::CanSend (void) const
+{
+  return true;
+}
+
+int
+MemoryFileFd::Fsync (void)
+{
+  return 0;
+}
+
+std::string
+MemoryFileFd::GetPath (void) const
+{
+  return m_path;
+}
+
+const MemoryFileSystem::DirEntry *
+MemoryFileFd::NextEntry (void)
+{
+  if (!IsDirectory ())
+    {
+      return 0;
+    }
+  if (!m_listed)
+    {
+      m_fs->List (m_inode, &m_entries);
+      m_listed = true;
+    }
+  if (m_nextEntry >= m_entries.size ())
+    {
+      return 0;
+    }
+  return &m_entries[m_nextEntry++];
+}
+
+struct dirent *
+MemoryFileFd::Readdir (void)
+{
+  const MemoryFileSystem::DirEntry *entry = NextEntry ();
+  if (entry == 0)
+    {
+      return 0;
+    }
+  memset (&m_dirent, 0, sizeof (m_dirent));
+  m_dirent.d_ino = entry->ino;
+  m_dirent.d_off = m_nextEntry;
+  m_dirent.d_reclen = sizeof (m_dirent);
+  m_dirent.d_type = entry->type;
+  strncpy (m_dirent.d_name, entry->name.c_str (), sizeof (m_dirent.d_name) - 1);
+  return &m_dirent;
+}
+
+struct dirent64 *
+MemoryFileFd::Readdir64 (void)
+{
+  const MemoryFileSystem::DirEntry *entry = NextEntry ();
+  if (entry == 0)
+    {
+      return 0;
+    }
+  memset (&m_dirent64, 0, sizeof (m_dirent64));
+  m_dirent64.d_ino = entry->ino;
+  m_dirent64.d_off = m_nextEntry;
+  m_dirent64.d_reclen = sizeof (m_dirent64);
+  m_dirent64.d_type = entry->type;
+  strncpy (m_dirent64.d_name, entry->name.c_str (), sizeof (m_dirent64.d_name) - 1);
+  return &m_dirent64;
+}
+
+void
+MemoryFileFd::Rewinddir (void)
+{
+  m_entries.clear ();
+  m_nextEntry = 0;
+  m_listed = false;
+}
+
+} // namespace ns3
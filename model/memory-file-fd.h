@@ -0,0 +1,60 @@
+#ifndef MEMORY_FILE_FD_H
+#define MEMORY_FILE_FD_H
+
+#include "unix-file-fd.h"
+#include "memory-file-system.h"
+#include <dirent.h>
+
+namespace ns3 {
+
+/**
+ * A file or a directory of a MemoryFileSystem. There is no host fd behind
+ * it: GetRealFd returns -1.
+ */
+class MemoryFileFd : public UnixFileFdBase
+{
+public:
+  MemoryFileFd (Ptr<MemoryFileSystem> fs, MemoryInode *inode, std::string path, int flags);
+  virtual ~MemoryFileFd ();
+
+  virtual int Close (void);
+  virtual ssize_t Write (const void *buf, size_t count);
+  virtual ssize_t Read (void *buf, size_t count);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
+  virtual void * Mmap (void *start, size_t length, int prot, int flags, off64_t offset);
+  virtual off64_t Lseek (off64_t offset, int whence);
+  virtual int Fxstat (int ver, struct ::stat *buf);
+  virtual int Fxstat64 (int ver, struct ::stat64 *buf);
+  virtual int Fcntl (int cmd, unsigned long arg);
+  virtual int Ftruncate (off_t length);
+  virtual bool CanRecv (void) const;
+  virtual bool CanSend (void) const;
+  virtual int Fsync (void);
+
+  // the path used to open it.
+  std::string GetPath (void) const;
+  // Directories only: the entries, listed when first read.
+  struct dirent * Readdir (void);
+  struct dirent64 * Readdir64 (void);
+  void Rewinddir (void);
+
+private:
+  bool IsDirectory (void) const;
+  const MemoryFileSystem::DirEntry * NextEntry (void);
+
+  Ptr<MemoryFileSystem> m_fs;
+  MemoryInode *m_inode;
+  std::string m_path;
+  int m_flags;
+  off64_t m_offset;
+  std::vector<MemoryFileSystem::DirEntry> m_entries;
+  size_t m_nextEntry;
+  bool m_listed;
+  struct dirent m_dirent;
+  struct dirent64 m_dirent64;
+};
+
+} // namespace ns3
+
+#endif /* MEMORY_FILE_FD_H */
@@ -0,0 +1,941 @@
+#include "memory-file-system.h"
+#include "memory-file-fd.h"
+#include "utils.h"
+#include "ns3/log.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+
+NS_LOG_COMPONENT_DEFINE ("MemoryFileSystem");
+
+#define MEMORY_PAGE_SIZE 4096
+#define MEMORY_MIN_BUCKETS 64
+
+namespace ns3 {
+
+struct MemoryPage
+{
+  uint32_t refs; // files sharing this page.
+  uint8_t data[MEMORY_PAGE_SIZE];
+};
+
+struct MemoryInode
+{
+  uint32_t refs; // directory entries and open files.
+  struct ::stat64 st;
+  std::map<uint64_t, MemoryPage *> pages; // by index, none for the holes.
+  // directories only.
+  MemoryDentry *children;
+  MemoryDentry *dentry; // 0 for the root.
+  const MemoryInode *lower; // same directory in the base.
+};
+
+struct MemoryDentry
+{
+  std::string name;
+  uint32_t hash;
+  MemoryInode *parent;
+  MemoryInode *inode; // 0 hides the entry of the base (whiteout).
+  MemoryDentry *hashNext;
+  MemoryDentry *prev;
+  MemoryDentry *next;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (MemoryFileSystem);
+
+TypeId
+MemoryFileSystem::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MemoryFileSystem")
+    .SetParent<FileSystem> ()
+    .AddConstructor<MemoryFileSystem> ()
+    .AddAttribute ("Base",
+                   "Read-only MemoryFileSystem this one is an overlay of, "
+                   "typically shared by all the nodes.",
+                   PointerValue (),
+                   MakePointerAccessor (&MemoryFileSystem::m_base),
+                   MakePointerChecker<MemoryFileSystem> ())
+  ;
+  return tid;
+}
+
+MemoryFileSystem::MemoryFileSystem ()
+  : m_buckets (MEMORY_MIN_BUCKETS, (MemoryDentry *)0),
+    m_dentries (0),
+    m_nextIno (1)
+{
+  m_root = NewInode (S_IFDIR | 0755);
+  m_root->refs = 1;
+  m_root->st.st_nlink = 2;
+}
+
+MemoryFileSystem::~MemoryFileSystem ()
+{
+  // no file is open anymore: they keep a reference to the file system.
+  std::vector<MemoryDentry *> dentries;
+  for (uint32_t i = 0; i < m_buckets.size (); i++)
+    {
+      for (MemoryDentry *d = m_buckets[i]; d != 0; d = d->hashNext)
+        {
+          dentries.push_back (d);
+        }
+    }
+  for (std::vector<MemoryDentry *>::iterator i = dentries.begin (); i != dentries.end (); ++i)
+    {
+      if ((*i)->inode != 0)
+        {
+          Release ((*i)->inode);
+        }
+      delete *i;
+    }
+  Release (m_root);
+}
+
+uint32_t
+MemoryFileSystem::Hash (const MemoryInode *dir, const std::string &name)
+{
+  // FNV-1a, seeded by the directory.
+  uint32_t hash = 2166136261U ^ (uint32_t)((uintptr_t)dir >> 4);
+  for (std::string::const_iterator i = name.begin (); i != name.end (); ++i)
+    {
+      hash ^= (uint8_t)*i;
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+void
+MemoryFileSystem::Rehash (void)
+{
+  std::vector<MemoryDentry *> buckets (m_buckets.size () * 2, (MemoryDentry *)0);
+  for (uint32_t i = 0; i < m_buckets.size (); i++)
+    {
+      MemoryDentry *d = m_buckets[i];
+      while (d != 0)
+        {
+          MemoryDentry *next = d->hashNext;
+          MemoryDentry **head = &buckets[d->hash & (buckets.size () - 1)];
+          d->hashNext = *head;
+          *head = d;
+          d = next;
+        }
+    }
+  m_buckets.swap (buckets);
+}
+
+MemoryDentry *
+MemoryFileSystem::Find (const MemoryInode *dir, const std::string &name) const
+{
+  uint32_t hash = Hash (dir, name);
+  for (MemoryDentry *d = m_buckets[hash & (m_buckets.size () - 1)]; d != 0; d = d->hashNext)
+    {
+      if (d->hash == hash && d->parent == dir && d->name == name)
+        {
+          return d;
+        }
+    }
+  return 0;
+}
+
+MemoryDentry *
+MemoryFileSystem::Lookup (MemoryInode *dir, const std::string &name)
+{
+  MemoryDentry *d = Find (dir, name);
+  if (d != 0 || dir->lower == 0)
+    {
+      return d;
+    }
+  MemoryDentry *lower = m_base->Find (dir->lower, name);
+  if (lower == 0 || lower->inode == 0)
+    {
+      return 0;
+    }
+  // first use of an entry of the base: copy it, the data stays shared.
+  // dir already counts and dates it.
+  Insert (dir, name, CopyInode (lower->inode));
+  return Find (dir, name);
+}
+
+void
+MemoryFileSystem::Insert (MemoryInode *dir, const std::string &name, MemoryInode *inode)
+{
+  MemoryDentry *d = Find (dir, name);
+  if (d == 0)
+    {
+      d = new MemoryDentry ();
+      d->name = name;
+      d->hash = Hash (dir, name);
+      d->parent = dir;
+      MemoryDentry **head = &m_buckets[d->hash & (m_buckets.size () - 1)];
+      d->hashNext = *head;
+      *head = d;
+      d->prev = 0;
+      d->next = dir->children;
+      if (dir->children != 0)
+        {
+          dir->children->prev = d;
+        }
+      dir->children = d;
+      m_dentries++;
+      if (m_dentries > 2 * m_buckets.size ())
+        {
+          Rehash ();
+        }
+    }
+  NS_ASSERT (d->inode == 0);
+  d->inode = inode;
+  inode->refs++;
+  if (S_ISDIR (inode->st.st_mode))
+    {
+      inode->dentry = d;
+    }
+}
+
+void
+MemoryFileSystem::Link (MemoryInode *dir, const std::string &name, MemoryInode *inode)
+{
+  Insert (dir, name, inode);
+  inode->st.st_nlink++;
+  if (S_ISDIR (inode->st.st_mode))
+    {
+      dir->st.st_nlink++;
+    }
+  Touch (dir);
+}
+
+void
+MemoryFileSystem::Unhash (MemoryDentry *dentry)
+{
+  MemoryDentry **p = &m_buckets[dentry->hash & (m_buckets.size () - 1)];
+  while (*p != dentry)
+    {
+      p = &(*p)->hashNext;
+    }
+  *p = dentry->hashNext;
+  if (dentry->prev != 0)
+    {
+      dentry->prev->next = dentry->next;
+    }
+  else
+    {
+      dentry->parent->children = dentry->next;
+    }
+  if (dentry->next != 0)
+    {
+      dentry->next->prev = dentry->prev;
+    }
+  m_dentries--;
+}
+
+void
+MemoryFileSystem::Remove (MemoryDentry *dentry)
+{
+  MemoryInode *dir = dentry->parent;
+  MemoryInode *inode = dentry->inode;
+  MemoryDentry *lower = dir->lower ? m_base->Find (dir->lower, dentry->name) : 0;
+  if (lower != 0 && lower->inode != 0)
+    {
+      // keep hiding the entry of the base.
+      dentry->inode = 0;
+    }
+  else
+    {
+      Unhash (dentry);
+      delete dentry;
+    }
+  if (S_ISDIR (inode->st.st_mode))
+    {
+      inode->dentry = 0;
+      dir->st.st_nlink--;
+    }
+  inode->st.st_nlink--;
+  Touch (dir);
+  Release (inode);
+}
+
+bool
+MemoryFileSystem::IsEmpty (const MemoryInode *dir) const
+{
+  for (MemoryDentry *d = dir->children; d != 0; d = d->next)
+    {
+      if (d->inode != 0)
+        {
+          return false;
+        }
+    }
+  if (dir->lower != 0)
+    {
+      for (MemoryDentry *d = dir->lower->children; d != 0; d = d->next)
+        {
+          if (d->inode != 0 && Find (dir, d->name) == 0)
+            {
+              return false;
+            }
+        }
+    }
+  return true;
+}
+
+void
+MemoryFileSystem::RemoveWhiteouts (MemoryInode *dir)
+{
+  while (dir->children != 0)
+    {
+      MemoryDentry *d = dir->children;
+      NS_ASSERT (d->inode == 0);
+      Unhash (d);
+      delete d;
+    }
+}
+
+MemoryInode *
+MemoryFileSystem::NewInode (mode_t mode)
+{
+  if (m_base != 0)
+    {
+      // the copies of the entries of the base keep their number.
+      m_nextIno = std::max (m_nextIno, m_base->m_nextIno);
+    }
+  MemoryInode *inode = new MemoryInode ();
+  inode->refs = 0;
+  memset (&inode->st, 0, sizeof (inode->st));
+  inode->st.st_ino = m_nextIno++;
+  inode->st.st_mode = mode;
+  inode->st.st_blksize = MEMORY_PAGE_SIZE;
+  inode->children = 0;
+  inode->dentry = 0;
+  inode->lower = 0;
+  Touch (inode);
+  inode->st.st_atim = inode->st.st_mtim;
+  return inode;
+}
+
+MemoryInode *
+MemoryFileSystem::CopyInode (const MemoryInode *inode)
+{
+  MemoryInode *copy = new MemoryInode ();
+  copy->refs = 0;
+  copy->st = inode->st;
+  copy->pages = inode->pages;
+  for (std::map<uint64_t, MemoryPage *>::iterator i = copy->pages.begin (); i != copy->pages.end (); ++i)
+    {
+      i->second->refs++;
+    }
+  copy->children = 0;
+  copy->dentry = 0;
+  copy->lower = S_ISDIR (inode->st.st_mode) ? inode : 0;
+  return copy;
+}
+
+void
+MemoryFileSystem::Touch (MemoryInode *inode)
+{
+  struct timespec now = UtilsTimeToTimespec (UtilsSimulationTimeToTime (Simulator::Now ()));
+  inode->st.st_mtim = now;
+  inode->st.st_ctim = now;
+}
+
+void
+MemoryFileSystem::PutPage (MemoryPage *page)
+{
+  if (page != 0 && --page->refs == 0)
+    {
+      free (page);
+    }
+}
+
+void
+MemoryFileSystem::Hold (MemoryInode *inode)
+{
+  inode->refs++;
+}
+
+void
+MemoryFileSystem::Release (MemoryInode *inode)
+{
+  NS_ASSERT (inode->refs > 0);
+  if (--inode->refs > 0)
+    {
+      return;
+    }
+  for (std::map<uint64_t, MemoryPage *>::iterator i = inode->pages.begin (); i != inode->pages.end (); ++i)
+    {
+      PutPage (i->second);
+    }
+  delete inode;
+}
+
+int
+MemoryFileSystem::Walk (std::string path, MemoryInode **parent, std::string *name,
+                        MemoryInode **inode)
+{
+  std::vector<std::string> components;
+  std::string::size_type start = 0;
+  while (start < path.size ())
+    {
+      std::string::size_type end = path.find ('/', start);
+      if (end == std::string::npos)
+        {
+          end = path.size ();
+        }
+      std::string component = path.substr (start, end - start);
+      if (component == "..")
+        {
+          if (!components.empty ())
+            {
+              components.pop_back ();
+            }
+        }
+      else if (component != "" && component != ".")
+        {
+          components.push_back (component);
+        }
+      start = end + 1;
+    }
+  if (m_base != 0 && m_root->lower == 0)
+    {
+      // the attribute is set after the construction.
+      m_root->lower = m_base->m_root;
+    }
+  *parent = 0;
+  *name = "";
+  *inode = m_root;
+  MemoryInode *dir = m_root;
+  for (uint32_t i = 0; i < components.size (); i++)
+    {
+      if (!S_ISDIR (dir->st.st_mode))
+        {
+          errno = ENOTDIR;
+          return -1;
+        }
+      MemoryDentry *d = Lookup (dir, components[i]);
+      if (i == components.size () - 1)
+        {
+          *parent = dir;
+          *name = components[i];
+          *inode = d ? d->inode : 0;
+          break;
+        }
+      if (d == 0 || d->inode == 0)
+        {
+          errno = ENOENT;
+          return -1;
+        }
+      dir = d->inode;
+    }
+  return 0;
+}
+
+UnixFd *
+MemoryFileSystem::Open (std::string path, int flags, mode_t mode)
+{
+  NS_LOG_FUNCTION (this << path << flags << mode);
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return 0;
+    }
+  int access = flags & O_ACCMODE;
+  if (inode == 0)
+    {
+      if (!(flags & O_CREAT))
+        {
+          errno = ENOENT;
+          return 0;
+        }
+      inode = NewInode (S_IFREG | (mode & 07777));
+      Link (parent, name, inode);
+    }
+  else if ((flags & O_CREAT) && (flags & O_EXCL))
+    {
+      errno = EEXIST;
+      return 0;
+    }
+  else if (S_ISDIR (inode->st.st_mode) && access != O_RDONLY)
+    {
+      errno = EISDIR;
+      return 0;
+    }
+  else if ((flags & O_DIRECTORY) && !S_ISDIR (inode->st.st_mode))
+    {
+      errno = ENOTDIR;
+      return 0;
+    }
+  else if ((flags & O_TRUNC) && access != O_RDONLY)
+    {
+      Truncate (inode, 0);
+    }
+  return new MemoryFileFd (this, inode, path, flags);
+}
+
+int
+MemoryFileSystem::Stat (std::string path, struct ::stat64 *buf, bool followLink)
+{
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  *buf = inode->st;
+  return 0;
+}
+
+int
+MemoryFileSystem::Access (std::string path, int mode)
+{
+  struct ::stat64 st;
+  if (Stat (path, &st, true) == -1)
+    {
+      return -1;
+    }
+  if ((mode & X_OK) && !(st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)))
+    {
+      errno = EACCES;
+      return -1;
+    }
+  return 0;
+}
+
+int
+MemoryFileSystem::Mkdir (std::string path, mode_t mode)
+{
+  NS_LOG_FUNCTION (this << path << mode);
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode != 0)
+    {
+      errno = EEXIST;
+      return -1;
+    }
+  // over a whiteout, the new directory hides the one of the base.
+  inode = NewInode (S_IFDIR | (mode & 07777));
+  inode->st.st_nlink = 1;
+  Link (parent, name, inode);
+  return 0;
+}
+
+int
+MemoryFileSystem::Rmdir (std::string path)
+{
+  NS_LOG_FUNCTION (this << path);
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  if (!S_ISDIR (inode->st.st_mode))
+    {
+      errno = ENOTDIR;
+      return -1;
+    }
+  if (parent == 0)
+    {
+      errno = EBUSY;
+      return -1;
+    }
+  if (!IsEmpty (inode))
+    {
+      errno = ENOTEMPTY;
+      return -1;
+    }
+  RemoveWhiteouts (inode);
+  Remove (inode->dentry);
+  return 0;
+}
+
+int
+MemoryFileSystem::Unlink (std::string path)
+{
+  NS_LOG_FUNCTION (this << path);
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  if (S_ISDIR (inode->st.st_mode))
+    {
+      errno = EISDIR;
+      return -1;
+    }
+  Remove (Find (parent, name));
+  return 0;
+}
+
+int
+MemoryFileSystem::Rename (std::string oldPath, std::string newPath)
+{
+  NS_LOG_FUNCTION (this << oldPath << newPath);
+  MemoryInode *oldParent;
+  MemoryInode *newParent;
+  MemoryInode *inode;
+  MemoryInode *target;
+  std::string oldName;
+  std::string newName;
+  if (Walk (oldPath, &oldParent, &oldName, &inode) == -1
+      || Walk (newPath, &newParent, &newName, &target) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  if (oldParent == 0 || newParent == 0)
+    {
+      errno = EBUSY;
+      return -1;
+    }
+  if (target == inode)
+    {
+      return 0;
+    }
+  if (S_ISDIR (inode->st.st_mode))
+    {
+      // a directory cannot be moved under itself.
+      for (MemoryInode *dir = newParent; dir->dentry != 0; dir = dir->dentry->parent)
+        {
+          if (dir == inode)
+            {
+              errno = EINVAL;
+              return -1;
+            }
+        }
+    }
+  if (target != 0)
+    {
+      if (S_ISDIR (inode->st.st_mode) && !S_ISDIR (target->st.st_mode))
+        {
+          errno = ENOTDIR;
+          return -1;
+        }
+      if (!S_ISDIR (inode->st.st_mode) && S_ISDIR (target->st.st_mode))
+        {
+          errno = EISDIR;
+          return -1;
+        }
+      if (S_ISDIR (target->st.st_mode))
+        {
+          if (!IsEmpty (target))
+            {
+              errno = ENOTEMPTY;
+              return -1;
+            }
+          RemoveWhiteouts (target);
+        }
+      Remove (Find (newParent, newName));
+    }
+  inode->refs++;
+  Remove (Find (oldParent, oldName));
+  Link (newParent, newName, inode);
+  Release (inode);
+  return 0;
+}
+
+ssize_t
+MemoryFileSystem::Readlink (std::string path, char *buf, size_t bufsize)
+{
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  // there is no symbolic link here.
+  errno = (inode == 0) ? ENOENT : EINVAL;
+  return -1;
+}
+
+int
+MemoryFileSystem::Utime (std::string path, const struct utimbuf *times)
+{
+  NS_LOG_FUNCTION (this << path << times);
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0)
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  Touch (inode);
+  if (times != 0)
+    {
+      inode->st.st_atim.tv_sec = times->actime;
+      inode->st.st_atim.tv_nsec = 0;
+      inode->st.st_mtim.tv_sec = times->modtime;
+      inode->st.st_mtim.tv_nsec = 0;
+    }
+  else
+    {
+      inode->st.st_atim = inode->st.st_mtim;
+    }
+  return 0;
+}
+
+int
+MemoryFileSystem::Append (std::string path, const void *buf, size_t count)
+{
+  MemoryInode *parent;
+  MemoryInode *inode;
+  std::string name;
+  if (Walk (path, &parent, &name, &inode) == -1)
+    {
+      return -1;
+    }
+  if (inode == 0 || S_ISDIR (inode->st.st_mode))
+    {
+      errno = (inode == 0) ? ENOENT : EISDIR;
+      return -1;
+    }
+  Write (inode, inode->st.st_size, buf, count);
+  return 0;
+}
+
+int
+MemoryFileSystem::Import (std::string hostPath, std::string path)
+{
+  NS_LOG_FUNCTION (this << hostPath << path);
+  if (Mkdir (path, 0755) == -1 && errno != EEXIST)
+    {
+      return -1;
+    }
+  ::DIR *dir = ::opendir (hostPath.c_str ());
+  if (dir == 0)
+    {
+      return -1;
+    }
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = ::readdir (dir)) != 0)
+    {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..")
+        {
+          continue;
+        }
+      std::string from = hostPath + "/" + name;
+      std::string to = path + "/" + name;
+      struct ::stat64 st;
+      if (::stat64 (from.c_str (), &st) == -1)
+        {
+          continue;
+        }
+      if (S_ISDIR (st.st_mode))
+        {
+          int n = Import (from, to);
+          count += (n > 0) ? n : 0;
+          continue;
+        }
+      if (!S_ISREG (st.st_mode))
+        {
+          continue;
+        }
+      int fd = ::open (from.c_str (), O_RDONLY);
+      if (fd == -1)
+        {
+          continue;
+        }
+      MemoryInode *parent;
+      MemoryInode *inode;
+      std::string leaf;
+      if (Walk (to, &parent, &leaf, &inode) == 0 && inode == 0)
+        {
+          inode = NewInode (S_IFREG | (st.st_mode & 07777));
+          Link (parent, leaf, inode);
+          uint8_t buffer[MEMORY_PAGE_SIZE];
+          ssize_t n;
+          while ((n = ::read (fd, buffer, sizeof (buffer))) > 0)
+            {
+              Write (inode, inode->st.st_size, buffer, n);
+            }
+          count++;
+        }
+      ::close (fd);
+    }
+  ::closedir (dir);
+  return count;
+}
+
+ssize_t
+MemoryFileSystem::Read (MemoryInode *inode, off64_t offset, void *buf, size_t count)
+{
+  if (offset >= inode->st.st_size)
+    {
+      return 0;
+    }
+  count = std::min ((off64_t)count, inode->st.st_size - offset);
+  size_t done = 0;
+  while (done < count)
+    {
+      off64_t position = offset + done;
+      size_t index = position / MEMORY_PAGE_SIZE;
+      size_t start = position % MEMORY_PAGE_SIZE;
+      size_t n = std::min (count - done, (size_t)(MEMORY_PAGE_SIZE - start));
+      std::map<uint64_t, MemoryPage *>::const_iterator i = inode->pages.find (index);
+      if (i != inode->pages.end ())
+        {
+          memcpy ((uint8_t *)buf + done, i->second->data + start, n);
+        }
+      else
+        {
+          memset ((uint8_t *)buf + done, 0, n);
+        }
+      done += n;
+    }
+  return count;
+}
+
+ssize_t
+MemoryFileSystem::Write (MemoryInode *inode, off64_t offset, const void *buf, size_t count)
+{
+  size_t done = 0;
+  while (done < count)
+    {
+      off64_t position = offset + done;
+      size_t index = position / MEMORY_PAGE_SIZE;
+      size_t start = position % MEMORY_PAGE_SIZE;
+      size_t n = std::min (count - done, (size_t)(MEMORY_PAGE_SIZE - start));
+      std::map<uint64_t, MemoryPage *>::iterator i = inode->pages.find (index);
+      MemoryPage *page = (i != inode->pages.end ()) ? i->second : 0;
+      if (page == 0 || page->refs > 1)
+        {
+          // a hole, or the first write to a shared page.
+          MemoryPage *copy = (MemoryPage *)malloc (sizeof (MemoryPage));
+          if (copy == 0)
+            {
+              break;
+            }
+          copy->refs = 1;
+          if (page != 0)
+            {
+              memcpy (copy->data, page->data, MEMORY_PAGE_SIZE);
+              PutPage (page);
+            }
+          else
+            {
+              memset (copy->data, 0, MEMORY_PAGE_SIZE);
+              inode->st.st_blocks += MEMORY_PAGE_SIZE / 512;
+            }
+          inode->pages[index] = page = copy;
+        }
+      memcpy (page->data + start, (const uint8_t *)buf + done, n);
+      done += n;
+    }
+  if (done == 0 && count > 0)
+    {
+      errno = ENOSPC;
+      return -1;
+    }
+  inode->st.st_size = std::max (inode->st.st_size, (off64_t)(offset + done));
+  Touch (inode);
+  return done;
+}
+
+void
+MemoryFileSystem::Truncate (MemoryInode *inode, off64_t length)
+{
+  uint64_t pages = (length + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+  std::map<uint64_t, MemoryPage *>::iterator i = inode->pages.lower_bound (pages);
+  while (i != inode->pages.end ())
+    {
+      inode->st.st_blocks -= MEMORY_PAGE_SIZE / 512;
+      PutPage (i->second);
+      inode->pages.erase (i++);
+    }
+  size_t tail = length % MEMORY_PAGE_SIZE;
+  if (tail != 0 && length < inode->st.st_size && inode->pages.count (pages - 1) != 0)
+    {
+      // the end of the last page must read as zeroes if the file grows again.
+      uint8_t zeroes[MEMORY_PAGE_SIZE - 1];
+      memset (zeroes, 0, sizeof (zeroes));
+      off64_t size = inode->st.st_size;
+      Write (inode, length, zeroes, MEMORY_PAGE_SIZE - tail);
+      inode->st.st_size = size;
+    }
+  inode->st.st_size = length;
+  Touch (inode);
+}
+
+const struct ::stat64 *
+MemoryFileSystem::GetStat (const MemoryInode *inode) const
+{
+  return &inode->st;
+}
+
+void
+MemoryFileSystem::List (const MemoryInode *dir, std::vector<DirEntry> *entries) const
+{
+  DirEntry entry;
+  entry.type = DT_DIR;
+  entry.name = ".";
+  entry.ino = dir->st.st_ino;
+  entries->push_back (entry);
+  entry.name = "..";
+  entry.ino = dir->dentry ? dir->dentry->parent->st.st_ino : dir->st.st_ino;
+  entries->push_back (entry);
+  for (MemoryDentry *d = dir->children; d != 0; d = d->next)
+    {
+      if (d->inode != 0)
+        {
+          entry.name = d->name;
+          entry.ino = d->inode->st.st_ino;
+          entry.type = IFTODT (d->inode->st.st_mode);
+          entries->push_back (entry);
+        }
+    }
+  if (dir->lower != 0)
+    {
+      for (MemoryDentry *d = dir->lower->children; d != 0; d = d->next)
+        {
+          if (d->inode != 0 && Find (dir, d->name) == 0)
+            {
+              entry.name = d->name;
+              entry.ino = d->inode->st.st_ino;
+              entry.type = IFTODT (d->inode->st.st_mode);
+              entries->push_back (entry);
+            }
+        }
+    }
+}
+
+} // namespace ns3
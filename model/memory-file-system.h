@@ -0,0 +1,98 @@
+#ifndef MEMORY_FILE_SYSTEM_H
+#define MEMORY_FILE_SYSTEM_H
+
+#include "file-system.h"
+#include <vector>
+#include <stdint.h>
+
+namespace ns3 {
+
+struct MemoryInode;
+struct MemoryDentry;
+struct MemoryPage;
+
+/**
+ * \brief tmpfs-like file system kept in memory
+ *
+ * The directory entries of the whole file system are indexed by a single
+ * hash table keyed by parent directory and name. The file data is kept in
+ * page-sized extents, indexed by their offset so a sparse file only holds
+ * the pages written. The pages are reference counted: a page shared by
+ * several files is copied when one of them first writes to it.
+ *
+ * If Base is set, this file system is an overlay of the Base image, which
+ * can be shared by any number of nodes and must not change while it is
+ * used. The entries of the base are copied in the overlay when they are
+ * first looked up, sharing their pages, and the entries removed from the
+ * overlay hide the ones of the base.
+ */
+class MemoryFileSystem : public FileSystem
+{
+public:
+  static TypeId GetTypeId (void);
+  MemoryFileSystem ();
+  virtual ~MemoryFileSystem ();
+
+  virtual UnixFd * Open (std::string path, int flags, mode_t mode);
+  virtual int Stat (std::string path, struct ::stat64 *buf, bool followLink);
+  virtual int Access (std::string path, int mode);
+  virtual int Mkdir (std::string path, mode_t mode);
+  virtual int Rmdir (std::string path);
+  virtual int Unlink (std::string path);
+  virtual int Rename (std::string oldPath, std::string newPath);
+  virtual ssize_t Readlink (std::string path, char *buf, size_t bufsize);
+  virtual int Utime (std::string path, const struct utimbuf *times);
+  virtual int Append (std::string path, const void *buf, size_t count);
+
+  /**
+   * Copy the regular files and directories of the host directory hostPath
+   * under path, typically to build a base image.
+   * \returns the number of files copied, -1 on error.
+   */
+  int Import (std::string hostPath, std::string path);
+
+  struct DirEntry
+  {
+    std::string name;
+    ino_t ino;
+    unsigned char type;
+  };
+
+  // Used by MemoryFileFd.
+  ssize_t Read (MemoryInode *inode, off64_t offset, void *buf, size_t count);
+  ssize_t Write (MemoryInode *inode, off64_t offset, const void *buf, size_t count);
+  void Truncate (MemoryInode *inode, off64_t length);
+  const struct ::stat64 * GetStat (const MemoryInode *inode) const;
+  void List (const MemoryInode *dir, std::vector<DirEntry> *entries) const;
+  void Hold (MemoryInode *inode);
+  void Release (MemoryInode *inode);
+
+private:
+  int Walk (std::string path, MemoryInode **parent, std::string *name,
+            MemoryInode **inode);
+  MemoryDentry * Find (const MemoryInode *dir, const std::string &name) const;
+  MemoryDentry * Lookup (MemoryInode *dir, const std::string &name);
+  // Link without changing the link counts and the times.
+  void Insert (MemoryInode *dir, const std::string &name, MemoryInode *inode);
+  void Link (MemoryInode *dir, const std::string &name, MemoryInode *inode);
+  void Remove (MemoryDentry *dentry);
+  void Unhash (MemoryDentry *dentry);
+  bool IsEmpty (const MemoryInode *dir) const;
+  void RemoveWhiteouts (MemoryInode *dir);
+  MemoryInode * NewInode (mode_t mode);
+  MemoryInode * CopyInode (const MemoryInode *inode);
+  void Touch (MemoryInode *inode);
+  void PutPage (MemoryPage *page);
+  void Rehash (void);
+  static uint32_t Hash (const MemoryInode *dir, const std::string &name);
+
+  std::vector<MemoryDentry *> m_buckets;
+  uint32_t m_dentries;
+  MemoryInode *m_root;
+  ino_t m_nextIno;
+  Ptr<MemoryFileSystem> m_base;
+};
+
+} // namespace ns3
+
+#endif /* MEMORY_FILE_SYSTEM_H */
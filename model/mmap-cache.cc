@@ -0,0 +1,561 @@
+#include "mmap-cache.h"
+#include "process.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+NS_LOG_COMPONENT_DEFINE ("MmapCache");
+
+// size of the reads done to hash and compare the files.
+#define CHUNK_SIZE (1 << 16)
+// a file changed this long after its hash might still have the same
+// ctime: coarser than the timestamps of any usual host file system.
+#define RACY_DELAY 1000000000LL
+// bounds of the snapshots kept open without mapping.
+#define RETIRED_SNAPSHOTS 32
+#define RETIRED_BYTES (256 << 20)
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1
+#endif
+
+namespace ns3 {
+
+struct MmapCache::Content
+{
+  int fd; // read-only, on the snapshot.
+  dev_t dev; // of the file the snapshot was made from.
+  ino_t ino;
+  off64_t size;
+  uint64_t hash;
+  uint32_t mappings; // entries of m_mappings using the snapshot.
+  bool retired; // in m_retired.
+  std::list<struct Content *>::iterator retiredPos;
+};
+
+static MmapCache *g_cache = 0;
+
+bool
+MmapCache::InodeKey::operator < (const InodeKey &o) const
+{
+  if (dev != o.dev)
+    {
+      return dev < o.dev;
+    }
+  if (ino != o.ino)
+    {
+      return ino < o.ino;
+    }
+  if (size != o.size)
+    {
+      return size < o.size;
+    }
+  if (mtime != o.mtime)
+    {
+      return mtime < o.mtime;
+    }
+  return ctime < o.ctime;
+}
+
+MmapCache *
+MmapCache::Get (void)
+{
+  if (g_cache == 0)
+    {
+      g_cache = new MmapCache ();
+    }
+  return g_cache;
+}
+
+MmapCache::MmapCache ()
+  : m_retiredBytes (0)
+{
+}
+
+MmapCache::InodeKey
+MmapCache::GetKey (const struct ::stat64 *st)
+{
+  InodeKey key;
+  key.dev = st->st_dev;
+  key.ino = st->st_ino;
+  key.size = st->st_size;
+  key.mtime = st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+  key.ctime = st->st_ctim.tv_sec * 1000000000LL + st->st_ctim.tv_nsec;
+  return key;
+}
+
+static int64_t
+HostTime (void)
+{
+  struct timespec now;
+  clock_gettime (CLOCK_REALTIME, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static uint32_t
+PageSize (void)
+{
+  static uint32_t pageSize = sysconf (_SC_PAGESIZE);
+  return pageSize;
+}
+
+static ssize_t
+ReadAt (int fd, uint8_t *buf, size_t count, off64_t offset)
+{
+  size_t done = 0;
+  while (done < count)
+    {
+      ssize_t ret = ::pread64 (fd, buf + done, count - done, offset + done);
+      if (ret == -1 && errno == EINTR)
+        {
+          continue;
+        }
+      if (ret <= 0)
+        {
+          return -1;
+        }
+      done += ret;
+    }
+  return done;
+}
+
+static bool
+WriteAt (int fd, const uint8_t *buf, size_t count, off64_t offset)
+{
+  size_t done = 0;
+  while (done < count)
+    {
+      ssize_t ret = ::pwrite64 (fd, buf + done, count - done, offset + done);
+      if (ret == -1 && errno == EINTR)
+        {
+          continue;
+        }
+      if (ret <= 0)
+        {
+          return false;
+        }
+      done += ret;
+    }
+  return true;
+}
+
+bool
+MmapCache::GetHash (int fd, off64_t size, uint64_t *hash)
+{
+  // FNV-1a on 64 bit words, collisions are caught by Equal.
+  uint64_t h = 14695981039346656037ULL;
+  std::vector<uint8_t> buf (CHUNK_SIZE);
+  for (off64_t offset = 0; offset < size; offset += CHUNK_SIZE)
+    {
+      size_t count = std::min ((off64_t)CHUNK_SIZE, size - offset);
+      if (ReadAt (fd, &buf[0], count, offset) == -1)
+        {
+          return false;
+        }
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+        {
+          uint64_t word;
+          memcpy (&word, &buf[i], 8);
+          h = (h ^ word) * 1099511628211ULL;
+        }
+      for (; i < count; i++)
+        {
+          h = (h ^ buf[i]) * 1099511628211ULL;
+        }
+    }
+  *hash = h;
+  return true;
+}
+
+bool
+MmapCache::Equal (int a, int b, off64_t size)
+{
+  std::vector<uint8_t> bufA (CHUNK_SIZE);
+  std::vector<uint8_t> bufB (CHUNK_SIZE);
+  for (off64_t offset = 0; offset < size; offset += CHUNK_SIZE)
+    {
+      size_t count = std::min ((off64_t)CHUNK_SIZE, size - offset);
+      if (ReadAt (a, &bufA[0], count, offset) == -1
+          || ReadAt (b, &bufB[0], count, offset) == -1
+          || memcmp (&bufA[0], &bufB[0], count) != 0)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+int
+MmapCache::Snapshot (int realFd, off64_t size)
+{
+  // an anonymous host file, in memory if possible.
+  int fd = -1;
+#ifdef __NR_memfd_create
+  fd = syscall (__NR_memfd_create, "dce-mmap-cache", MFD_CLOEXEC);
+#endif
+  if (fd == -1)
+    {
+      char path[] = "/tmp/dce-mmap-cache-XXXXXX";
+      fd = mkstemp (path);
+      if (fd == -1)
+        {
+          return -1;
+        }
+      unlink (path);
+    }
+  std::vector<uint8_t> buf (CHUNK_SIZE);
+  for (off64_t offset = 0; offset < size; offset += CHUNK_SIZE)
+    {
+      size_t count = std::min ((off64_t)CHUNK_SIZE, size - offset);
+      if (ReadAt (realFd, &buf[0], count, offset) == -1
+          || !WriteAt (fd, &buf[0], count, offset))
+        {
+          ::close (fd);
+          return -1;
+        }
+    }
+  // keep only a read-only fd: nobody can change the snapshot any more.
+  std::ostringstream oss;
+  oss << "/proc/self/fd/" << fd;
+  int readOnly = ::open (oss.str ().c_str (), O_RDONLY | O_CLOEXEC);
+  ::close (fd);
+  return readOnly;
+}
+
+void
+MmapCache::Drop (struct Content *content)
+{
+  NS_LOG_FUNCTION (this << content->fd);
+  Reuse (content);
+  std::map<InodeKey, struct Inode>::iterator i = m_inodes.begin ();
+  while (i != m_inodes.end ())
+    {
+      if (i->second.content == content)
+        {
+          m_inodes.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  std::multimap<std::pair<off64_t, uint64_t>, struct Content *>::iterator j;
+  for (j = m_contents.begin (); j != m_contents.end (); ++j)
+    {
+      if (j->second == content)
+        {
+          m_contents.erase (j);
+          break;
+        }
+    }
+  ::close (content->fd);
+  delete content;
+}
+
+void
+MmapCache::Retire (struct Content *content)
+{
+  NS_LOG_FUNCTION (this << content->fd);
+  NS_ASSERT (content->mappings == 0 && !content->retired);
+  m_retired.push_front (content);
+  content->retired = true;
+  content->retiredPos = m_retired.begin ();
+  m_retiredBytes += content->size;
+  while (m_retired.size () > RETIRED_SNAPSHOTS || m_retiredBytes > RETIRED_BYTES)
+    {
+      Drop (m_retired.back ());
+    }
+}
+
+void
+MmapCache::Reuse (struct Content *content)
+{
+  if (content->retired)
+    {
+      m_retired.erase (content->retiredPos);
+      content->retired = false;
+      m_retiredBytes -= content->size;
+    }
+}
+
+struct MmapCache::Content *
+MmapCache::Find (int realFd, off64_t size, uint64_t hash)
+{
+  std::pair<off64_t, uint64_t> contentKey = std::make_pair (size, hash);
+  std::multimap<std::pair<off64_t, uint64_t>, struct Content *>::iterator i = m_contents.lower_bound (contentKey);
+  for (; i != m_contents.end () && i->first == contentKey; ++i)
+    {
+      // the snapshots never change.
+      if (Equal (realFd, i->second->fd, size))
+        {
+          return i->second;
+        }
+    }
+  return 0;
+}
+
+struct MmapCache::Content *
+MmapCache::Lookup (int realFd, const struct ::stat64 *st)
+{
+  InodeKey key = GetKey (st);
+  std::map<InodeKey, struct Inode>::iterator i = m_inodes.find (key);
+  if (i != m_inodes.end () && key.ctime + RACY_DELAY < i->second.hashed)
+    {
+      // unchanged since its hash.
+      return i->second.content;
+    }
+  // before the hash, so that a write during the hash is seen as racy.
+  int64_t hashed = HostTime ();
+  uint64_t hash;
+  if (!GetHash (realFd, st->st_size, &hash))
+    {
+      return 0;
+    }
+  if (i != m_inodes.end ())
+    {
+      if (i->second.content->hash == hash)
+        {
+          i->second.hashed = hashed;
+          return i->second.content;
+        }
+      // changed in the same clock tick as the last hash.
+      m_inodes.erase (i);
+    }
+  struct Content *content = Find (realFd, st->st_size, hash);
+  if (content == 0)
+    {
+      // first copy of this content: the cache keeps its own snapshot so
+      // that the node writing to this copy later does not change the
+      // pages mapped by the others.
+      int fd = Snapshot (realFd, st->st_size);
+      if (fd == -1)
+        {
+          return 0;
+        }
+      content = new Content ();
+      content->fd = fd;
+      content->dev = st->st_dev;
+      content->ino = st->st_ino;
+      content->size = st->st_size;
+      content->hash = hash;
+      content->mappings = 0;
+      content->retired = false;
+      m_contents.insert (std::make_pair (std::make_pair (st->st_size, hash), content));
+    }
+  struct Inode inode;
+  inode.content = content;
+  inode.hashed = hashed;
+  m_inodes[key] = inode;
+  return content;
+}
+
+void
+MmapCache::Account (const struct Mapping &mapping, int64_t bytes)
+{
+  struct Stats *stats[2] = { &m_nodes[mapping.nodeId], 0 };
+  if (mapping.process != 0)
+    {
+      stats[1] = &m_processes[mapping.process];
+    }
+  for (uint32_t i = 0; i < 2 && stats[i] != 0; i++)
+    {
+      stats[i]->mapped += bytes;
+      stats[i]->peak = std::max (stats[i]->peak, stats[i]->mapped);
+      if (mapping.shared)
+        {
+          stats[i]->shared += bytes;
+        }
+    }
+}
+
+void *
+MmapCache::Map (Process *process, void *start, size_t length, int prot, int flags,
+                int realFd, off64_t offset)
+{
+  NS_LOG_FUNCTION (this << process << start << length << prot << flags << realFd << offset);
+  struct ::stat64 st;
+  if (::fstat64 (realFd, &st) == -1 || !S_ISREG (st.st_mode))
+    {
+      // devices and such are not counted.
+      return ::mmap64 (start, length, prot, flags, realFd, offset);
+    }
+  struct Content *content = 0;
+  // a shared mapping must stay coherent with the writes to the file.
+  if (process->shareFileMappings && (flags & MAP_PRIVATE) && st.st_size > 0)
+    {
+      content = Lookup (realFd, &st);
+    }
+  if (content != 0)
+    {
+      // it is pinned by its mapping from now on.
+      Reuse (content);
+    }
+  void *address = MAP_FAILED;
+  if (content != 0)
+    {
+      address = ::mmap64 (start, length, prot, flags, content->fd, offset);
+      if (address == MAP_FAILED)
+        {
+          // for example an executable mapping of a memfd refused by
+          // the host: map the file itself.
+          NS_LOG_DEBUG ("unable to map the snapshot: " << strerror (errno));
+          if (content->mappings == 0)
+            {
+              // never usable by the host.
+              Drop (content);
+            }
+          content = 0;
+        }
+    }
+  if (content == 0)
+    {
+      address = ::mmap64 (start, length, prot, flags, realFd, offset);
+    }
+  if (address == MAP_FAILED)
+    {
+      return address;
+    }
+  if (flags & MAP_FIXED)
+    {
+      // replaces whatever was there, which might be the last mapping of
+      // the same snapshot.
+      if (content != 0)
+        {
+          content->mappings++;
+        }
+      Unmap (address, length);
+      if (content != 0)
+        {
+          content->mappings--;
+        }
+    }
+  struct Mapping mapping;
+  mapping.length = (length + PageSize () - 1) & ~((size_t)PageSize () - 1);
+  mapping.nodeId = process->nodeId;
+  mapping.process = process;
+  mapping.content = content;
+  mapping.shared = content != 0
+    && (content->dev != st.st_dev || content->ino != st.st_ino);
+  AddMapping ((uintptr_t)address, mapping);
+  bool shared = mapping.shared;
+  NS_LOG_DEBUG ("mapped " << mapping.length << " bytes at " << address << (shared ? ", shared" : ""));
+  return address;
+}
+
+void
+MmapCache::Unmap (void *start, size_t length)
+{
+  uintptr_t begin = (uintptr_t)start;
+  uintptr_t end = begin + ((length + PageSize () - 1) & ~((size_t)PageSize () - 1));
+  std::map<uintptr_t, struct Mapping>::iterator i = m_mappings.lower_bound (begin);
+  if (i != m_mappings.begin ())
+    {
+      --i;
+    }
+  std::vector<std::pair<uintptr_t, struct Mapping> > pieces;
+  while (i != m_mappings.end () && i->first < end)
+    {
+      uintptr_t mapBegin = i->first;
+      uintptr_t mapEnd = mapBegin + i->second.length;
+      if (mapEnd <= begin)
+        {
+          ++i;
+          continue;
+        }
+      struct Mapping mapping = i->second;
+      uintptr_t from = std::max (mapBegin, begin);
+      uintptr_t to = std::min (mapEnd, end);
+      Account (mapping, -(int64_t)(to - from));
+      // what is left of the mapping on each side of the hole, counted
+      // before the mapping is removed so that its snapshot stays.
+      if (mapBegin < from)
+        {
+          mapping.length = from - mapBegin;
+          pieces.push_back (std::make_pair (mapBegin, mapping));
+        }
+      if (to < mapEnd)
+        {
+          mapping.length = mapEnd - to;
+          pieces.push_back (std::make_pair (to, mapping));
+        }
+      if (mapping.content != 0)
+        {
+          mapping.content->mappings += (mapBegin < from) + (to < mapEnd);
+        }
+      RemoveMapping (i++);
+    }
+  m_mappings.insert (pieces.begin (), pieces.end ());
+}
+
+void
+MmapCache::AddMapping (uintptr_t address, const struct Mapping &mapping)
+{
+  m_mappings[address] = mapping;
+  if (mapping.content != 0)
+    {
+      mapping.content->mappings++;
+    }
+  Account (mapping, mapping.length);
+}
+
+void
+MmapCache::RemoveMapping (std::map<uintptr_t, struct Mapping>::iterator i)
+{
+  struct Content *content = i->second.content;
+  m_mappings.erase (i);
+  if (content != 0)
+    {
+      content->mappings--;
+      if (content->mappings == 0)
+        {
+          // the next mapping of the same content needs no hash nor copy.
+          Retire (content);
+        }
+    }
+}
+
+struct MmapCache::Stats
+MmapCache::GetNodeStats (uint32_t nodeId) const
+{
+  std::map<uint32_t, struct Stats>::const_iterator i = m_nodes.find (nodeId);
+  if (i == m_nodes.end ())
+    {
+      struct Stats stats = { 0, 0, 0 };
+      return stats;
+    }
+  return i->second;
+}
+
+struct MmapCache::Stats
+MmapCache::Release (Process *process)
+{
+  struct Stats stats = { 0, 0, 0 };
+  std::map<Process *, struct Stats>::iterator i = m_processes.find (process);
+  if (i == m_processes.end ())
+    {
+      return stats;
+    }
+  stats = i->second;
+  m_processes.erase (i);
+  // the pages stay mapped for the node.
+  for (std::map<uintptr_t, struct Mapping>::iterator j = m_mappings.begin (); j != m_mappings.end (); ++j)
+    {
+      if (j->second.process == process)
+        {
+          j->second.process = 0;
+        }
+    }
+  return stats;
+}
+
+} // namespace ns3
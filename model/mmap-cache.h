@@ -0,0 +1,122 @@
+#ifndef MMAP_CACHE_H
+#define MMAP_CACHE_H
+
+#include <map>
+#include <list>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace ns3 {
+
+struct Process;
+
+/**
+ * \brief Share the file mappings of identical files between the nodes
+ *
+ * Each node has its own copy of the files, so mapping the same data file
+ * on N nodes used to take N times its size in the host page cache. The
+ * cache gives to all the copies of the same content a single snapshot,
+ * an immutable host file owned by the cache, found by hashing the content
+ * of the files and checked byte by byte. The MAP_PRIVATE mappings of any
+ * copy are mappings of the snapshot: the host shares their pages and
+ * copies them on write, and a node writing to its copy never changes what
+ * the other nodes mapped. The MAP_SHARED mappings are always mappings of
+ * the copy itself, so that they see the writes to the file and the file
+ * sees theirs. A snapshot stays open after its last mapping, for the next
+ * mapping of the same content, among a bounded number of the least
+ * recently unmapped ones.
+ *
+ * A file is hashed again when it might have changed since it was last
+ * hashed: its size, mtime or ctime changed, or its ctime is too recent to
+ * tell a write in the same clock tick.
+ *
+ * A private mapping of a copy does not see the writes done to this copy
+ * after the mapping was made, which POSIX leaves unspecified anyway.
+ *
+ * The snapshots are only used for the processes created with the
+ * DceManager attribute ShareFileMappings.
+ *
+ * The cache also counts the bytes mapped by each node and process, and
+ * how many of them are shared with an other copy of the file.
+ */
+class MmapCache
+{
+public:
+  struct Stats
+  {
+    uint64_t mapped; // bytes of files currently mapped.
+    uint64_t peak; // highest value of mapped.
+    uint64_t shared; // bytes of mapped which are pages of an other copy.
+  };
+
+  static MmapCache * Get (void);
+
+  /**
+   * Same as the mmap system call for the host fd realFd, but may map the
+   * canonical copy of the file instead if the process shares its file
+   * mappings.
+   */
+  void * Map (Process *process, void *start, size_t length, int prot, int flags,
+              int realFd, off64_t offset);
+  // Update the accounting after a munmap.
+  void Unmap (void *start, size_t length);
+
+  struct Stats GetNodeStats (uint32_t nodeId) const;
+  // Forget the mappings of an exiting process, returns its stats.
+  struct Stats Release (Process *process);
+
+private:
+  struct Content;
+  struct InodeKey
+  {
+    dev_t dev;
+    ino_t ino;
+    off64_t size;
+    int64_t mtime; // nanoseconds.
+    int64_t ctime; // nanoseconds.
+    bool operator < (const InodeKey &o) const;
+  };
+  struct Inode
+  {
+    struct Content *content;
+    int64_t hashed; // host time of the hash, nanoseconds.
+  };
+  struct Mapping
+  {
+    size_t length;
+    uint32_t nodeId;
+    Process *process; // 0 once the process is gone.
+    struct Content *content; // 0 if the file itself is mapped.
+    bool shared;
+  };
+
+  MmapCache ();
+  struct Content * Lookup (int realFd, const struct ::stat64 *st);
+  struct Content * Find (int realFd, off64_t size, uint64_t hash);
+  void Drop (struct Content *content);
+  // keep an unmapped snapshot, and close the oldest ones beyond the bound.
+  void Retire (struct Content *content);
+  // take a snapshot out of the retired ones.
+  void Reuse (struct Content *content);
+  void AddMapping (uintptr_t address, const struct Mapping &mapping);
+  void RemoveMapping (std::map<uintptr_t, struct Mapping>::iterator i);
+  static int Snapshot (int realFd, off64_t size);
+  void Account (const struct Mapping &mapping, int64_t bytes);
+  static bool GetHash (int fd, off64_t size, uint64_t *hash);
+  static bool Equal (int a, int b, off64_t size);
+  static InodeKey GetKey (const struct ::stat64 *st);
+
+  std::map<InodeKey, struct Inode> m_inodes;
+  std::multimap<std::pair<off64_t, uint64_t>, struct Content *> m_contents;
+  std::map<uintptr_t, struct Mapping> m_mappings;
+  std::map<uint32_t, struct Stats> m_nodes;
+  std::map<Process *, struct Stats> m_processes;
+  // the snapshots without mapping, the most recently unmapped first.
+  std::list<struct Content *> m_retired;
+  uint64_t m_retiredBytes;
+};
+
+} // namespace ns3
+
+#endif /* MMAP_CACHE_H */
@@ -25,10 +25,16 @@
 #include <poll.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
 
 NS_LOG_COMPONENT_DEFINE ("PipeFd");
 
 #define PIPE_CAPACITY 65536
+// Same limit as the default /proc/sys/fs/pipe-max-size.
+#define PIPE_MAX_CAPACITY (1 << 20)
 
 namespace ns3 {
 PipeFd::PipeFd () : m_peer (0),
@@ -98,7 +104,12 @@ PipeFd::DoRecvPacket (uint8_t* buf, size_t len)
 
   while (true)
     {
-      ssize_t r = m_buf.Write (buf, len);
+      ssize_t r = 0;
+      // writes of at most PIPE_BUF bytes are never interleaved with other writes.
+      if (len > PIPE_BUF || m_buf.GetSpace () >= (ssize_t)len)
+        {
+          r = m_buf.Write (buf, len);
+        }
       if (r > 0)
         {
           short pi = POLLIN;
@@ -142,6 +153,86 @@ PipeFd::DoRecvPacket (uint8_t* buf, size_t len)
     }
 }
 
+ssize_t
+PipeFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  if (m_readSide)
+    {
+      Current ()->err = EBADF;
+      return -1;
+    }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      count += iov[i].iov_len;
+    }
+  if (count <= PIPE_BUF)
+    {
+      // must not be interleaved with other writes: written as a whole.
+      uint8_t buf[PIPE_BUF];
+      uint8_t *bufp = buf;
+      for (int i = 0; i < iovcnt; i++)
+        {
+          memcpy (bufp, iov[i].iov_base, iov[i].iov_len);
+          bufp += iov[i].iov_len;
+        }
+      return Write (buf, count);
+    }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      const uint8_t *data = (const uint8_t *)iov[i].iov_base;
+      size_t left = iov[i].iov_len;
+      while (left > 0)
+        {
+          ssize_t room = WaitWritable (false);
+          if (room <= 0)
+            {
+              return total ? total : room;
+            }
+          size_t pushed = Push (data, left);
+          data += pushed;
+          left -= pushed;
+          total += pushed;
+        }
+    }
+  short po = POLLOUT;
+  WakeWaiters (&po);
+  return total;
+}
+
+ssize_t
+PipeFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  if (!m_readSide)
+    {
+      Current ()->err = EBADF;
+      return -1;
+    }
+  ssize_t available = WaitReadable (false);
+  if (available <= 0)
+    {
+      return available;
+    }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt && available > 0; i++)
+    {
+      ssize_t n = m_buf.Read ((uint8_t *)iov[i].iov_base,
+                              std::min (iov[i].iov_len, (size_t)available));
+      total += n;
+      available -= n;
+    }
+  short po = POLLOUT;
+  if (m_peer)
+    {
+      m_peer->WakeWaiters (&po);
+    }
+  WakeWaiters (&po);
+  return total;
+}
+
 ssize_t
 PipeFd::Read (void *buf, size_t count)
 {
@@ -384,6 +475,24 @@ PipeFd::Fcntl (int cmd, unsigned long arg)
       m_statusFlags = arg;
       return 0;
       break;
+#ifdef F_SETPIPE_SZ
+    case F_GETPIPE_SZ:
+    case F_SETPIPE_SZ:
+      {
+        // the data is kept by the read side.
+        PipeFd *reader = m_readSide ? this : m_peer;
+        if (reader == 0)
+          {
+            Current ()->err = EPIPE;
+            return -1;
+          }
+        if (cmd == F_SETPIPE_SZ)
+          {
+            return reader->SetCapacity (arg);
+          }
+        return reader->m_buf.GetCapacity ();
+      }
+#endif
     default:
       NS_FATAL_ERROR ("fcntl not implemented on pipe");
       return -1;
@@ -448,7 +557,8 @@ PipeFd::Poll (PollTable* ptable)
     }
   else
     {
-      if (m_peer && (m_peer->m_buf.GetSpace () > 0))
+      // like Linux, only when a write of PIPE_BUF bytes would not block.
+      if (m_peer && (m_peer->m_buf.GetSpace () >= PIPE_BUF))
         {
           ret |= POLLOUT;
         }
@@ -490,6 +600,175 @@ PipeFd::Poll (PollTable* ptable)
   return ret;
 }
 
+bool
+PipeFd::IsReadSide (void) const
+{
+  return m_readSide;
+}
+
+bool
+PipeFd::IsPeer (const PipeFd *other) const
+{
+  return m_peer == other;
+}
+
+int
+PipeFd::WaitEvent (short events)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << events);
+  NS_ASSERT (current != 0);
+
+  WaitQueueEntryTimeout *wq = new WaitQueueEntryTimeout (events, Time (0));
+  AddWaitQueue (wq, true);
+  PollTable::Result res = wq->Wait ();
+  RemoveWaitQueue (wq, true);
+  delete wq;
+
+  switch (res)
+    {
+    case PollTable::OK:
+      break;
+    case PollTable::INTERRUPTED:
+      {
+        UtilsDoSignal ();
+        current->err = EINTR;
+        return -1;
+      }
+    case PollTable::TIMEOUT:
+      {
+        current->err = EAGAIN;
+        return -1;
+      }
+    }
+  return 0;
+}
+
+ssize_t
+PipeFd::WaitReadable (bool nonBlocking)
+{
+  NS_LOG_FUNCTION (this << nonBlocking);
+  NS_ASSERT (m_readSide);
+  while (m_buf.GetSize () == 0)
+    {
+      if (0 == m_peer)
+        {
+          return 0;
+        }
+      if (nonBlocking || (m_statusFlags & O_NONBLOCK))
+        {
+          Current ()->err = EAGAIN;
+          return -1;
+        }
+      if (WaitEvent (POLLIN | POLLHUP) == -1)
+        {
+          return -1;
+        }
+    }
+  return m_buf.GetSize ();
+}
+
+ssize_t
+PipeFd::WaitWritable (bool nonBlocking)
+{
+  NS_LOG_FUNCTION (this << nonBlocking);
+  NS_ASSERT (!m_readSide);
+  while (true)
+    {
+      if (0 == m_peer)
+        {
+          UtilsSendSignal (Current ()->process, SIGPIPE);
+          UtilsDoSignal ();
+          Current ()->err = EPIPE;
+          return -1;
+        }
+      ssize_t room = m_peer->m_buf.GetSpace ();
+      if (room > 0)
+        {
+          return room;
+        }
+      if (nonBlocking || (m_statusFlags & O_NONBLOCK))
+        {
+          Current ()->err = EAGAIN;
+          return -1;
+        }
+      // the writers wait on the read side, see DoRecvPacket.
+      if (m_peer->WaitEvent (POLLOUT | POLLHUP) == -1)
+        {
+          return -1;
+        }
+    }
+}
+
+size_t
+PipeFd::Peek (uint8_t *buf, size_t len)
+{
+  NS_ASSERT (m_readSide);
+  return m_buf.Peek (buf, len);
+}
+
+void
+PipeFd::Consume (size_t len)
+{
+  NS_LOG_FUNCTION (this << len);
+  NS_ASSERT (m_readSide);
+  m_buf.Discard (len);
+  short po = POLLOUT;
+  if (m_peer)
+    {
+      m_peer->WakeWaiters (&po);
+    }
+  WakeWaiters (&po);
+}
+
+const uint8_t *
+PipeFd::PeekSegment (size_t offset, size_t *len) const
+{
+  NS_ASSERT (m_readSide);
+  return m_buf.PeekSegment (offset, len);
+}
+
+size_t
+PipeFd::Push (const uint8_t *buf, size_t len)
+{
+  NS_LOG_FUNCTION (this << len);
+  NS_ASSERT (!m_readSide && m_peer != 0);
+  ssize_t r = m_peer->m_buf.Write (buf, len);
+  if (r <= 0)
+    {
+      return 0;
+    }
+  short pi = POLLIN;
+  m_peer->WakeWaiters (&pi);
+  return r;
+}
+
+int
+PipeFd::SetCapacity (size_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+  NS_ASSERT (m_readSide);
+  if (capacity > PIPE_MAX_CAPACITY)
+    {
+      Current ()->err = EPERM;
+      return -1;
+    }
+  // at least one page, like Linux.
+  capacity = std::max (capacity, (size_t)sysconf (_SC_PAGESIZE));
+  if (!m_buf.SetCapacity (capacity))
+    {
+      Current ()->err = EBUSY;
+      return -1;
+    }
+  short po = POLLOUT;
+  if (m_peer)
+    {
+      m_peer->WakeWaiters (&po);
+    }
+  WakeWaiters (&po);
+  return m_buf.GetCapacity ();
+}
+
 int
 PipeFd::Fsync (void)
 {
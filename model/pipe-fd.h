@@ -46,6 +46,9 @@ public:
   virtual int Close (void);
   virtual ssize_t Write (const void *buf, size_t count);
   virtual ssize_t Read (void *buf, size_t count);
+  // straight between the buffers and the pipe, in a single wait.
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
   virtual ssize_t Recvmsg (struct msghdr *msg, int flags);
   virtual ssize_t Sendmsg (const struct msghdr *msg, int flags);
   virtual int Setsockopt (int level, int optname,
@@ -78,8 +81,30 @@ public:
   virtual int Poll (PollTable* ptable);
   virtual int Fsync (void);
 
+  // Used by splice and tee which move the data without Read and Write.
+  bool IsReadSide (void) const;
+  bool IsPeer (const PipeFd *other) const;
+  // Read side: wait for data, returns the number of bytes in the pipe,
+  // 0 if the write side is closed.
+  ssize_t WaitReadable (bool nonBlocking);
+  // Write side: wait for room in the pipe, returns the room available.
+  ssize_t WaitWritable (bool nonBlocking);
+  // Read side: copy data without removing it from the pipe.
+  size_t Peek (uint8_t *buf, size_t len);
+  // Read side: remove data from the pipe and wake up the writers.
+  void Consume (size_t len);
+  // Read side: contiguous data at offset from the head of the pipe, valid
+  // until consumed.
+  const uint8_t * PeekSegment (size_t offset, size_t *len) const;
+  // Write side: copy at most len bytes in the pipe without blocking and
+  // wake up the readers, returns the number of bytes copied.
+  size_t Push (const uint8_t *buf, size_t len);
+
 private:
   ssize_t DoRecvPacket (uint8_t* buf, size_t len);
+  // returns 0 when one of the events happened, -1 with errno set.
+  int WaitEvent (short events);
+  int SetCapacity (size_t capacity);
 
   PipeFd* m_peer;
   bool m_readSide;
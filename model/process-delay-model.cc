@@ -21,8 +21,18 @@
 #include "ns3/log.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
 #include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include <time.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <algorithm>
 
 namespace ns3 {
 
@@ -38,6 +48,15 @@ ProcessDelayModel::GetTypeId (void)
   return tid;
 }
 
+void
+ProcessDelayModel::RecordResume (void)
+{
+}
+void
+ProcessDelayModel::RecordSuspend (void)
+{
+}
+
 NS_OBJECT_ENSURE_REGISTERED (RandomProcessDelayModel);
 
 TypeId
@@ -119,5 +138,195 @@ TimeOfDayProcessDelayModel::RecordEnd (void)
   return delay;
 }
 
+NS_OBJECT_ENSURE_REGISTERED (CpuTimeProcessDelayModel);
+
+// the instruction counter of each host thread, plus one, closed when the
+// thread exits.
+static pthread_key_t g_counterKey;
+static pthread_once_t g_counterOnce = PTHREAD_ONCE_INIT;
+
+static void
+CloseCounter (void *value)
+{
+  close ((intptr_t)value - 1);
+}
+
+static void
+CreateCounterKey (void)
+{
+  pthread_key_create (&g_counterKey, &CloseCounter);
+}
+
+// -1 if the host has no instruction counter.
+static int
+GetThreadCounter (void)
+{
+  pthread_once (&g_counterOnce, &CreateCounterKey);
+  intptr_t value = (intptr_t)pthread_getspecific (g_counterKey);
+  if (value != 0)
+    {
+      return value - 1;
+    }
+  struct perf_event_attr attr;
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof (attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // only the calling thread: not the log writer or any other host thread.
+  attr.inherit = 0;
+  int fd = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd != -1)
+    {
+      pthread_setspecific (g_counterKey, (void *)(intptr_t)(fd + 1));
+    }
+  return fd;
+}
+
+TypeId
+CpuTimeProcessDelayModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CpuTimeProcessDelayModel")
+    .SetParent<ProcessDelayModel> ()
+    .AddConstructor<CpuTimeProcessDelayModel> ()
+    .AddAttribute ("InstructionsPerSecond",
+                   "The speed of the simulated cpu when the Clock is Instructions.",
+                   DoubleValue (1e9),
+                   MakeDoubleAccessor (&CpuTimeProcessDelayModel::m_instructionsPerSecond),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("Clock",
+                   "What is measured while a task runs: the cpu time of the host thread "
+                   "or the number of user-space instructions it retired (from a hardware "
+                   "counter, falls back to ThreadCpuTime if the counter is not available).",
+                   EnumValue (THREAD_CPU_TIME),
+                   MakeEnumAccessor (&CpuTimeProcessDelayModel::SetClock,
+                                     &CpuTimeProcessDelayModel::GetClock),
+                   MakeEnumChecker (THREAD_CPU_TIME, "ThreadCpuTime",
+                                    INSTRUCTIONS, "Instructions"))
+  ;
+  return tid;
+}
+
+CpuTimeProcessDelayModel::CpuTimeProcessDelayModel ()
+  : m_clock (THREAD_CPU_TIME),
+    m_instructionsPerSecond (1e9),
+    m_start (0),
+    m_accumulated (0),
+    m_readCost (0),
+    m_thread (pthread_self ())
+{
+  Calibrate ();
+}
+
+CpuTimeProcessDelayModel::~CpuTimeProcessDelayModel ()
+{
+}
+
+void
+CpuTimeProcessDelayModel::SetClock (enum Clock clock)
+{
+  NS_LOG_FUNCTION (this << clock);
+  if (clock == INSTRUCTIONS && GetThreadCounter () == -1)
+    {
+      NS_LOG_WARN ("no instruction counter (" << strerror (errno) << "), use the thread cpu time");
+      clock = THREAD_CPU_TIME;
+    }
+  m_clock = clock;
+  Calibrate ();
+}
+
+enum CpuTimeProcessDelayModel::Clock
+CpuTimeProcessDelayModel::GetClock (void) const
+{
+  return m_clock;
+}
+
+uint64_t
+CpuTimeProcessDelayModel::Read (void) const
+{
+  if (m_clock == INSTRUCTIONS)
+    {
+      uint64_t count = 0;
+      int fd = GetThreadCounter ();
+      if (fd == -1 || read (fd, &count, sizeof (count)) != sizeof (count))
+        {
+          return 0;
+        }
+      return count;
+    }
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ((uint64_t)ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void
+CpuTimeProcessDelayModel::Calibrate (void)
+{
+  // the part of a Read which ends up in the measured interval: keep the
+  // smallest difference between two successive reads.
+  m_readCost = ~((uint64_t)0);
+  for (uint32_t i = 0; i < 64; i++)
+    {
+      uint64_t a = Read ();
+      uint64_t b = Read ();
+      m_readCost = std::min (m_readCost, b - a);
+    }
+  NS_LOG_DEBUG ("read cost " << m_readCost);
+}
+
+void
+CpuTimeProcessDelayModel::Accumulate (void)
+{
+  if (!pthread_equal (m_thread, pthread_self ()))
+    {
+      NS_LOG_WARN ("task switched in by another thread: its time is lost");
+      return;
+    }
+  uint64_t end = Read ();
+  uint64_t delta = end - m_start;
+  if (end < m_start || delta < m_readCost)
+    {
+      return;
+    }
+  m_accumulated += delta - m_readCost;
+}
+
+void
+CpuTimeProcessDelayModel::RecordStart (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_accumulated = 0;
+  m_thread = pthread_self ();
+  m_start = Read ();
+}
+
+void
+CpuTimeProcessDelayModel::RecordResume (void)
+{
+  // forget the cost of the switch and of the work done on main.
+  m_thread = pthread_self ();
+  m_start = Read ();
+}
+
+void
+CpuTimeProcessDelayModel::RecordSuspend (void)
+{
+  Accumulate ();
+}
+
+Time
+CpuTimeProcessDelayModel::RecordEnd (void)
+{
+  NS_LOG_FUNCTION (this);
+  Accumulate ();
+  uint64_t accumulated = m_accumulated;
+  m_accumulated = 0;
+  if (m_clock == INSTRUCTIONS)
+    {
+      return Seconds (accumulated / m_instructionsPerSecond);
+    }
+  return NanoSeconds (accumulated);
+}
 
 } // namespace ns3
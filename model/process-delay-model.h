@@ -23,6 +23,7 @@
 #include "ns3/object.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/nstime.h"
+#include <pthread.h>
 
 namespace ns3 {
 
@@ -31,8 +32,18 @@ class ProcessDelayModel : public Object
 public:
   static TypeId GetTypeId (void);
 
+  // called on the main fiber before switching to the task.
   virtual void RecordStart (void) = 0;
+  // called by the task before switching back to the main fiber.
   virtual Time RecordEnd (void) = 0;
+  /**
+   * Called by the task when it is switched in, and when it temporarily
+   * leaves to execute something on the main fiber, so that a model
+   * can exclude the work done by DCE itself from the delay. The default
+   * implementation does nothing.
+   */
+  virtual void RecordResume (void);
+  virtual void RecordSuspend (void);
 };
 
 class RandomProcessDelayModel : public ProcessDelayModel
@@ -65,6 +76,50 @@ private:
   Time m_start;
 };
 
+/**
+ * The delay is the CPU time used by the task (as opposed to the wall
+ * clock time used by the TimeOfDayProcessDelayModel) or the number of
+ * instructions it retired, converted to a time by InstructionsPerSecond.
+ * Only the time between the switch into the task and the switch out of
+ * it is measured, minus the cost of reading the clock.
+ *
+ * Both clocks belong to the host thread running the task, so the other
+ * host threads, such as the writer of the BufferedLogWriter, are never
+ * counted. With the PthreadFiberManager each task reads the clock of its
+ * own thread, from the moment it is resumed.
+ */
+class CpuTimeProcessDelayModel : public ProcessDelayModel
+{
+public:
+  enum Clock
+  {
+    THREAD_CPU_TIME,
+    INSTRUCTIONS
+  };
+  static TypeId GetTypeId (void);
+
+  CpuTimeProcessDelayModel ();
+  virtual ~CpuTimeProcessDelayModel ();
+
+  virtual void RecordStart (void);
+  virtual Time RecordEnd (void);
+  virtual void RecordResume (void);
+  virtual void RecordSuspend (void);
+private:
+  void SetClock (enum Clock clock);
+  enum Clock GetClock (void) const;
+  uint64_t Read (void) const;
+  void Calibrate (void);
+  void Accumulate (void);
+
+  enum Clock m_clock;
+  double m_instructionsPerSecond;
+  uint64_t m_start; // nanoseconds or instructions.
+  uint64_t m_accumulated;
+  uint64_t m_readCost; // measured by Calibrate.
+  pthread_t m_thread; // the thread which read m_start.
+};
+
 } // namespace ns3
 
 #endif /* PROCESS_DELAY_MODEL_H */
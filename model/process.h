@@ -31,6 +31,7 @@
 #include "ns3/event-id.h"
 #include "ns3/nstime.h"
 #include "unix-fd.h"
+#include "fd-table.h"
 #include "ns3/random-variable-stream.h"
 
 class KingsleyAlloc;
@@ -50,6 +51,7 @@ class Loader;
 class Task;
 class FileUsage;
 class PollTable;
+struct PollContext;
 
 struct Mutex
 {
@@ -124,6 +126,12 @@ struct ProcessActivity
   std::string cmdLine;
 };
 
+struct ThreadStackUsage
+{
+  uint32_t size; // allocated stack size.
+  uint32_t peak; // peak number of bytes used.
+};
+
 struct Process
 {
   uid_t euid;
@@ -138,7 +146,7 @@ struct Process
   std::string name;
   std::string stdinFilename;
   // Key is the fd
-  std::map<int,FileUsage *> openFiles;
+  FdTable openFiles;
   std::vector<FILE *> openStreams;
   std::vector<DIR *> openDirs;
   std::vector<SignalHandler> signalHandlers;
@@ -182,6 +190,8 @@ struct Process
   char asctime_result[ 3 + 1 + 3 + 1 + 20 + 1 + 20 + 1 + 20 + 1 + 20 + 1 + 20 + 1 + 1]; // definition is stolen from glibc
   uint32_t nodeId; // NS3 NODE ID
   uint8_t minimizeFiles; // If true close stderr and stdout between writes .
+  uint8_t hostIoRing; // If true the host file I/O is batched by the HostIoRing.
+  uint8_t shareFileMappings; // If true the private file mappings go through the MmapCache.
   // an array of memory buffers which must be freed upon process
   // termination to avoid memory leaks. We stick in there a bunch
   // of buffers we allocate but for which we cannot control the
@@ -194,6 +204,8 @@ struct Process
   // Current umask
   mode_t uMask;
   struct ProcessActivity timing;
+  // stack usage of the threads, by tid, recorded when they end.
+  std::map<uint16_t, struct ThreadStackUsage> stackUsage;
 };
 
 struct ThreadKeyValue
@@ -224,6 +236,7 @@ struct Thread
   Time lastTime; // Last time of a possible infinite loop checkpoint.
   Waiter *childWaiter; // Not zero if thread waiting for a child in wait or waitall ...
   PollTable *pollTable; // No 0 if a poll is running on this thread
+  PollContext *pollContext; // reused by the poll calls of this thread, 0 before the first one.
   std::pair <UnixFd*, WaitQueueEntry*> ioWait;   // Filled if the current thread is currently waiting for IO
 };
 
@@ -194,6 +194,7 @@ PthreadFiberManager::Clone (struct Fiber *fib)
   clone->stack_bounds = clone->thread->stack_bounds;
   clone->stack_bounds.AddBound (__builtin_frame_address (0));
   clone->stack_bounds.AddBound (SelfStackBottom ());
+  clone->stack_peak = std::max (fiber->stack_peak, clone->stack_bounds.GetSize ());
 
   clone->stack_copy = malloc (fiber->thread->stack_size);
   // save current stack so that the next call to SwitchTo
@@ -302,6 +303,7 @@ PthreadFiberManager::Yield (struct PthreadFiber *fiber)
           fiber->stack_bounds = fiber->thread->stack_bounds;
           fiber->stack_bounds.AddBound (__builtin_frame_address (0));
           fiber->stack_bounds.AddBound (SelfStackBottom ());
+          fiber->stack_peak = std::max (fiber->stack_peak, fiber->stack_bounds.GetSize ());
           if (setjmp (fiber->yield_env) == 0)
             {
               // force the thread variable to be stored on the stack.
@@ -372,6 +374,7 @@ PthreadFiberManager::CreateFromCaller (void)
   fiber->thread = thread;
   fiber->state = RUNNING;
   fiber->stack_copy = 0;
+  fiber->stack_peak = 0;
   return fiber;
 }
 void
@@ -439,6 +442,12 @@ PthreadFiberManager::GetStackSize (struct Fiber *fib) const
   struct PthreadFiber *fiber = (struct PthreadFiber *)fib;
   return fiber->thread->stack_size;
 }
+uint32_t
+PthreadFiberManager::GetStackUsage (struct Fiber *fib) const
+{
+  struct PthreadFiber *fiber = (struct PthreadFiber *)fib;
+  return fiber->stack_peak;
+}
 void
 PthreadFiberManager::SetSwitchNotification (void (*fn)(void))
 {
@@ -61,6 +61,7 @@ struct PthreadFiber : public Fiber
   jmp_buf yield_env;
   size_t yield_stack_size;
   MemoryBounds stack_bounds;
+  size_t stack_peak; // largest stack_bounds seen at a yield.
 };
 
 struct PthreadFiberThread
@@ -95,6 +96,7 @@ public:
   virtual void SwitchTo (struct Fiber *from,
                          const struct Fiber *to);
   virtual uint32_t GetStackSize (struct Fiber *fiber) const;
+  virtual uint32_t GetStackUsage (struct Fiber *fiber) const;
   virtual void SetSwitchNotification (void (*fn)(void));
 private:
   static void * Run (void *arg);
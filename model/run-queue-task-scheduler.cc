@@ -0,0 +1,113 @@
+/* -*-	Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#include "run-queue-task-scheduler.h"
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+
+NS_LOG_COMPONENT_DEFINE ("RunQueueTaskScheduler");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (RunQueueTaskScheduler);
+
+TypeId
+RunQueueTaskScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RunQueueTaskScheduler")
+    .SetParent<TaskScheduler> ()
+    .AddConstructor<RunQueueTaskScheduler> ()
+    .AddAttribute ("UsePriorities",
+                   "If true, the tasks of higher priority (e.g. kernel tasks) run before "
+                   "the others, else all the tasks share a single round robin queue.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&RunQueueTaskScheduler::m_usePriorities),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+RunQueueTaskScheduler::RunQueueTaskScheduler ()
+  : m_usePriorities (true)
+{
+  for (int i = 0; i < Task::PRIORITY_COUNT; i++)
+    {
+      m_queues[i].head = 0;
+      m_queues[i].tail = 0;
+    }
+}
+
+struct Task *
+RunQueueTaskScheduler::PeekNext (void)
+{
+  for (int i = 0; i < Task::PRIORITY_COUNT; i++)
+    {
+      if (m_queues[i].head != 0)
+        {
+          NS_LOG_DEBUG ("next=" << m_queues[i].head);
+          return m_queues[i].head;
+        }
+    }
+  return 0;
+}
+void
+RunQueueTaskScheduler::DequeueNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  Task *task = PeekNext ();
+  NS_ASSERT (task != 0);
+  Unlink (task);
+}
+void
+RunQueueTaskScheduler::Enqueue (struct Task *task)
+{
+  NS_LOG_FUNCTION (this << task);
+  NS_ASSERT_MSG (task->m_runLink.queue == -1, "task " << task << " already queued");
+  int queue = m_usePriorities ? task->GetPriority () : Task::NORMAL_PRIORITY;
+  struct RunQueue *q = &m_queues[queue];
+  task->m_runLink.queue = queue;
+  task->m_runLink.next = 0;
+  task->m_runLink.prev = q->tail;
+  if (q->tail != 0)
+    {
+      q->tail->m_runLink.next = task;
+    }
+  else
+    {
+      q->head = task;
+    }
+  q->tail = task;
+}
+void
+RunQueueTaskScheduler::Dequeue (struct Task *task)
+{
+  NS_LOG_FUNCTION (this << task);
+  if (task->m_runLink.queue == -1)
+    {
+      return;
+    }
+  Unlink (task);
+}
+void
+RunQueueTaskScheduler::Unlink (struct Task *task)
+{
+  struct RunQueue *q = &m_queues[task->m_runLink.queue];
+  if (task->m_runLink.prev != 0)
+    {
+      task->m_runLink.prev->m_runLink.next = task->m_runLink.next;
+    }
+  else
+    {
+      q->head = task->m_runLink.next;
+    }
+  if (task->m_runLink.next != 0)
+    {
+      task->m_runLink.next->m_runLink.prev = task->m_runLink.prev;
+    }
+  else
+    {
+      q->tail = task->m_runLink.prev;
+    }
+  task->m_runLink.prev = 0;
+  task->m_runLink.next = 0;
+  task->m_runLink.queue = -1;
+}
+
+} // namespace ns3
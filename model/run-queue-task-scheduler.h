@@ -0,0 +1,41 @@
+/* -*-	Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef RUN_QUEUE_TASK_SCHEDULER_H
+#define RUN_QUEUE_TASK_SCHEDULER_H
+
+#include "task-scheduler.h"
+#include "task-manager.h"
+
+namespace ns3 {
+
+/**
+ * \brief Round Robin scheduler with one run queue per Task::Priority
+ *
+ * The queues are linked through the Task::m_runLink of the tasks: no
+ * allocation on Enqueue and every operation is O(1). The tasks of a
+ * queue run only when all the queues of higher priority are empty.
+ */
+class RunQueueTaskScheduler : public TaskScheduler
+{
+public:
+  static TypeId GetTypeId (void);
+  RunQueueTaskScheduler ();
+
+  virtual Task * PeekNext (void);
+  virtual void DequeueNext (void);
+  virtual void Enqueue (Task *task);
+  virtual void Dequeue (Task *task);
+private:
+  struct RunQueue
+  {
+    Task *head;
+    Task *tail;
+  };
+  void Unlink (Task *task);
+
+  struct RunQueue m_queues[Task::PRIORITY_COUNT];
+  bool m_usePriorities;
+};
+
+} // namespace ns3
+
+#endif /* RUN_QUEUE_TASK_SCHEDULER_H */
@@ -18,6 +18,8 @@ ssize_t dce_recv (int fd, void *buf, size_t count, int flags);
 ssize_t dce_recvfrom (int s, void *buf, size_t len, int flags,
                       struct sockaddr *from, socklen_t *fromlen);
 ssize_t dce_recvmsg (int s, struct msghdr *msg, int flags);
+int dce_recvmmsg (int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                  struct timespec *timeout);
 int dce_setsockopt (int s, int level, int optname,
                     const void *optval, socklen_t optlen);
 int dce_getsockopt (int s, int level, int optname,
@@ -26,6 +28,7 @@ ssize_t dce_send (int s, const void *buf, size_t len, int flags);
 ssize_t dce_sendto (int s, const void *buf, size_t len, int flags,
                     const struct sockaddr *to, socklen_t tolen);
 ssize_t dce_sendmsg (int s, const struct msghdr *msg, int flags);
+int dce_sendmmsg (int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
 int dce_getsockname (int s, struct sockaddr *name, socklen_t *namelen);
 int dce_getpeername (int s, struct sockaddr *name, socklen_t *namelen);
 int dce_socketpair (int domain, int type, int protocol, int sv[2]);
@@ -2,9 +2,11 @@
 #include "fiber-manager.h"
 #include "ucontext-fiber-manager.h"
 #include "pthread-fiber-manager.h"
+#include "asm-fiber-manager.h"
 #include "task-scheduler.h"
 #include "ns3/log.h"
 #include "ns3/uinteger.h"
+#include "ns3/boolean.h"
 #include "ns3/enum.h"
 #include "ns3/simulator.h"
 #include "ns3/node.h"
@@ -71,6 +73,33 @@ Task::SetSwitchNotifier (void (*fn)(enum SwitchType, void *), void *context)
   m_switchNotifierContext = context;
 }
 
+Task::Task ()
+  : m_fiber (0),
+    m_state (RUNNING),
+    m_context (0),
+    m_extraContext (0),
+    m_switchNotifier (0),
+    m_switchNotifierContext (0),
+    m_priority (NORMAL_PRIORITY)
+{
+  m_runLink.prev = 0;
+  m_runLink.next = 0;
+  m_runLink.queue = -1;
+  TimerWheel::InitEntry (&m_waitEntry, this);
+}
+
+void
+Task::SetPriority (enum Priority priority)
+{
+  m_priority = priority;
+}
+
+enum Task::Priority
+Task::GetPriority (void) const
+{
+  return m_priority;
+}
+
 Task::~Task ()
 {
 }
@@ -87,6 +116,15 @@ TaskManager::GetTypeId (void)
                    UintegerValue (8192),
                    MakeUintegerAccessor (&TaskManager::m_defaultStackSize),
                    MakeUintegerChecker<uint32_t> (4096))
+    // must be registered before FiberManagerType to be set when the
+    // fiber manager is constructed.
+    .AddAttribute ("FiberSaveSignalMask",
+                   "If true, the AsmFiberManager saves and restores the host signal mask "
+                   "of each fiber at each switch, like swapcontext does.",
+                   TypeId::ATTR_CONSTRUCT,
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TaskManager::m_fiberSaveSignalMask),
+                   MakeBooleanChecker ())
     .AddAttribute ("FiberManagerType",
                    "The type of FiberManager implementation to use to allocate, "
                    "deallocate and switch among fibers.",
@@ -94,7 +132,32 @@ TaskManager::GetTypeId (void)
                    EnumValue (PTHREAD_FIBER_MANAGER),
                    MakeEnumAccessor (&TaskManager::SetFiberManagerType),
                    MakeEnumChecker (PTHREAD_FIBER_MANAGER, "PthreadFiberManager",
-                                    UCONTEXT_FIBER_MANAGER, "UcontextFiberManager"))
+                                    UCONTEXT_FIBER_MANAGER, "UcontextFiberManager",
+                                    ASM_FIBER_MANAGER, "AsmFiberManager"))
+    .AddAttribute ("StackPoolHighWaterMark",
+                   "The maximum number of free stacks of each size kept for reuse by the "
+                   "UcontextFiberManager and the AsmFiberManager instead of being unmapped. "
+                   "This pool is shared by all the task managers.",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&TaskManager::SetStackPoolHighWaterMark,
+                                         &TaskManager::GetStackPoolHighWaterMark),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StackSentinel",
+                   "If true, the stacks of the UcontextFiberManager and the AsmFiberManager "
+                   "are filled with a pattern when created to measure exactly how much of "
+                   "them each task uses, at the cost of committing them in memory. Otherwise "
+                   "the usage is sampled at each context switch.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TaskManager::SetStackSentinel,
+                                        &TaskManager::GetStackSentinel),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SleepTimerGranularity",
+                   "The timeouts of the sleeping tasks are rounded up to a multiple of this "
+                   "duration so that all the tasks which wake up in the same interval are "
+                   "woken by a single simulator event. Must not be changed once tasks sleep.",
+                   TimeValue (TimeStep (1)),
+                   MakeTimeAccessor (&TaskManager::m_sleepGranularity),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
@@ -103,7 +166,10 @@ TaskManager::TaskManager ()
   : m_current (0),
     m_scheduler (0),
     m_fiberManager (0),
+    m_fiberSaveSignalMask (false),
     m_reSchedule (0),
+    m_sleepersEventTick (0),
+    m_sleepersChanged (false),
     m_disposing (0),
     m_todoOnMain (0),
     m_noSignal (0),
@@ -130,6 +196,7 @@ void TaskManager::DoDispose (void)
       return;
     }
   m_disposing = 1;
+  m_sleepersEvent.Cancel ();
 
   // Flush every FILEs in every processes.
   Ptr<DceManager> dceManager = this->GetObject<DceManager> ();
@@ -176,7 +243,7 @@ TaskManager::GarbageCollectDeadTasks (void)
         {
           m_fiberManager->Delete (task->m_fiber);
         }
-      task->m_waitTimer.Cancel ();
+      m_sleepers.Remove (&task->m_waitEntry);
       task->m_fiber = 0;
       delete task;
     }
@@ -227,11 +294,18 @@ static void SwitchNotifEatSignal (void)
 Task *
 TaskManager::Start (void (*fn)(void*), void *context, uint32_t stackSize)
 {
-  NS_LOG_FUNCTION (this << fn << context << stackSize);
+  return Start (fn, context, stackSize, Task::NORMAL_PRIORITY);
+}
+Task *
+TaskManager::Start (void (*fn)(void*), void *context, uint32_t stackSize,
+                    enum Task::Priority priority)
+{
+  NS_LOG_FUNCTION (this << fn << context << stackSize << priority);
   Task *task = new Task ();
   struct StartTaskContext *ctx = new StartTaskContext ();
   ctx->function = fn;
   ctx->context = context;
+  ctx->manager = this;
   task->m_fiber = m_fiberManager->Create (&TaskManager::Trampoline, ctx, stackSize);
   NS_LOG_DEBUG ("create " << task << " fiber=" << task->m_fiber);
   task->m_state = Task::BLOCKED; // must call Wakeup on task later.
@@ -239,6 +313,7 @@ TaskManager::Start (void (*fn)(void*), void *context, uint32_t stackSize)
   task->m_extraContext = 0;
   task->m_switchNotifier = 0;
   task->m_switchNotifierContext = 0;
+  task->m_priority = priority;
   Wakeup (task);
   return task;
 }
@@ -252,6 +327,7 @@ TaskManager::Clone (Task *task)
   clone->m_extraContext = 0;
   clone->m_switchNotifier = 0;
   clone->m_switchNotifierContext = 0;
+  clone->m_priority = task->m_priority;
   struct Fiber *cloneFiber = m_fiberManager->Clone (task->m_fiber);
   NS_LOG_DEBUG ("clone " << clone << " fiber=" << cloneFiber);
   if (cloneFiber != 0)
@@ -261,6 +337,7 @@ TaskManager::Clone (Task *task)
       Wakeup (clone);
       return clone;
     }
+  m_delayModel->RecordResume ();
   return 0;
 }
 
@@ -270,7 +347,9 @@ TaskManager::Trampoline (void *context)
   struct StartTaskContext *ctx = (struct StartTaskContext *)context;
   void (*fn)(void*) = ctx->function;
   void *fn_context = ctx->context;
+  TaskManager *manager = ctx->manager;
   delete ctx;
+  manager->m_delayModel->RecordResume ();
   fn (fn_context);
   NS_FATAL_ERROR ("The user function must not return.");
 }
@@ -293,7 +372,7 @@ TaskManager::Stop (Task *task)
       m_fiberManager->Delete (task->m_fiber);
     }
   task->m_state = Task::DEAD;
-  task->m_waitTimer.Cancel ();
+  m_sleepers.Remove (&task->m_waitEntry);
   task->m_fiber = 0;
   delete task;
 }
@@ -337,10 +416,13 @@ TaskManager::Sleep (Time timeout)
   current->m_state = Task::BLOCKED;
   if (!timeout.IsZero ())
     {
-      m_waitQueue.push_back (Sleeper (current,timeout));
+      // round up: never wake up before the timeout.
+      int64_t step = m_sleepGranularity.GetTimeStep ();
+      m_sleepers.Insert (&current->m_waitEntry, (expectedEnd.GetTimeStep () + step - 1) / step);
+      m_sleepersChanged = true;
     }
   Schedule ();
-  current->m_waitTimer.Cancel ();
+  m_sleepers.Remove (&current->m_waitEntry);
   if (!timeout.IsZero ()
       && Simulator::Now () <= expectedEnd)
     {
@@ -367,7 +449,7 @@ TaskManager::Exit (void)
   NS_ASSERT (m_current->m_state == Task::RUNNING);
   Task *current = m_current;
   current->m_state = Task::DEAD;
-  current->m_waitTimer.Cancel ();
+  m_sleepers.Remove (&current->m_waitEntry);
   m_deadTasks.push_back (current);
   Schedule ();
 }
@@ -461,12 +543,7 @@ again:
         {
           // but, we have nothing to schedule to.
         }
-      while (m_waitQueue.size () > 0)
-        {
-          Sleeper s = m_waitQueue.front ();
-          s.m_task->m_waitTimer = Simulator::Schedule (s.m_timeout, &TaskManager::EndWait, this, s.m_task);
-          m_waitQueue.pop_front ();
-        }
+      ScheduleSleepers ();
       GarbageCollectDeadTasks ();
     }
   else
@@ -492,6 +569,7 @@ again:
       if (fiber)
         {
           m_fiberManager->SwitchTo (fiber, m_mainFiber);
+          m_delayModel->RecordResume ();
         }
     }
 }
@@ -508,6 +586,9 @@ TaskManager::SetFiberManagerType (enum FiberManagerType type)
     case PTHREAD_FIBER_MANAGER:
       m_fiberManager = new PthreadFiberManager ();
       break;
+    case ASM_FIBER_MANAGER:
+      m_fiberManager = new AsmFiberManager (m_fiberSaveSignalMask);
+      break;
     default:
       NS_ASSERT (false);
       break;
@@ -517,6 +598,30 @@ TaskManager::SetFiberManagerType (enum FiberManagerType type)
 }
 
 
+void
+TaskManager::SetStackPoolHighWaterMark (uint32_t stacks)
+{
+  UcontextFiberManager::SetStackPoolHighWaterMark (stacks);
+}
+
+uint32_t
+TaskManager::GetStackPoolHighWaterMark (void) const
+{
+  return UcontextFiberManager::GetStackPoolHighWaterMark ();
+}
+
+void
+TaskManager::SetStackSentinel (bool enable)
+{
+  UcontextFiberManager::SetStackSentinel (enable);
+}
+
+bool
+TaskManager::GetStackSentinel (void) const
+{
+  return UcontextFiberManager::GetStackSentinel ();
+}
+
 void
 TaskManager::EndWait (Task *task)
 {
@@ -526,6 +631,55 @@ TaskManager::EndWait (Task *task)
     }
 }
 
+uint64_t
+TaskManager::GetSleepTick (void) const
+{
+  return Simulator::Now ().GetTimeStep () / m_sleepGranularity.GetTimeStep ();
+}
+
+void
+TaskManager::ScheduleSleepers (void)
+{
+  // the tasks cannot schedule events themselves: they may not run
+  // on the main thread. The wheel is looked at once they are back to main.
+  if (!m_sleepersChanged)
+    {
+      return;
+    }
+  m_sleepersChanged = false;
+  uint64_t next;
+  if (!m_sleepers.GetNext (GetSleepTick (), &next))
+    {
+      return;
+    }
+  if (m_sleepersEvent.IsRunning () && m_sleepersEventTick <= next)
+    {
+      return;
+    }
+  m_sleepersEvent.Cancel ();
+  m_sleepersEventTick = next;
+  Time at = TimeStep (next * m_sleepGranularity.GetTimeStep ());
+  Time delay = (at > Simulator::Now ()) ? at - Simulator::Now () : Time (0);
+  m_sleepersEvent = Simulator::Schedule (delay, &TaskManager::ExpireSleepers, this);
+}
+
+void
+TaskManager::ExpireSleepers (void)
+{
+  NS_LOG_FUNCTION (this);
+  TimerWheel::Entry *entry = m_sleepers.Expire (GetSleepTick ());
+  while (entry != 0)
+    {
+      TimerWheel::Entry *next = entry->next;
+      entry->next = 0;
+      EndWait ((Task *)entry->context);
+      entry = next;
+    }
+  // the next event, if any, is for a later tick.
+  m_sleepersChanged = true;
+  ScheduleSleepers ();
+}
+
 void
 TaskManager::SetSwitchNotify (void (*fn)(void))
 {
@@ -536,6 +690,11 @@ TaskManager::GetStackSize (Task *task) const
 {
   return m_fiberManager->GetStackSize (task->m_fiber);
 }
+uint32_t
+TaskManager::GetStackUsage (Task *task) const
+{
+  return m_fiberManager->GetStackUsage (task->m_fiber);
+}
 void
 TaskManager::ExecOnMain (EventImpl *e)
 {
@@ -550,7 +709,9 @@ TaskManager::ExecOnMain (EventImpl *e)
       struct Fiber *fiber = m_current->m_fiber;
       m_current = 0;
       m_noSignal = true;
+      m_delayModel->RecordSuspend ();
       m_fiberManager->SwitchTo (fiber, m_mainFiber);
+      m_delayModel->RecordResume ();
     }
 }
 EventId
@@ -6,6 +6,7 @@
 #include "ns3/event-id.h"
 #include "ns3/nstime.h"
 #include "task-scheduler.h"
+#include "timer-wheel.h"
 #include <list>
 #include "process-delay-model.h"
 
@@ -23,6 +24,25 @@ public:
     TO,
     FROM
   };
+  /**
+   * Honored by the schedulers which support it, such as the
+   * RunQueueTaskScheduler: an active task of a higher priority
+   * always runs before the tasks of lower priorities.
+   */
+  enum Priority
+  {
+    HIGH_PRIORITY, // kernel tasks
+    NORMAL_PRIORITY,
+    PRIORITY_COUNT
+  };
+  // Links reserved to the TaskScheduler to queue the task without allocation.
+  struct RunLink
+  {
+    Task *prev;
+    Task *next;
+    int queue; // -1 when not queued.
+  };
+  Task ();
   bool IsActive (void) const;
   bool IsRunning (void) const;
   bool IsBlocked (void) const;
@@ -35,7 +55,13 @@ public:
   void * GetContext (void) const;
 
   void SetSwitchNotifier (void (*fn)(enum SwitchType, void *), void *context);
+  /**
+   * The new priority is used the next time the task becomes active.
+   */
+  void SetPriority (enum Priority priority);
+  enum Priority GetPriority (void) const;
   Fiber *m_fiber;
+  struct RunLink m_runLink;
 private:
   friend class TaskManager;
   ~Task ();
@@ -47,22 +73,12 @@ private:
     DEAD
   };
   enum State m_state;
-  EventId m_waitTimer;
+  TimerWheel::Entry m_waitEntry; // armed while in a Sleep with a timeout.
   void *m_context;
   void *m_extraContext;
   void (*m_switchNotifier)(enum SwitchType, void *);
   void *m_switchNotifierContext;
-};
-
-class Sleeper
-{
-public:
-  Sleeper (Task *t, Time to) : m_task (t),
-                               m_timeout (to)
-  {
-  }
-  Task * const m_task;
-  const Time m_timeout;
+  enum Priority m_priority;
 };
 
 class TaskManager : public Object
@@ -83,6 +99,9 @@ public:
    */
   Task *Start (void (*fn)(void*), void *context);
   Task *Start (void (*fn)(void*), void *context, uint32_t stackSize);
+  // The task is queued with this priority from its first run.
+  Task *Start (void (*fn)(void*), void *context, uint32_t stackSize,
+               enum Task::Priority priority);
 
   Task * Clone (Task *task);
 
@@ -147,6 +166,11 @@ public:
 
   void SetSwitchNotify (void (*fn)(void));
   uint32_t GetStackSize (Task *task) const;
+  /**
+   * \returns the peak number of bytes of its stack used by this task so
+   * far, zero if unknown. See the StackSentinel attribute.
+   */
+  uint32_t GetStackUsage (Task *task) const;
 
   /**
    * NS-3 prohibits to post event from a thread which is not the main thread,
@@ -163,18 +187,27 @@ private:
   {
     UCONTEXT_FIBER_MANAGER,
     PTHREAD_FIBER_MANAGER,
+    ASM_FIBER_MANAGER,
   };
   struct StartTaskContext
   {
     void (*function)(void *);
     void *context;
+    TaskManager *manager;
   };
 
   virtual void DoDispose (void);
   void Schedule (void);
   void SetFiberManagerType (enum FiberManagerType type);
+  void SetStackPoolHighWaterMark (uint32_t stacks);
+  uint32_t GetStackPoolHighWaterMark (void) const;
+  void SetStackSentinel (bool enable);
+  bool GetStackSentinel (void) const;
   void GarbageCollectDeadTasks (void);
   void EndWait (Task *task);
+  uint64_t GetSleepTick (void) const;
+  void ScheduleSleepers (void);
+  void ExpireSleepers (void);
   static void Trampoline (void *context);
   static void MainSchedule (EventId *res,Time const &time, EventImpl *e);
 
@@ -186,10 +219,16 @@ private:
   FiberManager *m_fiberManager;
   Fiber *m_mainFiber;
   uint32_t m_defaultStackSize;
+  bool m_fiberSaveSignalMask;
   EventId m_nextSchedule;
   bool m_reSchedule;
   Time m_reScheduleTime;
-  std::list<Sleeper> m_waitQueue;
+  // the sleep timeouts of all the tasks, served by a single simulator event.
+  TimerWheel m_sleepers;
+  EventId m_sleepersEvent;
+  uint64_t m_sleepersEventTick;
+  bool m_sleepersChanged;
+  Time m_sleepGranularity;
   std::list<Task *> m_deadTasks;
   EventImpl *m_todoOnMain;
   bool m_noSignal; // I am not come back from a real thread interruption do not run signal ....
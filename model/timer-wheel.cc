@@ -0,0 +1,297 @@
+#include "timer-wheel.h"
+#include "ns3/assert.h"
+#include <string.h>
+#include <algorithm>
+
+namespace ns3 {
+
+TimerWheel::TimerWheel ()
+  : m_now (0),
+    m_size (0),
+    m_seq (0),
+    m_next (0),
+    m_nextDirty (true)
+{
+  memset (m_slots, 0, sizeof (m_slots));
+  memset (m_occupied, 0, sizeof (m_occupied));
+}
+
+void
+TimerWheel::InitEntry (struct Entry *entry, void *context)
+{
+  entry->prev = 0;
+  entry->next = 0;
+  entry->expire = 0;
+  entry->slot = -1;
+  entry->seq = 0;
+  entry->context = context;
+}
+
+bool
+TimerWheel::IsArmed (const struct Entry *entry)
+{
+  return entry->slot != -1;
+}
+
+bool
+TimerWheel::IsEmpty (void) const
+{
+  return m_size == 0;
+}
+
+uint64_t
+TimerWheel::Cycle (uint32_t level)
+{
+  // number of ticks covered by all the slots of this level.
+  return ((uint64_t)1) << (BITS * (level + 1));
+}
+
+void
+TimerWheel::Place (struct Entry *entry)
+{
+  NS_ASSERT (entry->expire > m_now);
+  uint64_t delta = entry->expire - m_now;
+  uint32_t level = 0;
+  while (level < LEVELS - 1 && delta >= Cycle (level))
+    {
+      level++;
+    }
+  uint64_t when = entry->expire;
+  if (delta >= Cycle (level))
+    {
+      // too far in the future: come back when the top level wraps, the
+      // entry is placed again then.
+      when = m_now + Cycle (level) - 1;
+    }
+  uint32_t index = (when >> (BITS * level)) & (SLOTS - 1);
+  struct Entry **head = &m_slots[level][index];
+  entry->slot = level * SLOTS + index;
+  entry->prev = 0;
+  entry->next = *head;
+  if (*head != 0)
+    {
+      (*head)->prev = entry;
+    }
+  *head = entry;
+  m_occupied[level] |= ((uint64_t)1) << index;
+  m_size++;
+}
+
+void
+TimerWheel::Unlink (struct Entry *entry)
+{
+  uint32_t level = entry->slot / SLOTS;
+  uint32_t index = entry->slot % SLOTS;
+  if (entry->prev != 0)
+    {
+      entry->prev->next = entry->next;
+    }
+  else
+    {
+      m_slots[level][index] = entry->next;
+    }
+  if (entry->next != 0)
+    {
+      entry->next->prev = entry->prev;
+    }
+  if (m_slots[level][index] == 0)
+    {
+      m_occupied[level] &= ~(((uint64_t)1) << index);
+    }
+  entry->prev = 0;
+  entry->next = 0;
+  entry->slot = -1;
+  m_size--;
+}
+
+void
+TimerWheel::Insert (struct Entry *entry, uint64_t expire)
+{
+  Remove (entry);
+  entry->expire = expire;
+  entry->seq = m_seq++;
+  Place (entry);
+  if (m_size == 1)
+    {
+      m_next = expire;
+      m_nextDirty = false;
+    }
+  else if (!m_nextDirty)
+    {
+      m_next = std::min (m_next, expire);
+    }
+}
+
+void
+TimerWheel::Remove (struct Entry *entry)
+{
+  if (IsArmed (entry))
+    {
+      Unlink (entry);
+      m_nextDirty = m_nextDirty || entry->expire == m_next;
+    }
+}
+
+bool
+TimerWheel::GetNextSlot (uint64_t *next) const
+{
+  if (m_size == 0)
+    {
+      return false;
+    }
+  uint64_t best = ~((uint64_t)0);
+  for (uint32_t level = 0; level < LEVELS; level++)
+    {
+      uint64_t occupied = m_occupied[level];
+      uint32_t shift = BITS * level;
+      uint64_t cycle = Cycle (level);
+      uint32_t current = (m_now >> shift) & (SLOTS - 1);
+      while (occupied != 0)
+        {
+          uint32_t index = __builtin_ctzll (occupied);
+          occupied &= occupied - 1;
+          // the wheel must come back here when it reaches the start of this slot.
+          uint64_t start = (m_now & ~(cycle - 1)) | (((uint64_t)index) << shift);
+          if (index <= current)
+            {
+              // already behind us in this cycle: the entries are for the next one.
+              start += cycle;
+            }
+          best = std::min (best, start);
+        }
+    }
+  *next = best;
+  return true;
+}
+
+uint64_t
+TimerWheel::GetEarliest (void) const
+{
+  uint64_t earliest = ~((uint64_t)0);
+  for (uint32_t level = 0; level < LEVELS; level++)
+    {
+      uint64_t occupied = m_occupied[level];
+      uint32_t shift = BITS * level;
+      uint32_t current = (m_now >> shift) & (SLOTS - 1);
+      if (occupied == 0)
+        {
+          continue;
+        }
+      // the slots of a level cover less than a cycle from now: the first
+      // one after the current slot holds the earliest entries of the level.
+      // The top level also keeps the entries too far to be placed: all of
+      // its slots are looked at.
+      uint64_t ahead = current + 1 < SLOTS ? occupied >> (current + 1) : 0;
+      uint32_t index = ahead != 0 ? current + 1 + __builtin_ctzll (ahead) : __builtin_ctzll (occupied);
+      if (level < LEVELS - 1)
+        {
+          occupied = ((uint64_t)1) << index;
+        }
+      while (occupied != 0)
+        {
+          index = __builtin_ctzll (occupied);
+          occupied &= occupied - 1;
+          for (const struct Entry *entry = m_slots[level][index]; entry != 0; entry = entry->next)
+            {
+              earliest = std::min (earliest, entry->expire);
+            }
+        }
+    }
+  return earliest;
+}
+
+bool
+TimerWheel::GetNext (uint64_t now, uint64_t *next) const
+{
+  if (m_size == 0)
+    {
+      return false;
+    }
+  if (m_nextDirty)
+    {
+      m_next = GetEarliest ();
+      m_nextDirty = false;
+    }
+  *next = std::max (m_next, now);
+  return true;
+}
+
+struct TimerWheel::Entry *
+TimerWheel::Sort (struct Entry *list)
+{
+  // merge sort of the list by expiry then Insert order.
+  if (list == 0 || list->next == 0)
+    {
+      return list;
+    }
+  struct Entry *slow = list;
+  for (struct Entry *fast = list->next; fast != 0 && fast->next != 0; fast = fast->next->next)
+    {
+      slow = slow->next;
+    }
+  struct Entry *second = Sort (slow->next);
+  slow->next = 0;
+  struct Entry *first = Sort (list);
+  struct Entry *head = 0;
+  struct Entry **tail = &head;
+  while (first != 0 && second != 0)
+    {
+      struct Entry **smaller = (first->expire < second->expire
+                                || (first->expire == second->expire && first->seq < second->seq))
+        ? &first : &second;
+      *tail = *smaller;
+      tail = &(*smaller)->next;
+      *smaller = (*smaller)->next;
+    }
+  *tail = first != 0 ? first : second;
+  return head;
+}
+
+struct TimerWheel::Entry *
+TimerWheel::Expire (uint64_t now)
+{
+  NS_ASSERT (now >= m_now);
+  struct Entry *expired = 0;
+  uint64_t step;
+  // never jump over a slot which needs to be cascaded.
+  while (true)
+    {
+      if (!GetNextSlot (&step) || step > now)
+        {
+          step = now;
+        }
+      m_now = step;
+      for (int level = LEVELS - 1; level >= 0; level--)
+        {
+          uint32_t index = (m_now >> (BITS * level)) & (SLOTS - 1);
+          struct Entry *entry = m_slots[level][index];
+          m_slots[level][index] = 0;
+          m_occupied[level] &= ~(((uint64_t)1) << index);
+          while (entry != 0)
+            {
+              struct Entry *next = entry->next;
+              m_size--;
+              if (entry->expire <= m_now)
+                {
+                  entry->slot = -1;
+                  entry->prev = 0;
+                  entry->next = expired;
+                  expired = entry;
+                }
+              else
+                {
+                  Place (entry);
+                }
+              entry = next;
+            }
+        }
+      if (step == now)
+        {
+          break;
+        }
+    }
+  m_nextDirty = true;
+  return Sort (expired);
+}
+
+} // namespace ns3
@@ -0,0 +1,93 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \brief Hierarchical timer wheel
+ *
+ * Times are expressed in ticks, the caller decides what a tick is. The
+ * entries are embedded in the objects which need a timer so Insert and
+ * Remove never allocate and are O(1). The wheel does not schedule
+ * anything itself: the owner asks GetNext when it must call Expire and
+ * typically keeps a single simulator event for the whole wheel.
+ *
+ * There are LEVELS levels of SLOTS slots. An entry expiring in less
+ * than SLOTS^(l+1) ticks is kept in the level l slot covering its expiry
+ * and moved down (cascaded) when the wheel reaches this slot. The
+ * cascades are done by Expire as it goes: GetNext gives the exact tick
+ * of the earliest entry, so the owner is only woken up by expiries.
+ */
+class TimerWheel
+{
+public:
+  struct Entry
+  {
+    Entry *prev;
+    Entry *next;
+    uint64_t expire; // in ticks.
+    int slot; // level * SLOTS + index, -1 when not armed.
+    uint64_t seq; // order of the Insert calls.
+    void *context; // not used by the wheel.
+  };
+
+  TimerWheel ();
+
+  static void InitEntry (struct Entry *entry, void *context);
+  static bool IsArmed (const struct Entry *entry);
+
+  /**
+   * \param expire the tick at which the entry must expire, must be later
+   *        than the tick of the last call to Expire.
+   * An entry already armed is moved.
+   */
+  void Insert (struct Entry *entry, uint64_t expire);
+  // Does nothing if the entry is not armed.
+  void Remove (struct Entry *entry);
+
+  /**
+   * \param next set to the tick of the earliest entry, at which Expire
+   *        must be called next
+   * \param now the current tick, next is never earlier.
+   * \returns false if the wheel is empty.
+   */
+  bool GetNext (uint64_t now, uint64_t *next) const;
+  /**
+   * Advance the wheel to now and return the list of the entries which
+   * expired, linked by next, in the order of their expiry and, for the
+   * same tick, of their Insert. They are no longer armed.
+   */
+  struct Entry * Expire (uint64_t now);
+
+  bool IsEmpty (void) const;
+
+private:
+  enum
+  {
+    BITS = 6,
+    SLOTS = 1 << BITS,
+    LEVELS = 10
+  };
+  static uint64_t Cycle (uint32_t level);
+  static struct Entry * Sort (struct Entry *list);
+  void Place (struct Entry *entry);
+  void Unlink (struct Entry *entry);
+  // the tick at which the first non-empty slot must be cascaded or expired.
+  bool GetNextSlot (uint64_t *next) const;
+  uint64_t GetEarliest (void) const;
+
+  struct Entry *m_slots[LEVELS][SLOTS];
+  uint64_t m_occupied[LEVELS]; // one bit per non-empty slot.
+  uint64_t m_now; // tick of the last Expire.
+  uint32_t m_size;
+  uint64_t m_seq;
+  // the tick of the earliest entry, unless m_nextDirty.
+  mutable uint64_t m_next;
+  mutable bool m_nextDirty;
+};
+
+} // namespace ns3
+
+#endif /* TIMER_WHEEL_H */
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE 1
 #include "ucontext-fiber-manager.h"
+#include "fault-handlers.h"
 #include "ns3/fatal-error.h"
 #include "ns3/assert.h"
 #include <ucontext.h>
@@ -13,6 +14,7 @@
 #include <malloc.h>
 #include <sys/mman.h>
 #include <link.h>
+#include <algorithm>
 
 #ifdef HAVE_VALGRIND_H
 # include "valgrind/valgrind.h"
@@ -26,15 +28,26 @@ namespace ns3 {
 
 void *UcontextFiberManager::g_alternateSignalStack = 0;
 std::list<unsigned long> UcontextFiberManager::g_guardPages;
+std::map<uint32_t, std::vector<uint8_t *> > UcontextFiberManager::g_stackPool;
+uint32_t UcontextFiberManager::g_stackPoolHighWaterMark = 16;
+bool UcontextFiberManager::g_stackSentinel = false;
+
+// The pages of pooled stacks up to this size stay resident so that
+// short-lived tasks are created and deleted without any system call.
+#define STACK_POOL_KEEP_RESIDENT (1 << 16)
+
+#define STACK_SENTINEL 0xa5
 
 struct UcontextFiber : public Fiber
 {
   uint8_t *stack;
   uint32_t stackSize;
+  uint32_t stackUsage; // deepest point seen at a switch.
+  bool sentinel;
   ucontext_t context;
   unsigned int vgId;
 };
-void
+bool
 UcontextFiberManager::SegfaultHandler (int sig, siginfo_t *si, void *unused)
 {
   int pagesize = sysconf (_SC_PAGE_SIZE);
@@ -57,6 +70,8 @@ UcontextFiberManager::SegfaultHandler (int sig, siginfo_t *si, void *unused)
           break;
         }
     }
+  // a crash anyway.
+  return false;
 }
 
 void
@@ -96,35 +111,37 @@ UcontextFiberManager::SetupSignalHandler (void)
 
   atexit (&FreeAlternateSignalStack);
 
-  struct sigaction sa;
-  sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESETHAND;
-  sigemptyset (&sa.sa_mask);
-  sa.sa_sigaction = &UcontextFiberManager::SegfaultHandler;
-  status = sigaction (SIGSEGV, &sa, NULL);
-  if (status == -1)
-    {
-      NS_FATAL_ERROR ("Unable to setup page fault handler, errno="
-                      << strerror (errno));
-    }
+  FaultHandlers::AddHandler (SIGSEGV, &UcontextFiberManager::SegfaultHandler);
 }
 
 uint32_t
-UcontextFiberManager::CalcStackSize (uint32_t size)
+UcontextFiberManager::CalcSizeClass (uint32_t size)
 {
   int pagesize = sysconf (_SC_PAGE_SIZE);
   if (pagesize == -1)
     {
       NS_FATAL_ERROR ("Unable to query page size");
     }
-
-  if ((size % pagesize) == 0)
+  if (size > 0xffffffffU - 3 * (uint32_t)pagesize)
     {
-      return size + 2 * pagesize;
+      // the last page, and the guard pages, do not fit.
+      NS_FATAL_ERROR ("Stack size too large: " << size);
     }
-  else
+  // a whole number of pages: the pool keeps one class per number of pages.
+  uint32_t sizeClass = std::max ((size + pagesize - 1) / pagesize, 1U) * pagesize;
+  return sizeClass;
+}
+
+uint32_t
+UcontextFiberManager::CalcStackSize (uint32_t size)
+{
+  int pagesize = sysconf (_SC_PAGE_SIZE);
+  if (pagesize == -1)
     {
-      return size + (pagesize - (size % pagesize)) + 2 * pagesize;
+      NS_FATAL_ERROR ("Unable to query page size");
     }
+
+  return CalcSizeClass (size) + 2 * pagesize;
 }
 
 uint8_t *
@@ -138,8 +155,18 @@ UcontextFiberManager::AllocateStack (uint32_t size)
 
   SetupSignalHandler ();
 
+  std::vector<uint8_t *> &pool = g_stackPool[CalcSizeClass (size)];
+  if (!pool.empty ())
+    {
+      // the guard pages of a pooled stack are still in place.
+      uint8_t *stack = pool.back ();
+      pool.pop_back ();
+      return stack;
+    }
+
   uint32_t realSize = CalcStackSize (size);
-  void *map = mmap (0, realSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  // the pages are committed on first use only.
+  void *map = mmap (0, realSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
   if (map == MAP_FAILED)
     {
       NS_FATAL_ERROR ("Unable to allocate stack pages: size=" << size <<
@@ -164,6 +191,18 @@ UcontextFiberManager::DeallocateStack (uint8_t *buffer,
     {
       NS_FATAL_ERROR ("Unable to query page size, errno=" << strerror (errno));
     }
+  uint32_t sizeClass = CalcSizeClass (stackSize);
+  std::vector<uint8_t *> &pool = g_stackPool[sizeClass];
+  if (pool.size () < g_stackPoolHighWaterMark)
+    {
+      if (sizeClass > STACK_POOL_KEEP_RESIDENT)
+        {
+          // give the pages back to the host but keep the mapping.
+          madvise (buffer, sizeClass, MADV_DONTNEED);
+        }
+      pool.push_back (buffer);
+      return;
+    }
   uint32_t realSize = CalcStackSize (stackSize);
   int status = munmap (buffer - pagesize, realSize);
   if (status == -1)
@@ -174,6 +213,54 @@ UcontextFiberManager::DeallocateStack (uint8_t *buffer,
   g_guardPages.remove (guard);
 }
 
+void
+UcontextFiberManager::SetStackPoolHighWaterMark (uint32_t stacks)
+{
+  g_stackPoolHighWaterMark = stacks;
+}
+
+uint32_t
+UcontextFiberManager::GetStackPoolHighWaterMark (void)
+{
+  return g_stackPoolHighWaterMark;
+}
+
+void
+UcontextFiberManager::SetStackSentinel (bool enable)
+{
+  g_stackSentinel = enable;
+}
+
+bool
+UcontextFiberManager::GetStackSentinel (void)
+{
+  return g_stackSentinel;
+}
+
+bool
+UcontextFiberManager::FillStack (uint8_t *buffer, uint32_t stackSize)
+{
+  if (!g_stackSentinel)
+    {
+      return false;
+    }
+  memset (buffer, STACK_SENTINEL, stackSize);
+  return true;
+}
+
+uint32_t
+UcontextFiberManager::ScanStack (const uint8_t *buffer, uint32_t stackSize)
+{
+  // the stack grows down: the first byte which is not the sentinel is
+  // the deepest ever written.
+  uint32_t i = 0;
+  while (i < stackSize && buffer[i] == STACK_SENTINEL)
+    {
+      i++;
+    }
+  return stackSize - i;
+}
+
 UcontextFiberManager::UcontextFiberManager ()
   : m_notifySwitch (0)
 {
@@ -212,6 +299,8 @@ UcontextFiberManager::Create (void (*callback)(void *),
   fiber->vgId = VALGRIND_STACK_REGISTER (stack,stack + stackSize);
   fiber->stack = stack;
   fiber->stackSize = stackSize;
+  fiber->stackUsage = 0;
+  fiber->sentinel = FillStack (stack, stackSize);
 
   retval = getcontext (&fiber->context);
   NS_ASSERT (retval != -1);
@@ -238,6 +327,8 @@ UcontextFiberManager::CreateFromCaller (void)
   struct UcontextFiber *fiber = new struct UcontextFiber ();
   fiber->stack = 0;
   fiber->stackSize = 0;
+  fiber->stackUsage = 0;
+  fiber->sentinel = false;
   return fiber;
 }
 
@@ -261,6 +352,11 @@ UcontextFiberManager::SwitchTo (struct Fiber *fromFiber,
 {
   struct UcontextFiber *from = (struct UcontextFiber *)fromFiber;
   struct UcontextFiber *to = (struct UcontextFiber *)toFiber;
+  if (from->stack != 0)
+    {
+      uint8_t *sp = (uint8_t *)__builtin_frame_address (0);
+      from->stackUsage = std::max (from->stackUsage, (uint32_t)(from->stack + from->stackSize - sp));
+    }
   swapcontext (&from->context, &to->context);
   if (m_notifySwitch != 0)
     {
@@ -275,6 +371,17 @@ UcontextFiberManager::GetStackSize (struct Fiber *fib) const
   return fiber->stackSize;
 }
 
+uint32_t
+UcontextFiberManager::GetStackUsage (struct Fiber *fib) const
+{
+  struct UcontextFiber *fiber = (struct UcontextFiber *)fib;
+  if (fiber->sentinel)
+    {
+      return std::max (fiber->stackUsage, ScanStack (fiber->stack, fiber->stackSize));
+    }
+  return fiber->stackUsage;
+}
+
 void
 UcontextFiberManager::SetSwitchNotification (void (*fn)(void))
 {
@@ -4,6 +4,8 @@
 #include "fiber-manager.h"
 #include <signal.h>
 #include <list>
+#include <map>
+#include <vector>
 
 namespace ns3 {
 
@@ -21,22 +23,48 @@ public:
   virtual void SwitchTo (struct Fiber *from,
                          const struct Fiber *to);
   virtual uint32_t GetStackSize (struct Fiber *fiber) const;
+  virtual uint32_t GetStackUsage (struct Fiber *fiber) const;
   virtual void SetSwitchNotification (void (*fn)(void));
+
+  /**
+   * \param stacks maximum number of free stacks kept for reuse per size
+   *        class, shared by all the managers. Stacks released beyond this
+   *        limit are unmapped.
+   */
+  static void SetStackPoolHighWaterMark (uint32_t stacks);
+  static uint32_t GetStackPoolHighWaterMark (void);
+  /**
+   * \param enable if true, the stacks of the fibers created afterwards are
+   *        filled with a sentinel pattern so that GetStackUsage reports
+   *        the exact peak usage instead of the deepest point seen at a
+   *        switch. This commits the whole stack in memory.
+   */
+  static void SetStackSentinel (bool enable);
+  static bool GetStackSentinel (void);
+protected:
+  uint8_t * AllocateStack (uint32_t stackSize);
+  void DeallocateStack (uint8_t *buffer, uint32_t stackSize);
+  // return true if the stack was filled with the sentinel pattern.
+  static bool FillStack (uint8_t *buffer, uint32_t stackSize);
+  static uint32_t ScanStack (const uint8_t *buffer, uint32_t stackSize);
 private:
-  static void SegfaultHandler (int sig, siginfo_t *si, void *unused);
+  static bool SegfaultHandler (int sig, siginfo_t *si, void *unused);
   // invoked as atexit handler
   static void FreeAlternateSignalStack (void);
 
   void SetupSignalHandler (void);
+  uint32_t CalcSizeClass (uint32_t size);
   uint32_t CalcStackSize (uint32_t size);
-  uint8_t * AllocateStack (uint32_t stackSize);
-  void DeallocateStack (uint8_t *buffer, uint32_t stackSize);
   static void Trampoline (int a0, int a1, int a2, int a3);
 
 
   void (*m_notifySwitch)(void);
   static void *g_alternateSignalStack;
   static std::list<unsigned long> g_guardPages;
+  // Key is the size class, value is the free stacks of this class.
+  static std::map<uint32_t, std::vector<uint8_t *> > g_stackPool;
+  static uint32_t g_stackPoolHighWaterMark;
+  static bool g_stackSentinel;
 };
 
 } // namespace ns3
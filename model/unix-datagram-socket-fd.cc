@@ -282,6 +282,18 @@ UnixDatagramSocketFd::DoRecvmsg (struct msghdr *msg, int flags)
   return l;
 }
 
+ssize_t
+UnixDatagramSocketFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  return WritevDatagram (iov, iovcnt);
+}
+ssize_t
+UnixDatagramSocketFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  return ReadvDatagram (iov, iovcnt);
+}
 ssize_t
 UnixDatagramSocketFd::DoSendmsg (const struct msghdr *msg, int flags)
 {
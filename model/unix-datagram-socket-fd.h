@@ -18,6 +18,8 @@ public:
 private:
   virtual ssize_t DoRecvmsg (struct msghdr *msg, int flags);
   virtual ssize_t DoSendmsg (const struct msghdr *msg, int flags);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
   virtual int Listen (int backlog);
   virtual int Accept (struct sockaddr *my_addr, socklen_t *addrlen);
   virtual int Shutdown (int how);
@@ -3,8 +3,13 @@
 #include "ns3/log.h"
 #include "process.h"
 #include "utils.h"
+#include "linux-epoll-fd.h"
+#include "ns3/simulator.h"
 #include <fcntl.h>
 #include <errno.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
 
 NS_LOG_COMPONENT_DEFINE ("UnixFd");
 
@@ -19,7 +24,8 @@ UnixFd::GetTypeId (void)
   return tid;
 }
 
-UnixFd::UnixFd () : m_fdCount (0),
+UnixFd::UnixFd () : m_wakeFrames (0),
+                    m_fdCount (0),
                     m_fdFlags (0),
                     m_statusFlags (0)
 {
@@ -27,7 +33,21 @@ UnixFd::UnixFd () : m_fdCount (0),
 void
 UnixFd::RemoveWaitQueue (WaitQueueEntry* old, bool andUnregister)
 {
-  m_waitQueueList.remove (old);
+  std::vector<WaitQueueEntry*>::iterator i = std::find (m_waitQueueList.begin (),
+                                                       m_waitQueueList.end (), old);
+  if (i != m_waitQueueList.end ())
+    {
+      uint32_t position = i - m_waitQueueList.begin ();
+      m_waitQueueList.erase (i);
+      // the running wake ups must not skip the entry moved to this position.
+      for (struct WakeFrame *frame = m_wakeFrames; frame != 0; frame = frame->outer)
+        {
+          if (position <= frame->index)
+            {
+              frame->index--;
+            }
+        }
+    }
   if (andUnregister)
     {
       Current ()->ioWait = std::make_pair ((UnixFd*)0,(WaitQueueEntry*)0);
@@ -45,10 +65,25 @@ UnixFd::AddWaitQueue (WaitQueueEntry* newOne, bool andRegister)
 void
 UnixFd::WakeWaiters (void* key)
 {
-  for (std::list<WaitQueueEntry*>::iterator i = m_waitQueueList.begin ();
-       i != m_waitQueueList.end (); ++i)
+  // by index: a wake up may add an entry to this queue or remove one,
+  // RemoveWaitQueue keeps frame.index on the entry just woken up.
+  struct WakeFrame frame;
+  frame.outer = m_wakeFrames;
+  m_wakeFrames = &frame;
+  for (frame.index = 0; frame.index < m_waitQueueList.size (); frame.index++)
+    {
+      m_waitQueueList[frame.index]->WakeUp (key);
+    }
+  m_wakeFrames = frame.outer;
+}
+void
+UnixFd::ReleaseEpollItems (void)
+{
+  while (!m_epollItems.empty ())
     {
-      (*i)->WakeUp (key);
+      EpollItem *item = m_epollItems.front ();
+      // removes it from m_epollItems.
+      item->m_epoll->Forget (item);
     }
 }
 void
@@ -71,6 +106,139 @@ UnixFd::Ttyname (void)
 {
   return 0;
 }
+ssize_t
+UnixFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      ssize_t ret = Write (iov[i].iov_base, iov[i].iov_len);
+      if (ret < 0)
+        {
+          return total ? total : ret;
+        }
+      total += ret;
+      if ((size_t)ret < iov[i].iov_len)
+        {
+          break;
+        }
+    }
+  return total;
+}
+ssize_t
+UnixFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      ssize_t ret = Read (iov[i].iov_base, iov[i].iov_len);
+      if (ret < 0)
+        {
+          return total ? total : ret;
+        }
+      total += ret;
+      if ((size_t)ret < iov[i].iov_len)
+        {
+          break;
+        }
+    }
+  return total;
+}
+int
+UnixFd::Sendmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  NS_LOG_FUNCTION (this << msgvec << vlen << flags);
+  unsigned int i;
+  for (i = 0; i < vlen; i++)
+    {
+      ssize_t ret = Sendmsg (&msgvec[i].msg_hdr, flags);
+      if (ret < 0)
+        {
+          // as linux: the error is only reported if nothing was sent.
+          return i ? i : -1;
+        }
+      msgvec[i].msg_len = ret;
+    }
+  return i;
+}
+int
+UnixFd::Recvmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                  struct timespec *timeout)
+{
+  NS_LOG_FUNCTION (this << msgvec << vlen << flags << timeout);
+  ssize_t error;
+  int received = UtilsRecvmmsg (msgvec, vlen, flags, timeout, &UnixFd::RecvmsgTrampoline,
+                                this, &error);
+  // current->err is set by Recvmsg.
+  return received ? received : -1;
+}
+ssize_t
+UnixFd::RecvmsgTrampoline (void *context, struct msghdr *msg, int flags)
+{
+  UnixFd *self = (UnixFd *)context;
+  return self->Recvmsg (msg, flags);
+}
+ssize_t
+UnixFd::WritevDatagram (const struct iovec *iov, int iovcnt)
+{
+  if (iovcnt == 1)
+    {
+      return Write (iov[0].iov_base, iov[0].iov_len);
+    }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      count += iov[i].iov_len;
+    }
+  uint8_t *buf = (uint8_t *)malloc (count);
+  if (buf == 0)
+    {
+      Current ()->err = ENOMEM;
+      return -1;
+    }
+  uint8_t *bufp = buf;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      memcpy (bufp, iov[i].iov_base, iov[i].iov_len);
+      bufp += iov[i].iov_len;
+    }
+  ssize_t ret = Write (buf, count);
+  free (buf);
+  return ret;
+}
+ssize_t
+UnixFd::ReadvDatagram (const struct iovec *iov, int iovcnt)
+{
+  if (iovcnt == 1)
+    {
+      return Read (iov[0].iov_base, iov[0].iov_len);
+    }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      count += iov[i].iov_len;
+    }
+  uint8_t *buf = (uint8_t *)malloc (count);
+  if (buf == 0)
+    {
+      Current ()->err = ENOMEM;
+      return -1;
+    }
+  ssize_t ret = Read (buf, count);
+  uint8_t *bufp = buf;
+  size_t left = ret > 0 ? ret : 0;
+  for (int i = 0; i < iovcnt && left > 0; i++)
+    {
+      size_t len = std::min (iov[i].iov_len, left);
+      memcpy (iov[i].iov_base, bufp, len);
+      bufp += len;
+      left -= len;
+    }
+  free (buf);
+  return ret;
+}
 int
 UnixFd::GetRealFd (void) const
 {
@@ -2,16 +2,19 @@
 #define UNIX_FD_H
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
 #include <time.h>
 #include "ns3/object.h"
 #include "wait-queue.h"
 #include <list>
+#include <vector>
 
 namespace ns3 {
 
 class Waiter;
 class DceManager;
+class EpollItem;
 
 // This class heritate from Object for Dispose and Reference Counting features.
 class UnixFd : public Object
@@ -23,6 +26,15 @@ public:
   virtual ssize_t Read (void *buf, size_t count) = 0;
   virtual ssize_t Recvmsg (struct msghdr *msg, int flags) = 0;
   virtual ssize_t Sendmsg (const struct msghdr *msg, int flags) = 0;
+  // The default implementations call Write and Read on each buffer and
+  // stop at the first short transfer: right for the byte streams only.
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
+  // Same as the system calls. The default implementations call Sendmsg
+  // and Recvmsg for each message.
+  virtual int Sendmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags);
+  virtual int Recvmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                        struct timespec *timeout);
   virtual bool Isatty (void) const = 0;
   virtual char * Ttyname (void);
   virtual int Setsockopt (int level, int optname,
@@ -60,19 +72,38 @@ public:
 
   virtual int Fsync (void) = 0;
 
+  // Called when the last fd on this file goes away: the epoll
+  // instances watching it forget it, as linux does.
+  void ReleaseEpollItems (void);
+
   friend class PollTableEntry;
   friend class PollTable;
   friend class DceManager;
+  friend class LinuxEpollFd;
 protected:
   UnixFd ();
   void RemoveWaitQueue (WaitQueueEntry*, bool andUnregister);
   void AddWaitQueue (WaitQueueEntry*, bool andRegister);
   void WakeWaiters (void *key);
+  // Writev and Readv of the datagram sockets: the buffers are gathered
+  // in, or scattered from, a single Write or Read to keep the datagram
+  // boundaries.
+  ssize_t WritevDatagram (const struct iovec *iov, int iovcnt);
+  ssize_t ReadvDatagram (const struct iovec *iov, int iovcnt);
   int m_fdFlags;
   int m_statusFlags;
 
 private:
-  std::list <WaitQueueEntry*> m_waitQueueList;
+  static ssize_t RecvmsgTrampoline (void *context, struct msghdr *msg, int flags);
+  // The position of each WakeWaiters running on this file, innermost first.
+  struct WakeFrame
+  {
+    uint32_t index;
+    struct WakeFrame *outer;
+  };
+  std::vector <WaitQueueEntry*> m_waitQueueList;
+  struct WakeFrame *m_wakeFrames;
+  std::list <EpollItem*> m_epollItems;
   // Number of FD referencing me
   int m_fdCount;
 };
@@ -10,6 +10,8 @@
 #include <fcntl.h>
 #include "dce-node-context.h"
 #include "poll.h"
+#include "host-io-ring.h"
+#include "mmap-cache.h"
 
 NS_LOG_COMPONENT_DEFINE ("UnixFileFd");
 
@@ -35,6 +37,7 @@ UnixFileFdBase::Write (const void *buf, size_t count)
   Thread *current = Current ();
   NS_LOG_FUNCTION (this << current << buf << count);
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, count, false);
   ssize_t result = ::write (m_realFd, buf, count);
   if (result == -1)
     {
@@ -48,6 +51,7 @@ UnixFileFdBase::Read (void *buf, size_t count)
   Thread *current = Current ();
   NS_LOG_FUNCTION (this << current << buf << count);
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, count, true);
   ssize_t result = ::read (m_realFd, buf, count);
   if (result == -1)
     {
@@ -55,6 +59,40 @@ UnixFileFdBase::Read (void *buf, size_t count)
     }
   return result;
 }
+ssize_t
+UnixFileFdBase::Writev (const struct iovec *iov, int iovcnt)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << iov << iovcnt);
+  NS_ASSERT (current != 0);
+  for (int i = 0; i < iovcnt; i++)
+    {
+      UtilsPrefault (current, iov[i].iov_base, iov[i].iov_len, false);
+    }
+  ssize_t result = ::writev (m_realFd, iov, iovcnt);
+  if (result == -1)
+    {
+      current->err = errno;
+    }
+  return result;
+}
+ssize_t
+UnixFileFdBase::Readv (const struct iovec *iov, int iovcnt)
+{
+  Thread *current = Current ();
+  NS_LOG_FUNCTION (this << current << iov << iovcnt);
+  NS_ASSERT (current != 0);
+  for (int i = 0; i < iovcnt; i++)
+    {
+      UtilsPrefault (current, iov[i].iov_base, iov[i].iov_len, true);
+    }
+  ssize_t result = ::readv (m_realFd, iov, iovcnt);
+  if (result == -1)
+    {
+      current->err = errno;
+    }
+  return result;
+}
 
 ssize_t
 UnixFileFdBase::Recvmsg (struct msghdr *msg, int flags)
@@ -180,8 +218,9 @@ UnixFileFdBase::Mmap (void *start, size_t length, int prot, int flags,
   NS_LOG_FUNCTION (this << current);
   NS_ASSERT (current != 0);
 
-  void *retval = ::mmap (start, length, prot, flags, m_realFd, offset);
-  if (retval == 0)
+  void *retval = MmapCache::Get ()->Map (current->process, start, length, prot, flags,
+                                         m_realFd, offset);
+  if (retval == MAP_FAILED)
     {
       current->err = errno;
     }
@@ -206,6 +245,7 @@ UnixFileFdBase::Fxstat (int ver, struct ::stat *buf)
   Thread *current = Current ();
   NS_LOG_FUNCTION (this << current << buf);
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, sizeof (*buf), true);
   int retval = ::__fxstat (ver, m_realFd, buf);
   if (retval == -1)
     {
@@ -219,6 +259,7 @@ UnixFileFdBase::Fxstat64 (int ver, struct ::stat64 *buf)
   Thread *current = Current ();
   NS_LOG_FUNCTION (this << current << buf);
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, sizeof (*buf), true);
   int retval = ::__fxstat64 (ver, m_realFd, buf);
   if (retval == -1)
     {
@@ -324,8 +365,11 @@ UnixFileFdBase::GetRealFd (void) const
 }
 
 UnixFileFd::UnixFileFd (int realFd)
-  : UnixFileFdBase (realFd)
+  : UnixFileFdBase (realFd),
+    m_regular (false)
 {
+  struct stat st;
+  m_regular = realFd != -1 && ::fstat (realFd, &st) == 0 && S_ISREG (st.st_mode);
 }
 UnixFileFd::~UnixFileFd ()
 {
@@ -340,6 +384,13 @@ UnixFileFd::Close (void)
   Thread *current = Current ();
   NS_LOG_FUNCTION (this << current);
   NS_ASSERT (current != 0);
+  HostIoRing *ring = GetRing ();
+  if (ring != 0)
+    {
+      // the operations queued by the other users of the fd, before the
+      // number is given to an other file.
+      ring->Sync (PeekRealFd ());
+    }
   int result = ::close (PeekRealFd ());
   if (result == -1)
     {
@@ -349,6 +400,101 @@ UnixFileFd::Close (void)
   // list of fds and deleting this class instance.
   return result;
 }
+HostIoRing *
+UnixFileFd::GetRing (void) const
+{
+  if (!m_regular || !Current ()->process->hostIoRing)
+    {
+      return 0;
+    }
+  return HostIoRing::Get ();
+}
+ssize_t
+UnixFileFd::Result (ssize_t result)
+{
+  if (result < 0)
+    {
+      Current ()->err = -result;
+      return -1;
+    }
+  return result;
+}
+ssize_t
+UnixFileFd::Write (const void *buf, size_t count)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring == 0)
+    {
+      return UnixFileFdBase::Write (buf, count);
+    }
+  NS_LOG_FUNCTION (this << Current () << buf << count);
+  return Result (ring->Write (PeekRealFd (), buf, count));
+}
+ssize_t
+UnixFileFd::Read (void *buf, size_t count)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring == 0)
+    {
+      return UnixFileFdBase::Read (buf, count);
+    }
+  NS_LOG_FUNCTION (this << Current () << buf << count);
+  return Result (ring->Read (PeekRealFd (), buf, count));
+}
+ssize_t
+UnixFileFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring == 0)
+    {
+      return UnixFileFdBase::Writev (iov, iovcnt);
+    }
+  NS_LOG_FUNCTION (this << Current () << iov << iovcnt);
+  return Result (ring->Writev (PeekRealFd (), iov, iovcnt));
+}
+ssize_t
+UnixFileFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring == 0)
+    {
+      return UnixFileFdBase::Readv (iov, iovcnt);
+    }
+  NS_LOG_FUNCTION (this << Current () << iov << iovcnt);
+  return Result (ring->Readv (PeekRealFd (), iov, iovcnt));
+}
+int
+UnixFileFd::Fsync (void)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring == 0)
+    {
+      return UnixFileFdBase::Fsync ();
+    }
+  NS_LOG_FUNCTION (this << Current ());
+  return Result (ring->Fsync (PeekRealFd ()));
+}
+off64_t
+UnixFileFd::Lseek (off64_t offset, int whence)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring != 0)
+    {
+      // the queued reads and writes use the current position.
+      ring->Sync (PeekRealFd ());
+    }
+  return UnixFileFdBase::Lseek (offset, whence);
+}
+int
+UnixFileFd::Ftruncate (off_t length)
+{
+  HostIoRing *ring = GetRing ();
+  if (ring != 0)
+    {
+      ring->Sync (PeekRealFd ());
+    }
+  return UnixFileFdBase::Ftruncate (length);
+}
 
 int
 UnixFileFdBase::Poll (PollTable* ptable)
@@ -376,33 +522,36 @@ UnixFileFdBase::Poll (PollTable* ptable)
   return ret;
 }
 
-UnixFileFdLight::UnixFileFdLight (std::string path) : m_path (path),
-                                                      UnixFileFdBase (-1)
+UnixFileFdLight::UnixFileFdLight (std::string path)
+  : UnixFileFdBase (-1),
+    m_path (path),
+    m_stream (BufferedLogWriter::Get ()->Open (path))
 {
-
 }
 
 UnixFileFdLight::~UnixFileFdLight ()
 {
-  m_path = "";
+  BufferedLogWriter::Get ()->Close (m_stream);
+  m_stream = 0;
 }
 
 ssize_t
 UnixFileFdLight::Write (const void *buf, size_t count)
 {
-  FILE *f = fopen (m_path.c_str (), "a");
+  BufferedLogWriter::Get ()->Write (m_stream, buf, count);
+  return count;
+}
 
-  if (!f)
+ssize_t
+UnixFileFdLight::Writev (const struct iovec *iov, int iovcnt)
+{
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
     {
-      Current ()->err = errno;
-      return -1;
+      BufferedLogWriter::Get ()->Write (m_stream, iov[i].iov_base, iov[i].iov_len);
+      count += iov[i].iov_len;
     }
-
-  ssize_t res = fwrite (buf, count, 1, f);
-
-  fclose (f);
-
-  return res;
+  return count;
 }
 
 int
@@ -417,6 +566,32 @@ UnixFileFdLight::CanSend (void) const
   return true;
 }
 
+int
+UnixFileFdLight::Fxstat (int ver, struct ::stat *buf)
+{
+  BufferedLogWriter::Sync (m_path);
+  UtilsPrefault (Current (), buf, sizeof (*buf), true);
+  int retval = ::__xstat (ver, m_path.c_str (), buf);
+  if (retval == -1)
+    {
+      Current ()->err = errno;
+    }
+  return retval;
+}
+
+int
+UnixFileFdLight::Fxstat64 (int ver, struct ::stat64 *buf)
+{
+  BufferedLogWriter::Sync (m_path);
+  UtilsPrefault (Current (), buf, sizeof (*buf), true);
+  int retval = ::__xstat64 (ver, m_path.c_str (), buf);
+  if (retval == -1)
+    {
+      Current ()->err = errno;
+    }
+  return retval;
+}
+
 TermUnixFileFd::TermUnixFileFd (int realFd)
   : UnixFileFdBase (realFd)
 {
@@ -449,6 +624,18 @@ UnixRandomFd::Read (void *buf, size_t count)
   return nodeContext->RandomRead (buf, count);
 }
 
+ssize_t
+UnixRandomFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  return UnixFd::Readv (iov, iovcnt);
+}
+
+ssize_t
+UnixRandomFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  return UnixFd::Writev (iov, iovcnt);
+}
+
 bool
 UnixRandomFd::CanRecv (void) const
 {
@@ -488,6 +675,7 @@ UnixRandomFd::Fxstat (int ver, struct ::stat *buf)
     }
 
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, sizeof (*buf), true);
   int retval = ::__fxstat (ver, tmpFd, buf);
   if (retval == -1)
     {
@@ -510,6 +698,7 @@ UnixRandomFd::Fxstat64 (int ver, struct ::stat64 *buf)
     }
 
   NS_ASSERT (current != 0);
+  UtilsPrefault (current, buf, sizeof (*buf), true);
   int retval = ::__fxstat64 (ver, tmpFd, buf);
   if (retval == -1)
     {
@@ -2,9 +2,12 @@
 #define UNIX_FILE_FD_H
 
 #include "unix-fd.h"
+#include "buffered-log-writer.h"
 
 namespace ns3 {
 
+class HostIoRing;
+
 class UnixFileFdBase : public UnixFd
 {
 public:
@@ -14,6 +17,8 @@ public:
   virtual ssize_t Read (void *buf, size_t count);
   virtual ssize_t Recvmsg (struct msghdr *msg, int flags);
   virtual ssize_t Sendmsg (const struct msghdr *msg, int flags);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
   virtual bool Isatty (void) const;
   virtual int Setsockopt (int level, int optname,
                           const void *optval, socklen_t optlen);
@@ -53,15 +58,32 @@ private:
   int m_realFd;
 };
 
+// A host file: if it is a regular file, its I/O goes through the HostIoRing
+// if the process asks for it.
 class UnixFileFd : public UnixFileFdBase
 {
 public:
   UnixFileFd (int realFd);
   virtual ~UnixFileFd ();
   virtual int Close (void);
+  virtual ssize_t Write (const void *buf, size_t count);
+  virtual ssize_t Read (void *buf, size_t count);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
+  virtual int Fsync (void);
+  virtual off64_t Lseek (off64_t offset, int whence);
+  virtual int Ftruncate (off_t length);
+
+private:
+  HostIoRing * GetRing (void) const;
+  static ssize_t Result (ssize_t result);
+
+  // only the regular files go through the ring.
+  bool m_regular;
 };
 
-// Only for stdout and stderr emulation, open file at each write then close it, in order
+// Only for stdout, stderr and syslog emulation, the writes are buffered by the
+// BufferedLogWriter which opens the file only when it writes it, in order
 // to have less file opened at same time see option
 class UnixFileFdLight : public UnixFileFdBase
 {
@@ -69,11 +91,15 @@ public:
   UnixFileFdLight (std::string path);
   virtual ~UnixFileFdLight ();
   virtual ssize_t Write (const void *buf, size_t count);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
   virtual int Close (void);
   virtual bool CanSend (void) const;
+  virtual int Fxstat (int ver, struct ::stat *buf);
+  virtual int Fxstat64 (int ver, struct ::stat64 *buf);
 
 private:
   std::string m_path;
+  struct BufferedLogWriter::Stream *m_stream;
 };
 
 class TermUnixFileFd : public UnixFileFdBase
@@ -95,6 +121,8 @@ public:
   virtual int Close (void);
   virtual bool CanSend (void) const;
   virtual ssize_t Write (const void *buf, size_t count);
+  virtual ssize_t Writev (const struct iovec *iov, int iovcnt);
+  virtual ssize_t Readv (const struct iovec *iov, int iovcnt);
   virtual int Fxstat (int ver, struct ::stat *buf);
   virtual int Fxstat64 (int ver, struct ::stat64 *buf);
 
@@ -38,6 +38,34 @@ UnixStreamSocketFd::~UnixStreamSocketFd (void)
   ClearSocket ();
 }
 
+ssize_t
+UnixStreamSocketFd::Writev (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  struct msghdr msg;
+  msg.msg_control = 0;
+  msg.msg_controllen = 0;
+  msg.msg_iovlen = iovcnt;
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_name = 0;
+  msg.msg_namelen = 0;
+  msg.msg_flags = 0;
+  return Sendmsg (&msg, 0);
+}
+ssize_t
+UnixStreamSocketFd::Readv (const struct iovec *iov, int iovcnt)
+{
+  NS_LOG_FUNCTION (this << iov << iovcnt);
+  struct msghdr msg;
+  msg.msg_control = 0;
+  msg.msg_controllen = 0;
+  msg.msg_iovlen = iovcnt;
+  msg.msg_iov = (struct iovec *)iov;
+  msg.msg_name = 0;
+  msg.msg_namelen = 0;
+  msg.msg_flags = 0;
+  return Recvmsg (&msg, 0);
+}
 ssize_t
 UnixStreamSocketFd::DoRecvmsg (struct msghdr *msg, int flags)
 {
@@ -80,9 +108,6 @@ UnixStreamSocketFd::DoRecvmsg (struct msghdr *msg, int flags)
     }
 
   uint32_t totalAvailable = 0;
-  uint32_t count = msg->msg_iov[0].iov_len;
-  uint8_t *buf = (uint8_t *)msg->msg_iov[0].iov_base;
-  size_t toCopy = 0;
   ssize_t ret = 0;
   Ptr<Packet> packet = 0;
 
@@ -91,15 +116,10 @@ UnixStreamSocketFd::DoRecvmsg (struct msghdr *msg, int flags)
       totalAvailable += msg->msg_iov[i].iov_len;
     }
 
-  if (isPeekedData ())
+  bool peeked = isPeekedData ();
+  if (peeked)
     {
-      m_peekedData->CopyData (buf, count);
-      toCopy = m_peekedData->GetSize ();
-
-      if (toCopy > totalAvailable)
-        {
-          toCopy = totalAvailable;
-        }
+      packet = m_peekedData;
       Ns3AddressToPosixAddress (GetPeekedFrom (), (struct sockaddr*)msg->msg_name, &msg->msg_namelen);
     }
   else
@@ -112,24 +132,30 @@ UnixStreamSocketFd::DoRecvmsg (struct msghdr *msg, int flags)
           return -1;
         }
       NS_ASSERT (packet->GetSize () <= totalAvailable);
-      packet->CopyData (buf, count);
-      toCopy = packet->GetSize ();
       Ns3AddressToPosixAddress (from, (struct sockaddr*)msg->msg_name, &msg->msg_namelen);
       if (flags & MSG_PEEK)
         {
-          AddPeekedData (buf, toCopy, from);
+          m_peekedAddress = from;
+          AddPeekedData (packet);
         }
     }
-  for (uint32_t i = 0; i < msg->msg_iovlen && toCopy > 0; i++)
+  // scatter the packet on the buffers.
+  uint32_t toCopy = std::min (packet->GetSize (), totalAvailable);
+  for (uint32_t i = 0; i < msg->msg_iovlen && (uint32_t)ret < toCopy; i++)
     {
-      uint32_t len = std::min (toCopy, msg->msg_iov[i].iov_len);
-      memcpy (msg->msg_iov[i].iov_base, buf, len);
-      toCopy -= len;
-      buf += len;
+      uint32_t len = std::min ((size_t)(toCopy - ret), msg->msg_iov[i].iov_len);
+      if (ret == 0)
+        {
+          packet->CopyData ((uint8_t *)msg->msg_iov[i].iov_base, len);
+        }
+      else
+        {
+          packet->CreateFragment (ret, len)->CopyData ((uint8_t *)msg->msg_iov[i].iov_base, len);
+        }
       ret += len;
     }
 
-  if (!(flags & MSG_PEEK) && isPeekedData ())
+  if (!(flags & MSG_PEEK) && peeked)
     {
       m_peekedData->RemoveAtStart (ret);
       if (m_peekedData->GetSize () <= 0)
@@ -348,7 +374,7 @@ UnixStreamSocketFd::Accept (struct sockaddr *my_addr, socklen_t *addrlen)
   Ns3AddressToPosixAddress (ad, my_addr, addrlen);
   socket->SetPeerAddress (new Address (ad));
   socket->IncFdCount ();
-  current->process->openFiles[fd] = new FileUsage (fd, socket);
+  current->process->openFiles.Set (fd, new FileUsage (fd, socket));
 
   RETURNFREE (fd);
 }
@@ -3,7 +3,11 @@
 #include "unix-fd.h"
 #include "process.h"
 #include "task-manager.h"
+#include "kingsley-alloc.h"
+#include "loader-factory.h"
+#include "host-file-system.h"
 #include "ns3/node.h"
+#include "ns3/simulator.h"
 #include "ns3/log.h"
 #include <sstream>
 #include <sys/types.h>
@@ -116,6 +120,38 @@ std::string UtilsGetVirtualFilePath (std::string path)
       return current->process->cwd + "/" + path;
     }
 }
+Ptr<FileSystem>
+UtilsGetFileSystem (void)
+{
+  NS_ASSERT (Current () != 0);
+  DceManager *manager = Current ()->process->manager;
+  Ptr<FileSystem> fs = manager->GetObject<FileSystem> ();
+  if (fs == 0)
+    {
+      // node not set up by the DceManagerHelper: the host files, as before.
+      fs = CreateObject<HostFileSystem> ();
+      manager->AggregateObject (fs);
+    }
+  return fs;
+}
+void
+UtilsStat64ToStat (const struct ::stat64 *from, struct ::stat *to)
+{
+  memset (to, 0, sizeof (*to));
+  to->st_dev = from->st_dev;
+  to->st_ino = from->st_ino;
+  to->st_mode = from->st_mode;
+  to->st_nlink = from->st_nlink;
+  to->st_uid = from->st_uid;
+  to->st_gid = from->st_gid;
+  to->st_rdev = from->st_rdev;
+  to->st_size = from->st_size;
+  to->st_blksize = from->st_blksize;
+  to->st_blocks = from->st_blocks;
+  to->st_atim = from->st_atim;
+  to->st_mtim = from->st_mtim;
+  to->st_ctim = from->st_ctim;
+}
 Thread *gDisposingThreadContext = 0;
 
 Thread * Current (void)
@@ -185,6 +221,42 @@ Time UtilsTimespecToTime (struct timespec tm)
   time += NanoSeconds (tm.tv_nsec);
   return time;
 }
+int
+UtilsRecvmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags,
+               struct timespec *timeout, UtilsRecvmsg recv, void *context,
+               ssize_t *error)
+{
+  Time end = Simulator::Now () + (timeout ? UtilsTimespecToTime (*timeout) : Seconds (0));
+  bool waitForOne = (flags & MSG_WAITFORONE) != 0;
+  flags &= ~MSG_WAITFORONE;
+  *error = 0;
+  unsigned int i;
+  for (i = 0; i < vlen; i++)
+    {
+      ssize_t ret = recv (context, &msgvec[i].msg_hdr, flags);
+      if (ret < 0)
+        {
+          *error = ret;
+          break;
+        }
+      msgvec[i].msg_len = ret;
+      if (waitForOne)
+        {
+          flags |= MSG_DONTWAIT;
+        }
+      if (timeout && Simulator::Now () >= end)
+        {
+          i++;
+          break;
+        }
+    }
+  if (timeout)
+    {
+      Time left = end - Simulator::Now ();
+      *timeout = UtilsTimeToTimespec (left.IsStrictlyPositive () ? left : Seconds (0));
+    }
+  return i;
+}
 void
 UtilsSendSignal (Process *process, int signum)
 {
@@ -267,19 +339,20 @@ int UtilsAllocateFd (void)
   Thread *current = Current ();
   NS_LOG_FUNCTION (current);
   NS_ASSERT (current != 0);
-  std::map<int,FileUsage *>::iterator end = current->process->openFiles.end ();
-  std::map<int,FileUsage *>::iterator it = end;
-
-  for (int fd = 0; fd < MAX_FDS; fd++)
+  int fd = current->process->openFiles.GetLowestFree (MAX_FDS);
+  NS_LOG_DEBUG ("Allocated fd=" << fd);
+  return fd;
+}
+void UtilsPrefault (Thread *current, const void *buffer, size_t size, bool write)
+{
+  // The host kernel returns EFAULT instead of raising a SIGSEGV on
+  // the pages protected by the copy-on-write heap or the data section
+  // tracking, so we make them accessible beforehand.
+  KingsleyAlloc::Prefault (buffer, size, write);
+  if (write && current->process->loader != 0)
     {
-      it = current->process->openFiles.find (fd);
-      if (it == end)
-        {
-          NS_LOG_DEBUG ("Allocated fd=" << fd);
-          return fd;
-        }
+      current->process->loader->Prefault ((void *)buffer, size);
     }
-  return -1;
 }
 // Little hack to advance time when detecting a possible infinite loop.
 void UtilsAdvanceTime (Thread *current)
@@ -419,11 +492,11 @@ FdDecUsage (int fd)
 {
   Thread *current = Current ();
 
-  FileUsage *fu = current->process->openFiles[fd];
+  FileUsage *fu = current->process->openFiles.Get (fd);
 
   if (fu && fu->DecUsage ())
     {
-      current->process->openFiles.erase (fd);
+      current->process->openFiles.Erase (fd);
       delete fu;
       fu = 0;
     }
@@ -431,24 +504,19 @@ FdDecUsage (int fd)
 bool
 CheckFdExists (Process* const p, int const fd, bool const opened)
 {
-  std::map<int,FileUsage *>::iterator it = p->openFiles.find (fd);
+  FileUsage *fu = p->openFiles.Get (fd);
 
-  if (it != p->openFiles.end ())
+  if (fu != 0)
     {
-      return !opened || (!(*it).second->IsClosed ());
+      return !opened || (!fu->IsClosed ());
     }
 
   return false;
 }
 int getRealFd (int fd, Thread *current)
 {
-  std::map<int,FileUsage *>::iterator it = current->process->openFiles.find (fd);
-  if (current->process->openFiles.end () == it)
-    {
-      return -1;
-    }
-  FileUsage *fu = it->second;
-  if (fu->IsClosed ())
+  FileUsage *fu = current->process->openFiles.Get (fd);
+  if (fu == 0 || fu->IsClosed ())
     {
       return -1;
     }
@@ -5,7 +5,9 @@
 #include <list>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 #include "ns3/nstime.h"
+#include "ns3/ptr.h"
 
 #define GET_CURRENT(x)                                  \
   Thread * current;                                      \
@@ -27,6 +29,7 @@ namespace ns3 {
 
 class Thread;
 class Process;
+class FileSystem;
 
 // Little hack in order to have a context usable when disposing the Task Manager and the hidden goal is to flush the open FILEs.
 extern Thread *gDisposingThreadContext;
@@ -36,6 +39,9 @@ void UtilsEnsureAllDirectoriesExist (std::string realPath);
 std::string UtilsGetRealFilePath (std::string path);
 std::string UtilsGetAbsRealFilePath (uint32_t node, std::string path);
 std::string UtilsGetVirtualFilePath (std::string path);
+// The file system of the node of the current process.
+Ptr<FileSystem> UtilsGetFileSystem (void);
+void UtilsStat64ToStat (const struct ::stat64 *from, struct ::stat *to);
 uint32_t UtilsGetNodeId (void);
 Thread * Current (void);
 bool HasPendingSignal (void);
@@ -46,11 +52,22 @@ struct timespec UtilsTimeToTimespec (Time time);
 Time UtilsTimespecToTime (struct timespec tm);
 Time UtilsTimevalToTime (struct timeval tv);
 Time UtilsTimevalToTime (const struct timeval *tv);
+// The loop of recvmmsg around recv, which returns the length of a message
+// or a negative value: MSG_WAITFORONE and the timeout, only checked after
+// each message as linux. As linux too, the time left is written back into
+// *timeout. Returns the number of messages received; *error is the last
+// value of recv when it failed.
+typedef ssize_t (*UtilsRecvmsg)(void *context, struct msghdr *msg, int flags);
+int UtilsRecvmmsg (struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                   struct timespec *timeout, UtilsRecvmsg recv, void *context,
+                   ssize_t *error);
 void UtilsSendSignal (Process *process, int signum);
 void UtilsDoSignal (void);
 int UtilsAllocateFd (void);
 // Little hack to advance time when detecting a possible infinite loop.
 void UtilsAdvanceTime (Thread *current);
+// Must be called before a host system call accesses a buffer of the current process.
+void UtilsPrefault (Thread *current, const void *buffer, size_t size, bool write);
 std::string GetTimeStamp ();
 bool CheckExeMode (struct stat *st, uid_t uid, gid_t gid);
 std::string FindExecFile (std::string root, std::string envPath, std::string fileName, uid_t uid, gid_t gid, int *errNo);
@@ -64,17 +81,11 @@ bool CheckShellScript (std::string fileName,
 char * seek_env (const char *name, char **array);
 std::string UtilsGetCurrentDirName (void);
 
-#define MAX_FDS 1024
+#define MAX_FDS 65536
 
 #define OPENED_FD_METHOD_ERR(errCode, rettype, args) \
-  std::map < int,FileUsage * > ::iterator it = current->process->openFiles.find (fd); \
-  if (current->process->openFiles.end () == it) \
-    { \
-      current->err = EBADF; \
-      return (rettype) errCode; \
-    } \
-  FileUsage *fu = it->second; \
-  if (fu->IsClosed ()) \
+  FileUsage *fu = current->process->openFiles.Get (fd); \
+  if (fu == 0 || fu->IsClosed ()) \
     { \
       current->err = EBADF; \
       return (rettype) errCode; \
@@ -83,7 +94,7 @@ std::string UtilsGetCurrentDirName (void);
   rettype retval = unixFd->args; \
   if (fu && fu->DecUsage ()) \
     { \
-      current->process->openFiles.erase (fd); \
+      current->process->openFiles.Erase (fd); \
       delete fu; \
       fu = 0; \
     } \
@@ -66,6 +66,12 @@ PollTableEntry::PollTableEntry (UnixFd *file, WaitQueueEntryPoll *wait, short em
     m_eventMask (em)
 {
 }
+void
+PollTableEntry::Set (UnixFd *file, short em)
+{
+  m_file = file;
+  m_eventMask = em;
+}
 PollTableEntry::~PollTableEntry ()
 {
   if (m_wait)
@@ -88,6 +94,9 @@ PollTableEntry::IsEventMatch (short e) const
 WaitPoint::WaitPoint () : m_waitTask (0)
 {
 }
+WaitPoint::~WaitPoint ()
+{
+}
 WaitPoint::Result
 WaitPoint::Wait (Time to)
 {
@@ -133,41 +142,71 @@ WaitPoint::WakeUpCallback ()
 
 
 PollTable::PollTable ()
+  : m_entryCount (0),
+    m_linuxEntryCount (0),
+    m_eventMask (0)
 {
 }
 
 PollTable::~PollTable ()
 {
-  for (std::list <PollTableEntry*>::iterator i = m_pollEntryList.begin ();
-       i != m_pollEntryList.end (); ++i)
+  for (std::vector <PollTableEntry*>::iterator i = m_entries.begin ();
+       i != m_entries.end (); ++i)
+    {
+      delete (*i);
+    }
+  for (std::vector <PollTableEntryLinux*>::iterator i = m_linuxEntries.begin ();
+       i != m_linuxEntries.end (); ++i)
     {
       delete (*i);
     }
-  m_pollEntryList.clear ();
 }
 
 void
 PollTable::PollWait (UnixFd* file)
 {
-  WaitQueueEntryPoll* we = new WaitQueueEntryPoll (MakeCallback (&PollTable::WakeUpCallback, this));
-  PollTableEntry* e = new PollTableEntry (file, we, m_eventMask);
-  we->SetPollTableEntry (e);
-  m_pollEntryList.push_back (e);
-  file->AddWaitQueue (we, false);
+  PollTableEntry *e;
+  if (m_entryCount < m_entries.size ())
+    {
+      e = m_entries[m_entryCount];
+      e->Set (file, m_eventMask);
+    }
+  else
+    {
+      WaitQueueEntryPoll* we = new WaitQueueEntryPoll (MakeCallback (&PollTable::WakeUpCallback, this));
+      e = new PollTableEntry (file, we, m_eventMask);
+      we->SetPollTableEntry (e);
+      m_entries.push_back (e);
+    }
+  m_entryCount++;
+  file->AddWaitQueue (e->m_wait, false);
 }
 void
 PollTable::PollWait (void *ref, Callback<void, void*> cb)
 {
-  m_pollEntryList.push_back (new PollTableEntryLinux (ref, cb));
+  if (m_linuxEntryCount < m_linuxEntries.size ())
+    {
+      m_linuxEntries[m_linuxEntryCount]->Set (ref, cb);
+    }
+  else
+    {
+      m_linuxEntries.push_back (new PollTableEntryLinux (ref, cb));
+    }
+  m_linuxEntryCount++;
 }
 void
 PollTable::FreeWait ()
 {
-  for (std::list <PollTableEntry*> :: iterator i = m_pollEntryList.begin ();
-       i != m_pollEntryList.end (); ++i)
+  for (uint32_t i = 0; i < m_entryCount; i++)
+    {
+      m_entries[i]->FreeWait ();
+    }
+  for (uint32_t i = 0; i < m_linuxEntryCount; i++)
     {
-      (*i)->FreeWait ();
+      m_linuxEntries[i]->FreeWait ();
     }
+  m_entryCount = 0;
+  m_linuxEntryCount = 0;
 }
 void
 PollTable::SetEventMask (short e)
@@ -228,8 +267,19 @@ PollTableEntryLinux::PollTableEntryLinux (void *kernelReference, Callback<void,
 {
 }
 void
+PollTableEntryLinux::Set (void *kernelReference, Callback<void, void*> cb)
+{
+  m_kernelRef = kernelReference;
+  m_freeCb = cb;
+}
+void
 PollTableEntryLinux::FreeWait ()
 {
   m_freeCb (m_kernelRef);
 }
+
+PollContext::PollContext ()
+  : busy (false)
+{
+}
 }
@@ -23,12 +23,14 @@
 
 #include "ns3/callback.h"
 #include "ns3/nstime.h"
-#include <list>
+#include <vector>
+#include <poll.h>
 
 namespace ns3 {
 
 struct Thread;
 class UnixFd;
+class FileUsage;
 
 /**
 * \brief Wait queue are similar to linux kernel wait queues.
@@ -90,6 +92,11 @@ public:
   PollTableEntry (UnixFd *file, WaitQueueEntryPoll* wait, short eventMask);
   virtual ~PollTableEntry ();
 
+  /**
+   * Reuse this entry, and its wait queue entry, for another file.
+   */
+  void Set (UnixFd *file, short eventMask);
+
   /**
    * Free the wait queue entry
    */
@@ -97,9 +104,10 @@ public:
   int IsEventMatch (short e) const;
 
 private:
-  UnixFd* const m_file;
+  friend class PollTable;
+  UnixFd* m_file;
   WaitQueueEntryPoll* const m_wait;
-  short const m_eventMask;
+  short m_eventMask;
 };
 
 /**
@@ -116,17 +124,24 @@ public:
   } Result;
 
   WaitPoint ();
+  virtual ~WaitPoint ();
 
   // Stop the thread until a wakeup or timeout reached .
   // \param: time max to wait or 0 for no max
   WaitPoint::Result Wait (Time to);
-  void WakeUpCallback ();
+  virtual void WakeUpCallback ();
 
 private:
   Thread* m_waitTask;
 };
+class PollTableEntryLinux;
+
 /**
  * Poll table used to store WaitQueues of waiting files.
+ *
+ * The entries are kept after FreeWait and reused by the next poll done
+ * with the same table so a table which is reused does not allocate once
+ * it has seen its largest number of files.
  */
 class PollTable : public WaitPoint
 {
@@ -134,7 +149,7 @@ public:
   PollTable ();
   ~PollTable ();
 
-  // Remove from every wait queues
+  // Remove from every wait queues, the entries are kept for the next poll.
   void FreeWait ();
   // Add new file to Poll table and add corresponding poll table entry to file's wait queue.
   void PollWait (UnixFd* file);
@@ -143,7 +158,10 @@ public:
   short GetEventMask () const;
 
 private:
-  std::list <PollTableEntry*> m_pollEntryList;
+  std::vector <PollTableEntry*> m_entries;
+  uint32_t m_entryCount; // number of entries of m_entries in use.
+  std::vector <PollTableEntryLinux*> m_linuxEntries;
+  uint32_t m_linuxEntryCount;
   short m_eventMask;
 };
 
@@ -158,12 +176,12 @@ public:
    */
   PollTableEntryLinux (void *kernelReference, Callback<void, void*> cb);
 
-
+  void Set (void *kernelReference, Callback<void, void*> cb);
   virtual void FreeWait ();
 
 private:
-  void * const m_kernelRef;
-  Callback<void, void*> const m_freeCb;
+  void * m_kernelRef;
+  Callback<void, void*> m_freeCb;
 };
 
 
@@ -183,6 +201,24 @@ private:
   short m_eventMask;
   Time m_lastTime;
 };
+/**
+ * State of the poll and select calls of a thread which is kept from one
+ * call to the next one: a steady state poll or select loop does not
+ * allocate.
+ */
+struct PollContext
+{
+  PollContext ();
+
+  PollTable table;
+  // usages taken while the poll is registered in the file wait queues.
+  std::vector<FileUsage *> usages;
+  // pollfd array built by select.
+  std::vector<struct pollfd> fds;
+  // true while a poll uses this context.
+  bool busy;
+};
+
 #define RETURNFREE(A) { if (wq) { delete wq; wq = 0; } return A; }
 }
 #endif /* WAIT_QUEUE_H */
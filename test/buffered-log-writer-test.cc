@@ -0,0 +1,191 @@
+#include "ns3/test.h"
+#include "ns3/assert.h"
+#include "buffered-log-writer.h"
+#include "fault-handlers.h"
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace ns3;
+namespace ns3 {
+
+static std::string
+ReadFile (std::string path)
+{
+  std::ifstream file (path.c_str ());
+  std::ostringstream content;
+  content << file.rdbuf ();
+  return content.str ();
+}
+
+static std::string
+CreateTemporaryFile (void)
+{
+  char path[] = "/tmp/dce-log-writer-XXXXXX";
+  int fd = mkstemp (path);
+  NS_ASSERT (fd != -1);
+  close (fd);
+  return path;
+}
+
+static uint8_t *g_page = 0;
+
+static bool
+ClaimFault (int sig, siginfo_t *si, void *context)
+{
+  if ((uint8_t *)si->si_addr != g_page)
+    {
+      return false;
+    }
+  mprotect (g_page, getpagesize (), PROT_READ | PROT_WRITE);
+  return true;
+}
+
+/**
+ * Write, Sync and Flush from the simulation thread.
+ */
+class BufferedLogWriterTestCase : public TestCase
+{
+public:
+  BufferedLogWriterTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BufferedLogWriterTestCase::BufferedLogWriterTestCase ()
+  : TestCase ("Check that the buffered data reaches the file in order")
+{
+}
+
+void
+BufferedLogWriterTestCase::DoRun (void)
+{
+  std::string path = CreateTemporaryFile ();
+  BufferedLogWriter *writer = BufferedLogWriter::Get ();
+  struct BufferedLogWriter::Stream *stream = writer->Open (path);
+  NS_TEST_ASSERT_MSG_EQ (writer->Open (path), stream, "one stream per path");
+  writer->Close (stream);
+
+  writer->Write (stream, "abc", 3);
+  BufferedLogWriter::Sync (path);
+  NS_TEST_ASSERT_MSG_EQ (ReadFile (path), "abc", "Sync writes the buffered data");
+  std::string big (100000, 'x');
+  writer->Write (stream, big.c_str (), big.size ());
+  writer->Write (stream, "def", 3);
+  BufferedLogWriter::FlushAll ();
+  NS_TEST_ASSERT_MSG_EQ (ReadFile (path), "abc" + big + "def", "FlushAll keeps the order of the writes");
+  writer->Close (stream);
+  writer->Flush ();
+  unlink (path.c_str ());
+}
+
+/**
+ * The crash handler flushes the buffered data only on a fault which no
+ * fault handler claims, and a forked child does not wait for the writer
+ * thread of its parent at exit.
+ */
+class BufferedLogWriterCrashTestCase : public TestCase
+{
+public:
+  BufferedLogWriterCrashTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+BufferedLogWriterCrashTestCase::BufferedLogWriterCrashTestCase ()
+  : TestCase ("Check the flush of the buffered data on crash")
+{
+}
+
+void
+BufferedLogWriterCrashTestCase::DoRun (void)
+{
+  struct rlimit noCore;
+  noCore.rlim_cur = 0;
+  noCore.rlim_max = 0;
+  int status;
+
+  // a fault claimed by a fault handler.
+  std::string claimedPath = CreateTemporaryFile ();
+  pid_t pid = fork ();
+  if (pid == 0)
+    {
+      setrlimit (RLIMIT_CORE, &noCore);
+      g_page = (uint8_t *)mmap (0, getpagesize (), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      BufferedLogWriter *writer = BufferedLogWriter::Get ();
+      FaultHandlers::AddHandler (SIGSEGV, &ClaimFault);
+      struct BufferedLogWriter::Stream *stream = writer->Open (claimedPath);
+      writer->Write (stream, "before", 6);
+      *(volatile uint8_t *)g_page = 1;
+      // the locks are free and the stream is still there.
+      writer->Write (stream, "after", 5);
+      BufferedLogWriter::Sync (claimedPath);
+      _exit (ReadFile (claimedPath) == "beforeafter" ? 0 : 1);
+    }
+  NS_TEST_ASSERT_MSG_EQ ((pid > 0), true, "fork");
+  waitpid (pid, &status, 0);
+  NS_TEST_ASSERT_MSG_EQ (WIFEXITED (status), true, "a claimed fault is not a crash");
+  NS_TEST_ASSERT_MSG_EQ (WEXITSTATUS (status), 0, "the stream survives a claimed fault");
+  unlink (claimedPath.c_str ());
+
+  // a fault nobody claims.
+  std::string crashPath = CreateTemporaryFile ();
+  pid = fork ();
+  if (pid == 0)
+    {
+      setrlimit (RLIMIT_CORE, &noCore);
+      BufferedLogWriter *writer = BufferedLogWriter::Get ();
+      struct BufferedLogWriter::Stream *stream = writer->Open (crashPath);
+      writer->Write (stream, "last words", 10);
+      *(volatile int *)0 = 0;
+      _exit (0);
+    }
+  NS_TEST_ASSERT_MSG_EQ ((pid > 0), true, "fork");
+  waitpid (pid, &status, 0);
+  NS_TEST_ASSERT_MSG_EQ (WIFSIGNALED (status), true, "an unclaimed fault kills the process");
+  NS_TEST_ASSERT_MSG_EQ (WTERMSIG (status), SIGSEGV, "with the original signal");
+  NS_TEST_ASSERT_MSG_EQ (ReadFile (crashPath), "last words", "the buffered data is flushed on crash");
+  unlink (crashPath.c_str ());
+
+  // exit in a child forked once the writer runs.
+  std::string forkPath = CreateTemporaryFile ();
+  BufferedLogWriter *writer = BufferedLogWriter::Get ();
+  struct BufferedLogWriter::Stream *stream = writer->Open (forkPath);
+  writer->Write (stream, "parent", 6);
+  pid = fork ();
+  if (pid == 0)
+    {
+      // instead of hanging in the join of a thread which is not there.
+      alarm (10);
+      exit (0);
+    }
+  NS_TEST_ASSERT_MSG_EQ ((pid > 0), true, "fork");
+  waitpid (pid, &status, 0);
+  NS_TEST_ASSERT_MSG_EQ (WIFEXITED (status), true, "the child exits");
+  BufferedLogWriter::Sync (forkPath);
+  NS_TEST_ASSERT_MSG_EQ (ReadFile (forkPath), "parent", "the child does not write the data of its parent");
+  writer->Close (stream);
+  unlink (forkPath.c_str ());
+}
+
+static class BufferedLogWriterTestSuite : public TestSuite
+{
+public:
+  BufferedLogWriterTestSuite ();
+} g_bufferedLogWriterTestSuite;
+
+BufferedLogWriterTestSuite::BufferedLogWriterTestSuite ()
+  : TestSuite ("dce-buffered-log-writer", UNIT)
+{
+  AddTestCase (new BufferedLogWriterCrashTestCase (), TestCase::QUICK);
+  AddTestCase (new BufferedLogWriterTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,9 @@
+// The data section switched by the cooja loader test: larger than a few
+// pages so that most of it is tracked page by page.
+
+#define COOJA_TEST_PAGES 16
+
+extern "C" {
+char cooja_test_data[COOJA_TEST_PAGES * 4096] = { 1 };
+unsigned int cooja_test_size = sizeof (cooja_test_data);
+}
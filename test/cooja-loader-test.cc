@@ -0,0 +1,101 @@
+#include "ns3/test.h"
+#include "ns3/boolean.h"
+#include "cooja-loader-factory.h"
+#include "exec-utils.h"
+#include <string>
+#include <stdint.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+using namespace ns3;
+namespace ns3 {
+
+/**
+ * Switch the data section of a library between a loader and its clone,
+ * with TrackDirtyPages: each switch must save only the pages the previous
+ * owner dirtied and restore only the pages which differ.
+ */
+class CoojaLoaderDirtyPagesTestCase : public TestCase
+{
+public:
+  CoojaLoaderDirtyPagesTestCase (std::string library);
+private:
+  virtual void DoRun (void);
+
+  std::string m_library;
+};
+
+CoojaLoaderDirtyPagesTestCase::CoojaLoaderDirtyPagesTestCase (std::string library)
+  : TestCase (std::string (library == "" ? "(SKIP) " : "")
+              + "Check that the cooja loader only saves and restores the dirtied pages"),
+    m_library (library)
+{
+}
+
+void
+CoojaLoaderDirtyPagesTestCase::DoRun (void)
+{
+  if (m_library == "")
+    {
+      return;
+    }
+  Ptr<CoojaLoaderFactory> factory = CreateObject<CoojaLoaderFactory> ();
+  factory->SetAttribute ("TrackDirtyPages", BooleanValue (true));
+  Loader *parent = factory->Create (0, 0, 0);
+  void *module = parent->Load (m_library, RTLD_LAZY);
+  NS_TEST_ASSERT_MSG_NE (module, 0, "the library is loaded");
+  char *data = (char *)parent->Lookup (module, "cooja_test_data");
+  uint32_t size = *(uint32_t *)parent->Lookup (module, "cooja_test_size");
+  uint32_t pageSize = sysconf (_SC_PAGESIZE);
+  // whole pages of the data section, tracked one by one.
+  char *page = (char *)((((uintptr_t)data) + pageSize - 1) & ~((uintptr_t)pageSize - 1));
+  uint32_t pages = (data + size - page) / pageSize;
+  NS_TEST_ASSERT_MSG_GT (pages, 8, "the data section spans many pages");
+
+  parent->NotifyStartExecute ();
+  page[pageSize] = 'p';
+  Loader *child = parent->Clone ();
+  child->NotifyStartExecute ();
+  NS_TEST_ASSERT_MSG_EQ (page[pageSize], 'p', "the child starts with the data of the parent");
+  page[2 * pageSize] = 'c';
+  struct CoojaLoaderFactory::SwapStats childStats = CoojaLoaderFactory::GetSwapStats (child);
+  NS_TEST_ASSERT_MSG_EQ (childStats.faults, 1, "a single page is dirtied by the child");
+
+  struct CoojaLoaderFactory::SwapStats before = CoojaLoaderFactory::GetSwapStats (parent);
+  parent->NotifyStartExecute ();
+  struct CoojaLoaderFactory::SwapStats after = CoojaLoaderFactory::GetSwapStats (parent);
+  NS_TEST_ASSERT_MSG_EQ (page[pageSize], 'p', "the parent keeps its data");
+  NS_TEST_ASSERT_MSG_EQ (page[2 * pageSize], 0, "the parent does not see the writes of the child");
+  // the partial pages at both ends of the section are always copied.
+  NS_TEST_ASSERT_MSG_LT (after.savedBytes - before.savedBytes, 3 * pageSize,
+                         "only the page dirtied by the child is saved");
+  NS_TEST_ASSERT_MSG_LT (after.restoredBytes - before.restoredBytes, 3 * pageSize,
+                         "only the page which differs is restored");
+  // the section of the library holds more than our array.
+  NS_TEST_ASSERT_MSG_GT (after.skippedBytes - before.skippedBytes, (uint64_t)(pages - 2) * pageSize,
+                         "the other pages are not restored");
+
+  child->NotifyStartExecute ();
+  NS_TEST_ASSERT_MSG_EQ (page[pageSize], 'p', "the child keeps the data of the parent");
+  NS_TEST_ASSERT_MSG_EQ (page[2 * pageSize], 'c', "the child keeps its writes");
+
+  delete child;
+  parent->NotifyStartExecute ();
+  NS_TEST_ASSERT_MSG_EQ (page[2 * pageSize], 0, "the parent gets its data back after the child is gone");
+  delete parent;
+}
+
+static class CoojaLoaderTestSuite : public TestSuite
+{
+public:
+  CoojaLoaderTestSuite ();
+} g_coojaLoaderTestSuite;
+
+CoojaLoaderTestSuite::CoojaLoaderTestSuite ()
+  : TestSuite ("dce-cooja-loader", UNIT)
+{
+  std::string library = SearchExecFile ("DCE_PATH", "libcooja-loader-test.so", 0);
+  AddTestCase (new CoojaLoaderDirtyPagesTestCase (library), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -201,6 +201,7 @@ DceManagerTestSuite::DceManagerTestSuite ()
     {  "test-random", 0, "", false, false, NS3_STACK|LINUX_STACK|FREEBSD_STACK},
     {  "test-local-socket", 0, "", false, false, NS3_STACK|LINUX_STACK|FREEBSD_STACK},
     {  "test-poll", 3200, "", true, false, NS3_STACK|LINUX_STACK},
+    {  "test-epoll", 3200, "", true, false, NS3_STACK|LINUX_STACK},
     {  "test-tcp-socket", 320, "", true, false, NS3_STACK|LINUX_STACK},
     {  "test-exec", 0, "", false, true, NS3_STACK|LINUX_STACK|FREEBSD_STACK},
     {  "test-raw-socket", 320, "", true, false, NS3_STACK|LINUX_STACK|FREEBSD_STACK},
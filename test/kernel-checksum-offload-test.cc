@@ -0,0 +1,146 @@
+#include "ns3/test.h"
+#include "ns3/dce-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "kernel-socket-fd-factory.h"
+#include <string.h>
+
+using namespace ns3;
+namespace ns3 {
+
+#define COUNT 10
+#define PAYLOAD_SIZE 100
+
+/**
+ * Send datagrams with ChecksumOffload, then again once the receiver has
+ * an error model: DevXmit must notice it and fill in the checksums.
+ */
+class KernelChecksumOffloadTestCase : public TestCase
+{
+public:
+  KernelChecksumOffloadTestCase (bool skip);
+private:
+  virtual void DoRun (void);
+  static void Connect (Ptr<Socket> socket, Address address);
+  static void Send (Ptr<Socket> socket);
+  static void AddErrorModel (Ptr<NetDevice> device);
+  void Record (Ptr<NetDevice> device, uint32_t i);
+
+  bool m_skip;
+  uint64_t m_txBytesCopied[3];
+};
+
+KernelChecksumOffloadTestCase::KernelChecksumOffloadTestCase (bool skip)
+  : TestCase (std::string (skip ? "(SKIP) " : "")
+              + "Check that the checksums are filled for an error model added during the simulation"),
+    m_skip (skip)
+{
+}
+
+void
+KernelChecksumOffloadTestCase::Connect (Ptr<Socket> socket, Address address)
+{
+  socket->Connect (address);
+}
+
+void
+KernelChecksumOffloadTestCase::Send (Ptr<Socket> socket)
+{
+  for (uint32_t i = 0; i < COUNT; i++)
+    {
+      uint8_t payload[PAYLOAD_SIZE];
+      memset (payload, i, sizeof (payload));
+      socket->Send (Create<Packet> (payload, sizeof (payload)));
+    }
+}
+
+void
+KernelChecksumOffloadTestCase::AddErrorModel (Ptr<NetDevice> device)
+{
+  Ptr<RateErrorModel> model = CreateObject<RateErrorModel> ();
+  model->SetRate (0.0);
+  device->SetAttribute ("ReceiveErrorModel", PointerValue (model));
+}
+
+void
+KernelChecksumOffloadTestCase::Record (Ptr<NetDevice> device, uint32_t i)
+{
+  uint64_t rxBytes;
+  LinuxStackHelper::GetDeviceStats (device, &m_txBytesCopied[i], &rxBytes);
+}
+
+void
+KernelChecksumOffloadTestCase::DoRun (void)
+{
+  if (m_skip)
+    {
+      return;
+    }
+  Config::SetDefault ("ns3::KernelSocketFdFactory::ChecksumOffload", BooleanValue (true));
+
+  NodeContainer nodes;
+  nodes.Create (2);
+  SimpleNetDeviceHelper simple;
+  simple.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = simple.Install (nodes);
+
+  DceManagerHelper dceManager;
+  dceManager.SetNetworkStack ("ns3::LinuxSocketFdFactory",
+                              "Library", StringValue ("liblinux.so"));
+  dceManager.Install (nodes);
+  LinuxStackHelper stack;
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  TypeId udp = TypeId::LookupByName ("ns3::LinuxUdpSocketFactory");
+  Ptr<Socket> sender = Socket::CreateSocket (nodes.Get (0), udp);
+  Simulator::ScheduleWithContext (0, Seconds (2.0), &KernelChecksumOffloadTestCase::Connect, sender,
+                                  Address (InetSocketAddress (interfaces.GetAddress (1), 9)));
+  // a first datagram resolves the neighbor.
+  Simulator::ScheduleWithContext (0, Seconds (3.0), &KernelChecksumOffloadTestCase::Send, sender);
+  Simulator::Schedule (Seconds (3.5), &KernelChecksumOffloadTestCase::Record, this, devices.Get (0), 0);
+  Simulator::ScheduleWithContext (0, Seconds (4.0), &KernelChecksumOffloadTestCase::Send, sender);
+  Simulator::Schedule (Seconds (4.5), &KernelChecksumOffloadTestCase::Record, this, devices.Get (0), 1);
+  Simulator::Schedule (Seconds (5.0), &KernelChecksumOffloadTestCase::AddErrorModel, devices.Get (1));
+  Simulator::ScheduleWithContext (0, Seconds (6.0), &KernelChecksumOffloadTestCase::Send, sender);
+  Simulator::Schedule (Seconds (6.5), &KernelChecksumOffloadTestCase::Record, this, devices.Get (0), 2);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  BooleanValue offload;
+  nodes.Get (0)->GetObject<KernelSocketFdFactory> ()->GetAttribute ("ChecksumOffload", offload);
+  Simulator::Destroy ();
+  Config::SetDefault ("ns3::KernelSocketFdFactory::ChecksumOffload", BooleanValue (false));
+
+  uint64_t before = m_txBytesCopied[1] - m_txBytesCopied[0];
+  uint64_t after = m_txBytesCopied[2] - m_txBytesCopied[1];
+  // the ethernet, ip and udp headers with each payload.
+  NS_TEST_ASSERT_MSG_EQ (before, COUNT * (PAYLOAD_SIZE + 42), "a single copy without error model");
+  if (!offload.Get ())
+    {
+      // the library does not support the offload: it computes the
+      // checksums itself.
+      NS_TEST_ASSERT_MSG_EQ (after, before, "still a single copy");
+      return;
+    }
+  NS_TEST_ASSERT_MSG_EQ (after, 2 * before, "the checksums are filled in a copy of each frame");
+}
+
+static class KernelChecksumOffloadTestSuite : public TestSuite
+{
+public:
+  KernelChecksumOffloadTestSuite ();
+} g_kernelChecksumOffloadTestSuite;
+
+KernelChecksumOffloadTestSuite::KernelChecksumOffloadTestSuite ()
+  : TestSuite ("dce-kernel-checksum-offload", UNIT)
+{
+  std::string filePath = SearchExecFile ("DCE_PATH", "liblinux.so", 0);
+  bool skip = filePath.length () <= 0;
+  AddTestCase (new KernelChecksumOffloadTestCase (skip), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,294 @@
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "kernel-offload.h"
+#include <vector>
+#include <string.h>
+
+using namespace ns3;
+namespace ns3 {
+
+#define TCP_PAYLOAD_SIZE 3000
+#define UDP_SIZE 2008
+
+static uint16_t
+Read16 (const uint8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t
+Read32 (const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void
+Write16 (uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v & 0xff;
+}
+
+// 10.1.1.1 to 10.1.1.2, identifier 0x1234, DF and a ttl of 64; the
+// checksum is left to the code under test.
+static void
+WriteIpv4 (uint8_t *ip, uint16_t len, uint8_t protocol)
+{
+  static const uint8_t header[20] = {
+    0x45, 0, 0, 0, 0x12, 0x34, 0x40, 0, 64, 0, 0, 0,
+    10, 1, 1, 1, 10, 1, 1, 2
+  };
+  memcpy (ip, header, sizeof (header));
+  Write16 (ip + 2, len);
+  ip[9] = protocol;
+}
+
+// a TCP super-packet from port 1000 to 2000, seq 0x01000000, ack 0x2000,
+// with TCP_PAYLOAD_SIZE bytes of payload.
+static std::vector<uint8_t>
+TcpSuperPacket (uint8_t flags)
+{
+  std::vector<uint8_t> data (40 + TCP_PAYLOAD_SIZE);
+  uint8_t *ip = &data[0];
+  WriteIpv4 (ip, data.size (), 6);
+  static const uint8_t tcp[20] = {
+    0x03, 0xe8, 0x07, 0xd0, 0x01, 0, 0, 0, 0, 0, 0x20, 0,
+    0x50, 0, 0xff, 0xff, 0, 0, 0, 0
+  };
+  memcpy (ip + 20, tcp, sizeof (tcp));
+  ip[33] = flags;
+  for (uint32_t i = 0; i < TCP_PAYLOAD_SIZE; i++)
+    {
+      ip[40 + i] = i * 7;
+    }
+  return data;
+}
+
+static std::vector<uint8_t>
+GetData (Ptr<const Packet> p)
+{
+  std::vector<uint8_t> data (p->GetSize ());
+  p->CopyData (&data[0], data.size ());
+  return data;
+}
+
+/**
+ * Cut IPv4 and IPv6 packets larger than the device mtu, and check the
+ * headers of the pieces against known values.
+ */
+class KernelOffloadSplitTestCase : public TestCase
+{
+public:
+  KernelOffloadSplitTestCase ();
+private:
+  virtual void DoRun (void);
+  void CheckTcp (void);
+  void CheckIpv4Fragments (void);
+  void CheckIpv6Fragments (void);
+};
+
+KernelOffloadSplitTestCase::KernelOffloadSplitTestCase ()
+  : TestCase ("Check the segments and fragments made by KernelOffload::Split")
+{
+}
+
+void
+KernelOffloadSplitTestCase::CheckTcp (void)
+{
+  // ACK, PSH, FIN and CWR.
+  std::vector<uint8_t> data = TcpSuperPacket (0x99);
+  uint32_t fragmentId = 0;
+  std::vector<Ptr<Packet> > packets;
+  KernelOffload::Split (&data[0], data.size (), 0x0800, 1500, &fragmentId, &packets);
+  NS_TEST_ASSERT_MSG_EQ (packets.size (), 3, "segments of 1460 bytes");
+  static const uint32_t sizes[3] = { 1500, 1500, 120 };
+  static const uint8_t flags[3] = { 0x90, 0x10, 0x19 };
+  static const uint16_t ipChecksums[3] = { 0x0ce4, 0x0ce3, 0x1246 };
+  static const uint16_t tcpChecksums[3] = { 0x72fd, 0x75d1, 0xe4c1 };
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      std::vector<uint8_t> segment = GetData (packets[i]);
+      NS_TEST_ASSERT_MSG_EQ (segment.size (), sizes[i], "segment size");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&segment[2]), sizes[i], "IP total length");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&segment[4]), 0x1234 + i, "one IP identifier per segment");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&segment[6]), 0x4000, "DF is kept");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&segment[10]), ipChecksums[i], "IP checksum");
+      NS_TEST_ASSERT_MSG_EQ (Read32 (&segment[24]), 0x01000000 + i * 1460, "sequence number");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)segment[33], (uint32_t)flags[i], "FIN and PSH last, CWR first");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&segment[36]), tcpChecksums[i], "TCP checksum");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&segment[40], &data[40 + i * 1460], sizes[i] - 40), 0,
+                             "payload");
+    }
+  NS_TEST_ASSERT_MSG_EQ (fragmentId, 0, "no IPv6 fragment identifier used");
+}
+
+void
+KernelOffloadSplitTestCase::CheckIpv4Fragments (void)
+{
+  std::vector<uint8_t> data (20 + UDP_SIZE);
+  WriteIpv4 (&data[0], data.size (), 17);
+  for (uint32_t i = 0; i < UDP_SIZE; i++)
+    {
+      data[20 + i] = i * 5;
+    }
+  uint32_t fragmentId = 0;
+  std::vector<Ptr<Packet> > packets;
+  KernelOffload::Split (&data[0], data.size (), 0x0800, 1000, &fragmentId, &packets);
+  NS_TEST_ASSERT_MSG_EQ (packets.size (), 3, "fragments of 976 bytes");
+  static const uint32_t sizes[3] = { 976, 976, 56 };
+  // MF on all but the last, DF cleared.
+  static const uint16_t offsets[3] = { 0x2000, 0x2000 | 122, 244 };
+  static const uint16_t ipChecksums[3] = { 0x2ed1, 0x2e57, 0x5175 };
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      std::vector<uint8_t> fragment = GetData (packets[i]);
+      NS_TEST_ASSERT_MSG_EQ (fragment.size (), 20 + sizes[i], "fragment size");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[2]), 20 + sizes[i], "IP total length");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[4]), 0x1234, "same IP identifier");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[6]), offsets[i], "fragment offset");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[10]), ipChecksums[i], "IP checksum");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&fragment[20], &data[20 + i * 976], sizes[i]), 0, "payload");
+    }
+}
+
+void
+KernelOffloadSplitTestCase::CheckIpv6Fragments (void)
+{
+  std::vector<uint8_t> data (40 + UDP_SIZE);
+  data[0] = 0x60;
+  Write16 (&data[4], UDP_SIZE);
+  data[6] = 17;
+  data[7] = 64;
+  data[8] = 0x20;
+  data[9] = 0x01;
+  data[23] = 1;
+  data[24] = 0x20;
+  data[25] = 0x01;
+  data[39] = 2;
+  for (uint32_t i = 0; i < UDP_SIZE; i++)
+    {
+      data[40 + i] = i * 5;
+    }
+  uint32_t fragmentId = 7;
+  std::vector<Ptr<Packet> > packets;
+  KernelOffload::Split (&data[0], data.size (), 0x86dd, 1280, &fragmentId, &packets);
+  NS_TEST_ASSERT_MSG_EQ (packets.size (), 2, "fragments of 1232 bytes");
+  NS_TEST_ASSERT_MSG_EQ (fragmentId, 8, "one identifier per fragmented packet");
+  static const uint32_t sizes[2] = { 1232, 776 };
+  static const uint16_t offsets[2] = { 1, 1232 };
+  for (uint32_t i = 0; i < packets.size (); i++)
+    {
+      std::vector<uint8_t> fragment = GetData (packets[i]);
+      NS_TEST_ASSERT_MSG_EQ (fragment.size (), 48 + sizes[i], "fragment size");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[4]), 8 + sizes[i], "payload length");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)fragment[6], 44, "fragment header");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&fragment[7], &data[7], 33), 0, "hop limit and addresses");
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)fragment[40], 17, "next header of the fragment header");
+      NS_TEST_ASSERT_MSG_EQ (Read16 (&fragment[42]), offsets[i], "fragment offset and M");
+      NS_TEST_ASSERT_MSG_EQ (Read32 (&fragment[44]), 7, "fragment identifier");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (&fragment[48], &data[40 + i * 1232], sizes[i]), 0, "payload");
+    }
+}
+
+void
+KernelOffloadSplitTestCase::DoRun (void)
+{
+  CheckTcp ();
+  CheckIpv4Fragments ();
+  CheckIpv6Fragments ();
+}
+
+/**
+ * Parse the segments of a super-packet and merge them back: the merged
+ * packet is the super-packet.
+ */
+class KernelOffloadMergeTestCase : public TestCase
+{
+public:
+  KernelOffloadMergeTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+KernelOffloadMergeTestCase::KernelOffloadMergeTestCase ()
+  : TestCase ("Check Parse, CanMerge and Finish on the segments of a super-packet")
+{
+}
+
+void
+KernelOffloadMergeTestCase::DoRun (void)
+{
+  // ACK and PSH.
+  std::vector<uint8_t> data = TcpSuperPacket (0x18);
+  uint32_t fragmentId = 0;
+  std::vector<Ptr<Packet> > packets;
+  KernelOffload::Split (&data[0], data.size (), 0x0800, 1500, &fragmentId, &packets);
+  NS_TEST_ASSERT_MSG_EQ (packets.size (), 3, "segments of 1460 bytes");
+
+  struct KernelOffload::Segment segments[3];
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (KernelOffload::Parse (packets[i], 0x0800, &segments[i]), true,
+                             "a TCP segment");
+      NS_TEST_ASSERT_MSG_EQ (segments[i].ipHeaderSize, 20, "IP header size");
+      NS_TEST_ASSERT_MSG_EQ (segments[i].headerSize, 40, "IP and TCP header size");
+      NS_TEST_ASSERT_MSG_EQ (segments[i].seq, 0x01000000 + i * 1460, "sequence number");
+    }
+  NS_TEST_ASSERT_MSG_EQ (segments[0].payloadSize, 1460, "payload size");
+  NS_TEST_ASSERT_MSG_EQ (segments[2].payloadSize, 80, "payload size of the last segment");
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::Parse (packets[0], 0x86dd, &segments[0]), false,
+                         "not an IPv6 packet");
+
+  // neither fragments nor IP options nor other protocols.
+  std::vector<uint8_t> fragment = GetData (packets[0]);
+  Write16 (&fragment[6], 0x2000);
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::Parse (Create<Packet> (&fragment[0], fragment.size ()), 0x0800, &segments[0]),
+                         false, "a fragment");
+  std::vector<uint8_t> udp = GetData (packets[0]);
+  udp[9] = 17;
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::Parse (Create<Packet> (&udp[0], udp.size ()), 0x0800, &segments[0]),
+                         false, "UDP");
+  KernelOffload::Parse (packets[0], 0x0800, &segments[0]);
+
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::CanMerge (segments[0], segments[0], 1460, segments[1]), true,
+                         "the next segment");
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::CanMerge (segments[0], segments[1], 2920, segments[2]), true,
+                         "a final PSH");
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::CanMerge (segments[0], segments[0], 1460, segments[2]), false,
+                         "a hole in the sequence");
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::CanMerge (segments[0], segments[2], 3000, segments[1]), false,
+                         "nothing after a PSH or a smaller segment");
+  struct KernelOffload::Segment other = segments[1];
+  other.header[19] = 3;
+  NS_TEST_ASSERT_MSG_EQ (KernelOffload::CanMerge (segments[0], segments[0], 1460, other), false,
+                         "another destination");
+
+  std::vector<uint8_t> merged (segments[0].header, segments[0].header + 40);
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      std::vector<uint8_t> segment = GetData (packets[i]);
+      merged.insert (merged.end (), segment.begin () + 40, segment.end ());
+    }
+  KernelOffload::Finish (&merged[0], merged.size (), segments[2]);
+  // the super-packet, with its checksums.
+  Write16 (&data[10], 0x06e0);
+  Write16 (&data[36], 0x04fd);
+  NS_TEST_ASSERT_MSG_EQ (merged.size (), data.size (), "merged size");
+  NS_TEST_ASSERT_MSG_EQ (memcmp (&merged[0], &data[0], data.size ()), 0,
+                         "the merged packet is the super-packet");
+}
+
+static class KernelOffloadTestSuite : public TestSuite
+{
+public:
+  KernelOffloadTestSuite ();
+} g_kernelOffloadTestSuite;
+
+KernelOffloadTestSuite::KernelOffloadTestSuite ()
+  : TestSuite ("dce-kernel-offload", UNIT)
+{
+  AddTestCase (new KernelOffloadSplitTestCase (), TestCase::QUICK);
+  AddTestCase (new KernelOffloadMergeTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
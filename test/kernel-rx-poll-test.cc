@@ -0,0 +1,166 @@
+#include "ns3/test.h"
+#include "ns3/dce-module.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "kernel-socket-fd-factory.h"
+#include <vector>
+#include <string.h>
+
+using namespace ns3;
+namespace ns3 {
+
+#define BURST 20
+#define PAYLOAD_SIZE 100
+
+/**
+ * A burst of datagrams reaching a device in the same timestep, with an
+ * RxBudget smaller than the burst: the kernel must still get every frame,
+ * in order, over several polls.
+ */
+class KernelRxPollTestCase : public TestCase
+{
+public:
+  KernelRxPollTestCase (std::string name, uint32_t budget, bool skip);
+private:
+  virtual void DoRun (void);
+  static void Bind (Ptr<Socket> socket, Address address);
+  static void Connect (Ptr<Socket> socket, Address address);
+  static void SendBurst (Ptr<Socket> socket, uint32_t count, uint8_t first);
+  void Receive (Ptr<Socket> socket);
+
+  uint32_t m_budget;
+  bool m_skip;
+  std::vector<uint8_t> m_received;
+};
+
+KernelRxPollTestCase::KernelRxPollTestCase (std::string name, uint32_t budget, bool skip)
+  : TestCase (std::string (skip ? "(SKIP) " : "") + name),
+    m_budget (budget),
+    m_skip (skip)
+{
+}
+
+void
+KernelRxPollTestCase::Bind (Ptr<Socket> socket, Address address)
+{
+  socket->Bind (address);
+}
+
+void
+KernelRxPollTestCase::Connect (Ptr<Socket> socket, Address address)
+{
+  socket->Connect (address);
+}
+
+void
+KernelRxPollTestCase::SendBurst (Ptr<Socket> socket, uint32_t count, uint8_t first)
+{
+  for (uint32_t i = 0; i < count; i++)
+    {
+      uint8_t payload[PAYLOAD_SIZE];
+      memset (payload, first + i, sizeof (payload));
+      socket->Send (Create<Packet> (payload, sizeof (payload)));
+    }
+}
+
+void
+KernelRxPollTestCase::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  while ((packet = socket->Recv ()) != 0)
+    {
+      uint8_t first;
+      packet->CopyData (&first, 1);
+      m_received.push_back (first);
+    }
+}
+
+void
+KernelRxPollTestCase::DoRun (void)
+{
+  if (m_skip)
+    {
+      return;
+    }
+  Config::SetDefault ("ns3::KernelSocketFdFactory::RxBudget", UintegerValue (m_budget));
+
+  NodeContainer nodes;
+  nodes.Create (2);
+  // no data rate: the frames sent in a timestep arrive in the same one.
+  SimpleNetDeviceHelper simple;
+  simple.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = simple.Install (nodes);
+
+  DceManagerHelper dceManager;
+  dceManager.SetNetworkStack ("ns3::LinuxSocketFdFactory",
+                              "Library", StringValue ("liblinux.so"));
+  dceManager.Install (nodes);
+  LinuxStackHelper stack;
+  stack.Install (nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = address.Assign (devices);
+
+  TypeId udp = TypeId::LookupByName ("ns3::LinuxUdpSocketFactory");
+  Ptr<Socket> receiver = Socket::CreateSocket (nodes.Get (1), udp);
+  Ptr<Socket> sender = Socket::CreateSocket (nodes.Get (0), udp);
+  Simulator::ScheduleWithContext (1, Seconds (2.0), &KernelRxPollTestCase::Bind, receiver,
+                                  Address (InetSocketAddress (Ipv4Address::GetAny (), 9)));
+  receiver->SetRecvCallback (MakeCallback (&KernelRxPollTestCase::Receive, this));
+  Simulator::ScheduleWithContext (0, Seconds (2.0), &KernelRxPollTestCase::Connect, sender,
+                                  Address (InetSocketAddress (interfaces.GetAddress (1), 9)));
+  // a first datagram resolves the neighbor, then the burst.
+  Simulator::ScheduleWithContext (0, Seconds (3.0), &KernelRxPollTestCase::SendBurst, sender, 1, 0);
+  Simulator::ScheduleWithContext (0, Seconds (4.0), &KernelRxPollTestCase::SendBurst, sender, BURST, 1);
+  Simulator::Stop (Seconds (10.0));
+  Simulator::Run ();
+
+  uint64_t txBytes;
+  uint64_t rxBytes;
+  LinuxStackHelper::GetDeviceStats (devices.Get (1), &txBytes, &rxBytes);
+  Ptr<KernelSocketFdFactory> factory = nodes.Get (1)->GetObject<KernelSocketFdFactory> ();
+  struct KernelSocketFdFactory::DeviceStats stats = factory->GetDeviceStats (devices.Get (1));
+  Simulator::Destroy ();
+  Config::SetDefault ("ns3::KernelSocketFdFactory::RxBudget", UintegerValue (0));
+
+  NS_TEST_ASSERT_MSG_EQ (m_received.size (), BURST + 1, "every datagram of the burst is received");
+  for (uint32_t i = 0; i < m_received.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t)m_received[i], i, "the datagrams are received in order");
+    }
+  // the ethernet, ip and udp headers with each payload, and the frames of
+  // the neighbor resolution.
+  NS_TEST_ASSERT_MSG_GT (rxBytes, (BURST + 1) * (PAYLOAD_SIZE + 42), "each frame is given to the kernel");
+  NS_TEST_ASSERT_MSG_GT (stats.rxFrames, BURST, "each frame is counted");
+  if (m_budget == 0)
+    {
+      NS_TEST_ASSERT_MSG_EQ (stats.rxEntries, stats.rxFrames, "a single frame per entry into the kernel");
+    }
+  else
+    {
+      // the burst takes BURST / m_budget polls, rounded up.
+      NS_TEST_ASSERT_MSG_LT (stats.rxEntries, stats.rxFrames, "several frames per RxPoll");
+      NS_TEST_ASSERT_MSG_LT (stats.rxEntries, stats.rxFrames - BURST + (BURST + m_budget - 1) / m_budget + 1,
+                             "the budget is filled at each RxPoll of the burst");
+    }
+}
+
+static class KernelRxPollTestSuite : public TestSuite
+{
+public:
+  KernelRxPollTestSuite ();
+} g_kernelRxPollTestSuite;
+
+KernelRxPollTestSuite::KernelRxPollTestSuite ()
+  : TestSuite ("dce-kernel-rx-poll", UNIT)
+{
+  std::string filePath = SearchExecFile ("DCE_PATH", "liblinux.so", 0);
+  bool skip = filePath.length () <= 0;
+  AddTestCase (new KernelRxPollTestCase ("Check that a burst reaches the kernel in order without RxBudget",
+                                         0, skip), TestCase::QUICK);
+  AddTestCase (new KernelRxPollTestCase ("Check that a burst larger than the RxBudget reaches the kernel in order",
+                                         3, skip), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,181 @@
+#include "ns3/test.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/object-factory.h"
+#include "ns3/task-manager.h"
+#include "ns3/task-scheduler.h"
+#include "ns3/process-delay-model.h"
+#include "kernel-socket-fd-factory.h"
+#include "loader-factory.h"
+#include <string>
+#include <deque>
+#include <vector>
+
+using namespace ns3;
+namespace ns3 {
+
+// no stack library: the timers need nothing from the loader.
+class KernelTimersTestLoader : public Loader
+{
+public:
+  virtual Loader * Clone (void)
+  {
+    return new KernelTimersTestLoader ();
+  }
+  virtual void UnloadAll (void)
+  {
+  }
+  virtual void * Load (std::string filename, int flag, bool failsafe)
+  {
+    return 0;
+  }
+  virtual void Unload (void *module)
+  {
+  }
+  virtual void * Lookup (void *module, std::string symbol)
+  {
+    return 0;
+  }
+};
+
+/**
+ * Arm, cancel and re-arm kernel timers through EventScheduleNs and
+ * EventCancel, from a task and from the callbacks of the timers.
+ */
+class KernelTimersTestCase : public TestCase
+{
+public:
+  KernelTimersTestCase ();
+private:
+  struct Timer
+  {
+    KernelTimersTestCase *test;
+    char name;
+  };
+  virtual void DoRun (void);
+  static void StartTask (Ptr<TaskManager> manager, KernelTimersTestCase *self);
+  static void ArmTask (void *context);
+  static void Fire (void *context);
+  static void PreFire (void);
+  void * Arm (uint64_t ns, char name);
+  void Cancel (void *timer);
+
+  Ptr<KernelSocketFdFactory> m_factory;
+  std::deque<struct Timer> m_timers; // never moved.
+  void *m_c;
+  std::string m_fired;
+  std::vector<int64_t> m_ticks;
+};
+
+KernelTimersTestCase::KernelTimersTestCase ()
+  : TestCase ("Check the kernel timers armed, cancelled and re-armed in the timer wheel"),
+    m_c (0)
+{
+}
+
+void
+KernelTimersTestCase::PreFire (void)
+{
+}
+
+void *
+KernelTimersTestCase::Arm (uint64_t ns, char name)
+{
+  struct Timer timer;
+  timer.test = this;
+  timer.name = name;
+  m_timers.push_back (timer);
+  return KernelSocketFdFactory::EventScheduleNs ((struct SimKernel *)PeekPointer (m_factory), ns,
+                                                 &KernelTimersTestCase::Fire, &m_timers.back (),
+                                                 &KernelTimersTestCase::PreFire);
+}
+
+void
+KernelTimersTestCase::Cancel (void *timer)
+{
+  KernelSocketFdFactory::EventCancel ((struct SimKernel *)PeekPointer (m_factory), timer);
+}
+
+void
+KernelTimersTestCase::StartTask (Ptr<TaskManager> manager, KernelTimersTestCase *self)
+{
+  manager->Start (&KernelTimersTestCase::ArmTask, self, 1 << 16);
+}
+
+void
+KernelTimersTestCase::ArmTask (void *context)
+{
+  KernelTimersTestCase *self = (KernelTimersTestCase *)context;
+  // in decreasing order: each one is earlier than the previous ones.
+  void *d = self->Arm (30000000, 'D');
+  self->m_c = self->Arm (20000000, 'C');
+  self->Arm (20000000, 'B');
+  self->Arm (10000000, 'A');
+  self->Arm (5000000, 'E');
+  self->Cancel (d);
+  TaskManager::Current ()->Exit ();
+}
+
+void
+KernelTimersTestCase::Fire (void *context)
+{
+  struct Timer *timer = (struct Timer *)context;
+  KernelTimersTestCase *self = timer->test;
+  self->m_fired += timer->name;
+  self->m_ticks.push_back (Simulator::Now ().GetMilliSeconds ());
+  if (timer->name == 'B' && self->m_c != 0)
+    {
+      // C expires in the same batch, after B.
+      self->Cancel (self->m_c);
+      self->m_c = 0;
+      self->Arm (5000000, 'F');
+      // due in the nanosecond already expired.
+      self->Arm (0, 'G');
+    }
+}
+
+void
+KernelTimersTestCase::DoRun (void)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<TaskManager> manager = CreateObject<TaskManager> ();
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::RunQueueTaskScheduler");
+  manager->SetScheduler (factory.Create<TaskScheduler> ());
+  factory.SetTypeId ("ns3::RandomProcessDelayModel");
+  manager->SetDelayModel (factory.Create<ProcessDelayModel> ());
+  node->AggregateObject (manager);
+  m_factory = CreateObject<KernelSocketFdFactory> ();
+  m_factory->m_loader = new KernelTimersTestLoader ();
+
+  Simulator::ScheduleWithContext (node->GetId (), Seconds (1.0),
+                                  &KernelTimersTestCase::StartTask, manager, this);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_factory->m_timers.IsEmpty (), true, "no timer left in the wheel");
+  Simulator::Destroy ();
+  m_factory->Dispose ();
+  m_factory = 0;
+
+  // C is cancelled in its batch, D before it expires.
+  NS_TEST_ASSERT_MSG_EQ (m_fired, "EABGF", "the timers expire in order");
+  static const int64_t ticks[] = { 1005, 1010, 1020, 1020, 1025 };
+  NS_TEST_ASSERT_MSG_EQ (m_ticks.size (), 5, "each live timer expires once");
+  for (uint32_t i = 0; i < m_ticks.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_ticks[i], ticks[i], "each timer expires at its time");
+    }
+}
+
+static class KernelTimersTestSuite : public TestSuite
+{
+public:
+  KernelTimersTestSuite ();
+} g_kernelTimersTestSuite;
+
+KernelTimersTestSuite::KernelTimersTestSuite ()
+  : TestSuite ("dce-kernel-timers", UNIT)
+{
+  AddTestCase (new KernelTimersTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,131 @@
+#include "ns3/test.h"
+#include "kingsley-alloc.h"
+#include <string>
+#include <string.h>
+#include <stdint.h>
+
+using namespace ns3;
+namespace ns3 {
+
+#define SMALL_SIZE 64
+#define MEDIUM_SIZE (3 * 4096)
+#define LARGE_SIZE (100 * 4096)
+
+/**
+ * Fork a heap, as a fork of the process does, then write to the buffers
+ * from each side: the other one must keep its own content, with or
+ * without copy-on-write.
+ */
+class KingsleyAllocForkTestCase : public TestCase
+{
+public:
+  KingsleyAllocForkTestCase (bool cow);
+private:
+  virtual void DoRun (void);
+  static bool Check (const uint8_t *buffer, uint32_t size, uint8_t expected);
+
+  bool m_cow;
+};
+
+KingsleyAllocForkTestCase::KingsleyAllocForkTestCase (bool cow)
+  : TestCase (std::string ("Check that the clones of a heap do not see the writes of each other")
+              + (cow ? " with copy-on-write" : "")),
+    m_cow (cow)
+{
+}
+
+bool
+KingsleyAllocForkTestCase::Check (const uint8_t *buffer, uint32_t size, uint8_t expected)
+{
+  for (uint32_t i = 0; i < size; i++)
+    {
+      if (buffer[i] != expected)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+KingsleyAllocForkTestCase::DoRun (void)
+{
+  KingsleyAlloc *parent = new KingsleyAlloc ();
+  parent->SetCopyOnWrite (m_cow);
+  // from a slab, a run of slabs and an mmap of its own.
+  uint8_t *small = parent->Malloc (SMALL_SIZE);
+  uint8_t *medium = parent->Malloc (MEDIUM_SIZE);
+  uint8_t *large = parent->Malloc (LARGE_SIZE);
+  memset (small, 'p', SMALL_SIZE);
+  memset (medium, 'p', MEDIUM_SIZE);
+  memset (large, 'p', LARGE_SIZE);
+
+  KingsleyAlloc *child = parent->Clone ();
+  child->SwitchTo ();
+  NS_TEST_ASSERT_MSG_EQ (Check (small, SMALL_SIZE, 'p'), true, "the child starts with the content of the parent");
+  NS_TEST_ASSERT_MSG_EQ (Check (large, LARGE_SIZE, 'p'), true, "the child starts with the content of the parent");
+  memset (small, 'c', SMALL_SIZE);
+  large[LARGE_SIZE / 2] = 'c';
+  // taken from the free space shared with the parent.
+  uint8_t *childOnly = child->Malloc (SMALL_SIZE);
+  memset (childOnly, 'c', SMALL_SIZE);
+
+  parent->SwitchTo ();
+  NS_TEST_ASSERT_MSG_EQ (Check (small, SMALL_SIZE, 'p'), true, "the parent does not see the writes of the child");
+  NS_TEST_ASSERT_MSG_EQ (Check (large, LARGE_SIZE, 'p'), true, "the parent does not see the writes of the child");
+  NS_TEST_ASSERT_MSG_EQ (Check (medium, MEDIUM_SIZE, 'p'), true, "the parent keeps the buffers nobody wrote");
+  memset (medium, 'q', MEDIUM_SIZE);
+  uint8_t *parentOnly = parent->Malloc (SMALL_SIZE);
+  NS_TEST_ASSERT_MSG_EQ (parentOnly, childOnly, "both sides allocate from the same free space");
+  memset (parentOnly, 'q', SMALL_SIZE);
+
+  child->SwitchTo ();
+  NS_TEST_ASSERT_MSG_EQ (Check (small, SMALL_SIZE, 'c'), true, "the child keeps its writes");
+  NS_TEST_ASSERT_MSG_EQ (large[LARGE_SIZE / 2], 'c', "the child keeps its writes");
+  NS_TEST_ASSERT_MSG_EQ (Check (childOnly, SMALL_SIZE, 'c'), true, "the child keeps its own buffer");
+  NS_TEST_ASSERT_MSG_EQ (Check (medium, MEDIUM_SIZE, 'p'), true, "the child does not see the writes of the parent");
+  child->Free (childOnly);
+  child->Dispose ();
+  delete child;
+
+  // the last clone left takes the heap back.
+  parent->SwitchTo ();
+  NS_TEST_ASSERT_MSG_EQ (Check (small, SMALL_SIZE, 'p'), true, "the parent keeps its content");
+  NS_TEST_ASSERT_MSG_EQ (Check (medium, MEDIUM_SIZE, 'q'), true, "the parent keeps its writes");
+  NS_TEST_ASSERT_MSG_EQ (Check (parentOnly, SMALL_SIZE, 'q'), true, "the parent keeps its own buffer");
+  memset (large, 'r', LARGE_SIZE);
+  NS_TEST_ASSERT_MSG_EQ (Check (large, LARGE_SIZE, 'r'), true, "the parent writes to its heap");
+
+  struct KingsleyAlloc::Stats stats = parent->GetStats ();
+  if (m_cow)
+    {
+      // only the pages touched after the fork.
+      NS_TEST_ASSERT_MSG_GT (stats.faults, 0, "the pages are copied on write");
+      NS_TEST_ASSERT_MSG_LT (stats.copiedBytes, LARGE_SIZE, "the heap is not copied as a whole");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ (stats.faults, 0, "no page fault without copy-on-write");
+    }
+  parent->Free (small);
+  parent->Free (medium);
+  parent->Free (large);
+  parent->Free (parentOnly);
+  parent->Dispose ();
+  delete parent;
+}
+
+static class KingsleyAllocTestSuite : public TestSuite
+{
+public:
+  KingsleyAllocTestSuite ();
+} g_kingsleyAllocTestSuite;
+
+KingsleyAllocTestSuite::KingsleyAllocTestSuite ()
+  : TestSuite ("dce-kingsley-alloc", UNIT)
+{
+  AddTestCase (new KingsleyAllocForkTestCase (false), TestCase::QUICK);
+  AddTestCase (new KingsleyAllocForkTestCase (true), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,219 @@
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/pointer.h"
+#include "ns3/assert.h"
+#include "ns3/memory-file-system.h"
+#include "unix-fd.h"
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace ns3;
+namespace ns3 {
+
+static void
+CreateFile (Ptr<MemoryFileSystem> fs, std::string path, std::string content)
+{
+  UnixFd *fd = fs->Open (path, O_CREAT | O_WRONLY, 0644);
+  NS_ASSERT (fd != 0);
+  fd->Unref ();
+  fs->Append (path, content.c_str (), content.size ());
+}
+
+/**
+ * The calls of a single MemoryFileSystem, as a process would see them.
+ */
+class MemoryFileSystemTestCase : public TestCase
+{
+public:
+  MemoryFileSystemTestCase ();
+private:
+  virtual void DoRun (void);
+};
+
+MemoryFileSystemTestCase::MemoryFileSystemTestCase ()
+  : TestCase ("Check the directories, files and errors of MemoryFileSystem")
+{
+}
+
+void
+MemoryFileSystemTestCase::DoRun (void)
+{
+  Ptr<MemoryFileSystem> fs = CreateObject<MemoryFileSystem> ();
+  struct ::stat64 st;
+
+  NS_TEST_ASSERT_MSG_EQ (fs->Mkdir ("/tmp", 0755), 0, "mkdir");
+  NS_TEST_ASSERT_MSG_EQ (fs->Mkdir ("/tmp", 0755), -1, "mkdir twice");
+  NS_TEST_ASSERT_MSG_EQ (errno, EEXIST, "mkdir twice");
+  NS_TEST_ASSERT_MSG_EQ (fs->Mkdir ("/tmp/a/b", 0755), -1, "no parent");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOENT, "no parent");
+  NS_TEST_ASSERT_MSG_EQ (fs->Mkdir ("/tmp/a", 0755), 0, "mkdir");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (S_ISDIR (st.st_mode), true, "a directory");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, 3, "., its entry and a/..");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/./a/../a", &st, true), 0, "dots");
+
+  CreateFile (fs, "/tmp/a/f", "hello");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/a/f", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (S_ISREG (st.st_mode), true, "a file");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 5, "appended");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, 1, "one entry");
+  NS_TEST_ASSERT_MSG_EQ (st.st_blocks, 4096 / 512, "one page");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/a/f/g", &st, true), -1, "below a file");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOTDIR, "below a file");
+  NS_TEST_ASSERT_MSG_EQ (fs->Access ("/tmp/a/f", X_OK), -1, "not executable");
+  NS_TEST_ASSERT_MSG_EQ (errno, EACCES, "not executable");
+
+  // O_TRUNC frees the pages.
+  std::string big (10000, 'x');
+  fs->Append ("/tmp/a/f", big.c_str (), big.size ());
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/a/f", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 10005, "appended");
+  NS_TEST_ASSERT_MSG_EQ (st.st_blocks, 3 * 4096 / 512, "three pages");
+  UnixFd *fd = fs->Open ("/tmp/a/f", O_WRONLY | O_TRUNC, 0);
+  NS_TEST_ASSERT_MSG_NE (fd, 0, "open");
+  fd->Unref ();
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/a/f", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 0, "truncated");
+  NS_TEST_ASSERT_MSG_EQ (st.st_blocks, 0, "no page left");
+
+  NS_TEST_ASSERT_MSG_EQ (fs->Open ("/tmp/a/f", O_CREAT | O_EXCL | O_RDWR, 0644), 0, "exclusive");
+  NS_TEST_ASSERT_MSG_EQ (errno, EEXIST, "exclusive");
+  NS_TEST_ASSERT_MSG_EQ (fs->Open ("/tmp/a", O_RDWR, 0), 0, "a directory for writing");
+  NS_TEST_ASSERT_MSG_EQ (errno, EISDIR, "a directory for writing");
+
+  NS_TEST_ASSERT_MSG_EQ (fs->Rmdir ("/tmp/a"), -1, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOTEMPTY, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (fs->Rename ("/tmp", "/tmp/a/b"), -1, "under itself");
+  NS_TEST_ASSERT_MSG_EQ (errno, EINVAL, "under itself");
+  NS_TEST_ASSERT_MSG_EQ (fs->Rename ("/tmp/a/f", "/tmp/g"), 0, "rename");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/a/f", &st, true), -1, "moved");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/g", &st, true), 0, "moved");
+  NS_TEST_ASSERT_MSG_EQ (fs->Rmdir ("/tmp/a"), 0, "empty");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, 2, "no subdirectory left");
+  NS_TEST_ASSERT_MSG_EQ (fs->Unlink ("/tmp"), -1, "a directory");
+  NS_TEST_ASSERT_MSG_EQ (errno, EISDIR, "a directory");
+  NS_TEST_ASSERT_MSG_EQ (fs->Unlink ("/tmp/g"), 0, "unlink");
+  NS_TEST_ASSERT_MSG_EQ (fs->Unlink ("/tmp/g"), -1, "unlink twice");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOENT, "unlink twice");
+
+  // no symbolic links, the times are set as asked.
+  char buf[16];
+  CreateFile (fs, "/tmp/h", "");
+  NS_TEST_ASSERT_MSG_EQ (fs->Readlink ("/tmp/h", buf, sizeof (buf)), -1, "not a link");
+  NS_TEST_ASSERT_MSG_EQ (errno, EINVAL, "not a link");
+  NS_TEST_ASSERT_MSG_EQ (fs->Readlink ("/tmp/i", buf, sizeof (buf)), -1, "no file");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOENT, "no file");
+  struct utimbuf times;
+  times.actime = 1000;
+  times.modtime = 2000;
+  NS_TEST_ASSERT_MSG_EQ (fs->Utime ("/tmp/h", &times), 0, "utime");
+  NS_TEST_ASSERT_MSG_EQ (fs->Stat ("/tmp/h", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_atime, 1000, "access time");
+  NS_TEST_ASSERT_MSG_EQ (st.st_mtime, 2000, "modification time");
+  Simulator::Destroy ();
+}
+
+/**
+ * Two nodes on the same base image: the entries of the base are copied
+ * when first used, without changing their directory, and the changes of a
+ * node are not seen by the base or by the other node.
+ */
+class MemoryFileSystemOverlayTestCase : public TestCase
+{
+public:
+  MemoryFileSystemOverlayTestCase ();
+private:
+  virtual void DoRun (void);
+  void Check (void);
+
+  Ptr<MemoryFileSystem> m_base;
+  Ptr<MemoryFileSystem> m_node1;
+  Ptr<MemoryFileSystem> m_node2;
+};
+
+MemoryFileSystemOverlayTestCase::MemoryFileSystemOverlayTestCase ()
+  : TestCase ("Check the overlays of a MemoryFileSystem base")
+{
+}
+
+void
+MemoryFileSystemOverlayTestCase::Check (void)
+{
+  struct ::stat64 base;
+  struct ::stat64 st;
+  NS_TEST_ASSERT_MSG_EQ (m_base->Stat ("/etc", &base, true), 0, "in the base");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc", &st, true), 0, "seen by the node");
+  NS_TEST_ASSERT_MSG_EQ (st.st_ino, base.st_ino, "same directory");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, base.st_nlink, "same links");
+
+  // copying the entries does not change their directory.
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc/conf", &st, true), 0, "seen by the node");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, 1, "one entry");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc/init.d", &st, true), 0, "seen by the node");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, 2, "an empty directory");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc", &st, true), 0, "seen by the node");
+  NS_TEST_ASSERT_MSG_EQ (st.st_nlink, base.st_nlink, "same links");
+  NS_TEST_ASSERT_MSG_EQ (st.st_mtime, base.st_mtime, "not modified");
+
+  // a write is only seen by its node.
+  m_node1->Append ("/etc/conf", "more", 4);
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc/conf", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 9, "written");
+  NS_TEST_ASSERT_MSG_EQ (m_base->Stat ("/etc/conf", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 5, "base unchanged");
+  NS_TEST_ASSERT_MSG_EQ (m_node2->Stat ("/etc/conf", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (st.st_size, 5, "other node unchanged");
+
+  // a removed entry of the base stays hidden.
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Unlink ("/etc/conf"), 0, "unlink");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc/conf", &st, true), -1, "hidden");
+  NS_TEST_ASSERT_MSG_EQ (errno, ENOENT, "hidden");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_GT (st.st_mtime, base.st_mtime, "modified");
+  NS_TEST_ASSERT_MSG_EQ (m_node2->Stat ("/etc/conf", &st, true), 0, "still there");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Rmdir ("/etc/init.d"), 0, "rmdir");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Rmdir ("/etc"), 0, "empty once the base is hidden");
+  NS_TEST_ASSERT_MSG_EQ (m_base->Stat ("/etc/init.d", &st, true), 0, "base unchanged");
+  CreateFile (m_node1, "/etc", "");
+  NS_TEST_ASSERT_MSG_EQ (m_node1->Stat ("/etc", &st, true), 0, "stat");
+  NS_TEST_ASSERT_MSG_EQ (S_ISREG (st.st_mode), true, "a file over the directory of the base");
+}
+
+void
+MemoryFileSystemOverlayTestCase::DoRun (void)
+{
+  m_base = CreateObject<MemoryFileSystem> ();
+  m_base->Mkdir ("/etc", 0755);
+  m_base->Mkdir ("/etc/init.d", 0755);
+  CreateFile (m_base, "/etc/conf", "hello");
+  m_node1 = CreateObject<MemoryFileSystem> ();
+  m_node1->SetAttribute ("Base", PointerValue (m_base));
+  m_node2 = CreateObject<MemoryFileSystem> ();
+  m_node2->SetAttribute ("Base", PointerValue (m_base));
+
+  // later, so a change of the times would be seen.
+  Simulator::Schedule (Seconds (10.0), &MemoryFileSystemOverlayTestCase::Check, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+  m_node1 = 0;
+  m_node2 = 0;
+  m_base = 0;
+}
+
+static class MemoryFileSystemTestSuite : public TestSuite
+{
+public:
+  MemoryFileSystemTestSuite ();
+} g_memoryFileSystemTestSuite;
+
+MemoryFileSystemTestSuite::MemoryFileSystemTestSuite ()
+  : TestSuite ("dce-memory-file-system", UNIT)
+{
+  AddTestCase (new MemoryFileSystemTestCase (), TestCase::QUICK);
+  AddTestCase (new MemoryFileSystemOverlayTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
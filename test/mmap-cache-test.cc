@@ -0,0 +1,147 @@
+#include "ns3/test.h"
+#include "mmap-cache.h"
+#include "process.h"
+#include <string>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace ns3;
+namespace ns3 {
+
+#define FILE_SIZE (3 * 4096)
+
+/**
+ * Map copies of the same file on two nodes, then write to the copies.
+ */
+class MmapCacheTestCase : public TestCase
+{
+public:
+  MmapCacheTestCase ();
+private:
+  static int CreateCopy (char fill);
+  virtual void DoRun (void);
+};
+
+MmapCacheTestCase::MmapCacheTestCase ()
+  : TestCase ("Check that a node writing to its copy does not change the mappings of the others")
+{
+}
+
+int
+MmapCacheTestCase::CreateCopy (char fill)
+{
+  char path[] = "/tmp/dce-mmap-cache-test-XXXXXX";
+  int fd = mkstemp (path);
+  unlink (path);
+  char content[FILE_SIZE];
+  memset (content, fill, sizeof (content));
+  if (fd == -1 || write (fd, content, sizeof (content)) != sizeof (content))
+    {
+      return -1;
+    }
+  return fd;
+}
+
+void
+MmapCacheTestCase::DoRun (void)
+{
+  MmapCache *cache = MmapCache::Get ();
+  Process process1;
+  process1.nodeId = 1001;
+  process1.shareFileMappings = 1;
+  Process process2;
+  process2.nodeId = 1002;
+  process2.shareFileMappings = 1;
+  int copy1 = CreateCopy ('a');
+  int copy2 = CreateCopy ('a');
+  NS_TEST_ASSERT_MSG_EQ ((copy1 != -1 && copy2 != -1), true, "temporary files");
+
+  uint8_t *map1 = (uint8_t *)cache->Map (&process1, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy1, 0);
+  uint8_t *map2 = (uint8_t *)cache->Map (&process2, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy2, 0);
+  NS_TEST_ASSERT_MSG_NE (map1, MAP_FAILED, "map of the first copy");
+  NS_TEST_ASSERT_MSG_NE (map2, MAP_FAILED, "map of the second copy");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1001).mapped, FILE_SIZE, "counted");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1001).shared, 0, "the first copy has its own pages");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1002).shared, FILE_SIZE, "the second copy shares them");
+
+  // the node of the first copy, whose content was taken first, writes to it.
+  NS_TEST_ASSERT_MSG_EQ (pwrite (copy1, "bbbb", 4, 4096), 4, "write to the first copy");
+  NS_TEST_ASSERT_MSG_EQ (map2[4096], 'a', "the other node does not see the write");
+  NS_TEST_ASSERT_MSG_EQ (map1[4096], 'a', "nor an older mapping of the copy");
+
+  // a new mapping of the written copy has the new content right away,
+  // even within the same timestamp tick.
+  uint8_t *map3 = (uint8_t *)cache->Map (&process1, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy1, 0);
+  NS_TEST_ASSERT_MSG_NE (map3, MAP_FAILED, "map of the written copy");
+  NS_TEST_ASSERT_MSG_EQ (map3[4096], 'b', "the new mapping sees the write");
+  NS_TEST_ASSERT_MSG_EQ (map3[0], 'a', "and the rest of the copy");
+  uint8_t *map4 = (uint8_t *)cache->Map (&process2, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy2, 0);
+  NS_TEST_ASSERT_MSG_EQ (map4[4096], 'a', "the unchanged copy still has its content");
+
+  // a shared mapping is the file itself: it sees the writes.
+  uint8_t *map5 = (uint8_t *)cache->Map (&process2, 0, FILE_SIZE, PROT_READ, MAP_SHARED, copy2, 0);
+  NS_TEST_ASSERT_MSG_NE (map5, MAP_FAILED, "shared map of the second copy");
+  NS_TEST_ASSERT_MSG_EQ (pwrite (copy2, "cccc", 4, 8192), 4, "write to the second copy");
+  NS_TEST_ASSERT_MSG_EQ (map5[8192], 'c', "the shared mapping sees the write");
+  NS_TEST_ASSERT_MSG_EQ (map4[8192], 'a', "the private one does not");
+  NS_TEST_ASSERT_MSG_EQ (pwrite (copy2, "aaaa", 4, 8192), 4, "undo the write");
+  cache->Unmap (map5, FILE_SIZE);
+  munmap (map5, FILE_SIZE);
+
+  // partial and whole unmaps.
+  cache->Unmap (map1 + 4096, 4096);
+  munmap (map1 + 4096, 4096);
+  NS_TEST_ASSERT_MSG_EQ (map1[0], 'a', "what is left of a split mapping");
+  NS_TEST_ASSERT_MSG_EQ (map1[8192], 'a', "what is left of a split mapping");
+  cache->Unmap (map1, FILE_SIZE);
+  munmap (map1, FILE_SIZE);
+  cache->Unmap (map2, FILE_SIZE);
+  munmap (map2, FILE_SIZE);
+  cache->Unmap (map3, FILE_SIZE);
+  munmap (map3, FILE_SIZE);
+  cache->Unmap (map4, FILE_SIZE);
+  munmap (map4, FILE_SIZE);
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1001).mapped, 0, "all unmapped");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1002).mapped, 0, "all unmapped");
+
+  // the snapshot taken from the first copy outlives its mappings: the
+  // second copy, written back to its old content, still maps it.
+  uint8_t *map6 = (uint8_t *)cache->Map (&process2, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy2, 0);
+  NS_TEST_ASSERT_MSG_NE (map6, MAP_FAILED, "map after all the unmaps");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1002).shared, FILE_SIZE, "the snapshot is kept");
+  cache->Unmap (map6, FILE_SIZE);
+  munmap (map6, FILE_SIZE);
+
+  // without ShareFileMappings, each copy is mapped on its own.
+  Process process3;
+  process3.nodeId = 1003;
+  process3.shareFileMappings = 0;
+  uint8_t *map7 = (uint8_t *)cache->Map (&process3, 0, FILE_SIZE, PROT_READ, MAP_PRIVATE, copy2, 0);
+  NS_TEST_ASSERT_MSG_NE (map7, MAP_FAILED, "map without the cache");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1003).mapped, FILE_SIZE, "still counted");
+  NS_TEST_ASSERT_MSG_EQ (cache->GetNodeStats (1003).shared, 0, "not shared");
+  cache->Unmap (map7, FILE_SIZE);
+  munmap (map7, FILE_SIZE);
+  cache->Release (&process1);
+  cache->Release (&process2);
+  cache->Release (&process3);
+  close (copy1);
+  close (copy2);
+}
+
+static class MmapCacheTestSuite : public TestSuite
+{
+public:
+  MmapCacheTestSuite ();
+} g_mmapCacheTestSuite;
+
+MmapCacheTestSuite::MmapCacheTestSuite ()
+  : TestSuite ("dce-mmap-cache", UNIT)
+{
+  AddTestCase (new MmapCacheTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -0,0 +1,268 @@
+#include "ns3/test.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/object-factory.h"
+#include "ns3/task-manager.h"
+#include "ns3/task-scheduler.h"
+#include "ns3/process-delay-model.h"
+#include "asm-fiber-manager.h"
+#include "ucontext-fiber-manager.h"
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace ns3;
+namespace ns3 {
+
+static std::vector<int> g_order;
+
+static void
+RunTask (void *context)
+{
+  g_order.push_back ((int)(intptr_t)context);
+  TaskManager::Current ()->Exit ();
+}
+
+class TaskManagerPriorityTestCase : public TestCase
+{
+public:
+  TaskManagerPriorityTestCase ();
+private:
+  static void StartTasks (Ptr<TaskManager> manager);
+  virtual void DoRun (void);
+};
+
+TaskManagerPriorityTestCase::TaskManagerPriorityTestCase ()
+  : TestCase ("Check that a task started with a high priority runs first")
+{
+}
+
+void
+TaskManagerPriorityTestCase::StartTasks (Ptr<TaskManager> manager)
+{
+  manager->Start (&RunTask, (void *)1, 1 << 16);
+  manager->Start (&RunTask, (void *)2, 1 << 16, Task::HIGH_PRIORITY);
+}
+
+void
+TaskManagerPriorityTestCase::DoRun (void)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  Ptr<TaskManager> manager = CreateObject<TaskManager> ();
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::RunQueueTaskScheduler");
+  manager->SetScheduler (factory.Create<TaskScheduler> ());
+  factory.SetTypeId ("ns3::RandomProcessDelayModel");
+  manager->SetDelayModel (factory.Create<ProcessDelayModel> ());
+  node->AggregateObject (manager);
+
+  g_order.clear ();
+  Simulator::ScheduleWithContext (node->GetId (), Seconds (0.0),
+                                  &TaskManagerPriorityTestCase::StartTasks, manager);
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (g_order.size (), 2, "both tasks must have run");
+  NS_TEST_ASSERT_MSG_EQ (g_order[0], 2, "the kernel task must run before the one started earlier");
+  NS_TEST_ASSERT_MSG_EQ (g_order[1], 1, "the normal task must run last");
+  Simulator::Destroy ();
+}
+
+#define FIBER_SWITCHES 100
+#define FIBER_STACK_SIZE (1 << 16)
+
+/**
+ * Switch back and forth between the main stack and a fiber of the
+ * AsmFiberManager: the state of each side must survive the switches, and
+ * the fiber must run on its own stack, aligned as the ABI wants it.
+ */
+class AsmFiberManagerTestCase : public TestCase
+{
+public:
+  AsmFiberManagerTestCase ();
+private:
+  virtual void DoRun (void);
+  static void Run (void *context);
+
+  AsmFiberManager *m_manager;
+  struct Fiber *m_main;
+  struct Fiber *m_fiber;
+  uint32_t m_switches;
+  uintptr_t m_local;
+  bool m_aligned;
+  bool m_masked;
+};
+
+AsmFiberManagerTestCase::AsmFiberManagerTestCase ()
+  : TestCase ("Check the context switches and the stacks of the AsmFiberManager")
+{
+}
+
+void
+AsmFiberManagerTestCase::Run (void *context)
+{
+  AsmFiberManagerTestCase *self = (AsmFiberManagerTestCase *)context;
+  // 16 bytes, like the stack pointer at each call.
+  uint8_t aligned __attribute__ ((aligned (16)));
+  self->m_local = (uintptr_t)&aligned;
+  self->m_aligned = (((uintptr_t)&aligned) & 15) == 0;
+  sigset_t mask;
+  sigemptyset (&mask);
+  sigaddset (&mask, SIGUSR1);
+  sigprocmask (SIG_BLOCK, &mask, 0);
+  while (true)
+    {
+      self->m_switches++;
+      self->m_manager->SwitchTo (self->m_fiber, self->m_main);
+      sigprocmask (SIG_SETMASK, 0, &mask);
+      // the fiber keeps its own mask.
+      self->m_masked = self->m_masked && sigismember (&mask, SIGUSR1);
+    }
+}
+
+void
+AsmFiberManagerTestCase::DoRun (void)
+{
+  if (!AsmFiberManager::IsSupported ())
+    {
+      return;
+    }
+  m_manager = new AsmFiberManager (true);
+  m_switches = 0;
+  m_aligned = false;
+  m_masked = true;
+  m_main = m_manager->CreateFromCaller ();
+  m_fiber = m_manager->Create (&AsmFiberManagerTestCase::Run, this, FIBER_STACK_SIZE);
+  NS_TEST_ASSERT_MSG_EQ (m_manager->GetStackSize (m_fiber), FIBER_STACK_SIZE, "the stack has the size asked for");
+  NS_TEST_ASSERT_MSG_EQ (m_manager->GetStackSize (m_main), 0, "the caller has no stack of its own");
+
+  uint32_t expected = 0xdce;
+  double value = 1.25;
+  uintptr_t local = (uintptr_t)&expected;
+  for (uint32_t i = 0; i < FIBER_SWITCHES; i++)
+    {
+      m_manager->SwitchTo (m_main, m_fiber);
+      NS_TEST_ASSERT_MSG_EQ (m_switches, i + 1, "the fiber runs once per switch");
+      expected += i;
+      value *= 1.5;
+      sigset_t mask;
+      sigprocmask (SIG_SETMASK, 0, &mask);
+      NS_TEST_ASSERT_MSG_EQ (sigismember (&mask, SIGUSR1), 0, "the mask of the fiber stays in the fiber");
+    }
+  uint32_t sum = 0xdce;
+  double check = 1.25;
+  for (uint32_t i = 0; i < FIBER_SWITCHES; i++)
+    {
+      sum += i;
+      check *= 1.5;
+    }
+  NS_TEST_ASSERT_MSG_EQ (expected, sum, "the locals of the caller survive the switches");
+  NS_TEST_ASSERT_MSG_EQ (value, check, "the floating point state of the caller survives the switches");
+  NS_TEST_ASSERT_MSG_EQ ((uintptr_t)&expected, local, "the caller is back on its own stack");
+  NS_TEST_ASSERT_MSG_EQ (m_aligned, true, "the stack of the fiber is aligned");
+  NS_TEST_ASSERT_MSG_EQ (m_masked, true, "the fiber keeps its signal mask");
+  uintptr_t distance = m_local > local ? m_local - local : local - m_local;
+  NS_TEST_ASSERT_MSG_GT (distance, FIBER_STACK_SIZE, "the fiber runs on another stack");
+  uint32_t usage = m_manager->GetStackUsage (m_fiber);
+  NS_TEST_ASSERT_MSG_GT (usage, 0, "the usage of the stack is seen at the switches");
+  NS_TEST_ASSERT_MSG_LT (usage, FIBER_STACK_SIZE, "the usage of the stack fits in it");
+
+  m_manager->Delete (m_fiber);
+  m_manager->Delete (m_main);
+  delete m_manager;
+}
+
+/**
+ * The stacks freed by the UcontextFiberManager are kept in a pool by
+ * number of pages: a stack of the same number of pages must be taken
+ * back from there, a larger one must not.
+ */
+class UcontextFiberManagerStackPoolTestCase : public TestCase
+{
+public:
+  UcontextFiberManagerStackPoolTestCase ();
+private:
+  virtual void DoRun (void);
+  static void Run (void *context);
+  // the address of a local of a new fiber, near the top of its stack.
+  uintptr_t RunFiber (uint32_t stackSize, struct Fiber **fiber);
+
+  UcontextFiberManager *m_manager;
+  struct Fiber *m_main;
+  struct Fiber *m_fiber;
+  uintptr_t m_local;
+};
+
+UcontextFiberManagerStackPoolTestCase::UcontextFiberManagerStackPoolTestCase ()
+  : TestCase ("Check that the UcontextFiberManager reuses the stacks of the same number of pages")
+{
+}
+
+void
+UcontextFiberManagerStackPoolTestCase::Run (void *context)
+{
+  UcontextFiberManagerStackPoolTestCase *self = (UcontextFiberManagerStackPoolTestCase *)context;
+  uint8_t local;
+  self->m_local = (uintptr_t)&local;
+  while (true)
+    {
+      self->m_manager->SwitchTo (self->m_fiber, self->m_main);
+    }
+}
+
+uintptr_t
+UcontextFiberManagerStackPoolTestCase::RunFiber (uint32_t stackSize, struct Fiber **fiber)
+{
+  m_fiber = m_manager->Create (&UcontextFiberManagerStackPoolTestCase::Run, this, stackSize);
+  m_manager->SwitchTo (m_main, m_fiber);
+  *fiber = m_fiber;
+  return m_local;
+}
+
+void
+UcontextFiberManagerStackPoolTestCase::DoRun (void)
+{
+  uint32_t pageSize = sysconf (_SC_PAGESIZE);
+  uint32_t highWaterMark = UcontextFiberManager::GetStackPoolHighWaterMark ();
+  UcontextFiberManager::SetStackPoolHighWaterMark (16);
+  m_manager = new UcontextFiberManager ();
+  m_main = m_manager->CreateFromCaller ();
+
+  struct Fiber *first;
+  struct Fiber *second;
+  struct Fiber *third;
+  uintptr_t firstLocal = RunFiber (5 * pageSize, &first);
+  m_manager->Delete (first);
+  // the same number of pages: the stack freed above.
+  uintptr_t secondLocal = RunFiber (5 * pageSize - 100, &second);
+  uintptr_t distance = firstLocal > secondLocal ? firstLocal - secondLocal : secondLocal - firstLocal;
+  NS_TEST_ASSERT_MSG_LT (distance, pageSize, "a freed stack is reused");
+  NS_TEST_ASSERT_MSG_EQ (m_manager->GetStackSize (second), 5 * pageSize - 100, "the stack has the size asked for");
+  m_manager->Delete (second);
+  // one more page: not rounded to the same class.
+  uintptr_t thirdLocal = RunFiber (6 * pageSize, &third);
+  distance = firstLocal > thirdLocal ? firstLocal - thirdLocal : thirdLocal - firstLocal;
+  NS_TEST_ASSERT_MSG_GT (distance, pageSize, "a larger stack is not taken from a smaller class");
+  m_manager->Delete (third);
+
+  m_manager->Delete (m_main);
+  delete m_manager;
+  UcontextFiberManager::SetStackPoolHighWaterMark (highWaterMark);
+}
+
+static class TaskManagerTestSuite : public TestSuite
+{
+public:
+  TaskManagerTestSuite ();
+} g_taskManagerTestSuite;
+
+TaskManagerTestSuite::TaskManagerTestSuite ()
+  : TestSuite ("dce-task-manager", UNIT)
+{
+  AddTestCase (new TaskManagerPriorityTestCase (), TestCase::QUICK);
+  AddTestCase (new AsmFiberManagerTestCase (), TestCase::QUICK);
+  AddTestCase (new UcontextFiberManagerStackPoolTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3
@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <pthread.h>
 #include "test-macros.h"
 
 // 
@@ -15,6 +16,179 @@
 static char* readBuf[BUF_LEN];
 static char* writeBuf[BUF_LEN];
 
+static void
+test_errors (void)
+{
+  struct epoll_event ev, events[MAX_EVENTS];
+  int epollfd, fds[2], res;
+
+  epollfd = epoll_create (10);
+  TEST_ASSERT_UNEQUAL (epollfd, -1);
+  res = pipe (fds);
+  TEST_ASSERT_EQUAL (res, 0);
+  ev.events = EPOLLIN;
+  ev.data.fd = fds[0];
+
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, -1, &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, epollfd, &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EINVAL);
+  res = epoll_ctl (epollfd, EPOLL_CTL_MOD, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, ENOENT);
+  res = epoll_ctl (epollfd, EPOLL_CTL_DEL, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, ENOENT);
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, 0);
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EEXIST);
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, fds[1], NULL);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EFAULT);
+  res = epoll_ctl (epollfd, 1000, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EINVAL);
+  res = epoll_wait (epollfd, events, 0, 0);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EINVAL);
+
+  // the last close of a file removes it from the interest list.
+  close (fds[0]);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 0);
+  res = epoll_ctl (epollfd, EPOLL_CTL_DEL, fds[0], &ev);
+  TEST_ASSERT_EQUAL (res, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+
+  close (fds[1]);
+  close (epollfd);
+}
+
+static void
+test_triggers (void)
+{
+  struct epoll_event ev, events[MAX_EVENTS];
+  int epollfd, level[2], edge[2], oneshot[2], res;
+  char c = 'c';
+
+  epollfd = epoll_create (10);
+  TEST_ASSERT_UNEQUAL (epollfd, -1);
+  res = pipe (level);
+  TEST_ASSERT_EQUAL (res, 0);
+  res = pipe (edge);
+  TEST_ASSERT_EQUAL (res, 0);
+  res = pipe (oneshot);
+  TEST_ASSERT_EQUAL (res, 0);
+
+  ev.events = EPOLLIN;
+  ev.data.fd = level[0];
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, level[0], &ev);
+  TEST_ASSERT_EQUAL (res, 0);
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = edge[0];
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, edge[0], &ev);
+  TEST_ASSERT_EQUAL (res, 0);
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.fd = oneshot[0];
+  res = epoll_ctl (epollfd, EPOLL_CTL_ADD, oneshot[0], &ev);
+  TEST_ASSERT_EQUAL (res, 0);
+
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 0);
+
+  write (level[1], &c, 1);
+  write (edge[1], &c, 1);
+  write (oneshot[1], &c, 1);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 3);
+  for (int i = 0; i < res; i++)
+    {
+      TEST_ASSERT_EQUAL (events[i].events, EPOLLIN);
+    }
+
+  // nothing read: only the level triggered file is reported again.
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 1);
+  TEST_ASSERT_EQUAL (events[0].data.fd, level[0]);
+
+  // new data: the edge triggered file is reported, the oneshot one is disabled.
+  write (edge[1], &c, 1);
+  write (oneshot[1], &c, 1);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 2);
+  TEST_ASSERT_UNEQUAL (events[0].data.fd, oneshot[0]);
+  TEST_ASSERT_UNEQUAL (events[1].data.fd, oneshot[0]);
+
+  // EPOLL_CTL_MOD enables the oneshot file again.
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.fd = oneshot[0];
+  res = epoll_ctl (epollfd, EPOLL_CTL_MOD, oneshot[0], &ev);
+  TEST_ASSERT_EQUAL (res, 0);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 2);
+  TEST_ASSERT (events[0].data.fd == oneshot[0] || events[1].data.fd == oneshot[0]);
+
+  // the level triggered file is not reported once read.
+  char buf[4];
+  res = read (level[0], buf, sizeof (buf));
+  TEST_ASSERT_EQUAL (res, 1);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 0);
+
+  close (level[0]);
+  close (level[1]);
+  close (edge[0]);
+  close (edge[1]);
+  close (oneshot[0]);
+  close (oneshot[1]);
+  close (epollfd);
+}
+
+static void
+test_maxevents (void)
+{
+  struct epoll_event ev, events[MAX_EVENTS];
+  int epollfd, fds[3][2], res;
+  char c = 'c';
+
+  epollfd = epoll_create (10);
+  TEST_ASSERT_UNEQUAL (epollfd, -1);
+  for (int i = 0; i < 3; i++)
+    {
+      res = pipe (fds[i]);
+      TEST_ASSERT_EQUAL (res, 0);
+      ev.events = EPOLLIN;
+      ev.data.u32 = i;
+      res = epoll_ctl (epollfd, EPOLL_CTL_ADD, fds[i][0], &ev);
+      TEST_ASSERT_EQUAL (res, 0);
+      write (fds[i][1], &c, 1);
+    }
+
+  // the files not reported stay ready for the next call.
+  res = epoll_wait (epollfd, events, 2, 0);
+  TEST_ASSERT_EQUAL (res, 2);
+  uint32_t first = events[0].data.u32;
+  uint32_t second = events[1].data.u32;
+  TEST_ASSERT_UNEQUAL (first, second);
+  res = epoll_wait (epollfd, events, 1, 0);
+  TEST_ASSERT_EQUAL (res, 1);
+  TEST_ASSERT_UNEQUAL (events[0].data.u32, first);
+  TEST_ASSERT_UNEQUAL (events[0].data.u32, second);
+  res = epoll_wait (epollfd, events, MAX_EVENTS, 0);
+  TEST_ASSERT_EQUAL (res, 3);
+
+  for (int i = 0; i < 3; i++)
+    {
+      close (fds[i][0]);
+      close (fds[i][1]);
+    }
+  close (epollfd);
+}
+
 static void *
 server1 (void *arg)
 {
@@ -53,11 +227,12 @@ server1 (void *arg)
   res = epoll_ctl (epollfd, EPOLL_CTL_ADD, sock, &ev);
   TEST_ASSERT_UNEQUAL (res, -1);
 
-  for (;;)
+  bool done = false;
+  while (!done)
     {
       printf ("epoll wait\n");
       nfds = epoll_wait (epollfd, events, MAX_EVENTS, -1);
-      TEST_ASSERT_UNEQUAL (res, -1);
+      TEST_ASSERT_UNEQUAL (nfds, -1);
 
       printf ("epoll wake\n");
       for (n = 0; n < nfds; ++n)
@@ -77,9 +252,13 @@ server1 (void *arg)
             {
               res = read (events[n].data.fd, readBuf, BUF_LEN);
               TEST_ASSERT_EQUAL (res, 64);
+              close (events[n].data.fd);
+              done = true;
             }
         }
     }
+  close (sock);
+  close (epollfd);
   return arg;
 }
 
@@ -158,6 +337,10 @@ launch (void *(*clientStart)(void *), void *(*serverStart)(void *))
 int
 main (int argc, char *argv[])
 {
-
+  test_errors ();
+  test_triggers ();
+  test_maxevents ();
   launch (server1, client1);
+
+  return 0;
 }
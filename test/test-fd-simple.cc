@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <stdio.h>
 #include <limits.h>
+#include <sys/sendfile.h>
 
 static void test_open_exclusive (void)
 {
@@ -454,6 +455,156 @@ void test_fsync ()
   TEST_ASSERT_EQUAL (status, 0);
 }
 
+static void test_fd_allocation (void)
+{
+  int fds[200];
+  int status, fd;
+
+  fd = open ("X", O_CREAT | O_TRUNC | O_RDWR, S_IRWXU);
+  TEST_ASSERT (fd >= 3);
+  fds[0] = fd;
+  // grow the table across several bitmap words.
+  for (int i = 1; i < 200; i++)
+    {
+      fds[i] = dup (fds[0]);
+      TEST_ASSERT_EQUAL (fds[i], fds[0] + i);
+    }
+
+  // the lowest free fd is reused first.
+  status = close (fds[150]);
+  TEST_ASSERT_EQUAL (status, 0);
+  status = close (fds[70]);
+  TEST_ASSERT_EQUAL (status, 0);
+  fd = dup (fds[0]);
+  TEST_ASSERT_EQUAL (fd, fds[70]);
+  fd = dup (fds[0]);
+  TEST_ASSERT_EQUAL (fd, fds[150]);
+  fd = dup (fds[0]);
+  TEST_ASSERT_EQUAL (fd, fds[199] + 1);
+  status = close (fd);
+  TEST_ASSERT_EQUAL (status, 0);
+
+  // dup2 into a hole and onto an fd in use.
+  status = close (fds[10]);
+  TEST_ASSERT_EQUAL (status, 0);
+  fd = dup2 (fds[0], fds[10]);
+  TEST_ASSERT_EQUAL (fd, fds[10]);
+  fd = dup2 (fds[0], fds[20]);
+  TEST_ASSERT_EQUAL (fd, fds[20]);
+  fd = dup2 (fds[0], fds[0]);
+  TEST_ASSERT_EQUAL (fd, fds[0]);
+
+  // dup2 far after the end of the table leaves a hole behind.
+  fd = dup2 (fds[0], 5000);
+  TEST_ASSERT_EQUAL (fd, 5000);
+  fd = dup (fds[0]);
+  TEST_ASSERT_EQUAL (fd, fds[199] + 1);
+  status = close (fd);
+  TEST_ASSERT_EQUAL (status, 0);
+  status = close (5000);
+  TEST_ASSERT_EQUAL (status, 0);
+  status = close (5000);
+  TEST_ASSERT_EQUAL (status, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+
+  // invalid targets.
+  status = dup2 (fds[0], -1);
+  TEST_ASSERT_EQUAL (status, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+  status = dup2 (fds[0], 65536);
+  TEST_ASSERT_EQUAL (status, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+  status = dup2 (-1, fds[1]);
+  TEST_ASSERT_EQUAL (status, -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+
+  for (int i = 0; i < 200; i++)
+    {
+      status = close (fds[i]);
+      TEST_ASSERT_EQUAL (status, 0);
+    }
+  status = unlink ("X");
+  TEST_ASSERT_EQUAL (status, 0);
+}
+
+static void test_sendfile (void)
+{
+  static char content[300000];
+  static char buf[sizeof (content)];
+  int in, out, fds[2], status;
+  off_t offset;
+  ssize_t sent;
+
+  for (uint32_t i = 0; i < sizeof (content); i++)
+    {
+      content[i] = (i * 13) & 0xff;
+    }
+  in = open ("X", O_CREAT | O_TRUNC | O_RDWR, S_IRWXU);
+  TEST_ASSERT (in >= 0);
+  sent = write (in, content, sizeof (content));
+  TEST_ASSERT_EQUAL (sent, sizeof (content));
+  lseek (in, 0, SEEK_SET);
+
+  // no offset: from the file offset, which moves. More than a chunk.
+  out = open ("Y", O_CREAT | O_TRUNC | O_RDWR, S_IRWXU);
+  TEST_ASSERT (out >= 0);
+  sent = sendfile (out, in, NULL, 100000);
+  TEST_ASSERT_EQUAL (sent, 100000);
+  TEST_ASSERT_EQUAL (lseek (in, 0, SEEK_CUR), 100000);
+
+  // an offset: the file offset does not move.
+  offset = 250000;
+  sent = sendfile (out, in, &offset, 10000);
+  TEST_ASSERT_EQUAL (sent, 10000);
+  TEST_ASSERT_EQUAL (offset, 260000);
+  TEST_ASSERT_EQUAL (lseek (in, 0, SEEK_CUR), 100000);
+
+  // up to the end of the file, then nothing.
+  sent = sendfile (out, in, &offset, 100000);
+  TEST_ASSERT_EQUAL (sent, sizeof (content) - 260000);
+  TEST_ASSERT_EQUAL (offset, sizeof (content));
+  sent = sendfile (out, in, &offset, 100000);
+  TEST_ASSERT_EQUAL (sent, 0);
+
+  lseek (out, 0, SEEK_SET);
+  sent = read (out, buf, sizeof (buf));
+  TEST_ASSERT_EQUAL (sent, 100000 + 10000 + sizeof (content) - 260000);
+  TEST_ASSERT_EQUAL (memcmp (buf, content, 100000), 0);
+  TEST_ASSERT_EQUAL (memcmp (buf + 100000, content + 250000, sizeof (content) - 250000), 0);
+
+  // to a pipe, which has no host fd, from an unaligned offset.
+  status = pipe (fds);
+  TEST_ASSERT_EQUAL (status, 0);
+  offset = 4097;
+  sent = sendfile (fds[1], in, &offset, 3000);
+  TEST_ASSERT_EQUAL (sent, 3000);
+  TEST_ASSERT_EQUAL (offset, 7097);
+  sent = read (fds[0], buf, sizeof (buf));
+  TEST_ASSERT_EQUAL (sent, 3000);
+  TEST_ASSERT_EQUAL (memcmp (buf, content + 4097, 3000), 0);
+  lseek (in, sizeof (content) - 100, SEEK_SET);
+  sent = sendfile (fds[1], in, NULL, 3000);
+  TEST_ASSERT_EQUAL (sent, 100);
+  TEST_ASSERT_EQUAL (lseek (in, 0, SEEK_CUR), sizeof (content));
+  sent = read (fds[0], buf, sizeof (buf));
+  TEST_ASSERT_EQUAL (sent, 100);
+  TEST_ASSERT_EQUAL (memcmp (buf, content + sizeof (content) - 100, 100), 0);
+
+  // the source must be seekable.
+  sent = sendfile (out, fds[0], NULL, 10);
+  TEST_ASSERT_EQUAL (sent, -1);
+  TEST_ASSERT_EQUAL (errno, EINVAL);
+
+  close (fds[0]);
+  close (fds[1]);
+  close (in);
+  close (out);
+  status = unlink ("X");
+  TEST_ASSERT_EQUAL (status, 0);
+  status = unlink ("Y");
+  TEST_ASSERT_EQUAL (status, 0);
+}
+
 int main (int argc, char *argv[])
 {
   test_file_usage ();
@@ -470,6 +621,8 @@ int main (int argc, char *argv[])
   test_unlinkat ();
   test_pread_pwrite ();
   test_fsync ();
+  test_fd_allocation ();
+  test_sendfile ();
 
   return 0;
 }
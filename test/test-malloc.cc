@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <list>
+#include "test-macros.h"
 
 int main (int argc, char *argv[])
 {
@@ -10,6 +11,8 @@ int main (int argc, char *argv[])
     {
       int size = sizes[i];
       void *ptr = malloc (size);
+      // the buffers of every size are 16-byte aligned.
+      TEST_ASSERT_EQUAL ((uintptr_t)ptr % 16, 0);
       memset (ptr, 0x66, size);
       free (ptr);
     }
@@ -28,5 +31,38 @@ int main (int argc, char *argv[])
     }
   ptrs.clear ();
 
+  // freed runs next to each other are merged and reused by a larger one.
+  void *runs[8];
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      runs[i] = malloc (4000);
+      TEST_ASSERT_EQUAL ((uintptr_t)runs[i] % 16, 0);
+    }
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      free (runs[i]);
+    }
+  void *large = malloc (6 * 4096);
+  TEST_ASSERT_EQUAL ((uintptr_t)large % 16, 0);
+  memset (large, 0x66, 6 * 4096);
+
+  // realloc keeps the content across classes, runs and mmaps.
+  uint8_t *buffer = (uint8_t *)malloc (10);
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      buffer[i] = i;
+    }
+  for (uint32_t size = 20; size < 200000; size = size * 3 + 1)
+    {
+      buffer = (uint8_t *)realloc (buffer, size);
+      TEST_ASSERT_EQUAL ((uintptr_t)buffer % 16, 0);
+      for (uint32_t i = 0; i < 10; i++)
+        {
+          TEST_ASSERT_EQUAL (buffer[i], i);
+        }
+    }
+  free (buffer);
+  free (large);
+
   return 0;
 }
@@ -8,6 +8,8 @@
 #include <pthread.h>
 #include <signal.h>
 #include <sys/select.h>
+#include <string.h>
+#include <sys/uio.h>
 
 #define MAXLINE 4096
 
@@ -386,6 +388,129 @@ test6 ()
     }
 }
 
+// splice and tee between two pipes.
+void
+test7 ()
+{
+  int a[2], b[2];
+  char buf[16];
+
+  if (pipe (a) < 0 || pipe (b) < 0)
+    {
+      err_sys ((char*)"pipe error");
+    }
+  TEST_ASSERT_EQUAL (write (a[1], "0123456789", 10), 10);
+
+  // tee leaves the data in a.
+  TEST_ASSERT_EQUAL (tee (a[0], b[1], 4, 0), 4);
+  TEST_ASSERT_EQUAL (read (b[0], buf, sizeof (buf)), 4);
+  TEST_ASSERT (memcmp (buf, "0123", 4) == 0);
+
+  // splice moves it.
+  TEST_ASSERT_EQUAL (splice (a[0], NULL, b[1], NULL, 6, 0), 6);
+  TEST_ASSERT_EQUAL (read (b[0], buf, sizeof (buf)), 6);
+  TEST_ASSERT (memcmp (buf, "012345", 6) == 0);
+  TEST_ASSERT_EQUAL (read (a[0], buf, sizeof (buf)), 4);
+  TEST_ASSERT (memcmp (buf, "6789", 4) == 0);
+
+  // empty pipe.
+  TEST_ASSERT_EQUAL (splice (a[0], NULL, b[1], NULL, 6, SPLICE_F_NONBLOCK), -1);
+  TEST_ASSERT_EQUAL (errno, EAGAIN);
+  // not the read end.
+  TEST_ASSERT_EQUAL (tee (a[1], b[1], 6, 0), -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+
+  close (a[0]);
+  close (a[1]);
+  close (b[0]);
+  close (b[1]);
+}
+
+void
+test8 ()
+{
+  int a[2];
+  char buf[4096];
+  struct iovec iov[2];
+
+  if (pipe (a) < 0)
+    {
+      err_sys ((char*)"pipe error");
+    }
+  TEST_ASSERT_EQUAL (fcntl (a[0], F_SETPIPE_SZ, 5000), 8192);
+  TEST_ASSERT_EQUAL (fcntl (a[1], F_GETPIPE_SZ), 8192);
+
+  iov[0].iov_base = (void *)"01234567";
+  iov[0].iov_len = 8;
+  TEST_ASSERT_EQUAL (vmsplice (a[1], iov, 1, 0), 8);
+  TEST_ASSERT_EQUAL (fcntl (a[0], F_SETPIPE_SZ, 0), 4096);
+
+  // a write of PIPE_BUF bytes is all or nothing.
+  fcntl (a[1], F_SETFL, O_NONBLOCK);
+  memset (buf, 'x', sizeof (buf));
+  TEST_ASSERT_EQUAL (write (a[1], buf, 4096), -1);
+  TEST_ASSERT_EQUAL (errno, EAGAIN);
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 6;
+  iov[1].iov_base = buf + 6;
+  iov[1].iov_len = 6;
+  TEST_ASSERT_EQUAL (vmsplice (a[0], iov, 2, 0), 8);
+  TEST_ASSERT (memcmp (buf, "01234567", 8) == 0);
+
+  close (a[0]);
+  close (a[1]);
+}
+
+void
+test9 ()
+{
+  int a[2];
+  char buf[8192];
+  struct iovec iov[3];
+
+  TEST_ASSERT_EQUAL (pipe (a), 0);
+  TEST_ASSERT_EQUAL (writev (a[1], iov, 0), 0);
+  iov[0].iov_base = (void *)"ab";
+  iov[0].iov_len = 2;
+  iov[1].iov_base = (void *)"";
+  iov[1].iov_len = 0;
+  iov[2].iov_base = (void *)"cdef";
+  iov[2].iov_len = 4;
+  TEST_ASSERT_EQUAL (writev (a[1], iov, 3), 6);
+  TEST_ASSERT_EQUAL (readv (a[1], iov, 3), -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+  TEST_ASSERT_EQUAL (writev (a[0], iov, 3), -1);
+  TEST_ASSERT_EQUAL (errno, EBADF);
+
+  // scattered on the buffers, up to what is in the pipe.
+  memset (buf, 0, sizeof (buf));
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 4;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = 4;
+  TEST_ASSERT_EQUAL (readv (a[0], iov, 2), 6);
+  TEST_ASSERT (memcmp (buf, "abcd", 4) == 0);
+  TEST_ASSERT (memcmp (buf + 100, "ef", 2) == 0);
+
+  // more than PIPE_BUF: as much as fits without blocking.
+  TEST_ASSERT_EQUAL (fcntl (a[1], F_SETPIPE_SZ, 4096), 4096);
+  fcntl (a[1], F_SETFL, O_NONBLOCK);
+  memset (buf, 'y', sizeof (buf));
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 3000;
+  iov[1].iov_base = buf + 3000;
+  iov[1].iov_len = 3000;
+  TEST_ASSERT_EQUAL (writev (a[1], iov, 2), 4096);
+  TEST_ASSERT_EQUAL (writev (a[1], iov, 2), -1);
+  TEST_ASSERT_EQUAL (errno, EAGAIN);
+  iov[0].iov_len = 4000;
+  iov[1].iov_len = 4000;
+  TEST_ASSERT_EQUAL (readv (a[0], iov, 2), 4096);
+
+  close (a[0]);
+  close (a[1]);
+}
 
 int
 main (int c, char **v)
@@ -396,6 +521,9 @@ main (int c, char **v)
   test4 ();
   test5 ();
   test6 ();
+  test7 ();
+  test8 ();
+  test9 ();
 
   return 0;
 }
@@ -245,6 +245,93 @@ void test_udp (int connected)
   TEST_ASSERT_UNEQUAL (sock, -1);
 }
 
+void test_udp_batch (void)
+{
+  int sock;
+  char bufs[4][8];
+  struct mmsghdr msgs[4];
+  struct iovec iovs[4];
+  static struct sockaddr_in dst;
+  int ret;
+
+  sock = socket (AF_INET, SOCK_DGRAM, 0);
+  TEST_ASSERT_UNEQUAL (sock, -1);
+
+  memset (&dst, 0, sizeof (dst));
+  dst.sin_family = AF_INET;
+  dst.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  dst.sin_port = htons (31);
+  ret = bind (sock, (struct sockaddr *)&dst, sizeof (dst));
+  TEST_ASSERT_UNEQUAL (ret, -1);
+
+  // sendmmsg: one datagram per message, of different sizes
+  memset (msgs, 0, sizeof (msgs));
+  for (int i = 0; i < 4; i++)
+    {
+      memset (bufs[i], 'a' + i, sizeof (bufs[i]));
+      iovs[i].iov_base = bufs[i];
+      iovs[i].iov_len = i + 1;
+      msgs[i].msg_hdr.msg_name = &dst;
+      msgs[i].msg_hdr.msg_namelen = sizeof (dst);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  ret = sendmmsg (sock, msgs, 4, 0);
+  TEST_ASSERT_EQUAL (ret, 4);
+  for (int i = 0; i < 4; i++)
+    {
+      TEST_ASSERT_EQUAL (msgs[i].msg_len, i + 1);
+    }
+  OUTPUT ("UDP sendmmsg ret = " << ret);
+
+  // recvmmsg: the datagrams come back in order
+  memset (bufs, 0, sizeof (bufs));
+  memset (msgs, 0, sizeof (msgs));
+  for (int i = 0; i < 4; i++)
+    {
+      iovs[i].iov_base = bufs[i];
+      iovs[i].iov_len = sizeof (bufs[i]);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+  ret = recvmmsg (sock, msgs, 4, 0, NULL);
+  TEST_ASSERT_EQUAL (ret, 4);
+  for (int i = 0; i < 4; i++)
+    {
+      TEST_ASSERT_EQUAL (msgs[i].msg_len, i + 1);
+      TEST_ASSERT_EQUAL (bufs[i][0], 'a' + i);
+    }
+  OUTPUT ("UDP recvmmsg ret = " << ret);
+
+  // nothing left: MSG_DONTWAIT fails on the first message
+  ret = recvmmsg (sock, msgs, 4, MSG_DONTWAIT, NULL);
+  TEST_ASSERT_EQUAL (ret, -1);
+  TEST_ASSERT_EQUAL (errno, EAGAIN);
+
+  // MSG_WAITFORONE returns what is there after the first one
+  for (int i = 0; i < 2; i++)
+    {
+      msgs[i].msg_hdr.msg_name = &dst;
+      msgs[i].msg_hdr.msg_namelen = sizeof (dst);
+    }
+  ret = sendmmsg (sock, msgs, 2, 0);
+  TEST_ASSERT_EQUAL (ret, 2);
+  ret = recvmmsg (sock, msgs, 4, MSG_WAITFORONE, NULL);
+  TEST_ASSERT (ret >= 1 && ret <= 2);
+
+  // the time left is written back into the timeout
+  struct timespec timeout;
+  timeout.tv_sec = 1;
+  timeout.tv_nsec = 0;
+  ret = sendmmsg (sock, msgs, 1, 0);
+  TEST_ASSERT_EQUAL (ret, 1);
+  ret = recvmmsg (sock, msgs, 4, MSG_WAITFORONE, &timeout);
+  TEST_ASSERT_EQUAL (ret, 1);
+  TEST_ASSERT (timeout.tv_sec == 0 || (timeout.tv_sec == 1 && timeout.tv_nsec == 0));
+
+  close (sock);
+}
+
 static void *
 thread_recv (void *arg)
 {
@@ -526,6 +613,7 @@ int main (int argc, char *argv[])
   test_raw6 ();
   test_udp (0);
   test_udp (1);
+  test_udp_batch ();
   test_tcp ();
   test_netlink ();
 
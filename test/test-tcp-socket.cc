@@ -13,6 +13,7 @@
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 #define BUFF_LEN ((size_t) 33 * 1024)
 
@@ -1283,6 +1284,120 @@ server15 (void *arg)
   return arg;
 }
 
+// TEST 16: writev and readv on several buffers of uneven sizes
+static void *
+client16 (void *arg)
+{
+  int status;
+  struct sockaddr_in ad;
+  int sock = -1;
+
+  sleep (1);
+
+  sock = socket (AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT (sock >= 0);
+
+  fill_addr (ad, 1245);
+  status = connect (sock, (struct sockaddr *) &ad, sizeof(ad));
+  TEST_ASSERT_EQUAL (status, 0);
+
+  for (size_t i = 0; i < BUFF_LEN; i++)
+    {
+      sendBuffer[i] = (i * 7) & 0xff;
+    }
+
+  size_t sizes[] = { 1, 100, 5000, 27, BUFF_LEN - 5128 };
+  struct iovec iov[5];
+  size_t offset = 0;
+  for (int i = 0; i < 5; i++)
+    {
+      iov[i].iov_base = sendBuffer + offset;
+      iov[i].iov_len = sizes[i];
+      offset += sizes[i];
+    }
+  size_t tot = 0;
+  int first = 0;
+  while (tot < BUFF_LEN)
+    {
+      status = writev (sock, iov + first, 5 - first);
+      printf ("Client16: writev %d\n", status);
+      TEST_ASSERT (status > 0);
+      tot += status;
+      // skip what was sent.
+      size_t sent = status;
+      while (first < 5 && sent >= iov[first].iov_len)
+        {
+          sent -= iov[first].iov_len;
+          first++;
+        }
+      if (first < 5)
+        {
+          iov[first].iov_base = (char *)iov[first].iov_base + sent;
+          iov[first].iov_len -= sent;
+        }
+    }
+  TEST_ASSERT_EQUAL (tot, BUFF_LEN);
+
+  status = close (sock);
+  TEST_ASSERT_EQUAL (status, 0);
+
+  return arg;
+}
+
+static void *
+server16 (void *arg)
+{
+  int status;
+  int sock = -1;
+  int sockin = -1;
+  struct sockaddr_in ad;
+
+  sock = socket (AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT (sock >= 0);
+
+  fill_addr (ad, 1245);
+  status = bind (sock, (struct sockaddr *) &ad, sizeof(ad));
+  TEST_ASSERT_EQUAL (status, 0);
+
+  status = listen (sock, 1);
+  TEST_ASSERT_EQUAL (status, 0);
+
+  sockin = accept (sock, NULL, NULL);
+  TEST_ASSERT (sockin >= 0);
+
+  status = close (sock);
+  TEST_ASSERT_EQUAL (status, 0);
+
+  memset (readBuffer, 0, BUFF_LEN);
+  // each readv scatters on three buffers of the remaining space.
+  size_t tot = 0;
+  while (tot < BUFF_LEN)
+    {
+      size_t left = BUFF_LEN - tot;
+      struct iovec iov[3];
+      iov[0].iov_base = readBuffer + tot;
+      iov[0].iov_len = left < 3 ? left : 3;
+      iov[1].iov_base = readBuffer + tot + iov[0].iov_len;
+      iov[1].iov_len = (left - iov[0].iov_len) / 2;
+      iov[2].iov_base = (char *)iov[1].iov_base + iov[1].iov_len;
+      iov[2].iov_len = left - iov[0].iov_len - iov[1].iov_len;
+      status = readv (sockin, iov, 3);
+      printf ("Server16: readv %d / %ld\n", status, left);
+      TEST_ASSERT (status > 0);
+      tot += status;
+    }
+  TEST_ASSERT_EQUAL (tot, BUFF_LEN);
+
+  for (size_t i = 0; i < BUFF_LEN; i++)
+    {
+      TEST_ASSERT_EQUAL (readBuffer[i], sendBuffer[i]);
+    }
+
+  status = close (sockin);
+  TEST_ASSERT_EQUAL (status, 0);
+
+  return arg;
+}
 
 
 static void
@@ -1358,6 +1473,7 @@ main (int argc, char *argv[])
   launch (client12, client12);
   launch (client13, server13);
   launch (client14, server14);
+  launch (client16, server16);
 
   if (0)
     {
@@ -0,0 +1,292 @@
+#include "ns3/test.h"
+#include "ns3/timer-wheel.h"
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+using namespace ns3;
+namespace ns3 {
+
+/**
+ * Drive a TimerWheel the way its owners do: call Expire at each tick
+ * returned by GetNext and record when each entry came out.
+ */
+class TimerWheelTestCase : public TestCase
+{
+public:
+  TimerWheelTestCase ();
+private:
+  struct Timer
+  {
+    TimerWheel::Entry entry;
+    uint64_t expire;
+    uint64_t fired; // 0 if not fired.
+  };
+  void Add (uint64_t expire);
+  // returns the number of calls to Expire needed to empty the wheel.
+  uint32_t RunUntilEmpty (void);
+  virtual void DoRun (void);
+
+  TimerWheel m_wheel;
+  std::vector<struct Timer *> m_timers;
+  uint64_t m_now;
+};
+
+TimerWheelTestCase::TimerWheelTestCase ()
+  : TestCase ("Check insert, remove, cascade and GetNext of TimerWheel"),
+    m_now (0)
+{
+}
+
+void
+TimerWheelTestCase::Add (uint64_t expire)
+{
+  struct Timer *timer = new Timer ();
+  TimerWheel::InitEntry (&timer->entry, timer);
+  timer->expire = expire;
+  timer->fired = 0;
+  m_wheel.Insert (&timer->entry, expire);
+  m_timers.push_back (timer);
+}
+
+uint32_t
+TimerWheelTestCase::RunUntilEmpty (void)
+{
+  uint32_t calls = 0;
+  uint64_t next;
+  while (m_wheel.GetNext (m_now, &next))
+    {
+      m_now = next;
+      calls++;
+      TimerWheel::Entry *entry = m_wheel.Expire (m_now);
+      while (entry != 0)
+        {
+          TimerWheel::Entry *following = entry->next;
+          ((struct Timer *)entry->context)->fired = m_now;
+          entry = following;
+        }
+    }
+  return calls;
+}
+
+void
+TimerWheelTestCase::DoRun (void)
+{
+  // one entry per level, at the edges of the slots and far away.
+  uint64_t expires[] = { 1, 63, 64, 65, 4095, 4096, 4097, 100000, 262143, 262144,
+                         (1ULL << 30) + 7, (1ULL << 45) + 3, (1ULL << 59) + 1,
+                         (1ULL << 60) + 5, (1ULL << 62) + 11 };
+  uint32_t n = sizeof (expires) / sizeof (expires[0]);
+  for (uint32_t i = 0; i < n; i++)
+    {
+      Add (expires[i]);
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.IsEmpty (), false, "the entries are armed");
+
+  // a removed entry and a moved one.
+  Add (500);
+  m_wheel.Remove (&m_timers.back ()->entry);
+  NS_TEST_ASSERT_MSG_EQ (TimerWheel::IsArmed (&m_timers.back ()->entry), false, "removed");
+  Add (700);
+  m_wheel.Insert (&m_timers.back ()->entry, 70000);
+  m_timers.back ()->expire = 70000;
+
+  uint64_t next;
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNext (0, &next), true, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (next, 1, "the first entry is due at tick 1");
+
+  // the cascades do not wake the owner up: one call per expiry, with
+  // the moved entry.
+  uint32_t calls = RunUntilEmpty ();
+  NS_TEST_ASSERT_MSG_EQ (calls, n + 1, "one call to Expire per entry");
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.IsEmpty (), true, "every entry expired");
+  for (uint32_t i = 0; i < m_timers.size (); i++)
+    {
+      struct Timer *timer = m_timers[i];
+      if (i == n)
+        {
+          NS_TEST_ASSERT_MSG_EQ (timer->fired, 0, "a removed entry never expires");
+          continue;
+        }
+      NS_TEST_ASSERT_MSG_EQ (timer->fired, timer->expire, "each entry expires exactly at its tick");
+      NS_TEST_ASSERT_MSG_EQ (timer->entry.expire, timer->expire, "the expiry is kept");
+    }
+  for (uint32_t i = 0; i < m_timers.size (); i++)
+    {
+      delete m_timers[i];
+    }
+  m_timers.clear ();
+
+  // GetNext never returns a tick earlier than now, and Expire at the
+  // current tick returns the entries which are due.
+  Add (m_now + 10);
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNext (m_now + 20, &next), true, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (next, m_now + 20, "late: next is now");
+  m_now += 20;
+  TimerWheel::Entry *entry = m_wheel.Expire (m_now);
+  NS_TEST_ASSERT_MSG_EQ (entry, &m_timers.back ()->entry, "the late entry expires");
+  NS_TEST_ASSERT_MSG_EQ (entry->next, (TimerWheel::Entry *)0, "alone");
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.IsEmpty (), true, "nothing left");
+  delete m_timers.back ();
+  m_timers.clear ();
+}
+
+/**
+ * Arm, re-arm and cancel entries from the code run for the expired ones,
+ * as the owners of a wheel do, and check the order of the expiries.
+ */
+class TimerWheelCallbackTestCase : public TestCase
+{
+public:
+  TimerWheelCallbackTestCase ();
+private:
+  struct Timer
+  {
+    TimerWheel::Entry entry;
+    char name;
+    bool cancelled; // taken out of the wheel by Expire, not run yet.
+  };
+  struct Timer * Timer (char name);
+  void Cancel (char name);
+  void Fire (struct Timer *timer);
+  // returns the number of calls to Expire.
+  uint32_t RunUntilEmpty (void);
+  virtual void DoRun (void);
+
+  TimerWheel m_wheel;
+  struct Timer m_timers[8];
+  std::string m_fired;
+  std::vector<uint64_t> m_ticks;
+  uint64_t m_now;
+};
+
+TimerWheelCallbackTestCase::TimerWheelCallbackTestCase ()
+  : TestCase ("Check the expiries of TimerWheel with entries changed while they expire"),
+    m_now (0)
+{
+}
+
+struct TimerWheelCallbackTestCase::Timer *
+TimerWheelCallbackTestCase::Timer (char name)
+{
+  return &m_timers[name - 'A'];
+}
+
+void
+TimerWheelCallbackTestCase::Cancel (char name)
+{
+  struct Timer *timer = Timer (name);
+  if (!TimerWheel::IsArmed (&timer->entry))
+    {
+      // in the batch being run.
+      timer->cancelled = true;
+    }
+  m_wheel.Remove (&timer->entry);
+}
+
+void
+TimerWheelCallbackTestCase::Fire (struct Timer *timer)
+{
+  m_fired += timer->name;
+  m_ticks.push_back (m_now);
+  if (timer->name == 'B' && m_now == 500)
+    {
+      // arm an other entry for a tick which already has some, then re-arm
+      // itself after it.
+      m_wheel.Insert (&Timer ('D')->entry, 1000);
+      m_wheel.Insert (&timer->entry, 1000);
+    }
+  else if (timer->name == 'A' && m_now == 1000)
+    {
+      // cancel an entry of the same batch and one still in the wheel.
+      Cancel ('C');
+      Cancel ('E');
+    }
+  else if (timer->name == 'D')
+    {
+      // re-arm an entry of the same batch which already ran.
+      m_wheel.Insert (&Timer ('A')->entry, 1500);
+    }
+}
+
+uint32_t
+TimerWheelCallbackTestCase::RunUntilEmpty (void)
+{
+  uint32_t calls = 0;
+  uint64_t next;
+  while (m_wheel.GetNext (m_now, &next))
+    {
+      m_now = next;
+      calls++;
+      TimerWheel::Entry *entry = m_wheel.Expire (m_now);
+      for (TimerWheel::Entry *i = entry; i != 0; i = i->next)
+        {
+          ((struct Timer *)i->context)->cancelled = false;
+        }
+      while (entry != 0)
+        {
+          TimerWheel::Entry *following = entry->next;
+          struct Timer *timer = (struct Timer *)entry->context;
+          if (!timer->cancelled)
+            {
+              Fire (timer);
+            }
+          entry = following;
+        }
+    }
+  return calls;
+}
+
+void
+TimerWheelCallbackTestCase::DoRun (void)
+{
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      TimerWheel::InitEntry (&m_timers[i].entry, &m_timers[i]);
+      m_timers[i].name = 'A' + i;
+      m_timers[i].cancelled = false;
+    }
+  // a single timer of 200ms, in nanoseconds, wakes the owner up once.
+  m_wheel.Insert (&Timer ('H')->entry, 200000000);
+  uint64_t next;
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNext (0, &next), true, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (next, 200000000, "GetNext is the expiry, not a cascade");
+
+  m_wheel.Insert (&Timer ('A')->entry, 1000);
+  m_wheel.Insert (&Timer ('B')->entry, 500);
+  m_wheel.Insert (&Timer ('C')->entry, 1000);
+  m_wheel.Insert (&Timer ('E')->entry, 2000);
+  m_wheel.Insert (&Timer ('F')->entry, 800);
+  m_wheel.Insert (&Timer ('G')->entry, 100);
+  m_wheel.Remove (&Timer ('F')->entry);
+  // moved later.
+  m_wheel.Insert (&Timer ('G')->entry, 1200);
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.GetNext (0, &next), true, "not empty");
+  NS_TEST_ASSERT_MSG_EQ (next, 500, "the earliest entry");
+
+  uint32_t calls = RunUntilEmpty ();
+  NS_TEST_ASSERT_MSG_EQ (m_fired, "BADBGAH", "the entries of a tick expire in the order of their Insert");
+  static const uint64_t ticks[] = { 500, 1000, 1000, 1000, 1200, 1500, 200000000 };
+  NS_TEST_ASSERT_MSG_EQ (m_ticks.size (), 7, "the removed and cancelled entries never expire");
+  for (uint32_t i = 0; i < m_ticks.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_ticks[i], ticks[i], "each entry expires at its tick");
+    }
+  NS_TEST_ASSERT_MSG_EQ (calls, 5, "one call to Expire per tick with an expiry");
+  NS_TEST_ASSERT_MSG_EQ (m_wheel.IsEmpty (), true, "nothing left");
+}
+
+static class TimerWheelTestSuite : public TestSuite
+{
+public:
+  TimerWheelTestSuite ();
+} g_timerWheelTestSuite;
+
+TimerWheelTestSuite::TimerWheelTestSuite ()
+  : TestSuite ("dce-timer-wheel", UNIT)
+{
+  AddTestCase (new TimerWheelTestCase (), TestCase::QUICK);
+  AddTestCase (new TimerWheelCallbackTestCase (), TestCase::QUICK);
+}
+
+} // namespace ns3